@@ -28,6 +28,7 @@
 
 #include "plugin.h"
 #include "utils/common/common.h"
+#include "utils/ddsketch/ddsketch.h"
 #include "utils/lookup/vl_lookup.h"
 #include "utils/metadata/meta_data.h"
 #include "utils_cache.h" /* for uc_get_rate() */
@@ -54,6 +55,9 @@ struct aggregation_s /* {{{ */
   bool calc_min;
   bool calc_max;
   bool calc_stddev;
+
+  double *percentiles;
+  size_t percentiles_num;
 }; /* }}} */
 typedef struct aggregation_s aggregation_t;
 
@@ -73,12 +77,18 @@ struct agg_instance_s /* {{{ */
   gauge_t min;
   gauge_t max;
 
+  /* Only allocated if percentiles have been configured. */
+  ddsketch_t *sketch;
+  double const *percentiles;
+  size_t percentiles_num;
+
   rate_to_value_state_t *state_num;
   rate_to_value_state_t *state_sum;
   rate_to_value_state_t *state_average;
   rate_to_value_state_t *state_min;
   rate_to_value_state_t *state_max;
   rate_to_value_state_t *state_stddev;
+  rate_to_value_state_t *state_percentile; /* array of percentiles_num */
 
   agg_instance_t *next;
 }; /* }}} */
@@ -105,6 +115,10 @@ static bool agg_is_regex(char const *str) /* {{{ */
 
 static void agg_destroy(aggregation_t *agg) /* {{{ */
 {
+  if (agg == NULL)
+    return;
+
+  sfree(agg->percentiles);
   sfree(agg);
 } /* }}} void agg_destroy */
 
@@ -133,6 +147,9 @@ static void agg_instance_destroy(agg_instance_t *inst) /* {{{ */
   sfree(inst->state_min);
   sfree(inst->state_max);
   sfree(inst->state_stddev);
+  sfree(inst->state_percentile);
+
+  ddsketch_destroy(inst->sketch);
 
   memset(inst, 0, sizeof(*inst));
   inst->ds_type = -1;
@@ -270,6 +287,22 @@ static agg_instance_t *agg_instance_create(data_set_t const *ds, /* {{{ */
 
 #undef INIT_STATE
 
+  if (agg->percentiles_num > 0) {
+    inst->percentiles = agg->percentiles;
+    inst->percentiles_num = agg->percentiles_num;
+
+    inst->sketch =
+        ddsketch_create(DDSKETCH_DEFAULT_ACCURACY, DDSKETCH_DEFAULT_MAX_BINS);
+    inst->state_percentile =
+        calloc(agg->percentiles_num, sizeof(*inst->state_percentile));
+    if ((inst->sketch == NULL) || (inst->state_percentile == NULL)) {
+      agg_instance_destroy(inst);
+      free(inst);
+      ERROR("aggregation plugin: Allocating the percentile sketch failed.");
+      return NULL;
+    }
+  }
+
   pthread_mutex_lock(&agg_instance_list_lock);
   inst->next = agg_instance_list_head;
   agg_instance_list_head = inst;
@@ -317,6 +350,9 @@ static int agg_instance_update(agg_instance_t *inst, /* {{{ */
   if (isnan(inst->max) || (inst->max < rate[0]))
     inst->max = rate[0];
 
+  if (inst->sketch != NULL)
+    ddsketch_add(inst->sketch, rate[0]);
+
   pthread_mutex_unlock(&inst->lock);
 
   sfree(rate);
@@ -405,6 +441,14 @@ static int agg_instance_read(agg_instance_t *inst, cdtime_t t) /* {{{ */
     READ_FUNC(stddev, sqrt((((gauge_t)inst->num) * inst->squares_sum) -
                            (inst->sum * inst->sum)) /
                           ((gauge_t)inst->num));
+
+    for (size_t i = 0; i < inst->percentiles_num; i++) {
+      char func[DATA_MAX_NAME_LEN];
+      ssnprintf(func, sizeof(func), "percentile-%g", inst->percentiles[i]);
+      agg_instance_read_func(
+          inst, func, ddsketch_percentile(inst->sketch, inst->percentiles[i]),
+          inst->state_percentile + i, &vl, inst->ident.plugin_instance, t);
+    }
   }
 
   /* Reset internal state. */
@@ -413,6 +457,7 @@ static int agg_instance_read(agg_instance_t *inst, cdtime_t t) /* {{{ */
   inst->squares_sum = 0.0;
   inst->min = NAN;
   inst->max = NAN;
+  ddsketch_reset(inst->sketch);
 
   pthread_mutex_unlock(&inst->lock);
 
@@ -465,6 +510,7 @@ static void agg_lookup_free_obj_callback(void *user_obj) /* {{{ */
  *     CalculateMinimum true
  *     CalculateMaximum true
  *     CalculateStddev true
+ *     CalculatePercentile 50 95 99
  *   </Aggregation>
  * </Plugin>
  */
@@ -499,6 +545,47 @@ static int agg_config_handle_group_by(oconfig_item_t const *ci, /* {{{ */
   return 0;
 } /* }}} int agg_config_handle_group_by */
 
+static int agg_config_handle_percentile(oconfig_item_t const *ci, /* {{{ */
+                                        aggregation_t *agg) {
+  if (ci->values_num < 1) {
+    ERROR("aggregation plugin: The \"%s\" option requires at least one "
+          "argument.",
+          ci->key);
+    return EINVAL;
+  }
+
+  double *tmp = realloc(agg->percentiles, sizeof(*agg->percentiles) *
+                                              (agg->percentiles_num +
+                                               (size_t)ci->values_num));
+  if (tmp == NULL) {
+    ERROR("aggregation plugin: realloc failed.");
+    return ENOMEM;
+  }
+  agg->percentiles = tmp;
+
+  for (int i = 0; i < ci->values_num; i++) {
+    if (ci->values[i].type != OCONFIG_TYPE_NUMBER) {
+      ERROR("aggregation plugin: Argument %i of the \"%s\" option is not a "
+            "number.",
+            i + 1, ci->key);
+      return EINVAL;
+    }
+
+    double percent = ci->values[i].value.number;
+    if ((percent <= 0.0) || (percent >= 100.0)) {
+      ERROR("aggregation plugin: The percentiles given to \"%s\" must be "
+            "between 0 and 100, exclusively.",
+            ci->key);
+      return ERANGE;
+    }
+
+    agg->percentiles[agg->percentiles_num] = percent;
+    agg->percentiles_num++;
+  }
+
+  return 0;
+} /* }}} int agg_config_handle_percentile */
+
 static int agg_config_aggregation(oconfig_item_t *ci) /* {{{ */
 {
   aggregation_t *agg = calloc(1, sizeof(*agg));
@@ -555,13 +642,15 @@ static int agg_config_aggregation(oconfig_item_t *ci) /* {{{ */
       status = cf_util_get_boolean(child, &agg->calc_max);
     else if (strcasecmp("CalculateStddev", child->key) == 0)
       status = cf_util_get_boolean(child, &agg->calc_stddev);
+    else if (strcasecmp("CalculatePercentile", child->key) == 0)
+      status = agg_config_handle_percentile(child, agg);
     else
       WARNING("aggregation plugin: The \"%s\" key is not allowed inside "
               "<Aggregation /> blocks and will be ignored.",
               child->key);
 
     if (status != 0) {
-      sfree(agg);
+      agg_destroy(agg);
       return status;
     }
   } /* for (int i = 0; i < ci->children_num; i++) */
@@ -620,7 +709,8 @@ static int agg_config_aggregation(oconfig_item_t *ci) /* {{{ */
   } /* }}} */
 
   if (!agg->calc_num && !agg->calc_sum && !agg->calc_average /* {{{ */
-      && !agg->calc_min && !agg->calc_max && !agg->calc_stddev) {
+      && !agg->calc_min && !agg->calc_max && !agg->calc_stddev &&
+      (agg->percentiles_num == 0)) {
     ERROR("aggregation plugin: No aggregation function has been specified. "
           "Without this, I don't know what I should be calculating. "
           "(Host \"%s\", Plugin \"%s\", PluginInstance \"%s\", "
@@ -631,14 +721,14 @@ static int agg_config_aggregation(oconfig_item_t *ci) /* {{{ */
   } /* }}} */
 
   if (!is_valid) { /* {{{ */
-    sfree(agg);
+    agg_destroy(agg);
     return -1;
   } /* }}} */
 
   int status = lookup_add(lookup, &agg->ident, agg->group_by, agg);
   if (status != 0) {
     ERROR("aggregation plugin: lookup_add failed with status %i.", status);
-    sfree(agg);
+    agg_destroy(agg);
     return -1;
   }
 
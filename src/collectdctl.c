@@ -110,6 +110,7 @@ __attribute__((noreturn)) static void exit_usage(const char *name, int status) {
       " * flush [timeout=<seconds>] [plugin=<name>] [identifier=<id>]\n"
       " * listval\n"
       " * putval <identifier> [interval=<seconds>] <value-list(s)>\n"
+      " * readstats [<limit>]\n"
 
       "\nIdentifiers:\n\n"
 
@@ -543,6 +544,52 @@ static int putval(lcc_connection_t *c, int argc, char **argv) {
   return 0;
 } /* putval */
 
+static int readstats(lcc_connection_t *c, int argc, char **argv) {
+  lcc_read_stats_t *stats = NULL;
+  size_t stats_num = 0;
+  size_t limit = 10;
+
+  int status;
+
+  assert(strcasecmp(argv[0], "readstats") == 0);
+
+  if (argc > 2) {
+    fprintf(stderr, "ERROR: readstats: Too many arguments.\n");
+    return -1;
+  }
+
+  if (argc == 2) {
+    char *endptr = NULL;
+    long tmp;
+
+    errno = 0;
+    tmp = strtol(argv[1], &endptr, 10);
+    if ((errno != 0) || (endptr == argv[1]) || (*endptr != 0) || (tmp < 0)) {
+      fprintf(stderr, "ERROR: readstats: Invalid limit: %s\n", argv[1]);
+      return -1;
+    }
+    limit = (size_t)tmp;
+  }
+
+  status = lcc_readstats(c, limit, &stats, &stats_num);
+  if (status != 0) {
+    fprintf(stderr, "ERROR: %s\n", lcc_strerror(c));
+    return status;
+  }
+
+  printf("%10s %10s %10s %10s %10s %10s %10s  %s\n", "calls", "exec avg",
+         "exec p99", "exec max", "lag avg", "lag p99", "lag max", "callback");
+  for (size_t i = 0; i < stats_num; i++) {
+    lcc_read_stats_t *s = stats + i;
+    printf("%10" PRIu64 " %10.6f %10.6f %10.6f %10.6f %10.6f %10.6f  %s\n",
+           s->calls, s->exec_average, s->exec_percentile, s->exec_max,
+           s->lag_average, s->lag_percentile, s->lag_max, s->name);
+  }
+
+  free(stats);
+  return 0;
+} /* readstats */
+
 int main(int argc, char **argv) {
   char address[1024] = "unix:" DEFAULT_SOCK;
 
@@ -591,6 +638,8 @@ int main(int argc, char **argv) {
     status = listval(c, argc - optind, argv + optind);
   else if (strcasecmp(argv[optind], "putval") == 0)
     status = putval(c, argc - optind, argv + optind);
+  else if (strcasecmp(argv[optind], "readstats") == 0)
+    status = readstats(c, argc - optind, argv + optind);
   else {
     fprintf(stderr, "%s: invalid command: %s\n", argv[0], argv[optind]);
     return 1;
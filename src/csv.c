@@ -24,19 +24,52 @@
 #include "collectd.h"
 
 #include "plugin.h"
+#include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
 #include "utils_cache.h"
 
+/*
+ * Private types
+ */
+/* A CSV file kept open between writes. Open files are stored in "files",
+ * keyed by the value list's identifier, and in a list ordered by the time of
+ * the last write, so the least recently used file can be closed when
+ * "MaxOpenFiles" is reached. */
+struct csv_file_s {
+  char *identifier;
+  char filename[512];
+  FILE *fh;
+  dev_t dev;
+  ino_t ino;
+  cdtime_t last_flush;
+
+  struct csv_file_s *prev;
+  struct csv_file_s *next;
+};
+typedef struct csv_file_s csv_file_t;
+
 /*
  * Private variables
  */
-static const char *config_keys[] = {"DataDir", "StoreRates"};
+static const char *config_keys[] = {"DataDir", "StoreRates", "MaxOpenFiles",
+                                    "FlushInterval"};
 static int config_keys_num = STATIC_ARRAY_SIZE(config_keys);
 
 static char *datadir;
 static int store_rates;
 static int use_stdio;
 
+/* If max_open_files is zero, every file is opened and closed for each write. */
+static size_t max_open_files;
+static cdtime_t flush_interval = TIME_T_TO_CDTIME_T_STATIC(10);
+
+static c_avl_tree_t *files;
+static size_t files_num;
+static csv_file_t *files_head; /* most recently written */
+static csv_file_t *files_tail; /* least recently written */
+static cdtime_t files_flush_last;
+static pthread_mutex_t files_lock = PTHREAD_MUTEX_INITIALIZER;
+
 static int value_list_to_string(char *buffer, int buffer_len,
                                 const data_set_t *ds, const value_list_t *vl) {
   int offset;
@@ -205,20 +238,219 @@ static int csv_config(const char *key, const char *value) {
       store_rates = 1;
     else
       store_rates = 0;
+  } else if (strcasecmp("MaxOpenFiles", key) == 0) {
+    int tmp = atoi(value);
+    if (tmp < 0) {
+      ERROR("csv plugin: `MaxOpenFiles' must be greater than or equal to "
+            "zero.");
+      return 1;
+    }
+    max_open_files = (size_t)tmp;
+  } else if (strcasecmp("FlushInterval", key) == 0) {
+    double tmp = atof(value);
+    if (tmp < 0.0) {
+      ERROR("csv plugin: `FlushInterval' must be greater than or equal to "
+            "zero.");
+      return 1;
+    }
+    flush_interval = DOUBLE_TO_CDTIME_T(tmp);
   } else {
     return -1;
   }
   return 0;
 } /* int csv_config */
 
+/* Opens the CSV file for appending, creating it and writing the header line
+ * if it doesn't exist yet. The file is locked until it is closed. */
+static FILE *csv_open_file(const char *filename, const data_set_t *ds) {
+  struct stat statbuf;
+  FILE *csv;
+  struct flock fl = {0};
+  int status;
+
+  if (stat(filename, &statbuf) == -1) {
+    if (errno == ENOENT) {
+      if (csv_create_file(filename, ds))
+        return NULL;
+    } else {
+      ERROR("stat(%s) failed: %s", filename, STRERRNO);
+      return NULL;
+    }
+  } else if (!S_ISREG(statbuf.st_mode)) {
+    ERROR("stat(%s): Not a regular file!", filename);
+    return NULL;
+  }
+
+  csv = fopen(filename, "a");
+  if (csv == NULL) {
+    ERROR("csv plugin: fopen (%s) failed: %s", filename, STRERRNO);
+    return NULL;
+  }
+
+  fl.l_pid = getpid();
+  fl.l_type = F_WRLCK;
+  fl.l_whence = SEEK_SET;
+
+  status = fcntl(fileno(csv), F_SETLK, &fl);
+  if (status != 0) {
+    ERROR("csv plugin: flock (%s) failed: %s", filename, STRERRNO);
+    fclose(csv);
+    return NULL;
+  }
+
+  return csv;
+} /* FILE *csv_open_file */
+
+/* You must hold files_lock when calling the following functions. */
+static void csv_file_unlink(csv_file_t *f) {
+  if (f->prev == NULL)
+    files_head = f->next;
+  else
+    f->prev->next = f->next;
+
+  if (f->next == NULL)
+    files_tail = f->prev;
+  else
+    f->next->prev = f->prev;
+
+  f->prev = NULL;
+  f->next = NULL;
+} /* void csv_file_unlink */
+
+static void csv_file_push_front(csv_file_t *f) {
+  f->prev = NULL;
+  f->next = files_head;
+  if (files_head != NULL)
+    files_head->prev = f;
+  files_head = f;
+  if (files_tail == NULL)
+    files_tail = f;
+} /* void csv_file_push_front */
+
+/* Closes the file and removes it from the cache. The lock is implicitly
+ * released when closing the file. */
+static void csv_file_close(csv_file_t *f) {
+  c_avl_remove(files, f->identifier, NULL, NULL);
+  csv_file_unlink(f);
+  files_num--;
+
+  if (f->fh != NULL)
+    fclose(f->fh);
+  sfree(f->identifier);
+  sfree(f);
+} /* void csv_file_close */
+
+static int csv_file_open(csv_file_t *f, const char *filename,
+                         const data_set_t *ds) {
+  struct stat statbuf;
+
+  f->fh = csv_open_file(filename, ds);
+  if (f->fh == NULL)
+    return -1;
+
+  if (fstat(fileno(f->fh), &statbuf) == 0) {
+    f->dev = statbuf.st_dev;
+    f->ino = statbuf.st_ino;
+  }
+
+  sstrncpy(f->filename, filename, sizeof(f->filename));
+  f->last_flush = cdtime();
+  return 0;
+} /* int csv_file_open */
+
+/* Returns the open file for the identifier. If the file name changed, i.e. the
+ * date changed, the old file is closed and the new one opened. */
+static csv_file_t *csv_file_get(const char *identifier, const char *filename,
+                                const data_set_t *ds) {
+  csv_file_t *f = NULL;
+
+  if (c_avl_get(files, identifier, (void *)&f) == 0) {
+    csv_file_unlink(f);
+    csv_file_push_front(f);
+
+    if ((f->fh != NULL) && (strcmp(f->filename, filename) == 0))
+      return f;
+
+    if (f->fh != NULL) {
+      fclose(f->fh);
+      f->fh = NULL;
+    }
+    if (csv_file_open(f, filename, ds) != 0) {
+      csv_file_close(f);
+      return NULL;
+    }
+    return f;
+  }
+
+  while ((files_num >= max_open_files) && (files_tail != NULL))
+    csv_file_close(files_tail);
+
+  f = calloc(1, sizeof(*f));
+  if (f == NULL) {
+    ERROR("csv plugin: calloc failed.");
+    return NULL;
+  }
+
+  f->identifier = strdup(identifier);
+  if (f->identifier == NULL) {
+    ERROR("csv plugin: strdup failed.");
+    sfree(f);
+    return NULL;
+  }
+
+  if (csv_file_open(f, filename, ds) != 0) {
+    sfree(f->identifier);
+    sfree(f);
+    return NULL;
+  }
+
+  if (c_avl_insert(files, f->identifier, f) != 0) {
+    ERROR("csv plugin: c_avl_insert (%s) failed.", identifier);
+    fclose(f->fh);
+    sfree(f->identifier);
+    sfree(f);
+    return NULL;
+  }
+
+  csv_file_push_front(f);
+  files_num++;
+
+  return f;
+} /* csv_file_t *csv_file_get */
+
+/* Flushes all files that have not been flushed for "timeout". Files that have
+ * been removed or replaced, for example by log rotation, are closed and will
+ * be reopened by the next write. */
+static void csv_files_flush(cdtime_t timeout) {
+  cdtime_t now = cdtime();
+  csv_file_t *next;
+
+  for (csv_file_t *f = files_head; f != NULL; f = next) {
+    struct stat statbuf;
+
+    next = f->next;
+
+    if ((timeout != 0) && ((now - f->last_flush) < timeout))
+      continue;
+
+    fflush(f->fh);
+    f->last_flush = now;
+
+    if ((stat(f->filename, &statbuf) != 0) || (statbuf.st_dev != f->dev) ||
+        (statbuf.st_ino != f->ino)) {
+      DEBUG("csv plugin: %s has been removed, closing it.", f->filename);
+      csv_file_close(f);
+    }
+  }
+
+  files_flush_last = now;
+} /* void csv_files_flush */
+
 static int csv_write(const data_set_t *ds, const value_list_t *vl,
                      user_data_t __attribute__((unused)) * user_data) {
-  struct stat statbuf;
   char filename[512];
   char values[4096];
   FILE *csv;
-  int csv_fd;
-  struct flock fl = {0};
   int status;
 
   if (0 != strcmp(ds->type, vl->type)) {
@@ -251,37 +483,37 @@ static int csv_write(const data_set_t *ds, const value_list_t *vl,
     return 0;
   }
 
-  if (stat(filename, &statbuf) == -1) {
-    if (errno == ENOENT) {
-      if (csv_create_file(filename, ds))
-        return -1;
-    } else {
-      ERROR("stat(%s) failed: %s", filename, STRERRNO);
+  if (max_open_files > 0) {
+    char identifier[6 * DATA_MAX_NAME_LEN];
+    csv_file_t *f;
+
+    status = FORMAT_VL(identifier, sizeof(identifier), vl);
+    if (status != 0)
+      return -1;
+
+    pthread_mutex_lock(&files_lock);
+
+    f = csv_file_get(identifier, filename, ds);
+    if (f == NULL) {
+      pthread_mutex_unlock(&files_lock);
       return -1;
     }
-  } else if (!S_ISREG(statbuf.st_mode)) {
-    ERROR("stat(%s): Not a regular file!", filename);
-    return -1;
-  }
 
-  csv = fopen(filename, "a");
-  if (csv == NULL) {
-    ERROR("csv plugin: fopen (%s) failed: %s", filename, STRERRNO);
-    return -1;
-  }
-  csv_fd = fileno(csv);
+    fprintf(f->fh, "%s\n", values);
 
-  fl.l_pid = getpid();
-  fl.l_type = F_WRLCK;
-  fl.l_whence = SEEK_SET;
+    if (flush_interval == 0)
+      fflush(f->fh);
+    else if ((cdtime() - files_flush_last) >= flush_interval)
+      csv_files_flush(flush_interval);
 
-  status = fcntl(csv_fd, F_SETLK, &fl);
-  if (status != 0) {
-    ERROR("csv plugin: flock (%s) failed: %s", filename, STRERRNO);
-    fclose(csv);
-    return -1;
+    pthread_mutex_unlock(&files_lock);
+    return 0;
   }
 
+  csv = csv_open_file(filename, ds);
+  if (csv == NULL)
+    return -1;
+
   fprintf(csv, "%s\n", values);
 
   /* The lock is implicitely released. I we don't release it explicitely
@@ -291,7 +523,63 @@ static int csv_write(const data_set_t *ds, const value_list_t *vl,
   return 0;
 } /* int csv_write */
 
+static int csv_flush(cdtime_t timeout, const char *identifier,
+                     __attribute__((unused)) user_data_t *user_data) {
+  csv_file_t *f;
+
+  pthread_mutex_lock(&files_lock);
+
+  if (files == NULL) {
+    pthread_mutex_unlock(&files_lock);
+    return 0;
+  }
+
+  if (identifier == NULL) {
+    csv_files_flush(timeout);
+  } else if (c_avl_get(files, identifier, (void *)&f) == 0) {
+    fflush(f->fh);
+    f->last_flush = cdtime();
+  }
+
+  pthread_mutex_unlock(&files_lock);
+  return 0;
+} /* int csv_flush */
+
+static int csv_init(void) {
+  if (max_open_files == 0)
+    return 0;
+
+  pthread_mutex_lock(&files_lock);
+  if (files == NULL)
+    files = c_avl_create((int (*)(const void *, const void *))strcmp);
+  files_flush_last = cdtime();
+  pthread_mutex_unlock(&files_lock);
+
+  if (files == NULL) {
+    ERROR("csv plugin: c_avl_create failed.");
+    return -1;
+  }
+
+  return 0;
+} /* int csv_init */
+
+static int csv_shutdown(void) {
+  pthread_mutex_lock(&files_lock);
+  while (files_head != NULL)
+    csv_file_close(files_head);
+  if (files != NULL) {
+    c_avl_destroy(files);
+    files = NULL;
+  }
+  pthread_mutex_unlock(&files_lock);
+
+  return 0;
+} /* int csv_shutdown */
+
 void module_register(void) {
   plugin_register_config("csv", csv_config, config_keys, config_keys_num);
+  plugin_register_init("csv", csv_init);
   plugin_register_write("csv", csv_write, /* user_data = */ NULL);
+  plugin_register_flush("csv", csv_flush, /* user_data = */ NULL);
+  plugin_register_shutdown("csv", csv_shutdown);
 } /* void module_register */
@@ -29,7 +29,9 @@
 #include "configfile.h"
 #include "filter_chain.h"
 #include "plugin.h"
+#include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
+#include "utils_atomic.h"
 #include "utils_complain.h"
 
 /*
@@ -65,6 +67,21 @@ struct fc_rule_s {
   fc_match_t *matches;
   fc_target_t *targets;
   fc_rule_t *next;
+
+  /* Statistics, only updated if "CollectInternalStats" is enabled. Updated
+   * atomically because chains are processed by several threads. */
+  uint64_t evaluated;
+  uint64_t hits;
+  cdtime_t time;
+}; /* }}} */
+
+/* The rules of a chain which may match value lists with a certain plugin and
+ * type, as indices into the chain's program. */
+struct fc_prefilter_s;
+typedef struct fc_prefilter_s fc_prefilter_t; /* {{{ */
+struct fc_prefilter_s {
+  size_t rules_num;
+  size_t rules[];
 }; /* }}} */
 
 /* List of chains, used for `chain_list_head' */
@@ -74,6 +91,14 @@ struct fc_chain_s /* {{{ */
   fc_rule_t *rules;
   fc_target_t *targets;
   fc_chain_t *next;
+
+  /* The rules compiled into an array by fc_chain_compile(). If at least one
+   * match of the chain has a prefilter, the rules to evaluate for each
+   * "plugin/type" pair are cached in "prefilter_cache". */
+  fc_rule_t **program;
+  size_t program_len;
+  c_avl_tree_t *prefilter_cache;
+  pthread_rwlock_t prefilter_lock;
 }; /* }}} */
 
 /* Writer configuration. */
@@ -90,6 +115,7 @@ struct fc_writer_s {
 static fc_match_t *match_list_head;
 static fc_target_t *target_list_head;
 static fc_chain_t *chain_list_head;
+static bool record_statistics;
 
 /*
  * Private functions
@@ -146,6 +172,21 @@ static void fc_free_rules(fc_rule_t *r) /* {{{ */
   free(r);
 } /* }}} void fc_free_rules */
 
+static void fc_free_prefilter_cache(c_avl_tree_t *cache) /* {{{ */
+{
+  void *key;
+  void *value;
+
+  if (cache == NULL)
+    return;
+
+  while (c_avl_pick(cache, &key, &value) == 0) {
+    free(key);
+    free(value);
+  }
+  c_avl_destroy(cache);
+} /* }}} void fc_free_prefilter_cache */
+
 static void fc_free_chains(fc_chain_t *c) /* {{{ */
 {
   if (c == NULL)
@@ -153,6 +194,9 @@ static void fc_free_chains(fc_chain_t *c) /* {{{ */
 
   fc_free_rules(c->rules);
   fc_free_targets(c->targets);
+  free(c->program);
+  fc_free_prefilter_cache(c->prefilter_cache);
+  pthread_rwlock_destroy(&c->prefilter_lock);
 
   if (c->next != NULL)
     fc_free_chains(c->next);
@@ -452,6 +496,113 @@ static int fc_config_add_rule(fc_chain_t *chain, /* {{{ */
   return 0;
 } /* }}} int fc_config_add_rule */
 
+/* Compiles the chain's list of rules into an array and resets the prefilter
+ * cache. Called whenever rules have been added to the chain. */
+static int fc_chain_compile(fc_chain_t *chain) /* {{{ */
+{
+  fc_rule_t **program;
+  size_t program_len = 0;
+  c_avl_tree_t *prefilter_cache = NULL;
+
+  for (fc_rule_t *rule = chain->rules; rule != NULL; rule = rule->next)
+    program_len++;
+
+  program = calloc(program_len + 1, sizeof(*program));
+  if (program == NULL) {
+    ERROR("fc_chain_compile: calloc failed.");
+    return -1;
+  }
+
+  program_len = 0;
+  for (fc_rule_t *rule = chain->rules; rule != NULL; rule = rule->next) {
+    program[program_len] = rule;
+    program_len++;
+
+    for (fc_match_t *match = rule->matches; match != NULL;
+         match = match->next) {
+      if ((match->proc.prefilter != NULL) && (prefilter_cache == NULL))
+        prefilter_cache =
+            c_avl_create((int (*)(const void *, const void *))strcmp);
+    }
+  }
+
+  pthread_rwlock_wrlock(&chain->prefilter_lock);
+  free(chain->program);
+  fc_free_prefilter_cache(chain->prefilter_cache);
+  chain->program = program;
+  chain->program_len = program_len;
+  chain->prefilter_cache = prefilter_cache;
+  pthread_rwlock_unlock(&chain->prefilter_lock);
+
+  return 0;
+} /* }}} int fc_chain_compile */
+
+/* Returns false if one of the rule's matches reports that no value list with
+ * this plugin and type can match. */
+static bool fc_rule_may_match(fc_rule_t *rule, /* {{{ */
+                              const char *plugin, const char *type) {
+  for (fc_match_t *match = rule->matches; match != NULL; match = match->next) {
+    if (match->proc.prefilter == NULL)
+      continue;
+
+    if ((*match->proc.prefilter)(plugin, type, &match->user_data) ==
+        FC_MATCH_NO_MATCH)
+      return false;
+  }
+
+  return true;
+} /* }}} bool fc_rule_may_match */
+
+/* Returns the rules of the chain to evaluate for the value list, or NULL if
+ * all rules need to be evaluated. */
+static fc_prefilter_t *fc_chain_get_prefilter(fc_chain_t *chain, /* {{{ */
+                                              const value_list_t *vl) {
+  char key[2 * DATA_MAX_NAME_LEN];
+  fc_prefilter_t *pf = NULL;
+  char *key_copy;
+  int status;
+
+  if (chain->prefilter_cache == NULL)
+    return NULL;
+
+  ssnprintf(key, sizeof(key), "%s/%s", vl->plugin, vl->type);
+
+  pthread_rwlock_rdlock(&chain->prefilter_lock);
+  status = c_avl_get(chain->prefilter_cache, key, (void *)&pf);
+  pthread_rwlock_unlock(&chain->prefilter_lock);
+  if (status == 0)
+    return pf;
+
+  pf = malloc(sizeof(*pf) + chain->program_len * sizeof(pf->rules[0]));
+  key_copy = fc_strdup(key);
+  if ((pf == NULL) || (key_copy == NULL)) {
+    free(pf);
+    free(key_copy);
+    return NULL;
+  }
+
+  pf->rules_num = 0;
+  for (size_t i = 0; i < chain->program_len; i++) {
+    if (fc_rule_may_match(chain->program[i], vl->plugin, vl->type)) {
+      pf->rules[pf->rules_num] = i;
+      pf->rules_num++;
+    }
+  }
+
+  pthread_rwlock_wrlock(&chain->prefilter_lock);
+  status = c_avl_insert(chain->prefilter_cache, key_copy, pf);
+  if (status != 0) {
+    /* Another thread was faster. */
+    free(key_copy);
+    free(pf);
+    pf = NULL;
+    c_avl_get(chain->prefilter_cache, key, (void *)&pf);
+  }
+  pthread_rwlock_unlock(&chain->prefilter_lock);
+
+  return pf;
+} /* }}} fc_prefilter_t *fc_chain_get_prefilter */
+
 static int fc_config_add_chain(const oconfig_item_t *ci) /* {{{ */
 {
   fc_chain_t *chain = NULL;
@@ -476,6 +627,7 @@ static int fc_config_add_chain(const oconfig_item_t *ci) /* {{{ */
       return -1;
     }
     sstrncpy(chain->name, ci->values[0].value.string, sizeof(chain->name));
+    pthread_rwlock_init(&chain->prefilter_lock, /* attr = */ NULL);
   }
 
   for (int i = 0; i < ci->children_num; i++) {
@@ -501,6 +653,12 @@ static int fc_config_add_chain(const oconfig_item_t *ci) /* {{{ */
     return -1;
   }
 
+  status = fc_chain_compile(chain);
+  if (status != 0) {
+    fc_free_chains(chain);
+    return -1;
+  }
+
   if (chain_list_head != NULL) {
     if (!new_chain)
       return 0;
@@ -855,9 +1013,87 @@ fc_chain_t *fc_chain_get_by_name(const char *chain_name) /* {{{ */
   return NULL;
 } /* }}} int fc_chain_get_by_name */
 
+/* Evaluates the rule's matches and executes its targets if all of them
+ * match. Returns one of the FC_TARGET_* values. */
+static int fc_process_rule(const data_set_t *ds, value_list_t *vl, /* {{{ */
+                           fc_chain_t *chain, fc_rule_t *rule,
+                           bool *ret_matched) {
+  fc_match_t *match;
+  fc_target_t *target;
+  int status = FC_TARGET_CONTINUE;
+
+  *ret_matched = false;
+
+  if (rule->name[0] != 0) {
+    DEBUG("fc_process_chain (%s): Testing the `%s' rule.", chain->name,
+          rule->name);
+  }
+
+  /* N. B.: rule->matches may be NULL. */
+  for (match = rule->matches; match != NULL; match = match->next) {
+    /* FIXME: Pass the meta-data to match targets here (when implemented). */
+    status = (*match->proc.match)(ds, vl, /* meta = */ NULL, &match->user_data);
+    if (status < 0) {
+      WARNING("fc_process_chain (%s): A match failed.", chain->name);
+      break;
+    } else if (status != FC_MATCH_MATCHES)
+      break;
+  }
+
+  /* for-loop has been aborted: Either error or no match. */
+  if (match != NULL)
+    return FC_TARGET_CONTINUE;
+
+  *ret_matched = true;
+
+  if (rule->name[0] != 0) {
+    DEBUG("fc_process_chain (%s): Rule `%s' matches.", chain->name,
+          rule->name);
+  }
+
+  status = FC_TARGET_CONTINUE;
+  for (target = rule->targets; target != NULL; target = target->next) {
+    /* If we get here, all matches have matched the value. Execute the
+     * target. */
+    /* FIXME: Pass the meta-data to match targets here (when implemented). */
+    status =
+        (*target->proc.invoke)(ds, vl, /* meta = */ NULL, &target->user_data);
+    if (status < 0) {
+      WARNING("fc_process_chain (%s): A target failed.", chain->name);
+      continue;
+    } else if (status == FC_TARGET_CONTINUE)
+      continue;
+    else if (status == FC_TARGET_STOP)
+      break;
+    else if (status == FC_TARGET_RETURN)
+      break;
+    else {
+      WARNING("fc_process_chain (%s): Unknown return value "
+              "from target `%s': %i",
+              chain->name, target->name, status);
+    }
+  }
+
+  if ((status == FC_TARGET_STOP) || (status == FC_TARGET_RETURN)) {
+    if (rule->name[0] != 0) {
+      DEBUG("fc_process_chain (%s): Rule `%s' signaled "
+            "the %s condition.",
+            chain->name, rule->name,
+            (status == FC_TARGET_STOP) ? "stop" : "return");
+    }
+    return status;
+  }
+
+  return FC_TARGET_CONTINUE;
+} /* }}} int fc_process_rule */
+
 int fc_process_chain(const data_set_t *ds, value_list_t *vl, /* {{{ */
                      fc_chain_t *chain) {
   fc_target_t *target;
+  fc_prefilter_t *pf;
+  size_t rules_num;
+  char plugin[DATA_MAX_NAME_LEN];
+  char type[DATA_MAX_NAME_LEN];
   int status = FC_TARGET_CONTINUE;
 
   if (chain == NULL)
@@ -865,70 +1101,60 @@ int fc_process_chain(const data_set_t *ds, value_list_t *vl, /* {{{ */
 
   DEBUG("fc_process_chain (chain = %s);", chain->name);
 
-  for (fc_rule_t *rule = chain->rules; rule != NULL; rule = rule->next) {
-    fc_match_t *match;
-    status = FC_TARGET_CONTINUE;
+  /* Rules which cannot match this plugin and type are skipped altogether. */
+  pf = fc_chain_get_prefilter(chain, vl);
+  rules_num = (pf != NULL) ? pf->rules_num : chain->program_len;
+  if (pf != NULL) {
+    sstrncpy(plugin, vl->plugin, sizeof(plugin));
+    sstrncpy(type, vl->type, sizeof(type));
+  }
 
-    if (rule->name[0] != 0) {
-      DEBUG("fc_process_chain (%s): Testing the `%s' rule.", chain->name,
-            rule->name);
-    }
+  /* Each rule's time is measured from the end of the previous one, so only
+   * one cdtime() call is needed per rule. */
+  cdtime_t start = record_statistics ? cdtime() : 0;
 
-    /* N. B.: rule->matches may be NULL. */
-    for (match = rule->matches; match != NULL; match = match->next) {
-      /* FIXME: Pass the meta-data to match targets here (when implemented). */
-      status =
-          (*match->proc.match)(ds, vl, /* meta = */ NULL, &match->user_data);
-      if (status < 0) {
-        WARNING("fc_process_chain (%s): A match failed.", chain->name);
-        break;
-      } else if (status != FC_MATCH_MATCHES)
-        break;
-    }
+  size_t i = 0;
+  while (i < rules_num) {
+    size_t index = (pf != NULL) ? pf->rules[i] : i;
+    fc_rule_t *rule = chain->program[index];
+    bool matched;
 
-    /* for-loop has been aborted: Either error or no match. */
-    if (match != NULL) {
-      status = FC_TARGET_CONTINUE;
-      continue;
-    }
+    status = fc_process_rule(ds, vl, chain, rule, &matched);
 
-    if (rule->name[0] != 0) {
-      DEBUG("fc_process_chain (%s): Rule `%s' matches.", chain->name,
-            rule->name);
+    if (record_statistics) {
+      cdtime_t now = cdtime();
+
+      ATOMIC_ADD_FETCH(&rule->time, now - start);
+      ATOMIC_ADD_FETCH(&rule->evaluated, 1);
+      if (matched)
+        ATOMIC_ADD_FETCH(&rule->hits, 1);
+      start = now;
     }
 
-    for (target = rule->targets; target != NULL; target = target->next) {
-      /* If we get here, all matches have matched the value. Execute the
-       * target. */
-      /* FIXME: Pass the meta-data to match targets here (when implemented). */
-      status =
-          (*target->proc.invoke)(ds, vl, /* meta = */ NULL, &target->user_data);
-      if (status < 0) {
-        WARNING("fc_process_chain (%s): A target failed.", chain->name);
-        continue;
-      } else if (status == FC_TARGET_CONTINUE)
+    if ((status == FC_TARGET_STOP) || (status == FC_TARGET_RETURN))
+      break;
+    i++;
+
+    /* Targets such as "set" and "replace" may have rewritten the plugin or
+     * type, so rules skipped for the old values may match now. Continue with
+     * the rules following this one which may match the new values. */
+    if ((pf != NULL) && matched &&
+        ((strcmp(plugin, vl->plugin) != 0) || (strcmp(type, vl->type) != 0))) {
+      pf = fc_chain_get_prefilter(chain, vl);
+      if (pf == NULL) {
+        /* Fall back to evaluating all remaining rules. */
+        rules_num = chain->program_len;
+        i = index + 1;
         continue;
-      else if (status == FC_TARGET_STOP)
-        break;
-      else if (status == FC_TARGET_RETURN)
-        break;
-      else {
-        WARNING("fc_process_chain (%s): Unknown return value "
-                "from target `%s': %i",
-                chain->name, target->name, status);
       }
-    }
 
-    if ((status == FC_TARGET_STOP) || (status == FC_TARGET_RETURN)) {
-      if (rule->name[0] != 0) {
-        DEBUG("fc_process_chain (%s): Rule `%s' signaled "
-              "the %s condition.",
-              chain->name, rule->name,
-              (status == FC_TARGET_STOP) ? "stop" : "return");
-      }
-      break;
+      sstrncpy(plugin, vl->plugin, sizeof(plugin));
+      sstrncpy(type, vl->type, sizeof(type));
+      rules_num = pf->rules_num;
+      for (i = 0; (i < rules_num) && (pf->rules[i] <= index); i++)
+        /* nop */;
     }
-  } /* for (rule) */
+  } /* while (i < rules_num) */
 
   if ((status == FC_TARGET_STOP) || (status == FC_TARGET_RETURN))
     return status;
@@ -983,6 +1209,58 @@ int fc_default_action(const data_set_t *ds, value_list_t *vl) /* {{{ */
   return fc_bit_write_invoke(ds, vl, NULL, NULL);
 } /* }}} int fc_default_action */
 
+void fc_enable_statistics(void) /* {{{ */
+{
+  record_statistics = true;
+} /* }}} void fc_enable_statistics */
+
+/* Dispatches the number of times each rule has been evaluated and has matched
+ * and the time spent processing it, including its targets. */
+void fc_dispatch_statistics(void) /* {{{ */
+{
+  value_list_t vl = VALUE_LIST_INIT;
+
+  sstrncpy(vl.plugin, "collectd", sizeof(vl.plugin));
+  vl.interval = plugin_get_interval();
+  vl.values_len = 1;
+
+  for (fc_chain_t *chain = chain_list_head; chain != NULL;
+       chain = chain->next) {
+    ssnprintf(vl.plugin_instance, sizeof(vl.plugin_instance), "filter-%s",
+              chain->name);
+
+    for (size_t i = 0; i < chain->program_len; i++) {
+      fc_rule_t *rule = chain->program[i];
+      char rule_name[DATA_MAX_NAME_LEN];
+
+      if (rule->name[0] != 0)
+        sstrncpy(rule_name, rule->name, sizeof(rule_name));
+      else
+        ssnprintf(rule_name, sizeof(rule_name), "rule%" PRIsz, i);
+
+      vl.values = &(value_t){
+          .derive = (derive_t)ATOMIC_LOAD(&rule->evaluated)};
+      sstrncpy(vl.type, "derive", sizeof(vl.type));
+      ssnprintf(vl.type_instance, sizeof(vl.type_instance), "%s-evaluated",
+                rule_name);
+      plugin_dispatch_values(&vl);
+
+      vl.values = &(value_t){
+          .derive = (derive_t)ATOMIC_LOAD(&rule->hits)};
+      sstrncpy(vl.type, "derive", sizeof(vl.type));
+      ssnprintf(vl.type_instance, sizeof(vl.type_instance), "%s-hits",
+                rule_name);
+      plugin_dispatch_values(&vl);
+
+      vl.values = &(value_t){
+          .derive = (derive_t)CDTIME_T_TO_MS(ATOMIC_LOAD(&rule->time))};
+      sstrncpy(vl.type, "total_time_in_ms", sizeof(vl.type));
+      sstrncpy(vl.type_instance, rule_name, sizeof(vl.type_instance));
+      plugin_dispatch_values(&vl);
+    }
+  }
+} /* }}} void fc_dispatch_statistics */
+
 int fc_configure(const oconfig_item_t *ci) /* {{{ */
 {
   fc_init_once();
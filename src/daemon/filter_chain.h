@@ -46,6 +46,10 @@ struct match_proc_s {
   int (*destroy)(void **user_data);
   int (*match)(const data_set_t *ds, const value_list_t *vl,
                notification_meta_t **meta, void **user_data);
+  /* Optional. Returns FC_MATCH_NO_MATCH if no value list with the given plugin
+   * and type can match, FC_MATCH_MATCHES otherwise. Used to skip rules without
+   * calling "match". */
+  int (*prefilter)(const char *plugin, const char *type, void **user_data);
 };
 typedef struct match_proc_s match_proc_t;
 
@@ -95,6 +99,12 @@ int fc_process_chain(const data_set_t *ds, value_list_t *vl, fc_chain_t *chain);
 
 int fc_default_action(const data_set_t *ds, value_list_t *vl);
 
+/*
+ * Statistics
+ */
+void fc_enable_statistics(void);
+void fc_dispatch_statistics(void);
+
 /*
  * Shortcut for global configuration
  */
@@ -0,0 +1,204 @@
+/**
+ * collectd - src/daemon/filter_chain_test.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "filter_chain.h"
+#include "testing.h"
+#include "utils/common/common.h"
+
+static data_source_t dsrc_test = {"value", DS_TYPE_GAUGE, 0.0, NAN};
+static data_set_t const ds_test = {"gauge", 1, &dsrc_test};
+
+static int match_calls;
+static int count_calls;
+
+/* The "plugin" match and the "set_plugin" target take the plugin name from
+ * their only child option. */
+static int test_create(const oconfig_item_t *ci, void **user_data) {
+  if ((ci->children_num != 1) || (ci->children[0].values_num != 1))
+    return -1;
+
+  *user_data = strdup(ci->children[0].values[0].value.string);
+  return (*user_data != NULL) ? 0 : -1;
+}
+
+static int test_destroy(void **user_data) {
+  sfree(*user_data);
+  return 0;
+}
+
+static int test_match(__attribute__((unused)) const data_set_t *ds,
+                      const value_list_t *vl,
+                      __attribute__((unused)) notification_meta_t **meta,
+                      void **user_data) {
+  match_calls++;
+  return (strcmp(vl->plugin, *user_data) == 0) ? FC_MATCH_MATCHES
+                                                : FC_MATCH_NO_MATCH;
+}
+
+static int test_prefilter(const char *plugin,
+                          __attribute__((unused)) const char *type,
+                          void **user_data) {
+  return (strcmp(plugin, *user_data) == 0) ? FC_MATCH_MATCHES
+                                           : FC_MATCH_NO_MATCH;
+}
+
+static int test_set_plugin(__attribute__((unused)) const data_set_t *ds,
+                           value_list_t *vl,
+                           __attribute__((unused)) notification_meta_t **meta,
+                           void **user_data) {
+  sstrncpy(vl->plugin, *user_data, sizeof(vl->plugin));
+  return FC_TARGET_CONTINUE;
+}
+
+static int test_count(__attribute__((unused)) const data_set_t *ds,
+                      __attribute__((unused)) value_list_t *vl,
+                      __attribute__((unused)) notification_meta_t **meta,
+                      __attribute__((unused)) void **user_data) {
+  count_calls++;
+  return FC_TARGET_CONTINUE;
+}
+
+/*
+ * <Chain "test">
+ *   <Rule "rename">
+ *     <Match "plugin">
+ *       Plugin "old"
+ *     </Match>
+ *     <Target "set_plugin">
+ *       Plugin "new"
+ *     </Target>
+ *   </Rule>
+ *   <Rule "count">
+ *     <Match "plugin">
+ *       Plugin "new"
+ *     </Match>
+ *     <Target "count">
+ *     </Target>
+ *   </Rule>
+ * </Chain>
+ */
+#define STRING_VALUE(s)                                                        \
+  { .value.string = (s), .type = OCONFIG_TYPE_STRING }
+
+static oconfig_value_t v_chain = STRING_VALUE("test");
+static oconfig_value_t v_rename = STRING_VALUE("rename");
+static oconfig_value_t v_count = STRING_VALUE("count");
+static oconfig_value_t v_plugin = STRING_VALUE("plugin");
+static oconfig_value_t v_set_plugin = STRING_VALUE("set_plugin");
+static oconfig_value_t v_old = STRING_VALUE("old");
+static oconfig_value_t v_new = STRING_VALUE("new");
+
+static oconfig_item_t opt_old = {.key = "Plugin", .values = &v_old,
+                                 .values_num = 1};
+static oconfig_item_t opt_new = {.key = "Plugin", .values = &v_new,
+                                 .values_num = 1};
+
+static oconfig_item_t rename_children[] = {
+    {.key = "Match", .values = &v_plugin, .values_num = 1,
+     .children = &opt_old, .children_num = 1},
+    {.key = "Target", .values = &v_set_plugin, .values_num = 1,
+     .children = &opt_new, .children_num = 1},
+};
+static oconfig_item_t count_children[] = {
+    {.key = "Match", .values = &v_plugin, .values_num = 1,
+     .children = &opt_new, .children_num = 1},
+    {.key = "Target", .values = &v_count, .values_num = 1},
+};
+static oconfig_item_t rules[] = {
+    {.key = "Rule", .values = &v_rename, .values_num = 1,
+     .children = rename_children, .children_num = 2},
+    {.key = "Rule", .values = &v_count, .values_num = 1,
+     .children = count_children, .children_num = 2},
+};
+static oconfig_item_t chain_config = {.key = "Chain", .values = &v_chain,
+                                      .values_num = 1, .children = rules,
+                                      .children_num = 2};
+
+static int process(char const *plugin, char *ret_plugin,
+                   size_t ret_plugin_size) {
+  value_list_t vl = VALUE_LIST_INIT;
+  fc_chain_t *chain = fc_chain_get_by_name("test");
+  int status;
+
+  if (chain == NULL)
+    return -1;
+
+  sstrncpy(vl.plugin, plugin, sizeof(vl.plugin));
+  sstrncpy(vl.type, "gauge", sizeof(vl.type));
+
+  status = fc_process_chain(&ds_test, &vl, chain);
+  sstrncpy(ret_plugin, vl.plugin, ret_plugin_size);
+  return status;
+}
+
+DEF_TEST(rewrite) {
+  match_proc_t mproc = {
+      .create = test_create,
+      .destroy = test_destroy,
+      .match = test_match,
+      .prefilter = test_prefilter,
+  };
+  target_proc_t tproc_set = {
+      .create = test_create,
+      .destroy = test_destroy,
+      .invoke = test_set_plugin,
+  };
+  target_proc_t tproc_count = {.invoke = test_count};
+  char plugin[DATA_MAX_NAME_LEN];
+
+  CHECK_ZERO(fc_register_match("plugin", mproc));
+  CHECK_ZERO(fc_register_target("set_plugin", tproc_set));
+  CHECK_ZERO(fc_register_target("count", tproc_count));
+  CHECK_ZERO(fc_configure(&chain_config));
+
+  /* Neither rule may match, so no match is evaluated at all. */
+  match_calls = count_calls = 0;
+  EXPECT_EQ_INT(FC_TARGET_CONTINUE, process("other", plugin, sizeof(plugin)));
+  EXPECT_EQ_STR("other", plugin);
+  EXPECT_EQ_INT(0, match_calls);
+  EXPECT_EQ_INT(0, count_calls);
+
+  match_calls = count_calls = 0;
+  EXPECT_EQ_INT(FC_TARGET_CONTINUE, process("new", plugin, sizeof(plugin)));
+  EXPECT_EQ_STR("new", plugin);
+  EXPECT_EQ_INT(1, match_calls);
+  EXPECT_EQ_INT(1, count_calls);
+
+  /* The first rule renames "old" to "new", which the second rule has to see
+   * although it was skipped for "old". */
+  match_calls = count_calls = 0;
+  EXPECT_EQ_INT(FC_TARGET_CONTINUE, process("old", plugin, sizeof(plugin)));
+  EXPECT_EQ_STR("new", plugin);
+  EXPECT_EQ_INT(2, match_calls);
+  EXPECT_EQ_INT(1, count_calls);
+
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(rewrite);
+
+  END_TEST;
+}
@@ -36,6 +36,8 @@
 #include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
 #include "utils/heap/heap.h"
+#include "utils/latency/latency.h"
+#include "utils_atomic.h"
 #include "utils_cache.h"
 #include "utils_complain.h"
 #include "utils_llist.h"
@@ -63,6 +65,14 @@ struct callback_func_s {
   void *cf_callback;
   user_data_t cf_udata;
   plugin_ctx_t cf_ctx;
+  /* Only used in `list_write': if true, `cf_callback' is a
+   * plugin_write_batch_cb rather than a plugin_write_cb. */
+  bool cf_write_batch;
+  /* Only used for batch callbacks: the list and every pending batch hold a
+   * reference, so that unregistering doesn't free the callback under a write
+   * thread. `cf_unregistered' tells the write threads to drop their values. */
+  unsigned int cf_refcount;
+  bool cf_unregistered;
 };
 typedef struct callback_func_s callback_func_t;
 
@@ -82,9 +92,31 @@ struct read_func_s {
   cdtime_t rf_interval;
   cdtime_t rf_effective_interval;
   cdtime_t rf_next_read;
+  /* Execution time and scheduling lag; protected by `rf_stats_lock'. */
+  pthread_mutex_t rf_stats_lock;
+  latency_counter_t *rf_exec_latency;
+  latency_counter_t *rf_lag_latency;
 };
 typedef struct read_func_s read_func_t;
 
+/* Each read thread runs the read functions in its own heap, ordered by
+ * `rf_next_read'. When none of them is due, it steals due functions from the
+ * heaps of threads which are busy running a (slow) read callback, so that those
+ * don't delay the other functions. Threads are woken up individually, when a
+ * function is added to their heap or when another thread becomes busy while
+ * functions are waiting for it. */
+struct read_scheduler_s {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  c_heap_t *heap;
+  size_t rf_num;
+  /* The thread is running a read callback. */
+  bool busy;
+  /* The thread has to re-evaluate when to run the next read function. */
+  bool kicked;
+};
+typedef struct read_scheduler_s read_scheduler_t;
+
 struct cache_event_func_s {
   plugin_cache_event_cb callback;
   char *name;
@@ -93,13 +125,31 @@ struct cache_event_func_s {
 };
 typedef struct cache_event_func_s cache_event_func_t;
 
-struct write_queue_s;
-typedef struct write_queue_s write_queue_t;
 struct write_queue_s {
   value_list_t *vl;
   plugin_ctx_t ctx;
-  write_queue_t *next;
 };
+typedef struct write_queue_s write_queue_t;
+
+/* Values for one batch write callback, collected by a write thread. */
+struct write_batch_s {
+  callback_func_t *cf;
+  write_batch_entry_t *entries;
+  size_t entries_num;
+  size_t entries_size;
+};
+typedef struct write_batch_s write_batch_t;
+
+struct write_batch_list_s {
+  /* Slots with `cf == NULL' are unused; their `entries' are kept for reuse. */
+  write_batch_t *batches;
+  size_t batches_num;
+  /* The queued value list which the write thread is dispatching, and whether
+   * batches may reference it rather than take a copy. */
+  value_list_t *current;
+  bool current_shareable;
+};
+typedef struct write_batch_list_s write_batch_list_t;
 
 struct flush_callback_s {
   char *name;
@@ -133,23 +183,41 @@ static char *plugindir;
 #ifndef DEFAULT_MAX_READ_INTERVAL
 #define DEFAULT_MAX_READ_INTERVAL TIME_T_TO_CDTIME_T_STATIC(86400)
 #endif
+/* Read functions are kept in `read_heap' until the read threads are started
+ * and are then handed to the threads' schedulers. */
 static c_heap_t *read_heap;
 static llist_t *read_list;
 static int read_loop = 1;
 static pthread_mutex_t read_lock = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t read_cond = PTHREAD_COND_INITIALIZER;
 static pthread_t *read_threads;
 static size_t read_threads_num;
+static read_scheduler_t *read_schedulers;
+static size_t read_schedulers_num;
 static cdtime_t max_read_interval = DEFAULT_MAX_READ_INTERVAL;
 
-static write_queue_t *write_queue_head;
-static write_queue_t *write_queue_tail;
+/* The write queue is a ring buffer of `write_queue_size' elements, which is
+ * always a power of two. It is grown when full and shrunk when mostly empty,
+ * so that enqueueing a value doesn't require an allocation of its own. Write
+ * threads remove up to WRITE_QUEUE_BATCH_MAX elements at once. */
+#ifndef WRITE_QUEUE_SIZE_MIN
+#define WRITE_QUEUE_SIZE_MIN 1024
+#endif
+#ifndef WRITE_QUEUE_BATCH_MAX
+#define WRITE_QUEUE_BATCH_MAX 64
+#endif
+static write_queue_t *write_queue;
+static size_t write_queue_size;
+static size_t write_queue_head;
 static long write_queue_length;
 static bool write_loop = true;
 static pthread_mutex_t write_lock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t write_cond = PTHREAD_COND_INITIALIZER;
+static size_t write_threads_waiting;
 static pthread_t *write_threads;
 static size_t write_threads_num;
+/* Points to the write thread's write_batch_list_t. */
+static pthread_key_t write_batch_key;
+static bool write_batch_key_initialized;
 
 static pthread_key_t plugin_ctx_key;
 static bool plugin_ctx_key_initialized;
@@ -161,6 +229,49 @@ static pthread_mutex_t statistics_lock = PTHREAD_MUTEX_INITIALIZER;
 static derive_t stats_values_dropped;
 static bool record_statistics;
 
+/* Clones of value lists are allocated from a pool of fixed-size entries with
+ * room for up to VL_POOL_VALUES_NUM values, so that the common case requires
+ * a single block. Each thread keeps up to VL_POOL_LOCAL_MAX free entries of
+ * its own and exchanges them with the shared pool in batches, so that
+ * allocating and freeing entries doesn't take a lock in most cases. Entries
+ * are usually allocated by read threads and freed by write threads, which
+ * return them to the shared pool from where the read threads take them. */
+#ifndef VL_POOL_VALUES_NUM
+#define VL_POOL_VALUES_NUM 4
+#endif
+#ifndef VL_POOL_LOCAL_MAX
+#define VL_POOL_LOCAL_MAX 128
+#endif
+#ifndef VL_POOL_SHARED_MAX
+#define VL_POOL_SHARED_MAX 8192
+#endif
+typedef struct vl_pool_entry_s vl_pool_entry_t;
+struct vl_pool_entry_s {
+  /* Must be the first member, see plugin_value_list_free(). */
+  value_list_t vl;
+  value_t values[VL_POOL_VALUES_NUM];
+  /* The write thread and its batches, see write_batch_add(). Only ever
+   * touched by the thread owning the value list. */
+  size_t refcount;
+  vl_pool_entry_t *next;
+};
+
+typedef struct {
+  vl_pool_entry_t *head;
+  size_t num;
+  /* Added to the shared counters whenever the shared pool is locked. */
+  derive_t pool_allocs;
+  derive_t heap_allocs;
+} vl_pool_local_t;
+
+static pthread_once_t vl_pool_once = PTHREAD_ONCE_INIT;
+static pthread_key_t vl_pool_key;
+static pthread_mutex_t vl_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static vl_pool_entry_t *vl_pool_head;
+static size_t vl_pool_num;
+static derive_t stats_vl_pool_allocs;
+static derive_t stats_vl_heap_allocs;
+
 /*
  * Static functions
  */
@@ -173,6 +284,121 @@ static const char *plugin_get_dir(void) {
     return plugindir;
 }
 
+static int compare_read_stats(const void *a, const void *b) /* {{{ */
+{
+  const plugin_read_stats_t *s0 = a;
+  const plugin_read_stats_t *s1 = b;
+
+  if (s0->exec_average > s1->exec_average)
+    return -1;
+  else if (s0->exec_average < s1->exec_average)
+    return 1;
+  return strcmp(s0->name, s1->name);
+} /* }}} int compare_read_stats */
+
+/* Copies the statistics of all read functions in `read_list' and, if `reset'
+ * is true, starts a new measurement period. */
+static int read_stats_snapshot(plugin_read_stats_t **ret_stats, /* {{{ */
+                               size_t *ret_stats_num, bool reset) {
+  plugin_read_stats_t *stats;
+  size_t stats_num = 0;
+  int list_size;
+
+  pthread_mutex_lock(&read_lock);
+
+  list_size = (read_list != NULL) ? llist_size(read_list) : 0;
+  stats = calloc((list_size > 0) ? (size_t)list_size : 1, sizeof(*stats));
+  if (stats == NULL) {
+    pthread_mutex_unlock(&read_lock);
+    return ENOMEM;
+  }
+
+  for (llentry_t *le = (read_list != NULL) ? llist_head(read_list) : NULL;
+       le != NULL; le = le->next) {
+    read_func_t *rf = le->value;
+    plugin_read_stats_t *s = stats + stats_num;
+
+    sstrncpy(s->name, rf->rf_name, sizeof(s->name));
+
+    pthread_mutex_lock(&rf->rf_stats_lock);
+    s->calls = latency_counter_get_num(rf->rf_exec_latency);
+    s->exec_average = latency_counter_get_average(rf->rf_exec_latency);
+    s->exec_percentile = latency_counter_get_percentile(
+        rf->rf_exec_latency, PLUGIN_READ_STATS_PERCENTILE);
+    s->exec_max = latency_counter_get_max(rf->rf_exec_latency);
+    s->lag_average = latency_counter_get_average(rf->rf_lag_latency);
+    s->lag_percentile = latency_counter_get_percentile(
+        rf->rf_lag_latency, PLUGIN_READ_STATS_PERCENTILE);
+    s->lag_max = latency_counter_get_max(rf->rf_lag_latency);
+    if (reset) {
+      latency_counter_reset(rf->rf_exec_latency);
+      latency_counter_reset(rf->rf_lag_latency);
+    }
+    pthread_mutex_unlock(&rf->rf_stats_lock);
+
+    stats_num++;
+  }
+
+  pthread_mutex_unlock(&read_lock);
+
+  qsort(stats, stats_num, sizeof(*stats), compare_read_stats);
+
+  *ret_stats = stats;
+  *ret_stats_num = stats_num;
+  return 0;
+} /* }}} int read_stats_snapshot */
+
+/* Dispatches execution time and scheduling lag of each read function that has
+ * been called since the last time. */
+static void plugin_dispatch_read_statistics(void) /* {{{ */
+{
+  plugin_read_stats_t *stats = NULL;
+  size_t stats_num = 0;
+
+  if (read_stats_snapshot(&stats, &stats_num, /* reset = */ true) != 0)
+    return;
+
+  value_list_t vl = VALUE_LIST_INIT;
+  sstrncpy(vl.plugin, "collectd", sizeof(vl.plugin));
+  sstrncpy(vl.type, "duration", sizeof(vl.type));
+  vl.interval = plugin_get_interval();
+  vl.values_len = 1;
+
+  for (size_t i = 0; i < stats_num; i++) {
+    plugin_read_stats_t *s = stats + i;
+    struct {
+      char const *name;
+      cdtime_t value;
+    } values[] = {
+        {"execution-average", s->exec_average},
+        {"execution-percentile", s->exec_percentile},
+        {"execution-max", s->exec_max},
+        {"lag-average", s->lag_average},
+        {"lag-percentile", s->lag_percentile},
+        {"lag-max", s->lag_max},
+    };
+
+    if (s->calls == 0)
+      continue;
+
+    ssnprintf(vl.plugin_instance, sizeof(vl.plugin_instance), "read-%s",
+              s->name);
+
+    for (size_t j = 0; j < STATIC_ARRAY_SIZE(values); j++) {
+      if (strstr(values[j].name, "percentile") != NULL)
+        ssnprintf(vl.type_instance, sizeof(vl.type_instance), "%s-%.0f",
+                  values[j].name, PLUGIN_READ_STATS_PERCENTILE);
+      else
+        sstrncpy(vl.type_instance, values[j].name, sizeof(vl.type_instance));
+
+      vl.values = &(value_t){.gauge = CDTIME_T_TO_DOUBLE(values[j].value)};
+      plugin_dispatch_values(&vl);
+    }
+  }
+
+  sfree(stats);
+} /* }}} void plugin_dispatch_read_statistics */
+
 static int plugin_update_internal_statistics(void) { /* {{{ */
   gauge_t copy_write_queue_length = (gauge_t)write_queue_length;
 
@@ -198,6 +424,36 @@ static int plugin_update_internal_statistics(void) { /* {{{ */
   sstrncpy(vl.type_instance, "dropped", sizeof(vl.type_instance));
   plugin_dispatch_values(&vl);
 
+  /* Value list pool */
+  pthread_mutex_lock(&vl_pool_lock);
+  derive_t copy_pool_allocs = stats_vl_pool_allocs;
+  derive_t copy_heap_allocs = stats_vl_heap_allocs;
+  gauge_t copy_pool_num = (gauge_t)vl_pool_num;
+  pthread_mutex_unlock(&vl_pool_lock);
+
+  sstrncpy(vl.plugin_instance, "value_list_pool", sizeof(vl.plugin_instance));
+
+  /* Value list pool : Clones served from the pool */
+  vl.values = &(value_t){.derive = copy_pool_allocs};
+  vl.values_len = 1;
+  sstrncpy(vl.type, "derive", sizeof(vl.type));
+  sstrncpy(vl.type_instance, "pool_allocs", sizeof(vl.type_instance));
+  plugin_dispatch_values(&vl);
+
+  /* Value list pool : Clones which required a heap allocation */
+  vl.values = &(value_t){.derive = copy_heap_allocs};
+  vl.values_len = 1;
+  sstrncpy(vl.type, "derive", sizeof(vl.type));
+  sstrncpy(vl.type_instance, "heap_allocs", sizeof(vl.type_instance));
+  plugin_dispatch_values(&vl);
+
+  /* Value list pool : Free entries in the shared pool */
+  vl.values = &(value_t){.gauge = copy_pool_num};
+  vl.values_len = 1;
+  sstrncpy(vl.type, "objects", sizeof(vl.type));
+  sstrncpy(vl.type_instance, "free", sizeof(vl.type_instance));
+  plugin_dispatch_values(&vl);
+
   /* Cache */
   sstrncpy(vl.plugin_instance, "cache", sizeof(vl.plugin_instance));
 
@@ -208,6 +464,12 @@ static int plugin_update_internal_statistics(void) { /* {{{ */
   vl.type_instance[0] = 0;
   plugin_dispatch_values(&vl);
 
+  /* Read callbacks */
+  plugin_dispatch_read_statistics();
+
+  /* Filter chain rules */
+  fc_dispatch_statistics();
+
   return 0;
 } /* }}} int plugin_update_internal_statistics */
 
@@ -221,14 +483,41 @@ static void free_userdata(user_data_t const *ud) /* {{{ */
   }
 } /* }}} void free_userdata */
 
+static void callback_unref(callback_func_t *cf) /* {{{ */
+{
+  if (ATOMIC_SUB_FETCH(&cf->cf_refcount, 1) > 0)
+    return;
+
+  free_userdata(&cf->cf_udata);
+  sfree(cf);
+} /* }}} void callback_unref */
+
 static void destroy_callback(callback_func_t *cf) /* {{{ */
 {
   if (cf == NULL)
     return;
+
+  if (cf->cf_write_batch) {
+    ATOMIC_STORE(&cf->cf_unregistered, true);
+    callback_unref(cf);
+    return;
+  }
+
   free_userdata(&cf->cf_udata);
   sfree(cf);
 } /* }}} void destroy_callback */
 
+static void destroy_read_func(read_func_t *rf) /* {{{ */
+{
+  if (rf == NULL)
+    return;
+  sfree(rf->rf_name);
+  latency_counter_destroy(rf->rf_exec_latency);
+  latency_counter_destroy(rf->rf_lag_latency);
+  pthread_mutex_destroy(&rf->rf_stats_lock);
+  destroy_callback((callback_func_t *)rf);
+} /* }}} void destroy_read_func */
+
 static void destroy_all_callbacks(llist_t **list) /* {{{ */
 {
   llentry_t *le;
@@ -264,8 +553,7 @@ static void destroy_read_heap(void) /* {{{ */
     rf = c_heap_get_root(read_heap);
     if (rf == NULL)
       break;
-    sfree(rf->rf_name);
-    destroy_callback((callback_func_t *)rf);
+    destroy_read_func(rf);
   }
 
   c_heap_destroy(read_heap);
@@ -447,7 +735,177 @@ static int plugin_load_file(char const *file, bool global) {
   return 0;
 }
 
-static void *plugin_read_thread(void __attribute__((unused)) * args) {
+/* NOTE: You must hold s->lock when calling this function! */
+static void read_scheduler_kick_nolock(read_scheduler_t *s) /* {{{ */
+{
+  s->kicked = true;
+  pthread_cond_signal(&s->cond);
+} /* }}} void read_scheduler_kick_nolock */
+
+/* Wakes up one thread which is not running a read callback, so that it can
+ * steal the due read functions of busy threads. */
+static void read_scheduler_kick_idle(read_scheduler_t *self) /* {{{ */
+{
+  size_t num = ATOMIC_LOAD(&read_schedulers_num);
+  size_t self_index = (self != NULL) ? (size_t)(self - read_schedulers) : 0;
+
+  for (size_t i = 1; i <= num; i++) {
+    read_scheduler_t *s = read_schedulers + ((self_index + i) % num);
+
+    if (s == self)
+      continue;
+
+    pthread_mutex_lock(&s->lock);
+    if (!s->busy) {
+      read_scheduler_kick_nolock(s);
+      pthread_mutex_unlock(&s->lock);
+      return;
+    }
+    pthread_mutex_unlock(&s->lock);
+  }
+} /* }}} void read_scheduler_kick_idle */
+
+/* Adds `rf' to the heap of `s' and makes sure a thread will run it in time. */
+static int read_scheduler_insert(read_scheduler_t *s, /* {{{ */
+                                 read_func_t *rf) {
+  bool busy;
+  int status;
+
+  pthread_mutex_lock(&s->lock);
+  status = c_heap_insert(s->heap, rf);
+  if (status == 0)
+    s->rf_num++;
+  read_scheduler_kick_nolock(s);
+  busy = s->busy;
+  pthread_mutex_unlock(&s->lock);
+
+  if ((status == 0) && busy)
+    read_scheduler_kick_idle(s);
+
+  return status;
+} /* }}} int read_scheduler_insert */
+
+/* Returns the scheduler with the fewest read functions.
+ * NOTE: You must hold read_lock when calling this function! */
+static read_scheduler_t *read_scheduler_least_loaded(void) /* {{{ */
+{
+  read_scheduler_t *ret = NULL;
+  size_t ret_num = 0;
+  size_t num = ATOMIC_LOAD(&read_schedulers_num);
+
+  for (size_t i = 0; i < num; i++) {
+    read_scheduler_t *s = read_schedulers + i;
+    size_t rf_num;
+
+    pthread_mutex_lock(&s->lock);
+    rf_num = s->rf_num + (s->busy ? 1 : 0);
+    pthread_mutex_unlock(&s->lock);
+
+    if ((ret == NULL) || (rf_num < ret_num)) {
+      ret = s;
+      ret_num = rf_num;
+    }
+  }
+
+  return ret;
+} /* }}} read_scheduler_t *read_scheduler_least_loaded */
+
+/* Takes a due read function from a thread that is busy running another one.
+ * Otherwise, lowers `*ret_next' to the time the next of those functions is
+ * due, so the calling thread wakes up in time to take it. */
+static read_func_t *read_scheduler_steal(read_scheduler_t *self, /* {{{ */
+                                         cdtime_t now, cdtime_t *ret_next) {
+  size_t num = ATOMIC_LOAD(&read_schedulers_num);
+  size_t self_index = (size_t)(self - read_schedulers);
+
+  for (size_t i = 1; i < num; i++) {
+    read_scheduler_t *s = read_schedulers + ((self_index + i) % num);
+    read_func_t *rf;
+
+    pthread_mutex_lock(&s->lock);
+    if (!s->busy) {
+      pthread_mutex_unlock(&s->lock);
+      continue;
+    }
+
+    rf = c_heap_peek_root(s->heap);
+    if ((rf != NULL) && (rf->rf_next_read <= now)) {
+      c_heap_get_root(s->heap);
+      s->rf_num--;
+      pthread_mutex_unlock(&s->lock);
+      return rf;
+    }
+
+    if ((rf != NULL) && ((*ret_next == 0) || (rf->rf_next_read < *ret_next)))
+      *ret_next = rf->rf_next_read;
+    pthread_mutex_unlock(&s->lock);
+  }
+
+  return NULL;
+} /* }}} read_func_t *read_scheduler_steal */
+
+/* Waits for the next read function of the thread's own heap or of the
+ * heaps of busy threads, see above, and takes it. Returns NULL if the thread
+ * should check again, e.g. because it has been woken up. */
+static read_func_t *read_scheduler_next(read_scheduler_t *self) /* {{{ */
+{
+  cdtime_t now = cdtime();
+  cdtime_t next = 0;
+  read_func_t *rf;
+  bool stolen = false;
+
+  pthread_mutex_lock(&self->lock);
+  self->kicked = false;
+  rf = c_heap_peek_root(self->heap);
+  if ((rf != NULL) && (rf->rf_next_read <= now)) {
+    c_heap_get_root(self->heap);
+    self->rf_num--;
+  } else {
+    rf = NULL;
+  }
+  pthread_mutex_unlock(&self->lock);
+
+  if (rf == NULL) {
+    rf = read_scheduler_steal(self, now, &next);
+    stolen = (rf != NULL);
+  }
+
+  pthread_mutex_lock(&self->lock);
+  if (rf != NULL) {
+    bool pending = (self->rf_num > 0) || stolen;
+
+    self->busy = true;
+    pthread_mutex_unlock(&self->lock);
+
+    /* Let an idle thread take care of the functions this thread was
+     * supposed to run while it is busy. */
+    if (pending)
+      read_scheduler_kick_idle(self);
+    return rf;
+  }
+
+  /* In pthread_cond_timedwait, spurious wakeups are possible (and really
+   * happen, at least on NetBSD with > 1 CPU), so the caller re-evaluates the
+   * heaps every time we return. */
+  if ((read_loop != 0) && !self->kicked) {
+    read_func_t *root = c_heap_peek_root(self->heap);
+    if ((root != NULL) && ((next == 0) || (root->rf_next_read < next)))
+      next = root->rf_next_read;
+
+    if (next == 0)
+      pthread_cond_wait(&self->cond, &self->lock);
+    else if (next > cdtime())
+      pthread_cond_timedwait(&self->cond, &self->lock,
+                             &CDTIME_T_TO_TIMESPEC(next));
+  }
+  pthread_mutex_unlock(&self->lock);
+
+  return NULL;
+} /* }}} read_func_t *read_scheduler_next */
+
+static void *plugin_read_thread(void *args) {
+  read_scheduler_t *self = args;
+
   while (read_loop != 0) {
     read_func_t *rf;
     plugin_ctx_t old_ctx;
@@ -456,20 +914,10 @@ static void *plugin_read_thread(void __attribute__((unused)) * args) {
     cdtime_t elapsed;
     int status;
     int rf_type;
-    int rc;
 
-    /* Get the read function that needs to be read next.
-     * We don't need to hold "read_lock" for the heap, but we need
-     * to call c_heap_get_root() and pthread_cond_wait() in the
-     * same protected block. */
-    pthread_mutex_lock(&read_lock);
-    rf = c_heap_get_root(read_heap);
-    if (rf == NULL) {
-      pthread_cond_wait(&read_cond, &read_lock);
-      pthread_mutex_unlock(&read_lock);
+    rf = read_scheduler_next(self);
+    if (rf == NULL)
       continue;
-    }
-    pthread_mutex_unlock(&read_lock);
 
     if (rf->rf_interval == 0) {
       /* this should not happen, because the interval is set
@@ -481,20 +929,8 @@ static void *plugin_read_thread(void __attribute__((unused)) * args) {
       rf->rf_next_read = cdtime();
     }
 
-    /* sleep until this entry is due,
-     * using pthread_cond_timedwait */
-    pthread_mutex_lock(&read_lock);
-    /* In pthread_cond_timedwait, spurious wakeups are possible
-     * (and really happen, at least on NetBSD with > 1 CPU), thus
-     * we need to re-evaluate the condition every time
-     * pthread_cond_timedwait returns. */
-    rc = 0;
-    while ((read_loop != 0) && (cdtime() < rf->rf_next_read) && rc == 0) {
-      rc = pthread_cond_timedwait(&read_cond, &read_lock,
-                                  &CDTIME_T_TO_TIMESPEC(rf->rf_next_read));
-    }
-
     /* Must hold `read_lock' when accessing `rf->rf_type'. */
+    pthread_mutex_lock(&read_lock);
     rf_type = rf->rf_type;
     pthread_mutex_unlock(&read_lock);
 
@@ -502,7 +938,11 @@ static void *plugin_read_thread(void __attribute__((unused)) * args) {
      * the sleep, too. */
     if (read_loop == 0) {
       /* Insert `rf' again, so it can be free'd correctly */
-      c_heap_insert(read_heap, rf);
+      pthread_mutex_lock(&self->lock);
+      c_heap_insert(self->heap, rf);
+      self->rf_num++;
+      self->busy = false;
+      pthread_mutex_unlock(&self->lock);
       break;
     }
 
@@ -514,9 +954,12 @@ static void *plugin_read_thread(void __attribute__((unused)) * args) {
       DEBUG("plugin_read_thread: Destroying the `%s' "
             "callback.",
             rf->rf_name);
-      sfree(rf->rf_name);
-      destroy_callback((callback_func_t *)rf);
+      destroy_read_func(rf);
       rf = NULL;
+
+      pthread_mutex_lock(&self->lock);
+      self->busy = false;
+      pthread_mutex_unlock(&self->lock);
       continue;
     }
 
@@ -571,6 +1014,15 @@ static void *plugin_read_thread(void __attribute__((unused)) * args) {
           rf->rf_name, CDTIME_T_TO_DOUBLE(elapsed),
           CDTIME_T_TO_DOUBLE(rf->rf_effective_interval));
 
+    /* latency_counter_add() ignores zero, so durations are recorded as at
+     * least one cdtime_t tick (2^-30 seconds). */
+    pthread_mutex_lock(&rf->rf_stats_lock);
+    latency_counter_add(rf->rf_exec_latency, (elapsed > 0) ? elapsed : 1);
+    latency_counter_add(rf->rf_lag_latency, (start > rf->rf_next_read)
+                                                ? (start - rf->rf_next_read)
+                                                : 1);
+    pthread_mutex_unlock(&rf->rf_stats_lock);
+
     DEBUG("plugin_read_thread: read-function of the `%s' plugin took "
           "%.6f seconds.",
           rf->rf_name, CDTIME_T_TO_DOUBLE(elapsed));
@@ -594,8 +1046,12 @@ static void *plugin_read_thread(void __attribute__((unused)) * args) {
     DEBUG("plugin_read_thread: Next read of the `%s' plugin at %.3f.",
           rf->rf_name, CDTIME_T_TO_DOUBLE(rf->rf_next_read));
 
-    /* Re-insert this read function into the heap again. */
-    c_heap_insert(read_heap, rf);
+    /* Re-insert this read function into the thread's heap again. */
+    pthread_mutex_lock(&self->lock);
+    c_heap_insert(self->heap, rf);
+    self->rf_num++;
+    self->busy = false;
+    pthread_mutex_unlock(&self->lock);
   } /* while (read_loop) */
 
   pthread_exit(NULL);
@@ -630,27 +1086,48 @@ static void set_thread_name(pthread_t tid, char const *name) {
 #endif
 }
 
+static int plugin_compare_read_func(const void *arg0, const void *arg1);
+
 static void start_read_threads(size_t num) /* {{{ */
 {
   if (read_threads != NULL)
     return;
 
   read_threads = calloc(num, sizeof(*read_threads));
-  if (read_threads == NULL) {
+  read_schedulers = calloc(num, sizeof(*read_schedulers));
+  if ((read_threads == NULL) || (read_schedulers == NULL)) {
     ERROR("plugin: start_read_threads: calloc failed.");
+    sfree(read_threads);
+    sfree(read_schedulers);
     return;
   }
 
+  pthread_mutex_lock(&read_lock);
+
   read_threads_num = 0;
   for (size_t i = 0; i < num; i++) {
+    read_scheduler_t *s = read_schedulers + read_threads_num;
+
+    s->heap = c_heap_create(plugin_compare_read_func);
+    if (s->heap == NULL) {
+      ERROR("plugin: start_read_threads: c_heap_create failed.");
+      break;
+    }
+    pthread_mutex_init(&s->lock, /* attr = */ NULL);
+    pthread_cond_init(&s->cond, /* attr = */ NULL);
+
     int status = pthread_create(read_threads + read_threads_num,
                                 /* attr = */ NULL, plugin_read_thread,
-                                /* arg = */ NULL);
+                                /* arg = */ s);
     if (status != 0) {
       ERROR("plugin: start_read_threads: pthread_create failed with status %i "
             "(%s).",
             status, STRERROR(status));
-      return;
+      pthread_cond_destroy(&s->cond);
+      pthread_mutex_destroy(&s->lock);
+      c_heap_destroy(s->heap);
+      s->heap = NULL;
+      break;
     }
 
     char name[THREAD_NAME_MAX];
@@ -659,7 +1136,22 @@ static void start_read_threads(size_t num) /* {{{ */
     set_thread_name(read_threads[read_threads_num], name);
 
     read_threads_num++;
+    ATOMIC_STORE(&read_schedulers_num, read_threads_num);
   } /* for (i) */
+
+  /* Hand the read functions registered so far to the threads. Taking them in
+   * the order they are due spreads functions due at the same time. */
+  if (read_schedulers_num > 0) {
+    read_func_t *rf;
+    size_t i = 0;
+
+    while ((rf = c_heap_get_root(read_heap)) != NULL) {
+      read_scheduler_insert(read_schedulers + (i % read_schedulers_num), rf);
+      i++;
+    }
+  }
+
+  pthread_mutex_unlock(&read_lock);
 } /* }}} void start_read_threads */
 
 static void stop_read_threads(void) {
@@ -670,10 +1162,15 @@ static void stop_read_threads(void) {
 
   pthread_mutex_lock(&read_lock);
   read_loop = 0;
-  DEBUG("plugin: stop_read_threads: Signalling `read_cond'");
-  pthread_cond_broadcast(&read_cond);
   pthread_mutex_unlock(&read_lock);
 
+  DEBUG("plugin: stop_read_threads: Waking up all read threads");
+  for (size_t i = 0; i < read_schedulers_num; i++) {
+    pthread_mutex_lock(&read_schedulers[i].lock);
+    read_scheduler_kick_nolock(read_schedulers + i);
+    pthread_mutex_unlock(&read_schedulers[i].lock);
+  }
+
   for (size_t i = 0; i < read_threads_num; i++) {
     if (pthread_join(read_threads[i], NULL) != 0) {
       ERROR("plugin: stop_read_threads: pthread_join failed.");
@@ -682,43 +1179,192 @@ static void stop_read_threads(void) {
   }
   sfree(read_threads);
   read_threads_num = 0;
+
+  /* Move the read functions back to `read_heap', so they can be freed. */
+  pthread_mutex_lock(&read_lock);
+  for (size_t i = 0; i < read_schedulers_num; i++) {
+    read_scheduler_t *s = read_schedulers + i;
+    read_func_t *rf;
+
+    while ((rf = c_heap_get_root(s->heap)) != NULL)
+      c_heap_insert(read_heap, rf);
+
+    c_heap_destroy(s->heap);
+    pthread_cond_destroy(&s->cond);
+    pthread_mutex_destroy(&s->lock);
+  }
+  ATOMIC_STORE(&read_schedulers_num, 0);
+  sfree(read_schedulers);
+  pthread_mutex_unlock(&read_lock);
 } /* void stop_read_threads */
 
+/* Adds the thread's counters to the shared counters.
+ * `vl_pool_lock' must be held by the caller. */
+static void vl_pool_flush_stats(vl_pool_local_t *local) /* {{{ */
+{
+  stats_vl_pool_allocs += local->pool_allocs;
+  stats_vl_heap_allocs += local->heap_allocs;
+  local->pool_allocs = 0;
+  local->heap_allocs = 0;
+} /* }}} void vl_pool_flush_stats */
+
+/* Moves up to `num' entries from the thread's free list to the shared pool.
+ * Entries exceeding VL_POOL_SHARED_MAX are returned to the heap.
+ * `vl_pool_lock' must be held by the caller. */
+static void vl_pool_release(vl_pool_local_t *local, size_t num) /* {{{ */
+{
+  while ((num > 0) && (local->head != NULL)) {
+    vl_pool_entry_t *e = local->head;
+    local->head = e->next;
+    local->num--;
+    num--;
+
+    if (vl_pool_num >= VL_POOL_SHARED_MAX) {
+      free(e);
+      continue;
+    }
+    e->next = vl_pool_head;
+    vl_pool_head = e;
+    vl_pool_num++;
+  }
+} /* }}} void vl_pool_release */
+
+static void vl_pool_local_destroy(void *arg) /* {{{ */
+{
+  vl_pool_local_t *local = arg;
+
+  pthread_mutex_lock(&vl_pool_lock);
+  vl_pool_release(local, local->num);
+  vl_pool_flush_stats(local);
+  pthread_mutex_unlock(&vl_pool_lock);
+
+  sfree(local);
+} /* }}} void vl_pool_local_destroy */
+
+static void vl_pool_init(void) /* {{{ */
+{
+  pthread_key_create(&vl_pool_key, vl_pool_local_destroy);
+} /* }}} void vl_pool_init */
+
+static vl_pool_local_t *vl_pool_local(void) /* {{{ */
+{
+  pthread_once(&vl_pool_once, vl_pool_init);
+
+  vl_pool_local_t *local = pthread_getspecific(vl_pool_key);
+  if (local != NULL)
+    return local;
+
+  local = calloc(1, sizeof(*local));
+  if (local == NULL)
+    return NULL;
+  pthread_setspecific(vl_pool_key, local);
+  return local;
+} /* }}} vl_pool_local_t *vl_pool_local */
+
+static vl_pool_entry_t *vl_pool_alloc(void) /* {{{ */
+{
+  vl_pool_local_t *local = vl_pool_local();
+  if (local == NULL)
+    return malloc(sizeof(vl_pool_entry_t));
+
+  /* Take half a thread cache's worth of entries from the shared pool. */
+  if (local->head == NULL) {
+    pthread_mutex_lock(&vl_pool_lock);
+    while ((vl_pool_head != NULL) && (local->num < VL_POOL_LOCAL_MAX / 2)) {
+      vl_pool_entry_t *e = vl_pool_head;
+      vl_pool_head = e->next;
+      vl_pool_num--;
+
+      e->next = local->head;
+      local->head = e;
+      local->num++;
+    }
+    vl_pool_flush_stats(local);
+    pthread_mutex_unlock(&vl_pool_lock);
+  }
+
+  if (local->head == NULL) {
+    local->heap_allocs++;
+    return malloc(sizeof(vl_pool_entry_t));
+  }
+
+  vl_pool_entry_t *e = local->head;
+  local->head = e->next;
+  local->num--;
+  local->pool_allocs++;
+  return e;
+} /* }}} vl_pool_entry_t *vl_pool_alloc */
+
+static void vl_pool_free(vl_pool_entry_t *e) /* {{{ */
+{
+  vl_pool_local_t *local = vl_pool_local();
+  if (local == NULL) {
+    free(e);
+    return;
+  }
+
+  e->next = local->head;
+  local->head = e;
+  local->num++;
+
+  if (local->num > VL_POOL_LOCAL_MAX) {
+    pthread_mutex_lock(&vl_pool_lock);
+    vl_pool_release(local, VL_POOL_LOCAL_MAX / 2);
+    vl_pool_flush_stats(local);
+    pthread_mutex_unlock(&vl_pool_lock);
+  }
+} /* }}} void vl_pool_free */
+
+/* Releases a reference to a value list allocated by
+ * plugin_value_list_clone() and frees it with the last one. */
 static void plugin_value_list_free(value_list_t *vl) /* {{{ */
 {
   if (vl == NULL)
     return;
 
+  vl_pool_entry_t *e = (vl_pool_entry_t *)vl;
+  if (--e->refcount > 0)
+    return;
+
   meta_data_destroy(vl->meta);
-  sfree(vl->values);
-  sfree(vl);
+  if (vl->values != e->values)
+    sfree(vl->values);
+  vl_pool_free(e);
 } /* }}} void plugin_value_list_free */
 
 static value_list_t *
 plugin_value_list_clone(value_list_t const *vl_orig) /* {{{ */
 {
+  vl_pool_entry_t *e;
   value_list_t *vl;
 
   if (vl_orig == NULL)
     return NULL;
 
-  vl = malloc(sizeof(*vl));
-  if (vl == NULL)
+  e = vl_pool_alloc();
+  if (e == NULL)
     return NULL;
+  e->refcount = 1;
+  vl = &e->vl;
   memcpy(vl, vl_orig, sizeof(*vl));
+  vl->meta = NULL;
 
   if (vl->host[0] == 0)
     sstrncpy(vl->host, hostname_g, sizeof(vl->host));
 
-  vl->values = calloc(vl_orig->values_len, sizeof(*vl->values));
-  if (vl->values == NULL) {
-    plugin_value_list_free(vl);
-    return NULL;
+  if (vl_orig->values_len <= VL_POOL_VALUES_NUM) {
+    vl->values = e->values;
+  } else {
+    vl->values = calloc(vl_orig->values_len, sizeof(*vl->values));
+    if (vl->values == NULL) {
+      plugin_value_list_free(vl);
+      return NULL;
+    }
   }
   memcpy(vl->values, vl_orig->values,
          vl_orig->values_len * sizeof(*vl->values));
 
-  vl->meta = meta_data_clone(vl->meta);
+  vl->meta = meta_data_clone(vl_orig->meta);
   if ((vl_orig->meta != NULL) && (vl->meta == NULL)) {
     plugin_value_list_free(vl);
     return NULL;
@@ -734,88 +1380,249 @@ plugin_value_list_clone(value_list_t const *vl_orig) /* {{{ */
   return vl;
 } /* }}} value_list_t *plugin_value_list_clone */
 
-static int plugin_write_enqueue(value_list_t const *vl) /* {{{ */
+/* Moves the queued elements into a new buffer of `size' elements.
+ * `write_lock' must be held by the caller. */
+static int write_queue_resize(size_t size) /* {{{ */
 {
-  write_queue_t *q;
+  write_queue_t *tmp;
 
-  q = malloc(sizeof(*q));
-  if (q == NULL)
-    return ENOMEM;
-  q->next = NULL;
+  assert(size >= (size_t)write_queue_length);
 
-  q->vl = plugin_value_list_clone(vl);
-  if (q->vl == NULL) {
-    sfree(q);
+  tmp = calloc(size, sizeof(*tmp));
+  if (tmp == NULL)
     return ENOMEM;
+
+  for (long i = 0; i < write_queue_length; i++) {
+    size_t index = (write_queue_head + (size_t)i) & (write_queue_size - 1);
+    tmp[i] = write_queue[index];
   }
 
+  sfree(write_queue);
+  write_queue = tmp;
+  write_queue_size = size;
+  write_queue_head = 0;
+
+  return 0;
+} /* }}} int write_queue_resize */
+
+static int plugin_write_enqueue(value_list_t const *vl) /* {{{ */
+{
+  write_queue_t q;
+
+  q.vl = plugin_value_list_clone(vl);
+  if (q.vl == NULL)
+    return ENOMEM;
+
   /* Store context of caller (read plugin); otherwise, it would not be
    * available to the write plugins when actually dispatching the
    * value-list later on. */
-  q->ctx = plugin_get_ctx();
+  q.ctx = plugin_get_ctx();
 
   pthread_mutex_lock(&write_lock);
 
-  if (write_queue_tail == NULL) {
-    write_queue_head = q;
-    write_queue_tail = q;
-    write_queue_length = 1;
-  } else {
-    write_queue_tail->next = q;
-    write_queue_tail = q;
-    write_queue_length += 1;
+  if ((size_t)write_queue_length == write_queue_size) {
+    size_t size = (write_queue_size == 0) ? WRITE_QUEUE_SIZE_MIN
+                                          : 2 * write_queue_size;
+    int status = write_queue_resize(size);
+    if (status != 0) {
+      pthread_mutex_unlock(&write_lock);
+      plugin_value_list_free(q.vl);
+      return status;
+    }
   }
 
-  pthread_cond_signal(&write_cond);
+  size_t index =
+      (write_queue_head + (size_t)write_queue_length) & (write_queue_size - 1);
+  write_queue[index] = q;
+  write_queue_length += 1;
+
+  /* Only wake up a write thread if one is actually waiting. Busy threads
+   * will pick up this value when they are done with their current batch. */
+  if (write_threads_waiting > 0)
+    pthread_cond_signal(&write_cond);
   pthread_mutex_unlock(&write_lock);
 
   return 0;
 } /* }}} int plugin_write_enqueue */
 
-static value_list_t *plugin_write_dequeue(void) /* {{{ */
-{
-  write_queue_t *q;
-  value_list_t *vl;
+/* Removes up to `ret_max' elements from the write queue and stores them in
+ * `ret'. Blocks until at least one element is available or the write threads
+ * are being shut down. Returns the number of elements stored in `ret'. */
+static size_t plugin_write_dequeue(write_queue_t *ret, /* {{{ */
+                                   size_t ret_max) {
+  size_t num;
 
   pthread_mutex_lock(&write_lock);
 
-  while (write_loop && (write_queue_head == NULL))
+  while (write_loop && (write_queue_length == 0)) {
+    write_threads_waiting++;
     pthread_cond_wait(&write_cond, &write_lock);
+    write_threads_waiting--;
+  }
 
-  if (write_queue_head == NULL) {
+  if (write_queue_length == 0) {
     pthread_mutex_unlock(&write_lock);
-    return NULL;
+    return 0;
   }
 
-  q = write_queue_head;
-  write_queue_head = q->next;
-  write_queue_length -= 1;
-  if (write_queue_head == NULL) {
-    write_queue_tail = NULL;
-    assert(0 == write_queue_length);
+  /* Take no more than a fair share of the queue, so that the other write
+   * threads have something to do, too. `write_threads_num' is still zero
+   * while the first thread is being started. */
+  size_t threads_num = (write_threads_num > 0) ? write_threads_num : 1;
+  num = ((size_t)write_queue_length + threads_num - 1) / threads_num;
+  if (num > ret_max)
+    num = ret_max;
+
+  for (size_t i = 0; i < num; i++) {
+    ret[i] = write_queue[write_queue_head];
+    write_queue_head = (write_queue_head + 1) & (write_queue_size - 1);
   }
+  write_queue_length -= (long)num;
+
+  /* Release memory after a burst. Failing to shrink is not an error. */
+  if ((write_queue_size > WRITE_QUEUE_SIZE_MIN) &&
+      ((size_t)write_queue_length < (write_queue_size / 4)))
+    (void)write_queue_resize(write_queue_size / 2);
+
+  /* Pass the wakeup on if there is more work than this thread took. */
+  if ((write_queue_length > 0) && (write_threads_waiting > 0))
+    pthread_cond_signal(&write_cond);
 
   pthread_mutex_unlock(&write_lock);
 
-  (void)plugin_set_ctx(q->ctx);
+  return num;
+} /* }}} size_t plugin_write_dequeue */
 
-  vl = q->vl;
-  sfree(q);
-  return vl;
-} /* }}} value_list_t *plugin_write_dequeue */
+static write_batch_list_t *write_batch_list_get(void) /* {{{ */
+{
+  if (!write_batch_key_initialized)
+    return NULL;
+  return pthread_getspecific(write_batch_key);
+} /* }}} write_batch_list_t *write_batch_list_get */
+
+/* Appends `vl' to the batch of `cf'. The queued value list is referenced if
+ * nothing can modify it after the write anymore, see
+ * plugin_dispatch_values_internal(). Otherwise it is copied, because the filter
+ * chain may still change it after the write target returned. */
+static int write_batch_add(write_batch_list_t *bl, /* {{{ */
+                           callback_func_t *cf, const data_set_t *ds,
+                           const value_list_t *vl) {
+  write_batch_t *b = NULL;
+  write_batch_t *unused = NULL;
+
+  for (size_t i = 0; i < bl->batches_num; i++) {
+    if (bl->batches[i].cf == cf) {
+      b = bl->batches + i;
+      break;
+    }
+    if ((unused == NULL) && (bl->batches[i].cf == NULL))
+      unused = bl->batches + i;
+  }
 
-static void *plugin_write_thread(void __attribute__((unused)) * args) /* {{{ */
+  if ((b == NULL) && (unused == NULL)) {
+    write_batch_t *tmp =
+        realloc(bl->batches, (bl->batches_num + 1) * sizeof(*bl->batches));
+    if (tmp == NULL)
+      return ENOMEM;
+    bl->batches = tmp;
+
+    unused = bl->batches + bl->batches_num;
+    *unused = (write_batch_t){0};
+    bl->batches_num++;
+  }
+
+  if (b == NULL) {
+    b = unused;
+    b->cf = cf;
+    ATOMIC_ADD_FETCH(&cf->cf_refcount, 1);
+  }
+
+  if (b->entries_num >= b->entries_size) {
+    size_t size = (b->entries_size == 0) ? WRITE_QUEUE_BATCH_MAX
+                                         : 2 * b->entries_size;
+    write_batch_entry_t *tmp = realloc(b->entries, size * sizeof(*tmp));
+    if (tmp == NULL)
+      return ENOMEM;
+    b->entries = tmp;
+    b->entries_size = size;
+  }
+
+  value_list_t *ref;
+  if (bl->current_shareable && (vl == bl->current)) {
+    ref = bl->current;
+    ((vl_pool_entry_t *)ref)->refcount++;
+  } else {
+    ref = plugin_value_list_clone(vl);
+    if (ref == NULL)
+      return ENOMEM;
+  }
+
+  b->entries[b->entries_num] = (write_batch_entry_t){.ds = ds, .vl = ref};
+  b->entries_num++;
+
+  return 0;
+} /* }}} int write_batch_add */
+
+/* Hands all collected values to the batch write callbacks and releases the
+ * callbacks. Values of callbacks unregistered in the meantime are dropped. */
+static void write_batch_flush(write_batch_list_t *bl) /* {{{ */
 {
-  while (write_loop) {
-    value_list_t *vl = plugin_write_dequeue();
-    if (vl == NULL)
+  for (size_t i = 0; i < bl->batches_num; i++) {
+    write_batch_t *b = bl->batches + i;
+    if (b->cf == NULL)
       continue;
 
-    plugin_dispatch_values_internal(vl);
+    if (ATOMIC_LOAD(&b->cf->cf_unregistered)) {
+      DEBUG("plugin: Dropping %" PRIsz " values of the unregistered write "
+            "callback of \"%s\".",
+            b->entries_num, b->cf->cf_ctx.name);
+    } else if (b->entries_num > 0) {
+      plugin_write_batch_cb callback = b->cf->cf_callback;
+      plugin_ctx_t old_ctx = plugin_set_ctx(b->cf->cf_ctx);
+      int status = (*callback)(b->entries, b->entries_num, &b->cf->cf_udata);
+      plugin_set_ctx(old_ctx);
 
-    plugin_value_list_free(vl);
+      if (status != 0)
+        ERROR("plugin: Writing %" PRIsz " values via \"%s\" failed with "
+              "status %i.",
+              b->entries_num, b->cf->cf_ctx.name, status);
+    }
+
+    for (size_t j = 0; j < b->entries_num; j++)
+      plugin_value_list_free((value_list_t *)b->entries[j].vl);
+    b->entries_num = 0;
+
+    callback_unref(b->cf);
+    b->cf = NULL;
+  }
+} /* }}} void write_batch_flush */
+
+static void *plugin_write_thread(void __attribute__((unused)) * args) /* {{{ */
+{
+  write_queue_t batch[WRITE_QUEUE_BATCH_MAX];
+  write_batch_list_t bl = {0};
+
+  pthread_setspecific(write_batch_key, &bl);
+
+  while (write_loop) {
+    size_t num = plugin_write_dequeue(batch, STATIC_ARRAY_SIZE(batch));
+
+    for (size_t i = 0; i < num; i++) {
+      (void)plugin_set_ctx(batch[i].ctx);
+      bl.current = batch[i].vl;
+      plugin_dispatch_values_internal(batch[i].vl);
+      bl.current = NULL;
+      plugin_value_list_free(batch[i].vl);
+    }
+
+    write_batch_flush(&bl);
   }
 
+  pthread_setspecific(write_batch_key, NULL);
+  for (size_t i = 0; i < bl.batches_num; i++)
+    sfree(bl.batches[i].entries);
+  sfree(bl.batches);
+
   pthread_exit(NULL);
   return (void *)0;
 } /* }}} void *plugin_write_thread */
@@ -825,6 +1632,17 @@ static void start_write_threads(size_t num) /* {{{ */
   if (write_threads != NULL)
     return;
 
+  if (!write_batch_key_initialized) {
+    int status = pthread_key_create(&write_batch_key, /* destructor = */ NULL);
+    if (status != 0) {
+      ERROR("plugin: start_write_threads: pthread_key_create failed with "
+            "status %i (%s).",
+            status, STRERROR(status));
+      return;
+    }
+    write_batch_key_initialized = true;
+  }
+
   write_threads = calloc(num, sizeof(*write_threads));
   if (write_threads == NULL) {
     ERROR("plugin: start_write_threads: calloc failed.");
@@ -848,13 +1666,15 @@ static void start_write_threads(size_t num) /* {{{ */
               (uint64_t)write_threads_num);
     set_thread_name(write_threads[write_threads_num], name);
 
+    /* Read by plugin_write_dequeue() to compute the fair share. */
+    pthread_mutex_lock(&write_lock);
     write_threads_num++;
+    pthread_mutex_unlock(&write_lock);
   } /* for (i) */
 } /* }}} void start_write_threads */
 
 static void stop_write_threads(void) /* {{{ */
 {
-  write_queue_t *q;
   size_t i;
 
   if (write_threads == NULL)
@@ -875,19 +1695,16 @@ static void stop_write_threads(void) /* {{{ */
     write_threads[i] = (pthread_t)0;
   }
   sfree(write_threads);
-  write_threads_num = 0;
 
   pthread_mutex_lock(&write_lock);
-  i = 0;
-  for (q = write_queue_head; q != NULL;) {
-    write_queue_t *q1 = q;
-    plugin_value_list_free(q->vl);
-    q = q->next;
-    sfree(q1);
-    i++;
-  }
-  write_queue_head = NULL;
-  write_queue_tail = NULL;
+  write_threads_num = 0;
+  for (i = 0; i < (size_t)write_queue_length; i++) {
+    size_t index = (write_queue_head + i) & (write_queue_size - 1);
+    plugin_value_list_free(write_queue[index].vl);
+  }
+  sfree(write_queue);
+  write_queue_size = 0;
+  write_queue_head = 0;
   write_queue_length = 0;
   pthread_mutex_unlock(&write_lock);
 
@@ -1085,7 +1902,7 @@ static int plugin_compare_read_func(const void *arg0, const void *arg1) {
     return 0;
 } /* int plugin_compare_read_func */
 
-/* Add a read function to both, the heap and a linked list. The linked list if
+/* Add a read function to both, a heap and a linked list. The linked list if
  * used to look-up read functions, especially for the remove function. The heap
  * is used to determine which plugin to read next. */
 static int plugin_insert_read(read_func_t *rf) {
@@ -1095,6 +1912,15 @@ static int plugin_insert_read(read_func_t *rf) {
   rf->rf_next_read = cdtime();
   rf->rf_effective_interval = rf->rf_interval;
 
+  pthread_mutex_init(&rf->rf_stats_lock, /* attr = */ NULL);
+  rf->rf_exec_latency =
+      latency_counter_create_type(LATENCY_HISTOGRAM_LOG_LINEAR);
+  rf->rf_lag_latency = latency_counter_create_type(LATENCY_HISTOGRAM_LOG_LINEAR);
+  if ((rf->rf_exec_latency == NULL) || (rf->rf_lag_latency == NULL)) {
+    ERROR("plugin_insert_read: latency_counter_create_type failed.");
+    return ENOMEM;
+  }
+
   pthread_mutex_lock(&read_lock);
 
   if (read_list == NULL) {
@@ -1131,7 +1957,12 @@ static int plugin_insert_read(read_func_t *rf) {
     return -1;
   }
 
-  status = c_heap_insert(read_heap, rf);
+  /* Once the read threads are running, the function goes to the thread with
+   * the fewest read functions. */
+  if (read_schedulers_num > 0)
+    status = read_scheduler_insert(read_scheduler_least_loaded(), rf);
+  else
+    status = c_heap_insert(read_heap, rf);
   if (status != 0) {
     pthread_mutex_unlock(&read_lock);
     ERROR("plugin_insert_read: c_heap_insert failed.");
@@ -1142,8 +1973,6 @@ static int plugin_insert_read(read_func_t *rf) {
   /* This does not fail. */
   llist_append(read_list, le);
 
-  /* Wake up all the read threads. */
-  pthread_cond_broadcast(&read_cond);
   pthread_mutex_unlock(&read_lock);
   return 0;
 } /* int plugin_insert_read */
@@ -1169,10 +1998,8 @@ EXPORT int plugin_register_read(const char *name, int (*callback)(void)) {
   rf->rf_ctx.interval = rf->rf_interval;
 
   status = plugin_insert_read(rf);
-  if (status != 0) {
-    sfree(rf->rf_name);
-    sfree(rf);
-  }
+  if (status != 0)
+    destroy_read_func(rf);
 
   return status;
 } /* int plugin_register_read */
@@ -1212,11 +2039,8 @@ EXPORT int plugin_register_complex_read(const char *group, const char *name,
   rf->rf_ctx.interval = rf->rf_interval;
 
   status = plugin_insert_read(rf);
-  if (status != 0) {
-    free_userdata(&rf->rf_udata);
-    sfree(rf->rf_name);
-    sfree(rf);
-  }
+  if (status != 0)
+    destroy_read_func(rf);
 
   return status;
 } /* int plugin_register_complex_read */
@@ -1226,6 +2050,29 @@ EXPORT int plugin_register_write(const char *name, plugin_write_cb callback,
   return create_register_callback(&list_write, name, (void *)callback, ud);
 } /* int plugin_register_write */
 
+EXPORT int plugin_register_write_batch(const char *name,
+                                       plugin_write_batch_cb callback,
+                                       user_data_t const *ud) {
+  if (name == NULL || callback == NULL)
+    return EINVAL;
+
+  callback_func_t *cf = calloc(1, sizeof(*cf));
+  if (cf == NULL) {
+    free_userdata(ud);
+    ERROR("plugin_register_write_batch: calloc failed.");
+    return ENOMEM;
+  }
+
+  cf->cf_callback = (void *)callback;
+  if (ud != NULL)
+    cf->cf_udata = *ud;
+  cf->cf_ctx = plugin_get_ctx();
+  cf->cf_write_batch = true;
+  cf->cf_refcount = 1;
+
+  return register_callback(&list_write, name, cf);
+} /* int plugin_register_write_batch */
+
 static int plugin_flush_timeout_callback(user_data_t *ud) {
   flush_callback_t *cb = ud->data;
 
@@ -1639,6 +2486,7 @@ EXPORT int plugin_init_all(void) {
 
   if (IS_TRUE(global_option_get("CollectInternalStats"))) {
     record_statistics = true;
+    fc_enable_statistics();
     plugin_register_read("collectd", plugin_update_internal_statistics);
   }
 
@@ -1772,13 +2620,40 @@ EXPORT int plugin_read_all_once(void) {
       return_status = -1;
     }
 
-    sfree(rf->rf_name);
-    destroy_callback((void *)rf);
+    destroy_read_func(rf);
   }
 
   return return_status;
 } /* int plugin_read_all_once */
 
+EXPORT int plugin_get_read_stats(plugin_read_stats_t **ret_stats, /* {{{ */
+                                 size_t *ret_stats_num) {
+  if ((ret_stats == NULL) || (ret_stats_num == NULL))
+    return EINVAL;
+
+  return read_stats_snapshot(ret_stats, ret_stats_num, /* reset = */ false);
+} /* }}} int plugin_get_read_stats */
+
+/* Calls a single write callback. Batch callbacks receive the value at the end
+ * of the write thread's current batch, or right away if called from any other
+ * thread. */
+static int plugin_write_callback(callback_func_t *cf, /* {{{ */
+                                 const data_set_t *ds,
+                                 const value_list_t *vl) {
+  if (!cf->cf_write_batch) {
+    plugin_write_cb callback = cf->cf_callback;
+    return (*callback)(ds, vl, &cf->cf_udata);
+  }
+
+  write_batch_list_t *bl = write_batch_list_get();
+  if (bl != NULL)
+    return write_batch_add(bl, cf, ds, vl);
+
+  plugin_write_batch_cb callback = cf->cf_callback;
+  write_batch_entry_t entry = {.ds = ds, .vl = vl};
+  return (*callback)(&entry, 1, &cf->cf_udata);
+} /* }}} int plugin_write_callback */
+
 EXPORT int plugin_write(const char *plugin, /* {{{ */
                         const data_set_t *ds, const value_list_t *vl) {
   llentry_t *le;
@@ -1805,7 +2680,6 @@ EXPORT int plugin_write(const char *plugin, /* {{{ */
     le = llist_head(list_write);
     while (le != NULL) {
       callback_func_t *cf = le->value;
-      plugin_write_cb callback;
 
       /* Keep the read plugin's interval and flush information but update the
        * plugin name. */
@@ -1815,8 +2689,7 @@ EXPORT int plugin_write(const char *plugin, /* {{{ */
       plugin_set_ctx(ctx);
 
       DEBUG("plugin: plugin_write: Writing values via %s.", le->key);
-      callback = cf->cf_callback;
-      status = (*callback)(ds, vl, &cf->cf_udata);
+      status = plugin_write_callback(cf, ds, vl);
       if (status != 0)
         failure++;
       else
@@ -1833,7 +2706,6 @@ EXPORT int plugin_write(const char *plugin, /* {{{ */
   } else /* plugin != NULL */
   {
     callback_func_t *cf;
-    plugin_write_cb callback;
 
     le = llist_head(list_write);
     while (le != NULL) {
@@ -1852,8 +2724,7 @@ EXPORT int plugin_write(const char *plugin, /* {{{ */
      * information of the calling read plugin */
 
     DEBUG("plugin: plugin_write: Writing values via %s.", le->key);
-    callback = cf->cf_callback;
-    status = (*callback)(ds, vl, &cf->cf_udata);
+    status = plugin_write_callback(cf, ds, vl);
   }
 
   return status;
@@ -2169,9 +3040,22 @@ static int plugin_dispatch_values_internal(value_list_t *vl) {
               "status %i (%#x).",
               status, status);
     }
-  } else
+  } else {
+    /* Nothing changes the queued value list after the default action, so
+     * batch write callbacks may reference it. It keeps its meta data then,
+     * which is freed with the last reference. */
+    write_batch_list_t *bl = write_batch_list_get();
+    if ((bl != NULL) && (bl->current == vl)) {
+      bl->current_shareable = true;
+      free_meta_data = false;
+    }
+
     fc_default_action(ds, vl);
 
+    if (bl != NULL)
+      bl->current_shareable = false;
+  }
+
   if ((free_meta_data == true) && (vl->meta != NULL)) {
     meta_data_destroy(vl->meta);
     vl->meta = NULL;
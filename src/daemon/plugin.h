@@ -180,6 +180,12 @@ typedef struct cache_event_s {
   int ret;
 } cache_event_t;
 
+/* Element of the array passed to batch write callbacks. */
+typedef struct write_batch_entry_s {
+  const data_set_t *ds;
+  const value_list_t *vl;
+} write_batch_entry_t;
+
 struct plugin_ctx_s {
   char *name;
   cdtime_t interval;
@@ -188,6 +194,20 @@ struct plugin_ctx_s {
 };
 typedef struct plugin_ctx_s plugin_ctx_t;
 
+/* Execution time and scheduling lag of one read callback, as returned by
+ * plugin_get_read_stats(). */
+struct plugin_read_stats_s {
+  char name[DATA_MAX_NAME_LEN];
+  size_t calls;
+  cdtime_t exec_average;
+  cdtime_t exec_percentile;
+  cdtime_t exec_max;
+  cdtime_t lag_average;
+  cdtime_t lag_percentile;
+  cdtime_t lag_max;
+};
+typedef struct plugin_read_stats_s plugin_read_stats_t;
+
 /*
  * Callback types
  */
@@ -195,6 +215,8 @@ typedef int (*plugin_init_cb)(void);
 typedef int (*plugin_read_cb)(user_data_t *);
 typedef int (*plugin_write_cb)(const data_set_t *, const value_list_t *,
                                user_data_t *);
+typedef int (*plugin_write_batch_cb)(const write_batch_entry_t *entries,
+                                     size_t entries_num, user_data_t *);
 typedef int (*plugin_flush_cb)(cdtime_t timeout, const char *identifier,
                                user_data_t *);
 /* "missing" callback. Returns less than zero on failure, zero if other
@@ -254,6 +276,26 @@ void plugin_read_all(void);
 int plugin_read_all_once(void);
 int plugin_shutdown_all(void);
 
+/*
+ * NAME
+ *  plugin_get_read_stats
+ *
+ * DESCRIPTION
+ *  Returns the execution time and the scheduling lag, i.e. the time between
+ *  the due time and the actual start, of all registered read callbacks. The
+ *  entries are sorted by descending average execution time. Percentiles are
+ *  the PLUGIN_READ_STATS_PERCENTILE'th percentile. The values cover the time
+ *  since internal statistics were last dispatched (see
+ *  "CollectInternalStats") or since the daemon was started.
+ *
+ * RETURN VALUE
+ *  Zero on success, an errno value otherwise. The caller must free
+ *  "ret_stats".
+ */
+#define PLUGIN_READ_STATS_PERCENTILE 99.0
+int plugin_get_read_stats(plugin_read_stats_t **ret_stats,
+                          size_t *ret_stats_num);
+
 /*
  * NAME
  *  plugin_write
@@ -305,6 +347,32 @@ int plugin_register_complex_read(const char *group, const char *name,
                                  user_data_t const *user_data);
 int plugin_register_write(const char *name, plugin_write_cb callback,
                           user_data_t const *user_data);
+/*
+ * NAME
+ *  plugin_register_write_batch
+ *
+ * DESCRIPTION
+ *  Registers a write callback that receives many value lists at once. Values
+ *  processed by a write thread are collected and handed to the callback after
+ *  the thread has finished its current batch of the write queue, so the
+ *  callback can take locks, prepare buffers and issue syscalls once per batch
+ *  rather than once per value. Values written from other threads are passed
+ *  on immediately, in a batch of one.
+ *
+ *  The callback runs in the context of the registering plugin, not in that of
+ *  the read plugins which dispatched the values; use the `interval' member of
+ *  the value lists rather than plugin_get_interval(). The entries are only
+ *  valid for the duration of the call.
+ *
+ *  Writing is deferred for values handled by a write thread:
+ *  `plugin_write' returns zero once such a value has been added to the
+ *  batch, and a non-zero status returned by the callback is logged when the
+ *  batch is handed over. Values which are pending when the callback is
+ *  unregistered with `plugin_unregister_write' are dropped.
+ */
+int plugin_register_write_batch(const char *name,
+                                plugin_write_batch_cb callback,
+                                user_data_t const *user_data);
 int plugin_register_flush(const char *name, plugin_flush_cb callback,
                           user_data_t const *user_data);
 int plugin_register_missing(const char *name, plugin_missing_cb callback,
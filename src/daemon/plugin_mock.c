@@ -35,6 +35,7 @@ kstat_ctl_t *kc = NULL;
 #endif /* HAVE_LIBKSTAT */
 
 char *hostname_g = "example.com";
+int timeout_g = 2;
 
 void plugin_set_dir(const char *dir) { /* nop */
 }
@@ -69,6 +70,13 @@ int plugin_register_write(__attribute__((unused)) const char *name,
   return ENOTSUP;
 }
 
+int plugin_register_write_batch(__attribute__((unused)) const char *name,
+                                __attribute__((unused))
+                                plugin_write_batch_cb callback,
+                                __attribute__((unused)) user_data_t const *ud) {
+  return ENOTSUP;
+}
+
 int plugin_register_flush(__attribute__((unused)) const char *name,
                           __attribute__((unused)) plugin_flush_cb callback,
                           __attribute__((unused))
@@ -121,6 +129,19 @@ DECLARE_UNREGISTER(notification)
 
 int plugin_dispatch_values(value_list_t const *vl) { return ENOTSUP; }
 
+int plugin_dispatch_missing(__attribute__((unused)) value_list_t const *vl) {
+  return ENOTSUP;
+}
+
+void plugin_dispatch_cache_event(__attribute__((unused))
+                                 enum cache_event_type_e event_type,
+                                 __attribute__((unused))
+                                 unsigned long callbacks_mask,
+                                 __attribute__((unused)) const char *name,
+                                 __attribute__((unused))
+                                 value_list_t const *vl) { /* nop */
+}
+
 int plugin_dispatch_notification(__attribute__((unused))
                                  const notification_t *notif) {
   return ENOTSUP;
@@ -180,10 +201,19 @@ int plugin_notification_meta_free(__attribute__((unused))
   return ENOTSUP;
 }
 
+int plugin_write(__attribute__((unused)) const char *plugin,
+                 __attribute__((unused)) const data_set_t *ds,
+                 __attribute__((unused)) const value_list_t *vl) {
+  return ENOTSUP;
+}
+
 int plugin_flush(const char *plugin, cdtime_t timeout, const char *identifier) {
   return ENOTSUP;
 }
 
+void plugin_log_available_writers(void) { /* nop */
+}
+
 static data_source_t magic_ds[] = {{"value", DS_TYPE_DERIVE, 0.0, NAN}};
 static data_set_t magic = {"MAGIC", 1, magic_ds};
 const data_set_t *plugin_get_ds(const char *name) {
@@ -232,15 +262,15 @@ plugin_ctx_t plugin_set_ctx(plugin_ctx_t ctx) {
 
 cdtime_t plugin_get_interval(void) { return mock_context.interval; }
 
+int plugin_get_read_stats(__attribute__((unused))
+                          plugin_read_stats_t **ret_stats,
+                          __attribute__((unused)) size_t *ret_stats_num) {
+  return ENOTSUP;
+}
+
 int plugin_thread_create(__attribute__((unused)) pthread_t *thread,
                          __attribute__((unused)) void *(*start_routine)(void *),
                          __attribute__((unused)) void *arg,
                          __attribute__((unused)) char const *name) {
   return ENOTSUP;
 }
-
-/* TODO(octo): this function is actually from filter_chain.h, but in order not
- * to tumble down that rabbit hole, we're declaring it here. A better solution
- * would be to hard-code the top-level config keys in daemon/collectd.c to avoid
- * having these references in daemon/configfile.c. */
-int fc_configure(const oconfig_item_t *ci) { return ENOTSUP; }
@@ -0,0 +1,187 @@
+/**
+ * collectd - src/daemon/plugin_test.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "plugin.c" /* (sic) */
+
+#include "testing.h"
+
+static data_source_t dsrc_test = {"value", DS_TYPE_GAUGE, 0.0, NAN};
+static data_set_t const ds_test = {"test", 1, &dsrc_test};
+
+static pthread_mutex_t test_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t test_cond = PTHREAD_COND_INITIALIZER;
+static size_t test_calls;
+static size_t test_values;
+static size_t test_max_entries;
+static gauge_t test_sum;
+static int test_frees;
+
+static int test_write_batch(const write_batch_entry_t *entries,
+                            size_t entries_num,
+                            __attribute__((unused)) user_data_t *ud) {
+  pthread_mutex_lock(&test_lock);
+  test_calls++;
+  test_values += entries_num;
+  if (test_max_entries < entries_num)
+    test_max_entries = entries_num;
+  for (size_t i = 0; i < entries_num; i++)
+    test_sum += entries[i].vl->values[0].gauge;
+  pthread_cond_broadcast(&test_cond);
+  pthread_mutex_unlock(&test_lock);
+  return 0;
+}
+
+static void test_free(__attribute__((unused)) void *data) { test_frees++; }
+
+static void test_reset(void) {
+  pthread_mutex_lock(&test_lock);
+  test_calls = test_values = test_max_entries = 0;
+  test_sum = 0.0;
+  test_frees = 0;
+  pthread_mutex_unlock(&test_lock);
+}
+
+static void test_vl(value_list_t *vl, value_t *value, int index) {
+  *vl = (value_list_t)VALUE_LIST_INIT;
+  vl->values = value;
+  vl->values_len = 1;
+  vl->time = TIME_T_TO_CDTIME_T(100);
+  vl->interval = TIME_T_TO_CDTIME_T(10);
+  sstrncpy(vl->host, "example.com", sizeof(vl->host));
+  sstrncpy(vl->plugin, "test", sizeof(vl->plugin));
+  sstrncpy(vl->type, "test", sizeof(vl->type));
+  ssnprintf(vl->type_instance, sizeof(vl->type_instance), "%04d", index);
+}
+
+static int test_register(void) {
+  return plugin_register_write_batch(
+      "test", test_write_batch,
+      &(user_data_t){.data = &test_frees, .free_func = test_free});
+}
+
+DEF_TEST(batch) {
+  test_reset();
+  CHECK_ZERO(test_register());
+
+  /* Fill the queue before the write thread runs, so that it takes all values
+   * at once and hands them over in a single batch. */
+  for (int i = 0; i < 10; i++) {
+    value_t value = {.gauge = (gauge_t)i};
+    value_list_t vl;
+    test_vl(&vl, &value, i);
+    CHECK_ZERO(plugin_dispatch_values(&vl));
+  }
+
+  start_write_threads(1);
+
+  pthread_mutex_lock(&test_lock);
+  while (test_values < 10)
+    pthread_cond_wait(&test_cond, &test_lock);
+  pthread_mutex_unlock(&test_lock);
+
+  stop_write_threads();
+
+  EXPECT_EQ_INT(1, (int)test_calls);
+  EXPECT_EQ_INT(10, (int)test_max_entries);
+  EXPECT_EQ_DOUBLE(45.0, test_sum);
+
+  CHECK_ZERO(plugin_unregister_write("test"));
+  EXPECT_EQ_INT(1, test_frees);
+  return 0;
+}
+
+DEF_TEST(synchronous) {
+  value_t value = {.gauge = 42.0};
+  value_list_t vl;
+
+  test_reset();
+  CHECK_ZERO(test_register());
+
+  /* Outside of the write threads, values are written right away. */
+  test_vl(&vl, &value, 0);
+  CHECK_ZERO(plugin_write(NULL, &ds_test, &vl));
+  EXPECT_EQ_INT(1, (int)test_calls);
+  EXPECT_EQ_INT(1, (int)test_max_entries);
+  EXPECT_EQ_DOUBLE(42.0, test_sum);
+
+  CHECK_ZERO(plugin_unregister_write("test"));
+  EXPECT_EQ_INT(1, test_frees);
+  return 0;
+}
+
+DEF_TEST(flush) {
+  write_batch_list_t bl = {0};
+
+  /* Act as a write thread; the key was created by the batch test. */
+  test_reset();
+  CHECK_ZERO(test_register());
+  CHECK_ZERO(pthread_setspecific(write_batch_key, &bl));
+
+  /* Values are collected until the batch is flushed. */
+  for (int i = 0; i < 3; i++) {
+    value_t value = {.gauge = 1.0};
+    value_list_t vl;
+    test_vl(&vl, &value, i);
+    CHECK_ZERO(plugin_write(NULL, &ds_test, &vl));
+  }
+  EXPECT_EQ_INT(0, (int)test_calls);
+
+  write_batch_flush(&bl);
+  EXPECT_EQ_INT(1, (int)test_calls);
+  EXPECT_EQ_INT(3, (int)test_values);
+  EXPECT_EQ_DOUBLE(3.0, test_sum);
+
+  /* Unregistering drops pending values, but the callback stays valid until
+   * the batch is flushed. */
+  for (int i = 0; i < 3; i++) {
+    value_t value = {.gauge = 1.0};
+    value_list_t vl;
+    test_vl(&vl, &value, i);
+    CHECK_ZERO(plugin_write(NULL, &ds_test, &vl));
+  }
+  CHECK_ZERO(plugin_unregister_write("test"));
+  EXPECT_EQ_INT(0, test_frees);
+
+  write_batch_flush(&bl);
+  EXPECT_EQ_INT(1, (int)test_calls);
+  EXPECT_EQ_INT(1, test_frees);
+
+  CHECK_ZERO(pthread_setspecific(write_batch_key, NULL));
+  for (size_t i = 0; i < bl.batches_num; i++)
+    sfree(bl.batches[i].entries);
+  sfree(bl.batches);
+  return 0;
+}
+
+int main(void) {
+  plugin_init_ctx();
+  hostname_g = strdup("example.com");
+  CHECK_ZERO(plugin_register_data_set(&ds_test));
+  CHECK_ZERO(uc_init());
+
+  RUN_TEST(batch);
+  RUN_TEST(synchronous);
+  RUN_TEST(flush);
+
+  END_TEST;
+}
@@ -0,0 +1,74 @@
+/**
+ * collectd - src/daemon/utils_atomic.h
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_ATOMIC_H
+#define UTILS_ATOMIC_H 1
+
+#include "collectd.h"
+
+/*
+ * Atomic operations on integers (and bools) of up to 64 bits. Loads have
+ * acquire, stores release and read-modify-write operations acquire-release
+ * semantics. The *_FETCH macros return the new value.
+ *
+ * If the compiler doesn't provide the __atomic builtins (see configure), the
+ * operations are serialized by a mutex. That mutex is private to the
+ * including file, so every object must only be accessed from one file.
+ */
+#if HAVE_ATOMIC_BUILTINS
+
+#define ATOMIC_LOAD(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define ATOMIC_STORE(ptr, v) __atomic_store_n((ptr), (v), __ATOMIC_RELEASE)
+#define ATOMIC_ADD_FETCH(ptr, n)                                               \
+  __atomic_add_fetch((ptr), (n), __ATOMIC_ACQ_REL)
+#define ATOMIC_SUB_FETCH(ptr, n)                                               \
+  __atomic_sub_fetch((ptr), (n), __ATOMIC_ACQ_REL)
+
+#else /* !HAVE_ATOMIC_BUILTINS */
+
+#include <pthread.h>
+
+static pthread_mutex_t atomic_fallback_lock __attribute__((unused)) =
+    PTHREAD_MUTEX_INITIALIZER;
+
+static inline uint64_t atomic_fallback_unlock(uint64_t v) {
+  pthread_mutex_unlock(&atomic_fallback_lock);
+  return v;
+}
+
+#define ATOMIC_LOAD(ptr)                                                       \
+  (pthread_mutex_lock(&atomic_fallback_lock),                                  \
+   atomic_fallback_unlock((uint64_t)*(ptr)))
+#define ATOMIC_STORE(ptr, v)                                                   \
+  ((void)(pthread_mutex_lock(&atomic_fallback_lock), *(ptr) = (v),             \
+          atomic_fallback_unlock(0)))
+#define ATOMIC_ADD_FETCH(ptr, n)                                               \
+  (pthread_mutex_lock(&atomic_fallback_lock),                                  \
+   atomic_fallback_unlock((uint64_t)(*(ptr) += (n))))
+#define ATOMIC_SUB_FETCH(ptr, n)                                               \
+  (pthread_mutex_lock(&atomic_fallback_lock),                                  \
+   atomic_fallback_unlock((uint64_t)(*(ptr) -= (n))))
+
+#endif /* !HAVE_ATOMIC_BUILTINS */
+
+#endif /* !UTILS_ATOMIC_H */
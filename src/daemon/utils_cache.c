@@ -29,7 +29,6 @@
 #include "collectd.h"
 
 #include "plugin.h"
-#include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
 #include "utils/metadata/meta_data.h"
 #include "utils_cache.h"
@@ -38,6 +37,8 @@
 
 typedef struct cache_entry_s {
   char name[6 * DATA_MAX_NAME_LEN];
+  /* cache_hash(name), so lookups and resizes don't need to hash again. */
+  uint32_t hash;
   size_t values_num;
   gauge_t *values_gauge;
   value_t *values_raw;
@@ -70,22 +71,180 @@ typedef struct cache_entry_s {
   unsigned long callbacks_mask;
 } cache_entry_t;
 
+/* The cache is split into UC_SHARDS_NUM partitions, each with its own lock
+ * and index. An identifier always lives in the shard selected by the upper
+ * bits of the hash of its name, so threads updating different values rarely
+ * contend with each other. */
+#define UC_SHARDS_BITS 6
+#define UC_SHARDS_NUM (1 << UC_SHARDS_BITS)
+
+/* Initial number of slots per shard. Must be a power of two. */
+#define UC_SLOTS_MIN 64
+
+typedef struct cache_slot_s {
+  uint32_t hash;
+  cache_entry_t *entry; /* NULL if the slot is unused. */
+} cache_slot_t;
+
+/* Each shard is an open addressing hash table using linear probing. The lower
+ * bits of the hash select the slot. The table is grown when it becomes more
+ * than 3/4 full, so a free slot always terminates a probe sequence. */
+typedef struct cache_shard_s {
+  cache_slot_t *slots;
+  size_t slots_num;
+  size_t entries_num;
+  pthread_mutex_t lock;
+} cache_shard_t;
+
+/* Copy of a cache entry, see uc_iterator_next(). */
+typedef struct {
+  char *name;
+  cdtime_t last_time;
+  cdtime_t interval;
+  value_t *values_raw;
+  size_t values_num;
+  meta_data_t *meta;
+} uc_iter_entry_t;
+
+/* The iterator copies the entries of one shard at a time, so that it never
+ * holds a lock while the caller processes the entries. */
 struct uc_iter_s {
-  c_avl_iterator_t *iter;
+  /* The next shard to copy. */
+  size_t shard_index;
+  uc_iter_entry_t *entries;
+  size_t entries_num;
+  size_t entries_pos;
 
   char *name;
-  cache_entry_t *entry;
+  uc_iter_entry_t *entry;
 };
 
-static c_avl_tree_t *cache_tree;
-static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static cache_shard_t cache_shards[UC_SHARDS_NUM];
+
+/* FNV-1a */
+static uint32_t cache_hash(const char *name) {
+  uint32_t hash = 2166136261U;
+  for (const unsigned char *ptr = (const unsigned char *)name; *ptr != 0;
+       ptr++) {
+    hash ^= *ptr;
+    hash *= 16777619U;
+  }
+  return hash;
+} /* uint32_t cache_hash */
+
+static cache_shard_t *cache_get_shard(uint32_t hash) {
+  return &cache_shards[hash >> (32 - UC_SHARDS_BITS)];
+} /* cache_shard_t *cache_get_shard */
+
+/* `shard->lock' must be held by the caller. */
+static cache_entry_t *cache_lookup(cache_shard_t *shard, uint32_t hash,
+                                   const char *name) {
+  size_t mask = shard->slots_num - 1;
+
+  for (size_t i = hash & mask; shard->slots[i].entry != NULL;
+       i = (i + 1) & mask) {
+    cache_slot_t *slot = &shard->slots[i];
+    if ((slot->hash == hash) && (strcmp(slot->entry->name, name) == 0))
+      return slot->entry;
+  }
+
+  return NULL;
+} /* cache_entry_t *cache_lookup */
+
+static void cache_place(cache_slot_t *slots, size_t slots_num,
+                        cache_entry_t *ce) {
+  size_t mask = slots_num - 1;
+  size_t i = ce->hash & mask;
+
+  while (slots[i].entry != NULL)
+    i = (i + 1) & mask;
+
+  slots[i].hash = ce->hash;
+  slots[i].entry = ce;
+} /* void cache_place */
+
+static int cache_resize(cache_shard_t *shard, size_t slots_num) {
+  cache_slot_t *slots = calloc(slots_num, sizeof(*slots));
+  if (slots == NULL) {
+    ERROR("utils_cache: cache_resize: calloc failed.");
+    return ENOMEM;
+  }
+
+  for (size_t i = 0; i < shard->slots_num; i++) {
+    if (shard->slots[i].entry != NULL)
+      cache_place(slots, slots_num, shard->slots[i].entry);
+  }
+
+  sfree(shard->slots);
+  shard->slots = slots;
+  shard->slots_num = slots_num;
+
+  return 0;
+} /* int cache_resize */
+
+/* `shard->lock' must be held by the caller. The entry must not exist yet. */
+static int cache_insert(cache_shard_t *shard, cache_entry_t *ce) {
+  if (4 * (shard->entries_num + 1) > 3 * shard->slots_num) {
+    int status = cache_resize(shard, 2 * shard->slots_num);
+    if (status != 0)
+      return status;
+  }
+
+  cache_place(shard->slots, shard->slots_num, ce);
+  shard->entries_num++;
+
+  return 0;
+} /* int cache_insert */
+
+/* `shard->lock' must be held by the caller. Removes the entry from the index
+ * and returns it, or returns NULL if no such entry exists. */
+static cache_entry_t *cache_remove(cache_shard_t *shard, uint32_t hash,
+                                   const char *name) {
+  size_t mask = shard->slots_num - 1;
+  size_t i = hash & mask;
+
+  while (true) {
+    if (shard->slots[i].entry == NULL)
+      return NULL;
+    if ((shard->slots[i].hash == hash) &&
+        (strcmp(shard->slots[i].entry->name, name) == 0))
+      break;
+    i = (i + 1) & mask;
+  }
+
+  cache_entry_t *ce = shard->slots[i].entry;
+  shard->slots[i].entry = NULL;
+  shard->entries_num--;
+
+  /* Backward shift deletion: move following entries of the probe sequence
+   * into the freed slot if that is closer to their home slot. This keeps
+   * lookups correct without the need for tombstones. */
+  size_t hole = i;
+  for (size_t j = (i + 1) & mask; shard->slots[j].entry != NULL;
+       j = (j + 1) & mask) {
+    size_t home = shard->slots[j].hash & mask;
+    /* Distance from the home slot to `hole' resp. `j', modulo table size. */
+    if (((hole - home) & mask) < ((j - home) & mask)) {
+      shard->slots[hole] = shard->slots[j];
+      shard->slots[j].entry = NULL;
+      hole = j;
+    }
+  }
+
+  return ce;
+} /* cache_entry_t *cache_remove */
+
+/* Locks all shards in ascending order. Callers that need more than one shard
+ * at a time must go through this function to avoid lock order inversions. */
+static void cache_lock_all(void) {
+  for (size_t i = 0; i < UC_SHARDS_NUM; i++)
+    pthread_mutex_lock(&cache_shards[i].lock);
+} /* void cache_lock_all */
 
-static int cache_compare(const cache_entry_t *a, const cache_entry_t *b) {
-#if COLLECT_DEBUG
-  assert((a != NULL) && (b != NULL));
-#endif
-  return strcmp(a->name, b->name);
-} /* int cache_compare */
+static void cache_unlock_all(void) {
+  for (size_t i = UC_SHARDS_NUM; i > 0; i--)
+    pthread_mutex_unlock(&cache_shards[i - 1].lock);
+} /* void cache_unlock_all */
 
 static cache_entry_t *cache_alloc(size_t values_num) {
   cache_entry_t *ce;
@@ -139,24 +298,18 @@ static void uc_check_range(const data_set_t *ds, cache_entry_t *ce) {
   }
 } /* void uc_check_range */
 
-static int uc_insert(const data_set_t *ds, const value_list_t *vl,
-                     const char *key) {
-  /* `cache_lock' has been locked by `uc_update' */
-
-  char *key_copy = strdup(key);
-  if (key_copy == NULL) {
-    ERROR("uc_insert: strdup failed.");
-    return -1;
-  }
+static int uc_insert(cache_shard_t *shard, const data_set_t *ds,
+                     const value_list_t *vl, const char *key, uint32_t hash) {
+  /* `shard->lock' has been locked by `uc_update' */
 
   cache_entry_t *ce = cache_alloc(ds->ds_num);
   if (ce == NULL) {
-    sfree(key_copy);
     ERROR("uc_insert: cache_alloc (%" PRIsz ") failed.", ds->ds_num);
     return -1;
   }
 
   sstrncpy(ce->name, key, sizeof(ce->name));
+  ce->hash = hash;
 
   for (size_t i = 0; i < ds->ds_num; i++) {
     switch (ds->ds[i].type) {
@@ -187,7 +340,6 @@ static int uc_insert(const data_set_t *ds, const value_list_t *vl,
       /* This shouldn't happen. */
       ERROR("uc_insert: Don't know how to handle data source type %i.",
             ds->ds[i].type);
-      sfree(key_copy);
       cache_free(ce);
       return -1;
     } /* switch (ds->ds[i].type) */
@@ -205,9 +357,9 @@ static int uc_insert(const data_set_t *ds, const value_list_t *vl,
     ce->meta = meta_data_clone(vl->meta);
   }
 
-  if (c_avl_insert(cache_tree, key_copy, ce) != 0) {
-    sfree(key_copy);
-    ERROR("uc_insert: c_avl_insert failed.");
+  if (cache_insert(shard, ce) != 0) {
+    cache_free(ce);
+    ERROR("uc_insert: cache_insert failed.");
     return -1;
   }
 
@@ -216,9 +368,20 @@ static int uc_insert(const data_set_t *ds, const value_list_t *vl,
 } /* int uc_insert */
 
 int uc_init(void) {
-  if (cache_tree == NULL)
-    cache_tree =
-        c_avl_create((int (*)(const void *, const void *))cache_compare);
+  for (size_t i = 0; i < UC_SHARDS_NUM; i++) {
+    cache_shard_t *shard = &cache_shards[i];
+    if (shard->slots != NULL)
+      continue;
+
+    shard->slots = calloc(UC_SLOTS_MIN, sizeof(*shard->slots));
+    if (shard->slots == NULL) {
+      ERROR("uc_init: calloc failed.");
+      return -1;
+    }
+    shard->slots_num = UC_SLOTS_MIN;
+    shard->entries_num = 0;
+    pthread_mutex_init(&shard->lock, /* attr = */ NULL);
+  }
 
   return 0;
 } /* int uc_init */
@@ -226,46 +389,54 @@ int uc_init(void) {
 int uc_check_timeout(void) {
   struct {
     char *key;
+    uint32_t hash;
     cdtime_t time;
     cdtime_t interval;
     unsigned long callbacks_mask;
   } *expired = NULL;
   size_t expired_num = 0;
 
-  pthread_mutex_lock(&cache_lock);
   cdtime_t now = cdtime();
 
-  /* Build a list of entries to be flushed */
-  c_avl_iterator_t *iter = c_avl_get_iterator(cache_tree);
-  char *key = NULL;
-  cache_entry_t *ce = NULL;
-  while (c_avl_iterator_next(iter, (void *)&key, (void *)&ce) == 0) {
-    /* If the entry is fresh enough, continue. */
-    if ((now - ce->last_update) < (ce->interval * timeout_g))
-      continue;
+  /* Build a list of entries to be flushed. Shards are scanned one at a time,
+   * so writers are only ever blocked by the scan of a single shard. */
+  for (size_t i = 0; i < UC_SHARDS_NUM; i++) {
+    cache_shard_t *shard = &cache_shards[i];
 
-    void *tmp = realloc(expired, (expired_num + 1) * sizeof(*expired));
-    if (tmp == NULL) {
-      ERROR("uc_check_timeout: realloc failed.");
-      continue;
-    }
-    expired = tmp;
+    pthread_mutex_lock(&shard->lock);
 
-    expired[expired_num].key = strdup(key);
-    expired[expired_num].time = ce->last_time;
-    expired[expired_num].interval = ce->interval;
-    expired[expired_num].callbacks_mask = ce->callbacks_mask;
+    for (size_t j = 0; j < shard->slots_num; j++) {
+      cache_entry_t *ce = shard->slots[j].entry;
+      if (ce == NULL)
+        continue;
 
-    if (expired[expired_num].key == NULL) {
-      ERROR("uc_check_timeout: strdup failed.");
-      continue;
-    }
+      /* If the entry is fresh enough, continue. */
+      if ((now - ce->last_update) < (ce->interval * timeout_g))
+        continue;
+
+      void *tmp = realloc(expired, (expired_num + 1) * sizeof(*expired));
+      if (tmp == NULL) {
+        ERROR("uc_check_timeout: realloc failed.");
+        continue;
+      }
+      expired = tmp;
 
-    expired_num++;
-  } /* while (c_avl_iterator_next) */
+      expired[expired_num].key = strdup(ce->name);
+      expired[expired_num].hash = ce->hash;
+      expired[expired_num].time = ce->last_time;
+      expired[expired_num].interval = ce->interval;
+      expired[expired_num].callbacks_mask = ce->callbacks_mask;
 
-  c_avl_iterator_destroy(iter);
-  pthread_mutex_unlock(&cache_lock);
+      if (expired[expired_num].key == NULL) {
+        ERROR("uc_check_timeout: strdup failed.");
+        continue;
+      }
+
+      expired_num++;
+    } /* for (j = 0; j < shard->slots_num; j++) */
+
+    pthread_mutex_unlock(&shard->lock);
+  } /* for (i = 0; i < UC_SHARDS_NUM; i++) */
 
   if (expired_num == 0) {
     sfree(expired);
@@ -299,23 +470,22 @@ int uc_check_timeout(void) {
   /* Now actually remove all the values from the cache. We don't re-evaluate
    * the timestamp again, so in theory it is possible we remove a value after
    * it is updated here. */
-  pthread_mutex_lock(&cache_lock);
   for (size_t i = 0; i < expired_num; i++) {
-    char *key = NULL;
-    cache_entry_t *value = NULL;
+    cache_shard_t *shard = cache_get_shard(expired[i].hash);
+
+    pthread_mutex_lock(&shard->lock);
+    cache_entry_t *value = cache_remove(shard, expired[i].hash, expired[i].key);
+    pthread_mutex_unlock(&shard->lock);
 
-    if (c_avl_remove(cache_tree, expired[i].key, (void *)&key,
-                     (void *)&value) != 0) {
-      ERROR("uc_check_timeout: c_avl_remove (\"%s\") failed.", expired[i].key);
+    if (value == NULL) {
+      ERROR("uc_check_timeout: cache_remove (\"%s\") failed.", expired[i].key);
       sfree(expired[i].key);
       continue;
     }
-    sfree(key);
     cache_free(value);
 
     sfree(expired[i].key);
   } /* for (i = 0; i < expired_num; i++) */
-  pthread_mutex_unlock(&cache_lock);
 
   sfree(expired);
   return 0;
@@ -329,14 +499,15 @@ int uc_update(const data_set_t *ds, const value_list_t *vl) {
     return -1;
   }
 
-  pthread_mutex_lock(&cache_lock);
+  uint32_t hash = cache_hash(name);
+  cache_shard_t *shard = cache_get_shard(hash);
+  pthread_mutex_lock(&shard->lock);
 
-  cache_entry_t *ce = NULL;
-  int status = c_avl_get(cache_tree, name, (void *)&ce);
-  if (status != 0) /* entry does not yet exist */
+  cache_entry_t *ce = cache_lookup(shard, hash, name);
+  if (ce == NULL) /* entry does not yet exist */
   {
-    status = uc_insert(ds, vl, name);
-    pthread_mutex_unlock(&cache_lock);
+    int status = uc_insert(shard, ds, vl, name, hash);
+    pthread_mutex_unlock(&shard->lock);
 
     if (status == 0)
       plugin_dispatch_cache_event(CE_VALUE_NEW, 0 /* mask */, name, vl);
@@ -348,7 +519,7 @@ int uc_update(const data_set_t *ds, const value_list_t *vl) {
   assert(ce->values_num == ds->ds_num);
 
   if (ce->last_time >= vl->time) {
-    pthread_mutex_unlock(&cache_lock);
+    pthread_mutex_unlock(&shard->lock);
     NOTICE("uc_update: Value too old: name = %s; value time = %.3f; "
            "last cache update = %.3f;",
            name, CDTIME_T_TO_DOUBLE(vl->time),
@@ -387,7 +558,7 @@ int uc_update(const data_set_t *ds, const value_list_t *vl) {
 
     default:
       /* This shouldn't happen. */
-      pthread_mutex_unlock(&cache_lock);
+      pthread_mutex_unlock(&shard->lock);
       ERROR("uc_update: Don't know how to handle data source type %i.",
             ds->ds[i].type);
       return -1;
@@ -418,7 +589,7 @@ int uc_update(const data_set_t *ds, const value_list_t *vl) {
   /* Check if cache entry has registered callbacks */
   unsigned long callbacks_mask = ce->callbacks_mask;
 
-  pthread_mutex_unlock(&cache_lock);
+  pthread_mutex_unlock(&shard->lock);
 
   if (callbacks_mask)
     plugin_dispatch_cache_event(CE_VALUE_UPDATE, callbacks_mask, name, vl);
@@ -427,17 +598,18 @@ int uc_update(const data_set_t *ds, const value_list_t *vl) {
 } /* int uc_update */
 
 int uc_set_callbacks_mask(const char *name, unsigned long mask) {
-  pthread_mutex_lock(&cache_lock);
-  cache_entry_t *ce = NULL;
-  int status = c_avl_get(cache_tree, name, (void *)&ce);
-  if (status != 0) { /* Ouch, just created entry disappeared ?! */
+  uint32_t hash = cache_hash(name);
+  cache_shard_t *shard = cache_get_shard(hash);
+  pthread_mutex_lock(&shard->lock);
+  cache_entry_t *ce = cache_lookup(shard, hash, name);
+  if (ce == NULL) { /* Ouch, just created entry disappeared ?! */
     ERROR("uc_set_callbacks_mask: Couldn't find %s entry!", name);
-    pthread_mutex_unlock(&cache_lock);
+    pthread_mutex_unlock(&shard->lock);
     return -1;
   }
   DEBUG("uc_set_callbacks_mask: set mask for \"%s\" to %lu.", name, mask);
   ce->callbacks_mask = mask;
-  pthread_mutex_unlock(&cache_lock);
+  pthread_mutex_unlock(&shard->lock);
   return 0;
 }
 
@@ -448,10 +620,12 @@ int uc_get_rate_by_name(const char *name, gauge_t **ret_values,
   cache_entry_t *ce = NULL;
   int status = 0;
 
-  pthread_mutex_lock(&cache_lock);
+  uint32_t hash = cache_hash(name);
+  cache_shard_t *shard = cache_get_shard(hash);
+  pthread_mutex_lock(&shard->lock);
 
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
-    assert(ce != NULL);
+  ce = cache_lookup(shard, hash, name);
+  if (ce != NULL) {
 
     /* remove missing values from getval */
     if (ce->state == STATE_MISSING) {
@@ -474,7 +648,7 @@ int uc_get_rate_by_name(const char *name, gauge_t **ret_values,
     status = -1;
   }
 
-  pthread_mutex_unlock(&cache_lock);
+  pthread_mutex_unlock(&shard->lock);
 
   if (status == 0) {
     *ret_values = ret;
@@ -519,10 +693,12 @@ int uc_get_value_by_name(const char *name, value_t **ret_values,
   cache_entry_t *ce = NULL;
   int status = 0;
 
-  pthread_mutex_lock(&cache_lock);
+  uint32_t hash = cache_hash(name);
+  cache_shard_t *shard = cache_get_shard(hash);
+  pthread_mutex_lock(&shard->lock);
 
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
-    assert(ce != NULL);
+  ce = cache_lookup(shard, hash, name);
+  if (ce != NULL) {
 
     /* remove missing values from getval */
     if (ce->state == STATE_MISSING) {
@@ -542,7 +718,7 @@ int uc_get_value_by_name(const char *name, value_t **ret_values,
     status = -1;
   }
 
-  pthread_mutex_unlock(&cache_lock);
+  pthread_mutex_unlock(&shard->lock);
 
   if (status == 0) {
     *ret_values = ret;
@@ -583,20 +759,25 @@ value_t *uc_get_value(const data_set_t *ds, const value_list_t *vl) {
 size_t uc_get_size(void) {
   size_t size_arrays = 0;
 
-  pthread_mutex_lock(&cache_lock);
-  size_arrays = (size_t)c_avl_size(cache_tree);
-  pthread_mutex_unlock(&cache_lock);
+  for (size_t i = 0; i < UC_SHARDS_NUM; i++) {
+    pthread_mutex_lock(&cache_shards[i].lock);
+    size_arrays += cache_shards[i].entries_num;
+    pthread_mutex_unlock(&cache_shards[i].lock);
+  }
 
   return size_arrays;
 }
 
-int uc_get_names(char ***ret_names, cdtime_t **ret_times, size_t *ret_number) {
-  c_avl_iterator_t *iter;
-  char *key;
-  cache_entry_t *value;
+static int uc_name_compare(const void *a, const void *b) {
+  return strcmp(*(char *const *)a, *(char *const *)b);
+} /* int uc_name_compare */
 
-  char **names = NULL;
-  cdtime_t *times = NULL;
+int uc_get_names(char ***ret_names, cdtime_t **ret_times, size_t *ret_number) {
+  /* The name has to be the first member, see uc_name_compare(). */
+  struct {
+    char *name;
+    cdtime_t time;
+  } *entries = NULL;
   size_t number = 0;
   size_t size_arrays = 0;
 
@@ -605,66 +786,89 @@ int uc_get_names(char ***ret_names, cdtime_t **ret_times, size_t *ret_number) {
   if ((ret_names == NULL) || (ret_number == NULL))
     return -1;
 
-  pthread_mutex_lock(&cache_lock);
+  /* Hold all shards so the returned list is a consistent snapshot. */
+  cache_lock_all();
 
-  size_arrays = (size_t)c_avl_size(cache_tree);
+  for (size_t i = 0; i < UC_SHARDS_NUM; i++)
+    size_arrays += cache_shards[i].entries_num;
   if (size_arrays < 1) {
     /* Handle the "no values" case here, to avoid the error message when
      * calloc() returns NULL. */
-    pthread_mutex_unlock(&cache_lock);
+    cache_unlock_all();
     return 0;
   }
 
-  names = calloc(size_arrays, sizeof(*names));
-  times = calloc(size_arrays, sizeof(*times));
-  if ((names == NULL) || (times == NULL)) {
+  entries = calloc(size_arrays, sizeof(*entries));
+  if (entries == NULL) {
     ERROR("uc_get_names: calloc failed.");
-    sfree(names);
-    sfree(times);
-    pthread_mutex_unlock(&cache_lock);
+    cache_unlock_all();
     return ENOMEM;
   }
 
-  iter = c_avl_get_iterator(cache_tree);
-  while (c_avl_iterator_next(iter, (void *)&key, (void *)&value) == 0) {
-    /* remove missing values when list values */
-    if (value->state == STATE_MISSING)
-      continue;
+  for (size_t i = 0; (i < UC_SHARDS_NUM) && (status == 0); i++) {
+    cache_shard_t *shard = &cache_shards[i];
 
-    /* c_avl_size does not return a number smaller than the number of elements
-     * returned by c_avl_iterator_next. */
-    assert(number < size_arrays);
+    for (size_t j = 0; j < shard->slots_num; j++) {
+      cache_entry_t *value = shard->slots[j].entry;
 
-    if (ret_times != NULL)
-      times[number] = value->last_time;
+      /* remove missing values when list values */
+      if ((value == NULL) || (value->state == STATE_MISSING))
+        continue;
 
-    names[number] = strdup(key);
-    if (names[number] == NULL) {
-      status = -1;
-      break;
-    }
+      /* The sum of all `entries_num' is the number of used slots. */
+      assert(number < size_arrays);
+
+      entries[number].time = value->last_time;
+      entries[number].name = strdup(value->name);
+      if (entries[number].name == NULL) {
+        status = -1;
+        break;
+      }
 
-    number++;
-  } /* while (c_avl_iterator_next) */
+      number++;
+    } /* for (j = 0; j < shard->slots_num; j++) */
+  }
 
-  c_avl_iterator_destroy(iter);
-  pthread_mutex_unlock(&cache_lock);
+  cache_unlock_all();
 
   if (status != 0) {
     for (size_t i = 0; i < number; i++) {
-      sfree(names[i]);
+      sfree(entries[i].name);
     }
+    sfree(entries);
+
+    return -1;
+  }
+
+  /* Shards are not ordered with respect to each other. Sort the result so
+   * that callers, e.g. LISTVAL, still see the identifiers in order. */
+  qsort(entries, number, sizeof(*entries), uc_name_compare);
+
+  char **names = calloc(size_arrays, sizeof(*names));
+  cdtime_t *times = NULL;
+  if (ret_times != NULL)
+    times = calloc(size_arrays, sizeof(*times));
+  if ((names == NULL) || ((ret_times != NULL) && (times == NULL))) {
+    ERROR("uc_get_names: calloc failed.");
+    for (size_t i = 0; i < number; i++) {
+      sfree(entries[i].name);
+    }
+    sfree(entries);
     sfree(names);
     sfree(times);
+    return ENOMEM;
+  }
 
-    return -1;
+  for (size_t i = 0; i < number; i++) {
+    names[i] = entries[i].name;
+    if (times != NULL)
+      times[i] = entries[i].time;
   }
+  sfree(entries);
 
   *ret_names = names;
   if (ret_times != NULL)
     *ret_times = times;
-  else
-    sfree(times);
   *ret_number = number;
 
   return 0;
@@ -680,14 +884,16 @@ int uc_get_state(const data_set_t *ds, const value_list_t *vl) {
     return STATE_ERROR;
   }
 
-  pthread_mutex_lock(&cache_lock);
+  uint32_t hash = cache_hash(name);
+  cache_shard_t *shard = cache_get_shard(hash);
+  pthread_mutex_lock(&shard->lock);
 
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
-    assert(ce != NULL);
+  ce = cache_lookup(shard, hash, name);
+  if (ce != NULL) {
     ret = ce->state;
   }
 
-  pthread_mutex_unlock(&cache_lock);
+  pthread_mutex_unlock(&shard->lock);
 
   return ret;
 } /* int uc_get_state */
@@ -702,15 +908,17 @@ int uc_set_state(const data_set_t *ds, const value_list_t *vl, int state) {
     return STATE_ERROR;
   }
 
-  pthread_mutex_lock(&cache_lock);
+  uint32_t hash = cache_hash(name);
+  cache_shard_t *shard = cache_get_shard(hash);
+  pthread_mutex_lock(&shard->lock);
 
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
-    assert(ce != NULL);
+  ce = cache_lookup(shard, hash, name);
+  if (ce != NULL) {
     ret = ce->state;
     ce->state = state;
   }
 
-  pthread_mutex_unlock(&cache_lock);
+  pthread_mutex_unlock(&shard->lock);
 
   return ret;
 } /* int uc_set_state */
@@ -718,18 +926,19 @@ int uc_set_state(const data_set_t *ds, const value_list_t *vl, int state) {
 int uc_get_history_by_name(const char *name, gauge_t *ret_history,
                            size_t num_steps, size_t num_ds) {
   cache_entry_t *ce = NULL;
-  int status = 0;
 
-  pthread_mutex_lock(&cache_lock);
+  uint32_t hash = cache_hash(name);
+  cache_shard_t *shard = cache_get_shard(hash);
+  pthread_mutex_lock(&shard->lock);
 
-  status = c_avl_get(cache_tree, name, (void *)&ce);
-  if (status != 0) {
-    pthread_mutex_unlock(&cache_lock);
+  ce = cache_lookup(shard, hash, name);
+  if (ce == NULL) {
+    pthread_mutex_unlock(&shard->lock);
     return -ENOENT;
   }
 
   if (((size_t)ce->values_num) != num_ds) {
-    pthread_mutex_unlock(&cache_lock);
+    pthread_mutex_unlock(&shard->lock);
     return -EINVAL;
   }
 
@@ -741,7 +950,7 @@ int uc_get_history_by_name(const char *name, gauge_t *ret_history,
     tmp =
         realloc(ce->history, sizeof(*ce->history) * num_steps * ce->values_num);
     if (tmp == NULL) {
-      pthread_mutex_unlock(&cache_lock);
+      pthread_mutex_unlock(&shard->lock);
       return -ENOMEM;
     }
 
@@ -770,7 +979,7 @@ int uc_get_history_by_name(const char *name, gauge_t *ret_history,
            sizeof(*ret_history) * num_ds);
   }
 
-  pthread_mutex_unlock(&cache_lock);
+  pthread_mutex_unlock(&shard->lock);
 
   return 0;
 } /* int uc_get_history_by_name */
@@ -797,14 +1006,16 @@ int uc_get_hits(const data_set_t *ds, const value_list_t *vl) {
     return STATE_ERROR;
   }
 
-  pthread_mutex_lock(&cache_lock);
+  uint32_t hash = cache_hash(name);
+  cache_shard_t *shard = cache_get_shard(hash);
+  pthread_mutex_lock(&shard->lock);
 
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
-    assert(ce != NULL);
+  ce = cache_lookup(shard, hash, name);
+  if (ce != NULL) {
     ret = ce->hits;
   }
 
-  pthread_mutex_unlock(&cache_lock);
+  pthread_mutex_unlock(&shard->lock);
 
   return ret;
 } /* int uc_get_hits */
@@ -819,15 +1030,17 @@ int uc_set_hits(const data_set_t *ds, const value_list_t *vl, int hits) {
     return STATE_ERROR;
   }
 
-  pthread_mutex_lock(&cache_lock);
+  uint32_t hash = cache_hash(name);
+  cache_shard_t *shard = cache_get_shard(hash);
+  pthread_mutex_lock(&shard->lock);
 
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
-    assert(ce != NULL);
+  ce = cache_lookup(shard, hash, name);
+  if (ce != NULL) {
     ret = ce->hits;
     ce->hits = hits;
   }
 
-  pthread_mutex_unlock(&cache_lock);
+  pthread_mutex_unlock(&shard->lock);
 
   return ret;
 } /* int uc_set_hits */
@@ -842,15 +1055,17 @@ int uc_inc_hits(const data_set_t *ds, const value_list_t *vl, int step) {
     return STATE_ERROR;
   }
 
-  pthread_mutex_lock(&cache_lock);
+  uint32_t hash = cache_hash(name);
+  cache_shard_t *shard = cache_get_shard(hash);
+  pthread_mutex_lock(&shard->lock);
 
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
-    assert(ce != NULL);
+  ce = cache_lookup(shard, hash, name);
+  if (ce != NULL) {
     ret = ce->hits;
     ce->hits = ret + step;
   }
 
-  pthread_mutex_unlock(&cache_lock);
+  pthread_mutex_unlock(&shard->lock);
 
   return ret;
 } /* int uc_inc_hits */
@@ -858,41 +1073,86 @@ int uc_inc_hits(const data_set_t *ds, const value_list_t *vl, int step) {
 /*
  * Iterator interface
  */
-uc_iter_t *uc_get_iterator(void) {
-  uc_iter_t *iter = calloc(1, sizeof(*iter));
-  if (iter == NULL)
-    return NULL;
+static void uc_iterator_free_entries(uc_iter_t *iter) {
+  for (size_t i = 0; i < iter->entries_num; i++) {
+    sfree(iter->entries[i].name);
+    sfree(iter->entries[i].values_raw);
+    meta_data_destroy(iter->entries[i].meta);
+  }
+  sfree(iter->entries);
+  iter->entries_num = 0;
+  iter->entries_pos = 0;
+  iter->name = NULL;
+  iter->entry = NULL;
+} /* void uc_iterator_free_entries */
+
+/* Replaces the iterator's entries with copies of the entries of the next
+ * shard, holding only that shard's lock. */
+static int uc_iterator_copy_shard(uc_iter_t *iter) {
+  cache_shard_t *shard = cache_shards + iter->shard_index;
+  int status = 0;
 
-  pthread_mutex_lock(&cache_lock);
+  uc_iterator_free_entries(iter);
+  iter->shard_index++;
 
-  iter->iter = c_avl_get_iterator(cache_tree);
-  if (iter->iter == NULL) {
-    free(iter);
-    return NULL;
+  pthread_mutex_lock(&shard->lock);
+
+  if (shard->entries_num > 0) {
+    iter->entries = calloc(shard->entries_num, sizeof(*iter->entries));
+    if (iter->entries == NULL) {
+      pthread_mutex_unlock(&shard->lock);
+      return ENOMEM;
+    }
   }
 
-  return iter;
+  for (size_t i = 0; i < shard->slots_num; i++) {
+    cache_entry_t *ce = shard->slots[i].entry;
+    if ((ce == NULL) || (ce->state == STATE_MISSING))
+      continue;
+
+    uc_iter_entry_t *e = iter->entries + iter->entries_num;
+    e->name = strdup(ce->name);
+    e->values_raw = calloc(ce->values_num, sizeof(*e->values_raw));
+    if ((e->name == NULL) || (e->values_raw == NULL)) {
+      sfree(e->name);
+      sfree(e->values_raw);
+      status = ENOMEM;
+      break;
+    }
+    memcpy(e->values_raw, ce->values_raw,
+           ce->values_num * sizeof(*e->values_raw));
+    e->values_num = ce->values_num;
+    e->last_time = ce->last_time;
+    e->interval = ce->interval;
+    e->meta = meta_data_clone(ce->meta);
+    iter->entries_num++;
+  }
+
+  pthread_mutex_unlock(&shard->lock);
+
+  return status;
+} /* int uc_iterator_copy_shard */
+
+uc_iter_t *uc_get_iterator(void) {
+  return calloc(1, sizeof(uc_iter_t));
 } /* uc_iter_t *uc_get_iterator */
 
 int uc_iterator_next(uc_iter_t *iter, char **ret_name) {
-  int status;
-
   if (iter == NULL)
     return -1;
 
-  while ((status = c_avl_iterator_next(iter->iter, (void *)&iter->name,
-                                       (void *)&iter->entry)) == 0) {
-    if (iter->entry->state == STATE_MISSING)
-      continue;
-
-    break;
-  }
-  if (status != 0) {
-    iter->name = NULL;
-    iter->entry = NULL;
-    return -1;
+  while (iter->entries_pos >= iter->entries_num) {
+    if ((iter->shard_index >= UC_SHARDS_NUM) ||
+        (uc_iterator_copy_shard(iter) != 0)) {
+      uc_iterator_free_entries(iter);
+      return -1;
+    }
   }
 
+  iter->entry = iter->entries + iter->entries_pos;
+  iter->name = iter->entry->name;
+  iter->entries_pos++;
+
   if (ret_name != NULL)
     *ret_name = iter->name;
 
@@ -903,9 +1163,7 @@ void uc_iterator_destroy(uc_iter_t *iter) {
   if (iter == NULL)
     return;
 
-  c_avl_iterator_destroy(iter->iter);
-  pthread_mutex_unlock(&cache_lock);
-
+  uc_iterator_free_entries(iter);
   free(iter);
 } /* void uc_iterator_destroy */
 
@@ -954,8 +1212,10 @@ int uc_iterator_get_meta(uc_iter_t *iter, meta_data_t **ret_meta) {
 /*
  * Meta data interface
  */
-/* XXX: This function will acquire `cache_lock' but will not free it! */
-static meta_data_t *uc_get_meta(const value_list_t *vl) /* {{{ */
+/* XXX: This function will acquire the lock of the shard returned in
+ * `ret_shard' but will not free it! */
+static meta_data_t *uc_get_meta(const value_list_t *vl,
+                                cache_shard_t **ret_shard) /* {{{ */
 {
   char name[6 * DATA_MAX_NAME_LEN];
   cache_entry_t *ce = NULL;
@@ -967,11 +1227,13 @@ static meta_data_t *uc_get_meta(const value_list_t *vl) /* {{{ */
     return NULL;
   }
 
-  pthread_mutex_lock(&cache_lock);
+  uint32_t hash = cache_hash(name);
+  cache_shard_t *shard = cache_get_shard(hash);
+  pthread_mutex_lock(&shard->lock);
 
-  status = c_avl_get(cache_tree, name, (void *)&ce);
-  if (status != 0) {
-    pthread_mutex_unlock(&cache_lock);
+  ce = cache_lookup(shard, hash, name);
+  if (ce == NULL) {
+    pthread_mutex_unlock(&shard->lock);
     return NULL;
   }
   assert(ce != NULL);
@@ -980,7 +1242,9 @@ static meta_data_t *uc_get_meta(const value_list_t *vl) /* {{{ */
     ce->meta = meta_data_create();
 
   if (ce->meta == NULL)
-    pthread_mutex_unlock(&cache_lock);
+    pthread_mutex_unlock(&shard->lock);
+  else
+    *ret_shard = shard;
 
   return ce->meta;
 } /* }}} meta_data_t *uc_get_meta */
@@ -989,13 +1253,14 @@ static meta_data_t *uc_get_meta(const value_list_t *vl) /* {{{ */
  * shorter.. */
 #define UC_WRAP(wrap_function)                                                 \
   {                                                                            \
+    cache_shard_t *shard;                                                      \
     meta_data_t *meta;                                                         \
     int status;                                                                \
-    meta = uc_get_meta(vl);                                                    \
+    meta = uc_get_meta(vl, &shard);                                            \
     if (meta == NULL)                                                          \
       return -1;                                                               \
     status = wrap_function(meta, key);                                         \
-    pthread_mutex_unlock(&cache_lock);                                         \
+    pthread_mutex_unlock(&shard->lock);                                        \
     return status;                                                             \
   }
 int uc_meta_data_exists(const value_list_t *vl, const char *key)
@@ -1015,13 +1280,14 @@ int uc_meta_data_exists(const value_list_t *vl, const char *key)
  * two argumetns. */
 #define UC_WRAP(wrap_function)                                                 \
   {                                                                            \
+    cache_shard_t *shard;                                                      \
     meta_data_t *meta;                                                         \
     int status;                                                                \
-    meta = uc_get_meta(vl);                                                    \
+    meta = uc_get_meta(vl, &shard);                                            \
     if (meta == NULL)                                                          \
       return -1;                                                               \
     status = wrap_function(meta, key, value);                                  \
-    pthread_mutex_unlock(&cache_lock);                                         \
+    pthread_mutex_unlock(&shard->lock);                                        \
     return status;                                                             \
   }
         int uc_meta_data_add_string(const value_list_t *vl, const char *key,
@@ -74,8 +74,10 @@ typedef struct uc_iter_s uc_iter_t;
  *   uc_get_iterator
  *
  * DESCRIPTION
- *   Create an iterator for the cache. It will hold the cache lock until it's
- *   destroyed.
+ *   Create an iterator for the cache. The entries are copied one cache shard
+ *   at a time, holding only that shard's lock while copying. They are
+ *   therefore not sorted by name, and entries added or changed during the
+ *   iteration may or may not be returned.
  *
  * RETURN VALUE
  *   An iterator object on success or NULL else.
@@ -0,0 +1,138 @@
+/**
+ * collectd - src/daemon/utils_cache_bench.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Microbenchmark for the value cache: measures the throughput of uc_update()
+ * with an increasing number of concurrent threads, each updating its own set
+ * of identifiers, similar to what the write threads do.
+ *
+ * Usage: bench_utils_cache [max_threads [series_per_thread [rounds]]]
+ */
+
+#include "collectd.h"
+
+#include "utils/common/common.h"
+#include "utils_cache.h"
+
+#include <time.h>
+
+static data_source_t dsrc_bench[] = {{"value", DS_TYPE_DERIVE, 0.0, NAN}};
+static data_set_t ds_bench = {"bench", 1, dsrc_bench};
+
+static int series_num = 10000;
+static int rounds_num = 20;
+
+typedef struct {
+  int run;
+  int thread;
+  int failed;
+} bench_thread_t;
+
+static double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + ((double)ts.tv_nsec) / 1e9;
+}
+
+static void *bench_thread(void *arg) {
+  bench_thread_t *bt = arg;
+  value_t value = {.derive = 0};
+  value_list_t vl = {
+      .values = &value,
+      .values_len = 1,
+      .interval = TIME_T_TO_CDTIME_T(10),
+  };
+
+  ssnprintf(vl.host, sizeof(vl.host), "run%d-thread%d", bt->run, bt->thread);
+  sstrncpy(vl.plugin, "bench", sizeof(vl.plugin));
+  sstrncpy(vl.type, "bench", sizeof(vl.type));
+
+  /* Round 0 inserts the identifiers, the following rounds update them. */
+  for (int round = 0; round <= rounds_num; round++) {
+    vl.time = TIME_T_TO_CDTIME_T(10 * (round + 1));
+    for (int i = 0; i < series_num; i++) {
+      ssnprintf(vl.type_instance, sizeof(vl.type_instance), "%d", i);
+      value.derive = round * i;
+      if (uc_update(&ds_bench, &vl) != 0)
+        bt->failed++;
+    }
+  }
+
+  return NULL;
+}
+
+static int bench_run(int run, int threads_num) {
+  pthread_t threads[threads_num];
+  bench_thread_t args[threads_num];
+
+  double start = now_seconds();
+  for (int i = 0; i < threads_num; i++) {
+    args[i] = (bench_thread_t){.run = run, .thread = i};
+    if (pthread_create(&threads[i], NULL, bench_thread, &args[i]) != 0) {
+      fprintf(stderr, "pthread_create failed\n");
+      return -1;
+    }
+  }
+
+  int failed = 0;
+  for (int i = 0; i < threads_num; i++) {
+    pthread_join(threads[i], NULL);
+    failed += args[i].failed;
+  }
+  double elapsed = now_seconds() - start;
+
+  double updates = (double)threads_num * series_num * (rounds_num + 1);
+  printf("%7d %12.0f %14.0f %8d\n", threads_num, updates, updates / elapsed,
+         failed);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  int max_threads = 16;
+
+  if (argc > 1)
+    max_threads = atoi(argv[1]);
+  if (argc > 2)
+    series_num = atoi(argv[2]);
+  if (argc > 3)
+    rounds_num = atoi(argv[3]);
+  if ((max_threads < 1) || (series_num < 1) || (rounds_num < 0)) {
+    fprintf(stderr,
+            "Usage: %s [max_threads [series_per_thread [rounds]]]\n",
+            argv[0]);
+    return 1;
+  }
+
+  if (uc_init() != 0)
+    return 1;
+
+  printf("%7s %12s %14s %8s\n", "threads", "updates", "updates/s", "failed");
+  int run = 0;
+  for (int threads_num = 1; threads_num <= max_threads; threads_num *= 2) {
+    if (bench_run(run, threads_num) != 0)
+      return 1;
+    run++;
+  }
+
+  return 0;
+}
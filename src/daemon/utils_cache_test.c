@@ -0,0 +1,165 @@
+/**
+ * collectd - src/daemon/utils_cache_test.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "collectd.h"
+
+#include "testing.h"
+#include "utils/common/common.h"
+#include "utils_cache.h"
+
+static data_source_t dsrc_test[] = {{"value", DS_TYPE_DERIVE, 0.0, NAN}};
+static data_set_t ds_test = {"test", 1, dsrc_test};
+
+#define NAMES_NUM 200
+
+static void set_vl(value_list_t *vl, value_t *value, int index, cdtime_t t) {
+  vl->values = value;
+  vl->values_len = 1;
+  vl->time = t;
+  vl->interval = TIME_T_TO_CDTIME_T(10);
+  sstrncpy(vl->host, "example.com", sizeof(vl->host));
+  sstrncpy(vl->plugin, "test", sizeof(vl->plugin));
+  sstrncpy(vl->type, "test", sizeof(vl->type));
+  ssnprintf(vl->type_instance, sizeof(vl->type_instance), "%04d", index);
+}
+
+DEF_TEST(update_and_rate) {
+  value_list_t vl = VALUE_LIST_INIT;
+  value_t value = {.derive = 100};
+
+  set_vl(&vl, &value, 0, TIME_T_TO_CDTIME_T(100));
+  sstrncpy(vl.plugin, "rate", sizeof(vl.plugin));
+  CHECK_ZERO(uc_update(&ds_test, &vl));
+
+  value.derive = 200;
+  vl.time = TIME_T_TO_CDTIME_T(110);
+  CHECK_ZERO(uc_update(&ds_test, &vl));
+
+  gauge_t *rate = uc_get_rate(&ds_test, &vl);
+  CHECK_NOT_NULL(rate);
+  EXPECT_EQ_DOUBLE(10.0, rate[0]);
+  sfree(rate);
+
+  /* Values must not go back in time. */
+  OK(uc_update(&ds_test, &vl) != 0);
+
+  EXPECT_EQ_INT(STATE_UNKNOWN, uc_set_state(&ds_test, &vl, STATE_OKAY));
+  EXPECT_EQ_INT(STATE_OKAY, uc_get_state(&ds_test, &vl));
+
+  return 0;
+}
+
+DEF_TEST(names_and_iterator) {
+  for (int i = 0; i < NAMES_NUM; i++) {
+    value_list_t vl = VALUE_LIST_INIT;
+    value_t value = {.derive = i};
+    set_vl(&vl, &value, i, TIME_T_TO_CDTIME_T(100));
+    CHECK_ZERO(uc_update(&ds_test, &vl));
+  }
+  /* One more entry has been added by the "update_and_rate" test. */
+  EXPECT_EQ_INT(NAMES_NUM + 1, uc_get_size());
+
+  char **names = NULL;
+  cdtime_t *times = NULL;
+  size_t names_num = 0;
+  CHECK_ZERO(uc_get_names(&names, &times, &names_num));
+  EXPECT_EQ_INT(NAMES_NUM + 1, names_num);
+
+  /* Entries are spread across shards but must be returned sorted. */
+  EXPECT_EQ_STR("example.com/rate/test-0000", names[0]);
+  for (size_t i = 1; i < names_num; i++) {
+    char want[DATA_MAX_NAME_LEN];
+    ssnprintf(want, sizeof(want), "example.com/test/test-%04d", (int)i - 1);
+    EXPECT_EQ_STR(want, names[i]);
+    EXPECT_EQ_UINT64(TIME_T_TO_CDTIME_T(100), times[i]);
+  }
+  for (size_t i = 0; i < names_num; i++)
+    sfree(names[i]);
+  sfree(names);
+  sfree(times);
+
+  uc_iter_t *iter = uc_get_iterator();
+  CHECK_NOT_NULL(iter);
+
+  size_t iter_num = 0;
+  char *name = NULL;
+  while (uc_iterator_next(iter, &name) == 0) {
+    OK(name != NULL);
+    iter_num++;
+  }
+  uc_iterator_destroy(iter);
+  EXPECT_EQ_INT(NAMES_NUM + 1, iter_num);
+
+  return 0;
+}
+
+DEF_TEST(timeout) {
+  extern cdtime_t cdtime_mock;
+  int found_num = 0;
+
+  /* Enough entries to force every shard to grow, with every other entry
+   * expiring, so that removal has to keep probe sequences intact. */
+  for (int i = 0; i < 5000; i++) {
+    value_list_t vl = VALUE_LIST_INIT;
+    value_t value = {.derive = i};
+    set_vl(&vl, &value, i, TIME_T_TO_CDTIME_T(100));
+    sstrncpy(vl.plugin, "timeout", sizeof(vl.plugin));
+    vl.interval = TIME_T_TO_CDTIME_T((i % 2) ? 1 : 1000);
+    CHECK_ZERO(uc_update(&ds_test, &vl));
+  }
+  EXPECT_EQ_INT(NAMES_NUM + 1 + 5000, uc_get_size());
+
+  /* Entries with an interval of one second expire, all others don't. */
+  cdtime_mock += TIME_T_TO_CDTIME_T(10);
+  CHECK_ZERO(uc_check_timeout());
+  EXPECT_EQ_INT(NAMES_NUM + 1 + 2500, uc_get_size());
+
+  for (int i = 0; i < 5000; i++) {
+    value_list_t vl = VALUE_LIST_INIT;
+    value_t value = {.derive = i};
+    set_vl(&vl, &value, i, TIME_T_TO_CDTIME_T(100));
+    sstrncpy(vl.plugin, "timeout", sizeof(vl.plugin));
+
+    value_t *got = uc_get_value(&ds_test, &vl);
+    if ((got != NULL) && ((i % 2) == 0) && (got[0].derive == i))
+      found_num++;
+    else if ((got != NULL) || ((i % 2) == 0))
+      found_num = -1;
+    sfree(got);
+    if (found_num < 0)
+      break;
+  }
+  EXPECT_EQ_INT(2500, found_num);
+
+  return 0;
+}
+
+int main(void) {
+  CHECK_ZERO(uc_init());
+
+  RUN_TEST(update_and_rate);
+  RUN_TEST(names_and_iterator);
+  RUN_TEST(timeout);
+
+  END_TEST;
+}
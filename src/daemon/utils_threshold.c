@@ -63,50 +63,216 @@ threshold_t *threshold_get(const char *hostname, const char *plugin,
     return NULL;
 } /* }}} threshold_t *threshold_get */
 
+/*
+ * Threshold index
+ * ===============
+ * Thresholds are indexed by type, then by plugin, then by host, the empty
+ * string acting as the wildcard on the plugin and host levels. Each leaf holds
+ * the threshold lists which only differ in their plugin and type instance.
+ * Keys point into the threshold_t at the head of each list, which lives as
+ * long as threshold_tree does.
+ * {{{ */
+typedef struct threshold_leaf_s {
+  threshold_t **heads;
+  size_t heads_num;
+} threshold_leaf_t;
+
+static c_avl_tree_t *threshold_index = NULL;
+
+static c_avl_tree_t *threshold_index_subtree(c_avl_tree_t *tree,
+                                             const char *key) {
+  c_avl_tree_t *subtree = NULL;
+
+  if (c_avl_get(tree, key, (void *)&subtree) == 0)
+    return subtree;
+
+  char *key_copy = strdup(key);
+  if (key_copy == NULL)
+    return NULL;
+
+  subtree = c_avl_create((int (*)(const void *, const void *))strcmp);
+  if (subtree == NULL) {
+    sfree(key_copy);
+    return NULL;
+  }
+
+  if (c_avl_insert(tree, key_copy, subtree) != 0) {
+    c_avl_destroy(subtree);
+    sfree(key_copy);
+    return NULL;
+  }
+
+  return subtree;
+} /* c_avl_tree_t *threshold_index_subtree */
+
+/*
+ * int threshold_index_insert
+ *
+ * Adds the head of a threshold list to the index used by "threshold_search".
+ * Must be called with "threshold_lock" held whenever a new list is inserted
+ * into "threshold_tree". Returns zero on success, non-zero otherwise.
+ */
+int threshold_index_insert(threshold_t *th) { /* {{{ */
+  c_avl_tree_t *plugins;
+  c_avl_tree_t *hosts;
+  threshold_leaf_t *leaf = NULL;
+  threshold_t **tmp;
+
+  if (th == NULL)
+    return EINVAL;
+
+  if (threshold_index == NULL) {
+    threshold_index =
+        c_avl_create((int (*)(const void *, const void *))strcmp);
+    if (threshold_index == NULL)
+      return ENOMEM;
+  }
+
+  plugins = threshold_index_subtree(threshold_index, th->type);
+  if (plugins == NULL)
+    return ENOMEM;
+
+  hosts = threshold_index_subtree(plugins, th->plugin);
+  if (hosts == NULL)
+    return ENOMEM;
+
+  if (c_avl_get(hosts, th->host, (void *)&leaf) != 0) {
+    char *host = strdup(th->host);
+    leaf = calloc(1, sizeof(*leaf));
+    if ((host == NULL) || (leaf == NULL)) {
+      sfree(host);
+      sfree(leaf);
+      return ENOMEM;
+    }
+
+    if (c_avl_insert(hosts, host, leaf) != 0) {
+      sfree(host);
+      sfree(leaf);
+      return ENOMEM;
+    }
+  }
+
+  tmp = realloc(leaf->heads, sizeof(*leaf->heads) * (leaf->heads_num + 1));
+  if (tmp == NULL)
+    return ENOMEM;
+  leaf->heads = tmp;
+  leaf->heads[leaf->heads_num] = th;
+  leaf->heads_num++;
+
+  return 0;
+} /* }}} int threshold_index_insert */
+
+/*
+ * void threshold_index_destroy
+ *
+ * Frees the index, but not the thresholds it points to. Must be called with
+ * "threshold_lock" held before the threshold lists in "threshold_tree" are
+ * freed.
+ */
+void threshold_index_destroy(void) { /* {{{ */
+  char *type;
+  c_avl_tree_t *plugins;
+
+  if (threshold_index == NULL)
+    return;
+
+  while (c_avl_pick(threshold_index, (void *)&type, (void *)&plugins) == 0) {
+    char *plugin;
+    c_avl_tree_t *hosts;
+
+    while (c_avl_pick(plugins, (void *)&plugin, (void *)&hosts) == 0) {
+      char *host;
+      threshold_leaf_t *leaf;
+
+      while (c_avl_pick(hosts, (void *)&host, (void *)&leaf) == 0) {
+        sfree(host);
+        sfree(leaf->heads);
+        sfree(leaf);
+      }
+      c_avl_destroy(hosts);
+      sfree(plugin);
+    }
+    c_avl_destroy(plugins);
+    sfree(type);
+  }
+
+  c_avl_destroy(threshold_index);
+  threshold_index = NULL;
+} /* }}} void threshold_index_destroy */
+
+/* Returns the most specific threshold list of a leaf matching "vl". A list
+ * with both instances set is preferred over one with only the plugin instance
+ * set, which is preferred over one with only the type instance set. */
+static threshold_t *threshold_leaf_search(const threshold_leaf_t *leaf,
+                                          const value_list_t *vl) {
+  threshold_t *best = NULL;
+  int best_score = -1;
+
+  if (leaf == NULL)
+    return NULL;
+
+  for (size_t i = 0; i < leaf->heads_num; i++) {
+    threshold_t *th = leaf->heads[i];
+    int score = 0;
+
+    if (th->plugin_instance[0] != 0) {
+      if (strcmp(th->plugin_instance, vl->plugin_instance) != 0)
+        continue;
+      score |= 2;
+    }
+
+    if (th->type_instance[0] != 0) {
+      if (strcmp(th->type_instance, vl->type_instance) != 0)
+        continue;
+      score |= 1;
+    }
+
+    if (score > best_score) {
+      best = th;
+      best_score = score;
+      if (score == 3)
+        break;
+    }
+  }
+
+  return best;
+} /* threshold_t *threshold_leaf_search */
+/* }}} */
+
 /*
  * threshold_t *threshold_search
  *
  * Searches for a threshold configuration using all the possible variations of
- * "Host", "Plugin" and "Type" blocks. Returns NULL if no threshold could be
- * found.
- * XXX: This is likely the least efficient function in collectd.
+ * "Host", "Plugin" and "Type" blocks. A threshold for the host is preferred
+ * over a global one, then a threshold for the plugin is preferred over one for
+ * the type alone. Returns NULL if no threshold could be found.
  */
 threshold_t *threshold_search(const value_list_t *vl) { /* {{{ */
-  threshold_t *th;
+  c_avl_tree_t *plugins = NULL;
+  c_avl_tree_t *hosts[2] = {NULL, NULL};
+  const char *host_keys[2] = {vl->host, ""};
 
-  if ((th = threshold_get(vl->host, vl->plugin, vl->plugin_instance, vl->type,
-                          vl->type_instance)) != NULL)
-    return th;
-  else if ((th = threshold_get(vl->host, vl->plugin, vl->plugin_instance,
-                               vl->type, NULL)) != NULL)
-    return th;
-  else if ((th = threshold_get(vl->host, vl->plugin, NULL, vl->type,
-                               vl->type_instance)) != NULL)
-    return th;
-  else if ((th = threshold_get(vl->host, vl->plugin, NULL, vl->type, NULL)) !=
-           NULL)
-    return th;
-  else if ((th = threshold_get(vl->host, "", NULL, vl->type,
-                               vl->type_instance)) != NULL)
-    return th;
-  else if ((th = threshold_get(vl->host, "", NULL, vl->type, NULL)) != NULL)
-    return th;
-  else if ((th = threshold_get("", vl->plugin, vl->plugin_instance, vl->type,
-                               vl->type_instance)) != NULL)
-    return th;
-  else if ((th = threshold_get("", vl->plugin, vl->plugin_instance, vl->type,
-                               NULL)) != NULL)
-    return th;
-  else if ((th = threshold_get("", vl->plugin, NULL, vl->type,
-                               vl->type_instance)) != NULL)
-    return th;
-  else if ((th = threshold_get("", vl->plugin, NULL, vl->type, NULL)) != NULL)
-    return th;
-  else if ((th = threshold_get("", "", NULL, vl->type, vl->type_instance)) !=
-           NULL)
-    return th;
-  else if ((th = threshold_get("", "", NULL, vl->type, NULL)) != NULL)
-    return th;
+  if ((threshold_index == NULL) ||
+      (c_avl_get(threshold_index, vl->type, (void *)&plugins) != 0))
+    return NULL;
+
+  c_avl_get(plugins, vl->plugin, (void *)&hosts[0]);
+  c_avl_get(plugins, "", (void *)&hosts[1]);
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(host_keys); i++) {
+    for (size_t j = 0; j < STATIC_ARRAY_SIZE(hosts); j++) {
+      threshold_leaf_t *leaf = NULL;
+      threshold_t *th;
+
+      if ((hosts[j] == NULL) ||
+          (c_avl_get(hosts[j], host_keys[i], (void *)&leaf) != 0))
+        continue;
+
+      th = threshold_leaf_search(leaf, vl);
+      if (th != NULL)
+        return th;
+    }
+  }
 
   return NULL;
 } /* }}} threshold_t *threshold_search */
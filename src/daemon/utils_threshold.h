@@ -56,6 +56,9 @@ threshold_t *threshold_get(const char *hostname, const char *plugin,
                            const char *plugin_instance, const char *type,
                            const char *type_instance);
 
+int threshold_index_insert(threshold_t *th);
+void threshold_index_destroy(void);
+
 threshold_t *threshold_search(const value_list_t *vl);
 
 int ut_search_threshold(const value_list_t *vl, threshold_t *ret_threshold);
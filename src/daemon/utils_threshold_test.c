@@ -0,0 +1,134 @@
+/**
+ * collectd - src/daemon/utils_threshold_test.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "plugin.h"
+#include "testing.h"
+#include "utils/avltree/avltree.h"
+#include "utils/common/common.h"
+#include "utils_threshold.h"
+
+/* Thresholds in increasing order of precedence, i.e. each one is preferred
+ * over all the ones before it when looking up "host/cpu-0/cpu-idle". */
+static threshold_t thresholds[] = {
+    {.type = "cpu"},
+    {.type = "cpu", .type_instance = "idle"},
+    {.plugin = "cpu", .type = "cpu"},
+    {.plugin = "cpu", .type = "cpu", .type_instance = "idle"},
+    {.plugin = "cpu", .plugin_instance = "0", .type = "cpu"},
+    {.plugin = "cpu",
+     .plugin_instance = "0",
+     .type = "cpu",
+     .type_instance = "idle"},
+    {.host = "host", .type = "cpu"},
+    {.host = "host", .type = "cpu", .type_instance = "idle"},
+    {.host = "host", .plugin = "cpu", .type = "cpu"},
+    {.host = "host", .plugin = "cpu", .type = "cpu", .type_instance = "idle"},
+    {.host = "host", .plugin = "cpu", .plugin_instance = "0", .type = "cpu"},
+    {.host = "host",
+     .plugin = "cpu",
+     .plugin_instance = "0",
+     .type = "cpu",
+     .type_instance = "idle"},
+};
+
+static value_list_t make_vl(char const *host, char const *plugin,
+                            char const *plugin_instance, char const *type,
+                            char const *type_instance) {
+  value_list_t vl = VALUE_LIST_INIT;
+
+  sstrncpy(vl.host, host, sizeof(vl.host));
+  sstrncpy(vl.plugin, plugin, sizeof(vl.plugin));
+  sstrncpy(vl.plugin_instance, plugin_instance, sizeof(vl.plugin_instance));
+  sstrncpy(vl.type, type, sizeof(vl.type));
+  sstrncpy(vl.type_instance, type_instance, sizeof(vl.type_instance));
+
+  return vl;
+}
+
+DEF_TEST(precedence) {
+  value_list_t vl = make_vl("host", "cpu", "0", "cpu", "idle");
+
+  EXPECT_EQ_PTR(NULL, threshold_search(&vl));
+
+  /* Every threshold added is more specific than the ones before. */
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(thresholds); i++) {
+    CHECK_ZERO(threshold_index_insert(thresholds + i));
+    EXPECT_EQ_PTR(thresholds + i, threshold_search(&vl));
+  }
+
+  threshold_index_destroy();
+  EXPECT_EQ_PTR(NULL, threshold_search(&vl));
+
+  /* The same, inserted in reverse order. */
+  for (size_t i = STATIC_ARRAY_SIZE(thresholds); i > 0; i--) {
+    CHECK_ZERO(threshold_index_insert(thresholds + i - 1));
+    EXPECT_EQ_PTR(thresholds + STATIC_ARRAY_SIZE(thresholds) - 1,
+                  threshold_search(&vl));
+  }
+
+  threshold_index_destroy();
+  return 0;
+}
+
+DEF_TEST(fallback) {
+  struct {
+    value_list_t vl;
+    threshold_t *want;
+  } cases[] = {
+      {make_vl("host", "cpu", "0", "cpu", "idle"), thresholds + 11},
+      {make_vl("host", "cpu", "0", "cpu", "user"), thresholds + 10},
+      {make_vl("host", "cpu", "1", "cpu", "idle"), thresholds + 9},
+      {make_vl("host", "cpu", "1", "cpu", "user"), thresholds + 8},
+      {make_vl("host", "other", "0", "cpu", "idle"), thresholds + 7},
+      {make_vl("host", "other", "0", "cpu", "user"), thresholds + 6},
+      {make_vl("other", "cpu", "0", "cpu", "idle"), thresholds + 5},
+      {make_vl("other", "cpu", "0", "cpu", "user"), thresholds + 4},
+      {make_vl("other", "cpu", "1", "cpu", "idle"), thresholds + 3},
+      {make_vl("other", "cpu", "1", "cpu", "user"), thresholds + 2},
+      {make_vl("other", "other", "0", "cpu", "idle"), thresholds + 1},
+      {make_vl("other", "other", "0", "cpu", "user"), thresholds + 0},
+      {make_vl("host", "cpu", "0", "memory", "idle"), NULL},
+  };
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(thresholds); i++)
+    CHECK_ZERO(threshold_index_insert(thresholds + i));
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
+    printf("## Case %" PRIsz ": %s/%s-%s/%s-%s\n", i, cases[i].vl.host,
+           cases[i].vl.plugin, cases[i].vl.plugin_instance, cases[i].vl.type,
+           cases[i].vl.type_instance);
+    EXPECT_EQ_PTR(cases[i].want, threshold_search(&cases[i].vl));
+  }
+
+  threshold_index_destroy();
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(precedence);
+  RUN_TEST(fallback);
+
+  END_TEST;
+}
@@ -900,6 +900,72 @@ int lcc_listval(lcc_connection_t *c, /* {{{ */
   return 0;
 } /* }}} int lcc_listval */
 
+int lcc_readstats(lcc_connection_t *c, size_t limit, /* {{{ */
+                  lcc_read_stats_t **ret_stats, size_t *ret_stats_num) {
+  char command[64];
+  lcc_response_t res;
+  lcc_read_stats_t *stats;
+  int status;
+
+  if (c == NULL)
+    return -1;
+
+  if ((ret_stats == NULL) || (ret_stats_num == NULL)) {
+    lcc_set_errno(c, EINVAL);
+    return -1;
+  }
+
+  snprintf(command, sizeof(command), "READSTATS %" PRIu64, (uint64_t)limit);
+
+  status = lcc_sendreceive(c, command, &res);
+  if (status != 0)
+    return status;
+
+  if (res.status != 0) {
+    LCC_SET_ERRSTR(c, "Server error: %s", res.message);
+    lcc_response_free(&res);
+    return -1;
+  }
+
+  stats = calloc(res.lines_num + 1, sizeof(*stats));
+  if (stats == NULL) {
+    lcc_response_free(&res);
+    lcc_set_errno(c, ENOMEM);
+    return -1;
+  }
+
+  /* <calls> <exec avg> <exec pct> <exec max> <lag avg> <lag pct> <lag max>
+   * <name> */
+  for (size_t i = 0; i < res.lines_num; i++) {
+    lcc_read_stats_t *s = stats + i;
+    int name_offset = 0;
+
+    status = sscanf(res.lines[i], "%" SCNu64 " %lf %lf %lf %lf %lf %lf %n",
+                    &s->calls, &s->exec_average, &s->exec_percentile,
+                    &s->exec_max, &s->lag_average, &s->lag_percentile,
+                    &s->lag_max, &name_offset);
+    if ((status != 7) || (res.lines[i][name_offset] == 0)) {
+      lcc_set_errno(c, EILSEQ);
+      status = -1;
+      break;
+    }
+    SSTRCPY(s->name, res.lines[i] + name_offset);
+    status = 0;
+  }
+
+  if (status != 0) {
+    free(stats);
+    lcc_response_free(&res);
+    return -1;
+  }
+
+  *ret_stats = stats;
+  *ret_stats_num = res.lines_num;
+
+  lcc_response_free(&res);
+  return 0;
+} /* }}} int lcc_readstats */
+
 const char *lcc_strerror(lcc_connection_t *c) /* {{{ */
 {
   if (c == NULL)
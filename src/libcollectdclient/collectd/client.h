@@ -72,6 +72,11 @@ int lcc_flush(lcc_connection_t *c, const char *plugin, lcc_identifier_t *ident,
 int lcc_listval(lcc_connection_t *c, lcc_identifier_t **ret_ident,
                 size_t *ret_ident_num);
 
+/* Returns the "limit" read callbacks with the highest average execution time,
+ * or all of them if "limit" is zero. */
+int lcc_readstats(lcc_connection_t *c, size_t limit,
+                  lcc_read_stats_t **ret_stats, size_t *ret_stats_num);
+
 /* TODO: putnotif */
 
 const char *lcc_strerror(lcc_connection_t *c);
@@ -84,6 +84,20 @@ typedef struct lcc_value_list_s lcc_value_list_t;
 #define LCC_VALUE_LIST_INIT                                                    \
   { NULL, NULL, 0, 0, 0, LCC_IDENTIFIER_INIT }
 
+/* Execution time and scheduling lag of one read callback of the daemon, as
+ * returned by the READSTATS command. All times are in seconds. */
+struct lcc_read_stats_s {
+  char name[LCC_NAME_LEN];
+  uint64_t calls;
+  double exec_average;
+  double exec_percentile;
+  double exec_max;
+  double lag_average;
+  double lag_percentile;
+  double lag_max;
+};
+typedef struct lcc_read_stats_s lcc_read_stats_t;
+
 /* lcc_value_list_writer_t is a write callback to which value lists are
  * dispatched. */
 typedef int (*lcc_value_list_writer_t)(lcc_value_list_t const *);
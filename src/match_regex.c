@@ -34,6 +34,7 @@
 #include "collectd.h"
 
 #include "filter_chain.h"
+#include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
 #include "utils/metadata/meta_data.h"
 #include "utils_llist.h"
@@ -67,8 +68,42 @@ struct mr_match_s {
   mr_regex_t *type_instance;
   llist_t *meta; /* Maps each meta key into mr_regex_t* */
   bool invert;
+
+  /* Index into the decision cache entries, see below. */
+  size_t index;
 };
 
+/*
+ * Decision cache
+ *
+ * Maps identifiers to the outcome of each regex match, so the regular
+ * expressions are only evaluated once per identifier. The outcome of the match
+ * with index "i" is stored in two bits of "results". Matches with "MetaData"
+ * expressions don't use the cache, since meta data may change while the
+ * identifier does not. The cache is cleared whenever a match is destroyed and
+ * when it holds MR_CACHE_SIZE_MAX identifiers, so that identifiers which are
+ * no longer seen don't occupy it forever.
+ */
+#ifndef MR_CACHE_SIZE_MAX
+#define MR_CACHE_SIZE_MAX 1048576
+#endif
+
+#define MR_CACHE_UNKNOWN 0
+#define MR_CACHE_MATCHES 1
+#define MR_CACHE_NO_MATCH 2
+
+struct mr_cache_entry_s;
+typedef struct mr_cache_entry_s mr_cache_entry_t;
+struct mr_cache_entry_s {
+  size_t results_size;
+  uint8_t *results;
+};
+
+static c_avl_tree_t *mr_cache;
+static size_t mr_cache_size;
+static size_t mr_match_num;
+static pthread_rwlock_t mr_cache_lock = PTHREAD_RWLOCK_INITIALIZER;
+
 /*
  * internal helper functions
  */
@@ -128,6 +163,145 @@ static int mr_match_regexen(mr_regex_t *re_head, /* {{{ */
   return FC_MATCH_MATCHES;
 } /* }}} int mr_match_regexen */
 
+/* Cache keys are the five parts of the identifier, each terminated by a null
+ * byte. Returns the size of the key. */
+static size_t mr_cache_key(char *buffer, const value_list_t *vl) /* {{{ */
+{
+  const char *parts[] = {vl->host, vl->plugin, vl->plugin_instance, vl->type,
+                         vl->type_instance};
+  size_t offset = 0;
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(parts); i++) {
+    size_t len = strlen(parts[i]) + 1;
+    memcpy(buffer + offset, parts[i], len);
+    offset += len;
+  }
+
+  return offset;
+} /* }}} size_t mr_cache_key */
+
+static int mr_cache_key_compare(const void *a_ptr, const void *b_ptr) /* {{{ */
+{
+  const char *a = a_ptr;
+  const char *b = b_ptr;
+
+  for (size_t i = 0; i < 5; i++) {
+    int status = strcmp(a, b);
+    if (status != 0)
+      return status;
+
+    a += strlen(a) + 1;
+    b += strlen(b) + 1;
+  }
+
+  return 0;
+} /* }}} int mr_cache_key_compare */
+
+/* mr_cache_lock must be held for writing when calling this function. */
+static void mr_cache_clear(void) /* {{{ */
+{
+  void *key;
+  void *value;
+
+  if (mr_cache == NULL)
+    return;
+
+  while (c_avl_pick(mr_cache, &key, &value) == 0) {
+    mr_cache_entry_t *entry = value;
+
+    sfree(key);
+    sfree(entry->results);
+    sfree(entry);
+  }
+  mr_cache_size = 0;
+} /* }}} void mr_cache_clear */
+
+/* Returns the cached outcome of the match for this identifier, or -1 if it is
+ * not known yet. */
+static int mr_cache_get(const mr_match_t *m, const value_list_t *vl) /* {{{ */
+{
+  char key[5 * DATA_MAX_NAME_LEN];
+  mr_cache_entry_t *entry = NULL;
+  int state = MR_CACHE_UNKNOWN;
+
+  mr_cache_key(key, vl);
+
+  pthread_rwlock_rdlock(&mr_cache_lock);
+  if ((mr_cache != NULL) &&
+      (c_avl_get(mr_cache, key, (void *)&entry) == 0) &&
+      ((m->index / 4) < entry->results_size))
+    state = (entry->results[m->index / 4] >> (2 * (m->index % 4))) & 0x03;
+  pthread_rwlock_unlock(&mr_cache_lock);
+
+  if (state == MR_CACHE_MATCHES)
+    return FC_MATCH_MATCHES;
+  else if (state == MR_CACHE_NO_MATCH)
+    return FC_MATCH_NO_MATCH;
+  return -1;
+} /* }}} int mr_cache_get */
+
+static void mr_cache_put(const mr_match_t *m, const value_list_t *vl, /* {{{ */
+                         int result) {
+  char key[5 * DATA_MAX_NAME_LEN];
+  mr_cache_entry_t *entry = NULL;
+  size_t key_size;
+  size_t results_size = (m->index / 4) + 1;
+  int state =
+      (result == FC_MATCH_MATCHES) ? MR_CACHE_MATCHES : MR_CACHE_NO_MATCH;
+
+  key_size = mr_cache_key(key, vl);
+
+  pthread_rwlock_wrlock(&mr_cache_lock);
+
+  if (mr_cache == NULL)
+    mr_cache = c_avl_create(mr_cache_key_compare);
+  if (mr_cache == NULL) {
+    pthread_rwlock_unlock(&mr_cache_lock);
+    return;
+  }
+
+  if (c_avl_get(mr_cache, key, (void *)&entry) != 0) {
+    char *key_copy;
+
+    if (mr_cache_size >= MR_CACHE_SIZE_MAX)
+      mr_cache_clear();
+
+    entry = calloc(1, sizeof(*entry));
+    key_copy = malloc(key_size);
+    if ((entry == NULL) || (key_copy == NULL)) {
+      pthread_rwlock_unlock(&mr_cache_lock);
+      sfree(entry);
+      sfree(key_copy);
+      return;
+    }
+    memcpy(key_copy, key, key_size);
+
+    if (c_avl_insert(mr_cache, key_copy, entry) != 0) {
+      pthread_rwlock_unlock(&mr_cache_lock);
+      sfree(entry);
+      sfree(key_copy);
+      return;
+    }
+    mr_cache_size++;
+  }
+
+  if (entry->results_size < results_size) {
+    uint8_t *tmp = realloc(entry->results, results_size);
+    if (tmp == NULL) {
+      pthread_rwlock_unlock(&mr_cache_lock);
+      return;
+    }
+    memset(tmp + entry->results_size, 0, results_size - entry->results_size);
+    entry->results = tmp;
+    entry->results_size = results_size;
+  }
+
+  entry->results[m->index / 4] &= ~(0x03 << (2 * (m->index % 4)));
+  entry->results[m->index / 4] |= state << (2 * (m->index % 4));
+
+  pthread_rwlock_unlock(&mr_cache_lock);
+} /* }}} void mr_cache_put */
+
 static int mr_add_regex(mr_regex_t **re_head, const char *re_str, /* {{{ */
                         const char *option) {
   mr_regex_t *re;
@@ -295,30 +469,32 @@ static int mr_create(const oconfig_item_t *ci, void **user_data) /* {{{ */
     return status;
   }
 
+  pthread_rwlock_wrlock(&mr_cache_lock);
+  m->index = mr_match_num;
+  mr_match_num++;
+  pthread_rwlock_unlock(&mr_cache_lock);
+
   *user_data = m;
   return 0;
 } /* }}} int mr_create */
 
 static int mr_destroy(void **user_data) /* {{{ */
 {
+  /* Cached outcomes may refer to this match's index. */
+  pthread_rwlock_wrlock(&mr_cache_lock);
+  mr_cache_clear();
+  pthread_rwlock_unlock(&mr_cache_lock);
+
   if ((user_data != NULL) && (*user_data != NULL))
     mr_free_match(*user_data);
   return 0;
 } /* }}} int mr_destroy */
 
-static int mr_match(const data_set_t __attribute__((unused)) * ds, /* {{{ */
-                    const value_list_t *vl,
-                    notification_meta_t __attribute__((unused)) * *meta,
-                    void **user_data) {
-  mr_match_t *m;
+static int mr_match_uncached(const mr_match_t *m, /* {{{ */
+                             const value_list_t *vl) {
   int match_value = FC_MATCH_MATCHES;
   int nomatch_value = FC_MATCH_NO_MATCH;
 
-  if ((user_data == NULL) || (*user_data == NULL))
-    return -1;
-
-  m = *user_data;
-
   if (m->invert) {
     match_value = FC_MATCH_NO_MATCH;
     nomatch_value = FC_MATCH_MATCHES;
@@ -355,13 +531,65 @@ static int mr_match(const data_set_t __attribute__((unused)) * ds, /* {{{ */
   }
 
   return match_value;
+} /* }}} int mr_match_uncached */
+
+static int mr_match(const data_set_t __attribute__((unused)) * ds, /* {{{ */
+                    const value_list_t *vl,
+                    notification_meta_t __attribute__((unused)) * *meta,
+                    void **user_data) {
+  mr_match_t *m;
+  int status;
+
+  if ((user_data == NULL) || (*user_data == NULL))
+    return -1;
+
+  m = *user_data;
+
+  if (m->meta != NULL)
+    return mr_match_uncached(m, vl);
+
+  status = mr_cache_get(m, vl);
+  if (status >= 0)
+    return status;
+
+  status = mr_match_uncached(m, vl);
+  mr_cache_put(m, vl, status);
+
+  return status;
 } /* }}} int mr_match */
 
+/* Only the "Plugin" and "Type" regular expressions are considered here, all
+ * others are assumed to match. */
+static int mr_prefilter(const char *plugin, const char *type, /* {{{ */
+                        void **user_data) {
+  mr_match_t *m;
+
+  if ((user_data == NULL) || (*user_data == NULL))
+    return FC_MATCH_MATCHES;
+
+  m = *user_data;
+
+  bool matches = (mr_match_regexen(m->plugin, plugin) == FC_MATCH_MATCHES) &&
+                 (mr_match_regexen(m->type, type) == FC_MATCH_MATCHES);
+
+  if (!m->invert)
+    return matches ? FC_MATCH_MATCHES : FC_MATCH_NO_MATCH;
+
+  /* An inverted match can only be ruled out if there are no other regular
+   * expressions which might not match. */
+  if (matches && (m->host == NULL) && (m->plugin_instance == NULL) &&
+      (m->type_instance == NULL) && (m->meta == NULL))
+    return FC_MATCH_NO_MATCH;
+
+  return FC_MATCH_MATCHES;
+} /* }}} int mr_prefilter */
+
 void module_register(void) {
   match_proc_t mproc = {0};
 
   mproc.create = mr_create;
   mproc.destroy = mr_destroy;
   mproc.match = mr_match;
+  mproc.prefilter = mr_prefilter;
   fc_register_match("regex", mproc);
 } /* module_register */
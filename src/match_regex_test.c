@@ -0,0 +1,134 @@
+/**
+ * collectd - src/match_regex_test.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "match_regex.c" /* (sic) */
+
+#include "testing.h"
+
+/* The filter chain is not linked into this test. */
+int fc_register_match(__attribute__((unused)) const char *name,
+                      __attribute__((unused)) match_proc_t proc) {
+  return 0;
+}
+
+static char const *hosts[] = {"alpha", "beta", "gamma"};
+static char const *plugins[] = {"cpu", "interface", "memory", "cpufreq"};
+static char const *types[] = {"cpu", "if_octets", "if_errors", "memory"};
+static char const *type_instances[] = {"", "idle", "user", "rx"};
+
+static int create_match(char const *key, char const *regex, void **ret) {
+  oconfig_value_t value = {.value.string = (char *)regex,
+                           .type = OCONFIG_TYPE_STRING};
+  oconfig_item_t child = {.key = (char *)key,
+                          .values = &value,
+                          .values_num = 1};
+  oconfig_item_t ci = {.key = "Match", .children = &child, .children_num = 1};
+
+  return mr_create(&ci, ret);
+}
+
+DEF_TEST(cache) {
+  struct {
+    char const *key;
+    char const *regex;
+    void *user_data;
+  } cases[] = {
+      {"Plugin", "^cpu$", NULL},
+      {"Type", "^if_", NULL},
+      {"Host", "^(alpha|gamma)$", NULL},
+      {"TypeInstance", "^$", NULL},
+  };
+  size_t identifiers_num = STATIC_ARRAY_SIZE(hosts) *
+                           STATIC_ARRAY_SIZE(plugins) *
+                           STATIC_ARRAY_SIZE(types) *
+                           STATIC_ARRAY_SIZE(type_instances);
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++)
+    CHECK_ZERO(create_match(cases[i].key, cases[i].regex, &cases[i].user_data));
+
+  /* The first pass fills the cache, the second one is answered from it. */
+  for (int pass = 0; pass < 2; pass++) {
+    for (size_t h = 0; h < STATIC_ARRAY_SIZE(hosts); h++)
+      for (size_t p = 0; p < STATIC_ARRAY_SIZE(plugins); p++)
+        for (size_t t = 0; t < STATIC_ARRAY_SIZE(types); t++)
+          for (size_t ti = 0; ti < STATIC_ARRAY_SIZE(type_instances); ti++) {
+            value_list_t vl = VALUE_LIST_INIT;
+
+            sstrncpy(vl.host, hosts[h], sizeof(vl.host));
+            sstrncpy(vl.plugin, plugins[p], sizeof(vl.plugin));
+            sstrncpy(vl.type, types[t], sizeof(vl.type));
+            sstrncpy(vl.type_instance, type_instances[ti],
+                     sizeof(vl.type_instance));
+
+            for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
+              int want = mr_match_uncached(cases[i].user_data, &vl);
+              int got = mr_match(NULL, &vl, NULL, &cases[i].user_data);
+              EXPECT_EQ_INT(want, got);
+              EXPECT_EQ_INT(want, mr_cache_get(cases[i].user_data, &vl));
+            }
+          }
+
+    EXPECT_EQ_UINT64(identifiers_num, mr_cache_size);
+  }
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++)
+    mr_destroy(&cases[i].user_data);
+  EXPECT_EQ_UINT64(0, mr_cache_size);
+
+  return 0;
+}
+
+DEF_TEST(cache_full) {
+  void *user_data = NULL;
+  value_list_t vl = VALUE_LIST_INIT;
+
+  CHECK_ZERO(create_match("Plugin", "^cpu$", &user_data));
+
+  sstrncpy(vl.host, "alpha", sizeof(vl.host));
+  sstrncpy(vl.plugin, "cpu", sizeof(vl.plugin));
+  sstrncpy(vl.type, "cpu", sizeof(vl.type));
+  EXPECT_EQ_INT(FC_MATCH_MATCHES, mr_match(NULL, &vl, NULL, &user_data));
+  EXPECT_EQ_INT(FC_MATCH_MATCHES, mr_cache_get(user_data, &vl));
+
+  /* Pretend the cache is full: the next new identifier clears it. */
+  mr_cache_size = MR_CACHE_SIZE_MAX;
+  sstrncpy(vl.host, "beta", sizeof(vl.host));
+  EXPECT_EQ_INT(FC_MATCH_MATCHES, mr_match(NULL, &vl, NULL, &user_data));
+  EXPECT_EQ_UINT64(1, mr_cache_size);
+  EXPECT_EQ_INT(FC_MATCH_MATCHES, mr_cache_get(user_data, &vl));
+
+  sstrncpy(vl.host, "alpha", sizeof(vl.host));
+  EXPECT_EQ_INT(-1, mr_cache_get(user_data, &vl));
+
+  mr_destroy(&user_data);
+  EXPECT_EQ_UINT64(0, mr_cache_size);
+
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(cache);
+  RUN_TEST(cache_full);
+
+  END_TEST;
+}
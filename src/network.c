@@ -24,6 +24,7 @@
 
 #define _DEFAULT_SOURCE
 #define _BSD_SOURCE /* For struct ip_mreq */
+#define _GNU_SOURCE /* For recvmmsg */
 
 #include "collectd.h"
 
@@ -252,15 +253,91 @@ struct part_encryption_aes256_s {
 };
 typedef struct part_encryption_aes256_s part_encryption_aes256_t;
 
+/* Maximum number of packets read with one system call. */
+#ifndef RECEIVE_BATCH_MAX
+#define RECEIVE_BATCH_MAX 64
+#endif
+
+typedef struct receive_thread_s receive_thread_t;
+
 struct receive_list_entry_s {
   char *data;
   int data_len;
-  int fd;
+  sockent_t *se;
   struct sockaddr_storage sender;
+  /* The receive thread owning the packet buffer. */
+  receive_thread_t *owner;
   struct receive_list_entry_s *next;
 };
 typedef struct receive_list_entry_s receive_list_entry_t;
 
+struct receive_list_s {
+  receive_list_entry_t *head;
+  receive_list_entry_t *tail;
+  uint64_t length;
+};
+typedef struct receive_list_s receive_list_t;
+
+/* Packets are parsed and dispatched by DispatchThreads threads, each with its
+ * own receive list. Receive threads choose the dispatch thread by hashing the
+ * sender address, so packets of one sender are dispatched in order. */
+struct dispatch_thread_s {
+  pthread_t id;
+  bool running;
+  /* Tells the thread to exit once its receive list is empty, see
+   * dispatch_threads_destroy(). */
+  bool stop;
+
+  receive_list_t list;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+
+  /* Values of a values part are decoded into this buffer, which can hold as
+   * many values as fit into one packet. */
+  value_t *values;
+  size_t values_size;
+
+  /* Written by the dispatch thread only, see the stats_* variables below. */
+  derive_t values_dispatched;
+  derive_t values_not_dispatched;
+#if HAVE_GCRYPT_H
+  /* Used to decrypt packets, since the socket's handle can't be shared. */
+  gcry_cipher_hd_t cypher;
+#endif
+};
+typedef struct dispatch_thread_s dispatch_thread_t;
+
+/* Each receive thread polls its own set of sockets. When ReceiveThreads is
+ * greater than one, every unicast address is bound once per thread using
+ * SO_REUSEPORT, so that the kernel distributes packets between the threads.
+ * Packets are read in batches into a fixed number of preallocated buffers,
+ * which are passed on to the dispatch thread and returned to the owning
+ * thread once parsed. If no buffer is available, packets are dropped. */
+struct receive_thread_s {
+  pthread_t id;
+  bool running;
+
+  struct pollfd *pollfd;
+  sockent_t **pollfd_se;
+  size_t pollfd_num;
+
+  receive_list_entry_t *entries;
+  char *buffers;
+  char *drop_buffer;
+  /* One list of received packets per dispatch thread. */
+  receive_list_t *private_lists;
+  /* Only accessed by the receive thread. */
+  receive_list_entry_t *free_head;
+  /* Entries returned by the dispatch thread. */
+  receive_list_entry_t *returned_head;
+  pthread_mutex_t returned_lock;
+
+  /* Written by the receive thread only, see the stats_* variables below. */
+  derive_t octets;
+  derive_t packets;
+  derive_t dropped;
+};
+
 /*
  * Private variables
  */
@@ -269,26 +346,26 @@ static int network_config_ttl;
 static size_t network_config_packet_size = 1452;
 static bool network_config_forward;
 static bool network_config_stats;
+static size_t network_config_receive_threads = 1;
+static size_t network_config_receive_queue_length = 1024;
+static size_t network_config_dispatch_threads = 1;
 
 static sockent_t *sending_sockets;
 
-static receive_list_entry_t *receive_list_head;
-static receive_list_entry_t *receive_list_tail;
-static pthread_mutex_t receive_list_lock = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t receive_list_cond = PTHREAD_COND_INITIALIZER;
-static uint64_t receive_list_length;
-
 static sockent_t *listen_sockets;
-static struct pollfd *listen_sockets_pollfd;
 static size_t listen_sockets_num;
 
 /* The receive and dispatch threads will run as long as `listen_loop' is set to
  * zero. */
 static int listen_loop;
-static int receive_thread_running;
-static pthread_t receive_thread_id;
-static int dispatch_thread_running;
-static pthread_t dispatch_thread_id;
+static receive_thread_t *receive_threads;
+static size_t receive_threads_num;
+static dispatch_thread_t *dispatch_threads;
+static size_t dispatch_threads_num;
+/* Points to the calling thread's dispatch_thread_t. Not set when parsing
+ * packets outside of a dispatch thread, e.g. in the unit tests. */
+static pthread_key_t dispatch_thread_key;
+static bool dispatch_thread_key_initialized;
 
 /* Buffer in which to-be-sent network packets are constructed. */
 static char *send_buffer;
@@ -304,9 +381,7 @@ static pthread_mutex_t send_buffer_lock = PTHREAD_MUTEX_INITIALIZER;
  * example). Only if neither is true, the stats_lock is acquired. The counters
  * are always read without holding a lock in the hope that writing 8 bytes to
  * memory is an atomic operation. */
-static derive_t stats_octets_rx;
 static derive_t stats_octets_tx;
-static derive_t stats_packets_rx;
 static derive_t stats_packets_tx;
 static derive_t stats_values_dispatched;
 static derive_t stats_values_not_dispatched;
@@ -393,51 +468,35 @@ static bool check_send_notify_okay(const notification_t *n) /* {{{ */
   return !received;
 } /* }}} bool check_send_notify_okay */
 
-static int network_dispatch_values(value_list_t *vl, /* {{{ */
-                                   const char *username,
-                                   struct sockaddr_storage *address) {
-  int status;
-
-  if ((vl->time == 0) || (strlen(vl->host) == 0) || (strlen(vl->plugin) == 0) ||
-      (strlen(vl->type) == 0))
-    return -EINVAL;
-
-  if (!check_receive_okay(vl)) {
-#if COLLECT_DEBUG
-    char name[6 * DATA_MAX_NAME_LEN];
-    FORMAT_VL(name, sizeof(name), vl);
-    name[sizeof(name) - 1] = '\0';
-    DEBUG("network plugin: network_dispatch_values: "
-          "NOT dispatching %s.",
-          name);
-#endif
-    stats_values_not_dispatched++;
-    return 0;
-  }
-
-  assert(vl->meta == NULL);
-
-  vl->meta = meta_data_create();
-  if (vl->meta == NULL) {
+static dispatch_thread_t *network_get_dispatch_thread(void) /* {{{ */
+{
+  if (!dispatch_thread_key_initialized)
+    return NULL;
+  return pthread_getspecific(dispatch_thread_key);
+} /* }}} dispatch_thread_t *network_get_dispatch_thread */
+
+/* Creates the meta data attached to all values received in one packet. */
+static meta_data_t *network_create_meta(const char *username, /* {{{ */
+                                        struct sockaddr_storage *address) {
+  meta_data_t *meta = meta_data_create();
+  if (meta == NULL) {
     ERROR("network plugin: meta_data_create failed.");
-    return -ENOMEM;
+    return NULL;
   }
 
-  status = meta_data_add_boolean(vl->meta, "network:received", 1);
+  int status = meta_data_add_boolean(meta, "network:received", 1);
   if (status != 0) {
     ERROR("network plugin: meta_data_add_boolean failed.");
-    meta_data_destroy(vl->meta);
-    vl->meta = NULL;
-    return status;
+    meta_data_destroy(meta);
+    return NULL;
   }
 
   if (username != NULL) {
-    status = meta_data_add_string(vl->meta, "network:username", username);
+    status = meta_data_add_string(meta, "network:username", username);
     if (status != 0) {
       ERROR("network plugin: meta_data_add_string failed.");
-      meta_data_destroy(vl->meta);
-      vl->meta = NULL;
-      return status;
+      meta_data_destroy(meta);
+      return NULL;
     }
   }
 
@@ -448,26 +507,73 @@ static int network_dispatch_values(value_list_t *vl, /* {{{ */
                          NULL, 0, NI_NUMERICHOST | NI_NUMERICSERV);
     if (status != 0) {
       ERROR("network plugin: getnameinfo failed: %s", gai_strerror(status));
-      meta_data_destroy(vl->meta);
-      vl->meta = NULL;
-      return status;
+      meta_data_destroy(meta);
+      return NULL;
     }
 
-    status = meta_data_add_string(vl->meta, "network:ip_address", host);
+    status = meta_data_add_string(meta, "network:ip_address", host);
     if (status != 0) {
       ERROR("network plugin: meta_data_add_string failed.");
-      meta_data_destroy(vl->meta);
-      vl->meta = NULL;
-      return status;
+      meta_data_destroy(meta);
+      return NULL;
     }
   }
 
-  plugin_dispatch_values(vl);
-  stats_values_dispatched++;
+  return meta;
+} /* }}} meta_data_t *network_create_meta */
 
-  meta_data_destroy(vl->meta);
+/* Dispatches a value list pointing into the packet being parsed. The meta
+ * data is created for the first value of a packet and shared by the
+ * following ones: plugin_dispatch_values() doesn't modify it and makes a copy
+ * when enqueueing the value. */
+static int network_dispatch_values(value_list_t *vl, /* {{{ */
+                                   meta_data_t **meta, const char *username,
+                                   struct sockaddr_storage *address) {
+  if ((vl->time == 0) || (strlen(vl->host) == 0) || (strlen(vl->plugin) == 0) ||
+      (strlen(vl->type) == 0))
+    return -EINVAL;
+
+  if (!check_receive_okay(vl)) {
+#if COLLECT_DEBUG
+    char name[6 * DATA_MAX_NAME_LEN];
+    FORMAT_VL(name, sizeof(name), vl);
+    name[sizeof(name) - 1] = '\0';
+    DEBUG("network plugin: network_dispatch_values: "
+          "NOT dispatching %s.",
+          name);
+#endif
+    dispatch_thread_t *dt = network_get_dispatch_thread();
+    if (dt != NULL) {
+      dt->values_not_dispatched++;
+    } else {
+      pthread_mutex_lock(&stats_lock);
+      stats_values_not_dispatched++;
+      pthread_mutex_unlock(&stats_lock);
+    }
+    return 0;
+  }
+
+  assert(vl->meta == NULL);
+
+  if (*meta == NULL) {
+    *meta = network_create_meta(username, address);
+    if (*meta == NULL)
+      return -ENOMEM;
+  }
+
+  vl->meta = *meta;
+  plugin_dispatch_values(vl);
   vl->meta = NULL;
 
+  dispatch_thread_t *dt = network_get_dispatch_thread();
+  if (dt != NULL) {
+    dt->values_dispatched++;
+  } else {
+    pthread_mutex_lock(&stats_lock);
+    stats_values_dispatched++;
+    pthread_mutex_unlock(&stats_lock);
+  }
+
   return 0;
 } /* }}} int network_dispatch_values */
 
@@ -547,7 +653,8 @@ static gcry_cipher_hd_t network_get_aes256_cypher(sockent_t *se, /* {{{ */
   } else {
     char *secret;
 
-    cyper_ptr = &se->data.server.cypher;
+    dispatch_thread_t *dt = network_get_dispatch_thread();
+    cyper_ptr = (dt != NULL) ? &dt->cypher : &se->data.server.cypher;
 
     if (username == NULL)
       return NULL;
@@ -761,8 +868,11 @@ static int write_part_string(char **ret_buffer, size_t *ret_buffer_len,
   return 0;
 } /* int write_part_string */
 
+/* Decodes a values part directly from the packet into `values', which holds
+ * `values_size' elements. */
 static int parse_part_values(void **ret_buffer, size_t *ret_buffer_len,
-                             value_t **ret_values, size_t *ret_num_values) {
+                             value_t *values, size_t values_size,
+                             size_t *ret_num_values) {
   char *buffer = *ret_buffer;
   size_t buffer_len = *ret_buffer_len;
 
@@ -774,7 +884,6 @@ static int parse_part_values(void **ret_buffer, size_t *ret_buffer_len,
   size_t pkg_numval;
 
   uint8_t *pkg_types;
-  value_t *pkg_values;
 
   if (buffer_len < 15) {
     NOTICE("network plugin: packet is too short: "
@@ -816,44 +925,43 @@ static int parse_part_values(void **ret_buffer, size_t *ret_buffer_len,
     return -1;
   }
 
-  pkg_types = calloc(pkg_numval, sizeof(*pkg_types));
-  pkg_values = calloc(pkg_numval, sizeof(*pkg_values));
-  if ((pkg_types == NULL) || (pkg_values == NULL)) {
-    sfree(pkg_types);
-    sfree(pkg_values);
-    ERROR("network plugin: parse_part_values: calloc failed.");
+  if (pkg_numval > values_size) {
+    ERROR("network plugin: parse_part_values: "
+          "Values buffer holds %" PRIsz " values, but the packet "
+          "contains %" PRIsz ".",
+          values_size, pkg_numval);
     return -1;
   }
 
-  memcpy(pkg_types, buffer, pkg_numval * sizeof(*pkg_types));
+  /* The types are read in place, the values need to be copied because they
+   * are not aligned. */
+  pkg_types = (uint8_t *)buffer;
   buffer += pkg_numval * sizeof(*pkg_types);
-  memcpy(pkg_values, buffer, pkg_numval * sizeof(*pkg_values));
-  buffer += pkg_numval * sizeof(*pkg_values);
+  memcpy(values, buffer, pkg_numval * sizeof(*values));
+  buffer += pkg_numval * sizeof(*values);
 
   for (size_t i = 0; i < pkg_numval; i++) {
     switch (pkg_types[i]) {
     case DS_TYPE_COUNTER:
-      pkg_values[i].counter = (counter_t)ntohll(pkg_values[i].counter);
+      values[i].counter = (counter_t)ntohll(values[i].counter);
       break;
 
     case DS_TYPE_GAUGE:
-      pkg_values[i].gauge = (gauge_t)ntohd(pkg_values[i].gauge);
+      values[i].gauge = (gauge_t)ntohd(values[i].gauge);
       break;
 
     case DS_TYPE_DERIVE:
-      pkg_values[i].derive = (derive_t)ntohll(pkg_values[i].derive);
+      values[i].derive = (derive_t)ntohll(values[i].derive);
       break;
 
     case DS_TYPE_ABSOLUTE:
-      pkg_values[i].absolute = (absolute_t)ntohll(pkg_values[i].absolute);
+      values[i].absolute = (absolute_t)ntohll(values[i].absolute);
       break;
 
     default:
       NOTICE("network plugin: parse_part_values: "
              "Don't know how to handle data source type %" PRIu8,
              pkg_types[i]);
-      sfree(pkg_types);
-      sfree(pkg_values);
       return -1;
     } /* switch (pkg_types[i]) */
   }
@@ -861,9 +969,6 @@ static int parse_part_values(void **ret_buffer, size_t *ret_buffer_len,
   *ret_buffer = buffer;
   *ret_buffer_len = buffer_len - pkg_length;
   *ret_num_values = pkg_numval;
-  *ret_values = pkg_values;
-
-  sfree(pkg_types);
 
   return 0;
 } /* int parse_part_values */
@@ -971,19 +1076,19 @@ static int parse_part_string(void **ret_buffer, size_t *ret_buffer_len,
     return -1;
   }
 
-  /* All sanity checks successfull, let's copy the data over */
-  memcpy((void *)output, (void *)buffer, payload_size);
-  buffer += payload_size;
-
   /* For some very weird reason '\0' doesn't do the trick on SPARC in
    * this statement. */
-  if (output[payload_size - 1] != 0) {
+  if (buffer[payload_size - 1] != 0) {
     WARNING("network plugin: parse_part_string: "
             "Received string does not end "
             "with a NULL-byte.");
     return -1;
   }
 
+  /* All sanity checks successfull, let's copy the data over */
+  memcpy((void *)output, (void *)buffer, payload_size);
+  buffer += payload_size;
+
   *ret_buffer = buffer;
   *ret_buffer_len = buffer_len - pkg_length;
 
@@ -1342,8 +1447,28 @@ static int parse_packet(sockent_t *se, /* {{{ */
                         struct sockaddr_storage *address) {
   int status;
 
+  /* The identifier parts are copied into `vl' and the values decoded into
+   * the dispatch thread's buffer, so that dispatching a value doesn't
+   * require any allocation until it is enqueued. Notifications take their
+   * identifier from `vl', too. */
   value_list_t vl = VALUE_LIST_INIT;
   notification_t n = {0};
+  meta_data_t *meta = NULL;
+
+  value_t *values;
+  size_t values_size;
+  dispatch_thread_t *dt = network_get_dispatch_thread();
+  if (dt != NULL) {
+    values = dt->values;
+    values_size = dt->values_size;
+  } else {
+    values_size = buffer_size / 9;
+    values = calloc(values_size + 1, sizeof(*values));
+    if (values == NULL) {
+      ERROR("network plugin: parse_packet: calloc failed.");
+      return ENOMEM;
+    }
+  }
 
 #if HAVE_GCRYPT_H
   int packet_was_signed = (flags & PP_SIGNED);
@@ -1421,28 +1546,24 @@ static int parse_packet(sockent_t *se, /* {{{ */
     }
 #endif /* HAVE_GCRYPT_H */
     else if (pkg_type == TYPE_VALUES) {
-      status =
-          parse_part_values(&buffer, &buffer_size, &vl.values, &vl.values_len);
+      status = parse_part_values(&buffer, &buffer_size, values, values_size,
+                                 &vl.values_len);
       if (status != 0)
         break;
 
-      network_dispatch_values(&vl, username, address);
-
-      sfree(vl.values);
+      vl.values = values;
+      network_dispatch_values(&vl, &meta, username, address);
+      vl.values = NULL;
     } else if (pkg_type == TYPE_TIME) {
       uint64_t tmp = 0;
       status = parse_part_number(&buffer, &buffer_size, &tmp);
-      if (status == 0) {
+      if (status == 0)
         vl.time = TIME_T_TO_CDTIME_T(tmp);
-        n.time = TIME_T_TO_CDTIME_T(tmp);
-      }
     } else if (pkg_type == TYPE_TIME_HR) {
       uint64_t tmp = 0;
       status = parse_part_number(&buffer, &buffer_size, &tmp);
-      if (status == 0) {
+      if (status == 0)
         vl.time = (cdtime_t)tmp;
-        n.time = (cdtime_t)tmp;
-      }
     } else if (pkg_type == TYPE_INTERVAL) {
       uint64_t tmp = 0;
       status = parse_part_number(&buffer, &buffer_size, &tmp);
@@ -1456,33 +1577,30 @@ static int parse_packet(sockent_t *se, /* {{{ */
     } else if (pkg_type == TYPE_HOST) {
       status =
           parse_part_string(&buffer, &buffer_size, vl.host, sizeof(vl.host));
-      if (status == 0)
-        sstrncpy(n.host, vl.host, sizeof(n.host));
     } else if (pkg_type == TYPE_PLUGIN) {
       status = parse_part_string(&buffer, &buffer_size, vl.plugin,
                                  sizeof(vl.plugin));
-      if (status == 0)
-        sstrncpy(n.plugin, vl.plugin, sizeof(n.plugin));
     } else if (pkg_type == TYPE_PLUGIN_INSTANCE) {
       status = parse_part_string(&buffer, &buffer_size, vl.plugin_instance,
                                  sizeof(vl.plugin_instance));
-      if (status == 0)
-        sstrncpy(n.plugin_instance, vl.plugin_instance,
-                 sizeof(n.plugin_instance));
     } else if (pkg_type == TYPE_TYPE) {
       status =
           parse_part_string(&buffer, &buffer_size, vl.type, sizeof(vl.type));
-      if (status == 0)
-        sstrncpy(n.type, vl.type, sizeof(n.type));
     } else if (pkg_type == TYPE_TYPE_INSTANCE) {
       status = parse_part_string(&buffer, &buffer_size, vl.type_instance,
                                  sizeof(vl.type_instance));
-      if (status == 0)
-        sstrncpy(n.type_instance, vl.type_instance, sizeof(n.type_instance));
     } else if (pkg_type == TYPE_MESSAGE) {
       status = parse_part_string(&buffer, &buffer_size, n.message,
                                  sizeof(n.message));
 
+      n.time = vl.time;
+      sstrncpy(n.host, vl.host, sizeof(n.host));
+      sstrncpy(n.plugin, vl.plugin, sizeof(n.plugin));
+      sstrncpy(n.plugin_instance, vl.plugin_instance,
+               sizeof(n.plugin_instance));
+      sstrncpy(n.type, vl.type, sizeof(n.type));
+      sstrncpy(n.type_instance, vl.type_instance, sizeof(n.type_instance));
+
       if (status != 0) {
         /* do nothing */
       } else if ((n.severity != NOTIF_FAILURE) &&
@@ -1520,6 +1638,10 @@ static int parse_packet(sockent_t *se, /* {{{ */
     WARNING("network plugin: parse_packet: Received truncated "
             "packet, try increasing `MaxPacketSize'");
 
+  meta_data_destroy(meta);
+  if (dt == NULL)
+    sfree(values);
+
   return status;
 } /* }}} int parse_packet */
 
@@ -1750,8 +1872,21 @@ static int network_bind_socket_to_addr(sockent_t *se,
   return 0;
 } /* int network_bind_socket_to_addr */
 
+static bool network_addr_is_multicast(const struct addrinfo *ai) /* {{{ */
+{
+  if (ai->ai_family == AF_INET) {
+    struct sockaddr_in *addr = (struct sockaddr_in *)ai->ai_addr;
+    return IN_MULTICAST(ntohl(addr->sin_addr.s_addr));
+  } else if (ai->ai_family == AF_INET6) {
+    struct sockaddr_in6 *addr = (struct sockaddr_in6 *)ai->ai_addr;
+    return IN6_IS_ADDR_MULTICAST(&addr->sin6_addr);
+  }
+
+  return false;
+} /* }}} bool network_addr_is_multicast */
+
 static int network_bind_socket(int fd, const struct addrinfo *ai,
-                               const int interface_idx) {
+                               const int interface_idx, bool reuse_port) {
 #if KERNEL_SOLARIS
   char loop = 0;
 #else
@@ -1764,6 +1899,18 @@ static int network_bind_socket(int fd, const struct addrinfo *ai,
     return -1;
   }
 
+#ifdef SO_REUSEPORT
+  /* let the kernel distribute packets between the receive threads */
+  if (reuse_port &&
+      (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &(int){1}, sizeof(int)) ==
+       -1)) {
+    ERROR("network plugin: setsockopt (reuseport): %s", STRERRNO);
+    return -1;
+  }
+#else
+  assert(!reuse_port);
+#endif
+
   DEBUG("fd = %i; calling `bind'", fd);
 
   if (bind(fd, ai->ai_addr, ai->ai_addrlen) == -1) {
@@ -2116,32 +2263,41 @@ static int sockent_server_listen(sockent_t *se) /* {{{ */
 
   for (struct addrinfo *ai_ptr = ai_list; ai_ptr != NULL;
        ai_ptr = ai_ptr->ai_next) {
-    int *tmp;
+    /* Open one socket per receive thread. Multicast packets are delivered to
+     * every socket bound to the group, so one socket is used for those. */
+    size_t sockets_num = network_config_receive_threads;
+    if (network_addr_is_multicast(ai_ptr))
+      sockets_num = 1;
+
+    for (size_t i = 0; i < sockets_num; i++) {
+      int *tmp;
+
+      tmp = realloc(se->data.server.fd,
+                    sizeof(*tmp) * (se->data.server.fd_num + 1));
+      if (tmp == NULL) {
+        ERROR("network plugin: realloc failed.");
+        break;
+      }
+      se->data.server.fd = tmp;
+      tmp = se->data.server.fd + se->data.server.fd_num;
 
-    tmp = realloc(se->data.server.fd,
-                  sizeof(*tmp) * (se->data.server.fd_num + 1));
-    if (tmp == NULL) {
-      ERROR("network plugin: realloc failed.");
-      continue;
-    }
-    se->data.server.fd = tmp;
-    tmp = se->data.server.fd + se->data.server.fd_num;
+      *tmp =
+          socket(ai_ptr->ai_family, ai_ptr->ai_socktype, ai_ptr->ai_protocol);
+      if (*tmp < 0) {
+        ERROR("network plugin: socket(2) failed: %s", STRERRNO);
+        break;
+      }
 
-    *tmp = socket(ai_ptr->ai_family, ai_ptr->ai_socktype, ai_ptr->ai_protocol);
-    if (*tmp < 0) {
-      ERROR("network plugin: socket(2) failed: %s", STRERRNO);
-      continue;
-    }
+      status = network_bind_socket(*tmp, ai_ptr, se->interface,
+                                   /* reuse_port = */ sockets_num > 1);
+      if (status != 0) {
+        close(*tmp);
+        *tmp = -1;
+        break;
+      }
 
-    status = network_bind_socket(*tmp, ai_ptr, se->interface);
-    if (status != 0) {
-      close(*tmp);
-      *tmp = -1;
-      continue;
+      se->data.server.fd_num++;
     }
-
-    se->data.server.fd_num++;
-    continue;
   } /* for (ai_list) */
 
   freeaddrinfo(ai_list);
@@ -2160,24 +2316,6 @@ static int sockent_add(sockent_t *se) /* {{{ */
     return -1;
 
   if (se->type == SOCKENT_TYPE_SERVER) {
-    struct pollfd *tmp;
-
-    tmp = realloc(listen_sockets_pollfd,
-                  sizeof(*tmp) * (listen_sockets_num + se->data.server.fd_num));
-    if (tmp == NULL) {
-      ERROR("network plugin: realloc failed.");
-      return -1;
-    }
-    listen_sockets_pollfd = tmp;
-    tmp = listen_sockets_pollfd + listen_sockets_num;
-
-    for (size_t i = 0; i < se->data.server.fd_num; i++) {
-      memset(tmp + i, 0, sizeof(*tmp));
-      tmp[i].fd = se->data.server.fd[i];
-      tmp[i].events = POLLIN | POLLPRI;
-      tmp[i].revents = 0;
-    }
-
     listen_sockets_num += se->data.server.fd_num;
 
     if (listen_sockets == NULL) {
@@ -2201,81 +2339,216 @@ static int sockent_add(sockent_t *se) /* {{{ */
   return 0;
 } /* }}} int sockent_add */
 
-static void *dispatch_thread(void __attribute__((unused)) * arg) /* {{{ */
+/* Returns a packet buffer to the receive thread owning it. */
+static void receive_list_entry_release(receive_list_entry_t *ent) /* {{{ */
 {
+  receive_thread_t *rt = ent->owner;
+
+  pthread_mutex_lock(&rt->returned_lock);
+  ent->next = rt->returned_head;
+  rt->returned_head = ent;
+  pthread_mutex_unlock(&rt->returned_lock);
+} /* }}} void receive_list_entry_release */
+
+static void *dispatch_thread(void *arg) /* {{{ */
+{
+  dispatch_thread_t *dt = arg;
+
+  pthread_setspecific(dispatch_thread_key, dt);
+
   while (42) {
     receive_list_entry_t *ent;
-    sockent_t *se;
 
     /* Lock and wait for more data to come in */
-    pthread_mutex_lock(&receive_list_lock);
-    while ((listen_loop == 0) && (receive_list_head == NULL))
-      pthread_cond_wait(&receive_list_cond, &receive_list_lock);
+    pthread_mutex_lock(&dt->lock);
+    while ((listen_loop == 0) && !dt->stop && (dt->list.head == NULL))
+      pthread_cond_wait(&dt->cond, &dt->lock);
 
-    /* Remove the head entry and unlock */
-    ent = receive_list_head;
-    if (ent != NULL)
-      receive_list_head = ent->next;
-    receive_list_length--;
-    pthread_mutex_unlock(&receive_list_lock);
+    /* Take all queued entries and unlock */
+    ent = dt->list.head;
+    dt->list.head = NULL;
+    dt->list.tail = NULL;
+    dt->list.length = 0;
+    pthread_mutex_unlock(&dt->lock);
 
     /* Check whether we are supposed to exit. We do NOT check `listen_loop'
      * because we dispatch all missing packets before shutting down. */
     if (ent == NULL)
       break;
 
-    /* Look for the correct `sockent_t' */
-    se = listen_sockets;
-    while (se != NULL) {
-      size_t i;
+    while (ent != NULL) {
+      receive_list_entry_t *next = ent->next;
 
-      for (i = 0; i < se->data.server.fd_num; i++)
-        if (se->data.server.fd[i] == ent->fd)
-          break;
+      parse_packet(ent->se, ent->data, ent->data_len, /* flags = */ 0,
+                   /* username = */ NULL, &ent->sender);
+      receive_list_entry_release(ent);
+      ent = next;
+    }
+  } /* while (42) */
 
-      if (i < se->data.server.fd_num)
-        break;
+#if HAVE_GCRYPT_H
+  if (dt->cypher != NULL) {
+    gcry_cipher_close(dt->cypher);
+    dt->cypher = NULL;
+  }
+#endif
 
-      se = se->next;
-    }
+  return NULL;
+} /* }}} void *dispatch_thread */
 
-    if (se == NULL) {
-      ERROR("network plugin: Got packet from FD %i, but can't "
-            "find an appropriate socket entry.",
-            ent->fd);
-      sfree(ent->data);
-      sfree(ent);
-      continue;
+/* Appends a private list of received packets to the dispatch thread's
+ * receive list and resets it. Unless `block' is true, the packets are kept
+ * in the private list if the receive list is locked. */
+static void receive_list_append(dispatch_thread_t *dt, /* {{{ */
+                                receive_list_t *private_list, bool block) {
+  if (private_list->head == NULL)
+    return;
+
+  if (block)
+    pthread_mutex_lock(&dt->lock);
+  else if (pthread_mutex_trylock(&dt->lock) != 0)
+    return;
+
+  assert(((dt->list.head == NULL) && (dt->list.length == 0)) ||
+         ((dt->list.head != NULL) && (dt->list.length != 0)));
+
+  if (dt->list.head == NULL)
+    dt->list.head = private_list->head;
+  else
+    dt->list.tail->next = private_list->head;
+  dt->list.tail = private_list->tail;
+  dt->list.length += private_list->length;
+
+  pthread_cond_signal(&dt->cond);
+  pthread_mutex_unlock(&dt->lock);
+
+  *private_list = (receive_list_t){0};
+} /* }}} void receive_list_append */
+
+/* Returns the index of the dispatch thread handling packets from `sender'. */
+static size_t sender_dispatch_index(const struct sockaddr_storage *sender) /* {{{ */
+{
+  const unsigned char *addr = NULL;
+  size_t addr_len = 0;
+  uint16_t port = 0;
+
+  if (dispatch_threads_num == 1)
+    return 0;
+
+  if (sender->ss_family == AF_INET) {
+    const struct sockaddr_in *sa = (const struct sockaddr_in *)sender;
+    addr = (const unsigned char *)&sa->sin_addr;
+    addr_len = sizeof(sa->sin_addr);
+    port = sa->sin_port;
+  } else if (sender->ss_family == AF_INET6) {
+    const struct sockaddr_in6 *sa = (const struct sockaddr_in6 *)sender;
+    addr = (const unsigned char *)&sa->sin6_addr;
+    addr_len = sizeof(sa->sin6_addr);
+    port = sa->sin6_port;
+  }
+
+  /* FNV-1a */
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < addr_len; i++)
+    hash = (hash ^ addr[i]) * 16777619u;
+  hash = (hash ^ (port & 0xff)) * 16777619u;
+  hash = (hash ^ (port >> 8)) * 16777619u;
+
+  return (size_t)(hash % dispatch_threads_num);
+} /* }}} size_t sender_dispatch_index */
+
+/* Takes up to `entries_max' free packet buffers. Buffers returned by the
+ * dispatch thread are only collected once the local free list is empty. */
+static size_t receive_thread_get_entries(receive_thread_t *rt, /* {{{ */
+                                         receive_list_entry_t **entries,
+                                         size_t entries_max) {
+  if (rt->free_head == NULL) {
+    pthread_mutex_lock(&rt->returned_lock);
+    rt->free_head = rt->returned_head;
+    rt->returned_head = NULL;
+    pthread_mutex_unlock(&rt->returned_lock);
+  }
+
+  size_t entries_num = 0;
+  while ((entries_num < entries_max) && (rt->free_head != NULL)) {
+    entries[entries_num] = rt->free_head;
+    rt->free_head = rt->free_head->next;
+    entries_num++;
+  }
+
+  return entries_num;
+} /* }}} size_t receive_thread_get_entries */
+
+/* Reads up to `entries_num' packets from `fd' into `entries' without
+ * blocking. Returns the number of packets read or -1 on error. */
+static int receive_batch(int fd, receive_list_entry_t **entries, /* {{{ */
+                         size_t entries_num) {
+#if HAVE_RECVMMSG
+  struct mmsghdr msgs[RECEIVE_BATCH_MAX];
+  struct iovec iovs[RECEIVE_BATCH_MAX];
+
+  assert(entries_num <= RECEIVE_BATCH_MAX);
+  memset(msgs, 0, sizeof(*msgs) * entries_num);
+  for (size_t i = 0; i < entries_num; i++) {
+    iovs[i].iov_base = entries[i]->data;
+    iovs[i].iov_len = network_config_packet_size;
+    msgs[i].msg_hdr.msg_iov = iovs + i;
+    msgs[i].msg_hdr.msg_iovlen = 1;
+    msgs[i].msg_hdr.msg_name = &entries[i]->sender;
+    msgs[i].msg_hdr.msg_namelen = sizeof(entries[i]->sender);
+  }
+
+  int status = recvmmsg(fd, msgs, (unsigned int)entries_num, MSG_DONTWAIT,
+                        /* timeout = */ NULL);
+  if (status < 0)
+    return ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+               ? 0
+               : -1;
+
+  for (int i = 0; i < status; i++)
+    entries[i]->data_len = (int)msgs[i].msg_len;
+  return status;
+#else
+  size_t received = 0;
+  while (received < entries_num) {
+    receive_list_entry_t *ent = entries[received];
+    socklen_t length = sizeof(ent->sender);
+
+    ssize_t status = recvfrom(fd, ent->data, network_config_packet_size,
+                              MSG_DONTWAIT, (struct sockaddr *)&ent->sender,
+                              &length);
+    if (status < 0) {
+      if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+        break;
+      return -1;
     }
 
-    parse_packet(se, ent->data, ent->data_len, /* flags = */ 0,
-                 /* username = */ NULL, &ent->sender);
-    sfree(ent->data);
-    sfree(ent);
-  } /* while (42) */
+    ent->data_len = (int)status;
+    received++;
+  }
 
-  return NULL;
-} /* }}} void *dispatch_thread */
+  return (int)received;
+#endif
+} /* }}} int receive_batch */
 
-static int network_receive(void) /* {{{ */
+static int network_receive(receive_thread_t *rt) /* {{{ */
 {
-  char buffer[network_config_packet_size];
-  int buffer_len;
+  receive_list_entry_t *entries[RECEIVE_BATCH_MAX];
+  receive_list_entry_t *drop_entries[RECEIVE_BATCH_MAX];
+  receive_list_entry_t drop_entry = {.data = rt->drop_buffer, .owner = rt};
 
   int status = 0;
 
-  receive_list_entry_t *private_list_head;
-  receive_list_entry_t *private_list_tail;
-  uint64_t private_list_length;
+  /* Packets not yet handed to the dispatch threads, one list each. */
+  receive_list_t *private_lists = rt->private_lists;
 
-  assert(listen_sockets_num > 0);
+  assert(rt->pollfd_num > 0);
 
-  private_list_head = NULL;
-  private_list_tail = NULL;
-  private_list_length = 0;
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(drop_entries); i++)
+    drop_entries[i] = &drop_entry;
 
   while (listen_loop == 0) {
-    status = poll(listen_sockets_pollfd, listen_sockets_num, -1);
+    status = poll(rt->pollfd, rt->pollfd_num, -1);
     if (status <= 0) {
       if (errno == EINTR)
         continue;
@@ -2283,110 +2556,289 @@ static int network_receive(void) /* {{{ */
       break;
     }
 
-    for (size_t i = 0; (i < listen_sockets_num) && (status > 0); i++) {
-      receive_list_entry_t *ent;
-
-      if ((listen_sockets_pollfd[i].revents & (POLLIN | POLLPRI)) == 0)
+    for (size_t i = 0; (i < rt->pollfd_num) && (status > 0); i++) {
+      if ((rt->pollfd[i].revents & (POLLIN | POLLPRI)) == 0)
         continue;
       status--;
 
-      struct sockaddr_storage address;
-      socklen_t length = sizeof(address);
-      memset(&address, 0, length);
-      buffer_len =
-          recvfrom(listen_sockets_pollfd[i].fd, buffer, sizeof(buffer),
-                   0 /* no flags */, (struct sockaddr *)&address, &length);
-      if (buffer_len < 0) {
-        status = (errno != 0) ? errno : -1;
-        ERROR("network plugin: recv(2) failed: %s", STRERRNO);
-        break;
+      size_t entries_num =
+          receive_thread_get_entries(rt, entries, STATIC_ARRAY_SIZE(entries));
+
+      /* No buffers left: read the packets into the drop buffer so that the
+       * socket doesn't overflow, and count them. */
+      if (entries_num == 0) {
+        int received = receive_batch(rt->pollfd[i].fd, drop_entries,
+                                     STATIC_ARRAY_SIZE(drop_entries));
+        if (received < 0) {
+          status = (errno != 0) ? errno : -1;
+          ERROR("network plugin: recv(2) failed: %s", STRERRNO);
+          break;
+        }
+        rt->dropped += (derive_t)received;
+        continue;
       }
 
-      stats_octets_rx += ((uint64_t)buffer_len);
-      stats_packets_rx++;
-
-      /* TODO: Possible performance enhancement: Do not free
-       * these entries in the dispatch thread but put them in
-       * another list, so we don't have to allocate more and
-       * more of these structures. */
-      ent = calloc(1, sizeof(*ent));
-      if (ent == NULL) {
-        ERROR("network plugin: calloc failed.");
-        status = ENOMEM;
+      int received = receive_batch(rt->pollfd[i].fd, entries, entries_num);
+      if (received < 0) {
+        status = (errno != 0) ? errno : -1;
+        ERROR("network plugin: recv(2) failed: %s", STRERRNO);
         break;
       }
 
-      ent->data = malloc(network_config_packet_size);
-      if (ent->data == NULL) {
-        sfree(ent);
-        ERROR("network plugin: malloc failed.");
-        status = ENOMEM;
-        break;
-      }
-      ent->fd = listen_sockets_pollfd[i].fd;
-      ent->next = NULL;
+      for (size_t j = 0; j < entries_num; j++) {
+        receive_list_entry_t *ent = entries[j];
 
-      memcpy(ent->data, buffer, buffer_len);
-      ent->data_len = buffer_len;
-      memcpy(&ent->sender, &address, sizeof(ent->sender));
+        /* Put unused buffers back. */
+        if (j >= (size_t)received) {
+          ent->next = rt->free_head;
+          rt->free_head = ent;
+          continue;
+        }
 
-      if (private_list_head == NULL)
-        private_list_head = ent;
-      else
-        private_list_tail->next = ent;
-      private_list_tail = ent;
-      private_list_length++;
+        rt->octets += (derive_t)ent->data_len;
+        rt->packets++;
 
-      /* Do not block here. Blocking here has led to
-       * insufficient performance in the past. */
-      if (pthread_mutex_trylock(&receive_list_lock) == 0) {
-        assert(((receive_list_head == NULL) && (receive_list_length == 0)) ||
-               ((receive_list_head != NULL) && (receive_list_length != 0)));
+        ent->se = rt->pollfd_se[i];
+        ent->next = NULL;
 
-        if (receive_list_head == NULL)
-          receive_list_head = private_list_head;
+        receive_list_t *private_list =
+            private_lists + sender_dispatch_index(&ent->sender);
+        if (private_list->head == NULL)
+          private_list->head = ent;
         else
-          receive_list_tail->next = private_list_head;
-        receive_list_tail = private_list_tail;
-        receive_list_length += private_list_length;
-
-        pthread_cond_signal(&receive_list_cond);
-        pthread_mutex_unlock(&receive_list_lock);
-
-        private_list_head = NULL;
-        private_list_tail = NULL;
-        private_list_length = 0;
+          private_list->tail->next = ent;
+        private_list->tail = ent;
+        private_list->length++;
       }
 
+      /* Do not block here. Blocking here has led to
+       * insufficient performance in the past. */
+      for (size_t j = 0; j < dispatch_threads_num; j++)
+        receive_list_append(dispatch_threads + j, private_lists + j,
+                            /* block = */ false);
+
       status = 0;
-    } /* for (listen_sockets_pollfd) */
+    } /* for (rt->pollfd) */
 
     if (status != 0)
       break;
   } /* while (listen_loop == 0) */
 
   /* Make sure everything is dispatched before exiting. */
-  if (private_list_head != NULL) {
-    pthread_mutex_lock(&receive_list_lock);
-
-    if (receive_list_head == NULL)
-      receive_list_head = private_list_head;
-    else
-      receive_list_tail->next = private_list_head;
-    receive_list_tail = private_list_tail;
-    receive_list_length += private_list_length;
-
-    pthread_cond_signal(&receive_list_cond);
-    pthread_mutex_unlock(&receive_list_lock);
-  }
+  for (size_t i = 0; i < dispatch_threads_num; i++)
+    receive_list_append(dispatch_threads + i, private_lists + i,
+                        /* block = */ true);
 
   return status;
 } /* }}} int network_receive */
 
-static void *receive_thread(void __attribute__((unused)) * arg) {
-  return network_receive() ? (void *)1 : (void *)0;
+static void *receive_thread(void *arg) {
+  return network_receive(arg) ? (void *)1 : (void *)0;
 } /* void *receive_thread */
 
+static void receive_thread_destroy(receive_thread_t *rt) /* {{{ */
+{
+  sfree(rt->pollfd);
+  sfree(rt->pollfd_se);
+  sfree(rt->entries);
+  sfree(rt->buffers);
+  sfree(rt->drop_buffer);
+  sfree(rt->private_lists);
+  pthread_mutex_destroy(&rt->returned_lock);
+} /* }}} void receive_thread_destroy */
+
+/* Allocates the packet buffers of a receive thread. */
+static int receive_thread_init(receive_thread_t *rt) /* {{{ */
+{
+  size_t entries_num = network_config_receive_queue_length;
+
+  rt->entries = calloc(entries_num, sizeof(*rt->entries));
+  rt->buffers = calloc(entries_num, network_config_packet_size);
+  rt->drop_buffer = malloc(network_config_packet_size);
+  rt->private_lists = calloc(dispatch_threads_num, sizeof(*rt->private_lists));
+  if ((rt->entries == NULL) || (rt->buffers == NULL) ||
+      (rt->drop_buffer == NULL) || (rt->private_lists == NULL)) {
+    ERROR("network plugin: Allocating %" PRIsz " packet buffers failed.",
+          entries_num);
+    return ENOMEM;
+  }
+
+  for (size_t i = 0; i < entries_num; i++) {
+    receive_list_entry_t *ent = rt->entries + i;
+
+    ent->data = rt->buffers + (i * network_config_packet_size);
+    ent->owner = rt;
+    ent->next = rt->free_head;
+    rt->free_head = ent;
+  }
+
+  return 0;
+} /* }}} int receive_thread_init */
+
+/* Allocates the state of the dispatch threads without starting them. */
+static int dispatch_threads_init(void) /* {{{ */
+{
+  if (!dispatch_thread_key_initialized) {
+    int status = pthread_key_create(&dispatch_thread_key, NULL);
+    if (status != 0) {
+      ERROR("network plugin: pthread_key_create failed: %s", STRERROR(status));
+      return status;
+    }
+    dispatch_thread_key_initialized = true;
+  }
+
+  dispatch_threads = calloc(network_config_dispatch_threads,
+                            sizeof(*dispatch_threads));
+  if (dispatch_threads == NULL) {
+    ERROR("network plugin: calloc failed.");
+    return ENOMEM;
+  }
+
+  for (size_t i = 0; i < network_config_dispatch_threads; i++) {
+    dispatch_thread_t *dt = dispatch_threads + i;
+
+    pthread_mutex_init(&dt->lock, NULL);
+    pthread_cond_init(&dt->cond, NULL);
+    /* Only the initialized threads are cleaned up on failure. */
+    dispatch_threads_num = i + 1;
+
+    dt->values_size = network_config_packet_size / 9;
+    dt->values = calloc(dt->values_size, sizeof(*dt->values));
+    if (dt->values == NULL) {
+      ERROR("network plugin: calloc failed.");
+      return ENOMEM;
+    }
+  }
+
+  return 0;
+} /* }}} int dispatch_threads_init */
+
+/* Stops the dispatch threads once they have dispatched all queued packets and
+ * frees their state. */
+static void dispatch_threads_destroy(void) /* {{{ */
+{
+  for (size_t i = 0; i < dispatch_threads_num; i++) {
+    dispatch_thread_t *dt = dispatch_threads + i;
+
+    if (!dt->running)
+      continue;
+
+    INFO("network plugin: Stopping dispatch thread %" PRIsz ".", i);
+    pthread_mutex_lock(&dt->lock);
+    dt->stop = true;
+    pthread_cond_broadcast(&dt->cond);
+    pthread_mutex_unlock(&dt->lock);
+    pthread_join(dt->id, /* ret = */ NULL);
+    dt->running = false;
+  }
+
+  for (size_t i = 0; i < dispatch_threads_num; i++) {
+    pthread_mutex_destroy(&dispatch_threads[i].lock);
+    pthread_cond_destroy(&dispatch_threads[i].cond);
+    sfree(dispatch_threads[i].values);
+  }
+  sfree(dispatch_threads);
+  dispatch_threads_num = 0;
+} /* }}} void dispatch_threads_destroy */
+
+static int dispatch_threads_create(void) /* {{{ */
+{
+  int status = dispatch_threads_init();
+  if (status != 0) {
+    dispatch_threads_destroy();
+    return status;
+  }
+
+  for (size_t i = 0; i < dispatch_threads_num; i++) {
+    dispatch_thread_t *dt = dispatch_threads + i;
+    char name[32];
+
+    ssnprintf(name, sizeof(name), "network disp#%" PRIsz, i);
+    status = plugin_thread_create(&dt->id, dispatch_thread, dt, name);
+    if (status != 0) {
+      /* Packets of some senders would never be dispatched. */
+      ERROR("network: pthread_create failed: %s", STRERROR(status));
+      dispatch_threads_destroy();
+      return status;
+    }
+    dt->running = true;
+  }
+
+  return 0;
+} /* }}} int dispatch_threads_create */
+
+/* Distributes the listening sockets between the receive threads. The sockets
+ * bound to the same address are consecutive, so each thread gets one of
+ * them. */
+static int receive_threads_create(void) /* {{{ */
+{
+  receive_threads = calloc(network_config_receive_threads,
+                           sizeof(*receive_threads));
+  if (receive_threads == NULL) {
+    ERROR("network plugin: calloc failed.");
+    return ENOMEM;
+  }
+  receive_threads_num = network_config_receive_threads;
+
+  for (size_t i = 0; i < receive_threads_num; i++)
+    pthread_mutex_init(&receive_threads[i].returned_lock, NULL);
+
+  size_t fd_index = 0;
+  for (sockent_t *se = listen_sockets; se != NULL; se = se->next) {
+    for (size_t i = 0; i < se->data.server.fd_num; i++) {
+      receive_thread_t *rt = receive_threads + (fd_index % receive_threads_num);
+      fd_index++;
+
+      struct pollfd *tmp_pollfd =
+          realloc(rt->pollfd, sizeof(*tmp_pollfd) * (rt->pollfd_num + 1));
+      if (tmp_pollfd == NULL) {
+        ERROR("network plugin: realloc failed.");
+        return ENOMEM;
+      }
+      rt->pollfd = tmp_pollfd;
+
+      sockent_t **tmp_se =
+          realloc(rt->pollfd_se, sizeof(*tmp_se) * (rt->pollfd_num + 1));
+      if (tmp_se == NULL) {
+        ERROR("network plugin: realloc failed.");
+        return ENOMEM;
+      }
+      rt->pollfd_se = tmp_se;
+
+      rt->pollfd[rt->pollfd_num] = (struct pollfd){
+          .fd = se->data.server.fd[i],
+          .events = POLLIN | POLLPRI,
+      };
+      rt->pollfd_se[rt->pollfd_num] = se;
+      rt->pollfd_num++;
+    }
+  }
+
+  for (size_t i = 0; i < receive_threads_num; i++) {
+    receive_thread_t *rt = receive_threads + i;
+    char name[32];
+
+    /* Multicast groups are bound only once, so not every thread may have a
+     * socket to read from. */
+    if (rt->pollfd_num == 0)
+      continue;
+
+    int status = receive_thread_init(rt);
+    if (status != 0)
+      return status;
+
+    ssnprintf(name, sizeof(name), "network recv#%" PRIsz, i);
+    status = plugin_thread_create(&rt->id, receive_thread, rt, name);
+    if (status != 0) {
+      ERROR("network: pthread_create failed: %s", STRERRNO);
+      continue;
+    }
+    rt->running = true;
+  }
+
+  return 0;
+} /* }}} int receive_threads_create */
+
 static void network_init_buffer(void) {
   memset(send_buffer, 0, network_config_packet_size);
   send_buffer_ptr = send_buffer;
@@ -2833,6 +3285,61 @@ static int network_config_set_buffer_size(const oconfig_item_t *ci) /* {{{ */
   return 0;
 } /* }}} int network_config_set_buffer_size */
 
+static int network_config_set_receive_threads(const oconfig_item_t *ci) /* {{{ */
+{
+  int tmp = 0;
+
+  if (cf_util_get_int(ci, &tmp) != 0)
+    return -1;
+  else if (tmp < 1) {
+    WARNING("network plugin: `ReceiveThreads' must be at least 1.");
+    return -1;
+  }
+
+#ifndef SO_REUSEPORT
+  if (tmp > 1) {
+    WARNING("network plugin: `ReceiveThreads' greater than 1 requires "
+            "SO_REUSEPORT, which is not available on this system.");
+    return -1;
+  }
+#endif
+
+  network_config_receive_threads = (size_t)tmp;
+  return 0;
+} /* }}} int network_config_set_receive_threads */
+
+static int
+network_config_set_receive_queue_length(const oconfig_item_t *ci) /* {{{ */
+{
+  int tmp = 0;
+
+  if (cf_util_get_int(ci, &tmp) != 0)
+    return -1;
+  else if (tmp < RECEIVE_BATCH_MAX) {
+    WARNING("network plugin: `ReceiveQueueLength' must be at least %d.",
+            RECEIVE_BATCH_MAX);
+    return -1;
+  }
+
+  network_config_receive_queue_length = (size_t)tmp;
+  return 0;
+} /* }}} int network_config_set_receive_queue_length */
+
+static int network_config_set_dispatch_threads(const oconfig_item_t *ci) /* {{{ */
+{
+  int tmp = 0;
+
+  if (cf_util_get_int(ci, &tmp) != 0)
+    return -1;
+  else if (tmp < 1) {
+    WARNING("network plugin: `DispatchThreads' must be at least 1.");
+    return -1;
+  }
+
+  network_config_dispatch_threads = (size_t)tmp;
+  return 0;
+} /* }}} int network_config_set_dispatch_threads */
+
 #if HAVE_GCRYPT_H
 static int network_config_set_security_level(oconfig_item_t *ci, /* {{{ */
                                              int *retval) {
@@ -3024,6 +3531,8 @@ static int network_config(oconfig_item_t *ci) /* {{{ */
     oconfig_item_t *child = ci->children + i;
     if (strcasecmp("TimeToLive", child->key) == 0)
       network_config_set_ttl(child);
+    else if (strcasecmp("ReceiveThreads", child->key) == 0)
+      network_config_set_receive_threads(child);
   }
 
   for (int i = 0; i < ci->children_num; i++) {
@@ -3033,9 +3542,14 @@ static int network_config(oconfig_item_t *ci) /* {{{ */
       network_config_add_listen(child);
     else if (strcasecmp("Server", child->key) == 0)
       network_config_add_server(child);
-    else if (strcasecmp("TimeToLive", child->key) == 0) {
+    else if ((strcasecmp("TimeToLive", child->key) == 0) ||
+             (strcasecmp("ReceiveThreads", child->key) == 0)) {
       /* Handled earlier */
-    } else if (strcasecmp("MaxPacketSize", child->key) == 0)
+    } else if (strcasecmp("ReceiveQueueLength", child->key) == 0)
+      network_config_set_receive_queue_length(child);
+    else if (strcasecmp("DispatchThreads", child->key) == 0)
+      network_config_set_dispatch_threads(child);
+    else if (strcasecmp("MaxPacketSize", child->key) == 0)
       network_config_set_buffer_size(child);
     else if (strcasecmp("Forward", child->key) == 0)
       cf_util_get_boolean(child, &network_config_forward);
@@ -3120,25 +3634,29 @@ static int network_notification(const notification_t *n,
 static int network_shutdown(void) {
   listen_loop++;
 
-  /* Kill the listening thread */
-  if (receive_thread_running != 0) {
-    INFO("network plugin: Stopping receive thread.");
-    pthread_kill(receive_thread_id, SIGTERM);
-    pthread_join(receive_thread_id, NULL /* no return value */);
-    memset(&receive_thread_id, 0, sizeof(receive_thread_id));
-    receive_thread_running = 0;
-  }
+  /* Kill the listening threads */
+  for (size_t i = 0; i < receive_threads_num; i++) {
+    receive_thread_t *rt = receive_threads + i;
 
-  /* Shutdown the dispatching thread */
-  if (dispatch_thread_running != 0) {
-    INFO("network plugin: Stopping dispatch thread.");
-    pthread_mutex_lock(&receive_list_lock);
-    pthread_cond_broadcast(&receive_list_cond);
-    pthread_mutex_unlock(&receive_list_lock);
-    pthread_join(dispatch_thread_id, /* ret = */ NULL);
-    dispatch_thread_running = 0;
+    if (!rt->running)
+      continue;
+
+    INFO("network plugin: Stopping receive thread %" PRIsz ".", i);
+    pthread_kill(rt->id, SIGTERM);
+    pthread_join(rt->id, NULL /* no return value */);
+    memset(&rt->id, 0, sizeof(rt->id));
+    rt->running = false;
   }
 
+  /* Shutdown the dispatching threads */
+  dispatch_threads_destroy();
+
+  /* The packet buffers may only be freed once all packets are dispatched. */
+  for (size_t i = 0; i < receive_threads_num; i++)
+    receive_thread_destroy(receive_threads + i);
+  sfree(receive_threads);
+  receive_threads_num = 0;
+
   sockent_destroy(listen_sockets);
 
   if (send_buffer_fill > 0)
@@ -3172,15 +3690,26 @@ static int network_stats_read(void) /* {{{ */
   value_list_t vl = VALUE_LIST_INIT;
   value_t values[2];
 
-  copy_octets_rx = stats_octets_rx;
+  copy_octets_rx = 0;
+  copy_packets_rx = 0;
+  for (size_t i = 0; i < receive_threads_num; i++) {
+    copy_octets_rx += receive_threads[i].octets;
+    copy_packets_rx += receive_threads[i].packets;
+  }
   copy_octets_tx = stats_octets_tx;
-  copy_packets_rx = stats_packets_rx;
   copy_packets_tx = stats_packets_tx;
+  pthread_mutex_lock(&stats_lock);
   copy_values_dispatched = stats_values_dispatched;
   copy_values_not_dispatched = stats_values_not_dispatched;
+  pthread_mutex_unlock(&stats_lock);
   copy_values_sent = stats_values_sent;
   copy_values_not_sent = stats_values_not_sent;
-  copy_receive_list_length = receive_list_length;
+  copy_receive_list_length = 0;
+  for (size_t i = 0; i < dispatch_threads_num; i++) {
+    copy_values_dispatched += dispatch_threads[i].values_dispatched;
+    copy_values_not_dispatched += dispatch_threads[i].values_not_dispatched;
+    copy_receive_list_length += (derive_t)dispatch_threads[i].list.length;
+  }
 
   /* Initialize `vl' */
   vl.values = values;
@@ -3220,6 +3749,25 @@ static int network_stats_read(void) /* {{{ */
   sstrncpy(vl.type_instance, "send-rejected", sizeof(vl.type_instance));
   plugin_dispatch_values(&vl);
 
+  /* Packets received / dropped by each receive thread */
+  sstrncpy(vl.type, "packets", sizeof(vl.type));
+  for (size_t i = 0; i < receive_threads_num; i++) {
+    receive_thread_t *rt = receive_threads + i;
+
+    if (rt->pollfd_num == 0)
+      continue;
+
+    vl.values[0].derive = rt->packets;
+    ssnprintf(vl.type_instance, sizeof(vl.type_instance),
+              "receive%" PRIsz "-accepted", i);
+    plugin_dispatch_values(&vl);
+
+    vl.values[0].derive = rt->dropped;
+    ssnprintf(vl.type_instance, sizeof(vl.type_instance),
+              "receive%" PRIsz "-dropped", i);
+    plugin_dispatch_values(&vl);
+  }
+
   /* Receive queue length */
   vl.values[0].gauge = (gauge_t)copy_receive_list_length;
   sstrncpy(vl.type, "queue_length", sizeof(vl.type));
@@ -3260,28 +3808,23 @@ static int network_init(void) {
 
   /* If no threads need to be started, return here. */
   if ((listen_sockets_num == 0) ||
-      ((dispatch_thread_running != 0) && (receive_thread_running != 0)))
+      ((dispatch_threads != NULL) && (receive_threads != NULL)))
     return 0;
 
-  if (dispatch_thread_running == 0) {
-    int status;
-    status = plugin_thread_create(&dispatch_thread_id, dispatch_thread,
-                                  NULL /* no argument */, "network disp");
+  /* The receive threads need to know the number of dispatch threads. */
+  if (dispatch_threads == NULL) {
+    int status = dispatch_threads_create();
     if (status != 0) {
-      ERROR("network: pthread_create failed: %s", STRERRNO);
-    } else {
-      dispatch_thread_running = 1;
+      ERROR("network plugin: Starting the dispatch threads failed.");
+      return status;
     }
   }
 
-  if (receive_thread_running == 0) {
-    int status;
-    status = plugin_thread_create(&receive_thread_id, receive_thread,
-                                  NULL /* no argument */, "network recv");
+  if (receive_threads == NULL) {
+    int status = receive_threads_create();
     if (status != 0) {
-      ERROR("network: pthread_create failed: %s", STRERRNO);
-    } else {
-      receive_thread_running = 1;
+      ERROR("network plugin: Starting the receive threads failed.");
+      return status;
     }
   }
 
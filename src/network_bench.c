@@ -0,0 +1,176 @@
+/**
+ * collectd - src/network_bench.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Microbenchmark for the network plugin's packet parser. Starts collectd-tg,
+ * captures the packets it sends to a local socket and then measures how fast
+ * parse_packet() handles them in a dispatch thread. plugin_dispatch_values()
+ * is mocked, so enqueueing the values is not included.
+ *
+ * Usage: bench_plugin_network [packets [rounds [collectd-tg]]]
+ */
+
+#include "network.c" /* (sic) */
+
+#include <sys/wait.h>
+#include <time.h>
+
+static double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + ((double)ts.tv_nsec) / 1e9;
+}
+
+static int open_socket(char *port, size_t port_size) {
+  struct sockaddr_in addr = {
+      .sin_family = AF_INET,
+      .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+  };
+  socklen_t addr_len = sizeof(addr);
+
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0) {
+    fprintf(stderr, "socket: %s\n", STRERRNO);
+    return -1;
+  }
+
+  if ((bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) ||
+      (getsockname(fd, (struct sockaddr *)&addr, &addr_len) != 0)) {
+    fprintf(stderr, "bind: %s\n", STRERRNO);
+    close(fd);
+    return -1;
+  }
+
+  ssnprintf(port, port_size, "%d", (int)ntohs(addr.sin_port));
+  return fd;
+}
+
+/* Runs collectd-tg until `packets_num' packets have been received. */
+static int capture_packets(const char *tg, char **packets, int *packets_len,
+                           int packets_num) {
+  char port[16];
+  int fd = open_socket(port, sizeof(port));
+  if (fd < 0)
+    return -1;
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    fprintf(stderr, "fork: %s\n", STRERRNO);
+    close(fd);
+    return -1;
+  } else if (pid == 0) {
+    int devnull = open("/dev/null", O_WRONLY);
+    if (devnull >= 0)
+      dup2(devnull, STDOUT_FILENO);
+    execl(tg, tg, "-d", "127.0.0.1", "-D", port, "-n", "50000", "-H", "1000",
+          "-p", "20", "-i", "1", (char *)NULL);
+    fprintf(stderr, "exec %s: %s\n", tg, STRERRNO);
+    _exit(1);
+  }
+
+  int status = 0;
+  for (int i = 0; i < packets_num; i++) {
+    struct pollfd pfd = {.fd = fd, .events = POLLIN};
+    if (poll(&pfd, 1, /* timeout = */ 10000) <= 0) {
+      fprintf(stderr, "Timed out after receiving %d packets.\n", i);
+      status = -1;
+      break;
+    }
+
+    packets[i] = malloc(network_config_packet_size);
+    if (packets[i] == NULL) {
+      status = -1;
+      break;
+    }
+    packets_len[i] = (int)recv(fd, packets[i], network_config_packet_size, 0);
+    if (packets_len[i] < 0) {
+      fprintf(stderr, "recv: %s\n", STRERRNO);
+      status = -1;
+      break;
+    }
+  }
+
+  kill(pid, SIGTERM);
+  waitpid(pid, NULL, 0);
+  close(fd);
+  return status;
+}
+
+int main(int argc, char **argv) {
+  int packets_num = 5000;
+  int rounds_num = 20;
+  const char *tg = "./collectd-tg";
+
+  if (argc > 1)
+    packets_num = atoi(argv[1]);
+  if (argc > 2)
+    rounds_num = atoi(argv[2]);
+  if (argc > 3)
+    tg = argv[3];
+  if ((packets_num < 1) || (rounds_num < 1)) {
+    fprintf(stderr, "Usage: %s [packets [rounds [collectd-tg]]]\n", argv[0]);
+    return 1;
+  }
+
+  char **packets = calloc(packets_num, sizeof(*packets));
+  int *packets_len = calloc(packets_num, sizeof(*packets_len));
+  if ((packets == NULL) || (packets_len == NULL))
+    return 1;
+
+  printf("Capturing %d packets from %s ...\n", packets_num, tg);
+  if (capture_packets(tg, packets, packets_len, packets_num) != 0)
+    return 1;
+
+  /* Parse the packets the way a dispatch thread does. */
+  network_config_dispatch_threads = 1;
+  if (dispatch_threads_init() != 0)
+    return 1;
+  dispatch_thread_t *dt = dispatch_threads;
+  pthread_setspecific(dispatch_thread_key, dt);
+
+  sockent_t se = {.type = SOCKENT_TYPE_SERVER};
+  struct sockaddr_storage sender = {0};
+  struct sockaddr_in *sin = (struct sockaddr_in *)&sender;
+  sin->sin_family = AF_INET;
+  sin->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  double start = now_seconds();
+  for (int round = 0; round < rounds_num; round++)
+    for (int i = 0; i < packets_num; i++)
+      parse_packet(&se, packets[i], (size_t)packets_len[i], /* flags = */ 0,
+                   /* username = */ NULL, &sender);
+  double elapsed = now_seconds() - start;
+
+  double parsed = (double)packets_num * rounds_num;
+  double values = (double)dt->values_dispatched;
+  printf("%12s %12s %14s %14s %10s\n", "packets", "values", "packets/s",
+         "values/s", "ns/value");
+  printf("%12.0f %12.0f %14.0f %14.0f %10.1f\n", parsed, values,
+         parsed / elapsed, values / elapsed, 1e9 * elapsed / values);
+
+  for (int i = 0; i < packets_num; i++)
+    sfree(packets[i]);
+  sfree(packets);
+  sfree(packets_len);
+  return 0;
+}
@@ -42,6 +42,8 @@ typedef struct rrd_cache_s {
   cdtime_t first_value;
   cdtime_t last_value;
   int64_t random_variation;
+  /* Inode of the RRD file, used to order updates by their on-disk location. */
+  ino_t inode;
   enum { FLAG_NONE = 0x00, FLAG_QUEUED = 0x01, FLAG_FLUSHQ = 0x02 } flags;
 } rrd_cache_t;
 
@@ -50,17 +52,49 @@ typedef enum rrd_queue_dir_e rrd_queue_dir_t;
 
 struct rrd_queue_s {
   char *filename;
+  ino_t inode;
+  cdtime_t time; /* when the entry was queued */
   struct rrd_queue_s *next;
 };
 typedef struct rrd_queue_s rrd_queue_t;
 
+/* RRD files are partitioned between the write threads by the hash of their
+ * file name, so each file is only ever updated by one thread. Every thread has
+ * its own update and flush queue, protected by the thread's lock. */
+struct rrd_writer_s {
+  pthread_t thread;
+  bool thread_running;
+
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+
+  rrd_queue_t *queue_head;
+  rrd_queue_t *queue_tail;
+  size_t queue_length;
+  rrd_queue_t *flushq_head;
+  rrd_queue_t *flushq_tail;
+  size_t flushq_length;
+
+  /* Statistics, dispatched when "CollectStatistics" is enabled. */
+  derive_t updates_num;
+  derive_t values_num;
+  cdtime_t latency_sum;
+  uint64_t latency_num;
+};
+typedef struct rrd_writer_s rrd_writer_t;
+
+/* Maximum number of queue entries a write thread takes at once. The entries
+ * are sorted by inode before being written. */
+#define RRD_QUEUE_BATCH_MAX 64
+
 /*
  * Private variables
  */
 static const char *config_keys[] = {
     "CacheTimeout", "CacheFlush",      "CreateFilesAsync", "DataDir",
     "StepSize",     "HeartBeat",       "RRARows",          "RRATimespan",
-    "XFF",          "WritesPerSecond", "RandomTimeout"};
+    "XFF",          "WritesPerSecond", "RandomTimeout",    "WriteThreads",
+    "CollectStatistics"};
 static int config_keys_num = STATIC_ARRAY_SIZE(config_keys);
 
 /* If datadir is zero, the daemon's basedir is used. If stepsize or heartbeat
@@ -82,8 +116,8 @@ static rrdcreate_config_t rrdcreate_config = {
 
     /* async = */ 0};
 
-/* XXX: If you need to lock both, cache_lock and queue_lock, at the same time,
- * ALWAYS lock `cache_lock' first! */
+/* XXX: If you need to lock both, cache_lock and a writer's lock, at the same
+ * time, ALWAYS lock `cache_lock' first! */
 static cdtime_t cache_timeout;
 static cdtime_t cache_flush_timeout;
 static cdtime_t random_timeout;
@@ -91,14 +125,10 @@ static cdtime_t cache_flush_last;
 static c_avl_tree_t *cache;
 static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
 
-static rrd_queue_t *queue_head;
-static rrd_queue_t *queue_tail;
-static rrd_queue_t *flushq_head;
-static rrd_queue_t *flushq_tail;
-static pthread_t queue_thread;
-static int queue_thread_running = 1;
-static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static rrd_writer_t *writers;
+static size_t writers_num;
+static size_t conf_write_threads = 1;
+static bool conf_collect_stats;
 
 #if !HAVE_THREADSAFE_LIBRRD
 static pthread_mutex_t librrd_lock = PTHREAD_MUTEX_INITIALIZER;
@@ -279,36 +309,134 @@ static int value_list_to_filename(char *buffer, size_t buffer_size,
   return 0;
 } /* int value_list_to_filename */
 
-static void *rrd_queue_thread(void __attribute__((unused)) * data) {
+/* FNV-1a */
+static uint32_t rrd_hash(const char *filename) {
+  uint32_t hash = 2166136261U;
+  for (const unsigned char *ptr = (const unsigned char *)filename; *ptr != 0;
+       ptr++) {
+    hash ^= *ptr;
+    hash *= 16777619U;
+  }
+  return hash;
+} /* uint32_t rrd_hash */
+
+static rrd_writer_t *rrd_get_writer(const char *filename) {
+  return writers + (rrd_hash(filename) % writers_num);
+} /* rrd_writer_t *rrd_get_writer */
+
+/* Orders queue entries by inode, which on most file systems correlates with
+ * the location of the file on disk. */
+static int rrd_queue_compare(const void *a_ptr, const void *b_ptr) {
+  rrd_queue_t const *a = *((rrd_queue_t *const *)a_ptr);
+  rrd_queue_t const *b = *((rrd_queue_t *const *)b_ptr);
+
+  if (a->inode < b->inode)
+    return -1;
+  else if (a->inode > b->inode)
+    return 1;
+  else
+    return strcmp(a->filename, b->filename);
+} /* int rrd_queue_compare */
+
+/* Removes up to "max" entries from the front of a queue and stores them in
+ * "batch". You must hold the writer's lock when calling this function. */
+static size_t rrd_queue_take(rrd_queue_t **head, rrd_queue_t **tail,
+                             rrd_queue_t **batch, size_t max) {
+  size_t num = 0;
+
+  while ((*head != NULL) && (num < max)) {
+    batch[num] = *head;
+    *head = (*head)->next;
+    batch[num]->next = NULL;
+    num++;
+  }
+
+  if (*head == NULL)
+    *tail = NULL;
+
+  return num;
+} /* size_t rrd_queue_take */
+
+/* Writes all values cached for the queue entry's file and frees the entry. */
+static void rrd_queue_write(rrd_writer_t *w, rrd_queue_t *queue_entry) {
+  rrd_cache_t *cache_entry;
+  char **values = NULL;
+  int values_num = 0;
+
+  /* We now need the cache lock so the entry isn't updated while
+   * we make a copy of its values */
+  pthread_mutex_lock(&cache_lock);
+
+  int status = c_avl_get(cache, queue_entry->filename, (void *)&cache_entry);
+  if (status == 0) {
+    values = cache_entry->values;
+    values_num = cache_entry->values_num;
+
+    cache_entry->values = NULL;
+    cache_entry->values_num = 0;
+    cache_entry->flags = FLAG_NONE;
+  }
+
+  pthread_mutex_unlock(&cache_lock);
+
+  /* The values may already have been written, for example if the file was
+   * moved to the flush queue while it was being processed. */
+  if (values_num > 0) {
+    cdtime_t start = cdtime();
+
+    /* Write the values to the RRD-file */
+    srrd_update(queue_entry->filename, NULL, values_num,
+                (const char **)values);
+    DEBUG("rrdtool plugin: queue thread: Wrote %i value%s to %s", values_num,
+          (values_num == 1) ? "" : "s", queue_entry->filename);
+
+    cdtime_t latency = cdtime() - start;
+
+    pthread_mutex_lock(&w->lock);
+    w->updates_num++;
+    w->values_num += values_num;
+    w->latency_sum += latency;
+    w->latency_num++;
+    pthread_mutex_unlock(&w->lock);
+  }
+
+  for (int i = 0; i < values_num; i++) {
+    sfree(values[i]);
+  }
+  sfree(values);
+  sfree(queue_entry->filename);
+  sfree(queue_entry);
+} /* void rrd_queue_write */
+
+static void *rrd_queue_thread(void *data) {
+  rrd_writer_t *w = data;
+  rrd_queue_t *batch[RRD_QUEUE_BATCH_MAX];
   struct timeval tv_next_update;
   struct timeval tv_now;
 
+  /* "WritesPerSecond" is shared between all write threads. */
+  double thread_write_rate = write_rate * (double)writers_num;
+
   gettimeofday(&tv_next_update, /* timezone = */ NULL);
 
   while (42) {
-    rrd_queue_t *queue_entry;
-    rrd_cache_t *cache_entry;
-    char **values;
-    int values_num;
+    size_t batch_num;
     int status;
 
-    values = NULL;
-    values_num = 0;
-
-    pthread_mutex_lock(&queue_lock);
+    pthread_mutex_lock(&w->lock);
     /* Wait for values to arrive */
     while (42) {
       struct timespec ts_wait;
 
-      while ((flushq_head == NULL) && (queue_head == NULL) &&
+      while ((w->flushq_head == NULL) && (w->queue_head == NULL) &&
              (do_shutdown == 0))
-        pthread_cond_wait(&queue_cond, &queue_lock);
+        pthread_cond_wait(&w->cond, &w->lock);
 
-      if ((flushq_head == NULL) && (queue_head == NULL))
+      if ((w->flushq_head == NULL) && (w->queue_head == NULL))
         break;
 
       /* Don't delay if there's something to flush */
-      if (flushq_head != NULL)
+      if (w->flushq_head != NULL)
         break;
 
       /* Don't delay if we're shutting down */
@@ -316,7 +444,7 @@ static void *rrd_queue_thread(void __attribute__((unused)) * data) {
         break;
 
       /* Don't delay if no delay was configured. */
-      if (write_rate <= 0.0)
+      if (thread_write_rate <= 0.0)
         break;
 
       gettimeofday(&tv_now, /* timezone = */ NULL);
@@ -331,94 +459,64 @@ static void *rrd_queue_thread(void __attribute__((unused)) * data) {
       ts_wait.tv_sec = tv_next_update.tv_sec;
       ts_wait.tv_nsec = 1000 * tv_next_update.tv_usec;
 
-      status = pthread_cond_timedwait(&queue_cond, &queue_lock, &ts_wait);
+      status = pthread_cond_timedwait(&w->cond, &w->lock, &ts_wait);
       if (status == ETIMEDOUT)
         break;
     } /* while (42) */
 
-    /* XXX: If you need to lock both, cache_lock and queue_lock, at
+    /* XXX: If you need to lock both, cache_lock and a writer's lock, at
      * the same time, ALWAYS lock `cache_lock' first! */
 
     /* We're in the shutdown phase */
-    if ((flushq_head == NULL) && (queue_head == NULL)) {
-      pthread_mutex_unlock(&queue_lock);
+    if ((w->flushq_head == NULL) && (w->queue_head == NULL)) {
+      pthread_mutex_unlock(&w->lock);
       break;
     }
 
-    if (flushq_head != NULL) {
-      /* Dequeue the first flush entry */
-      queue_entry = flushq_head;
-      if (flushq_head == flushq_tail)
-        flushq_head = flushq_tail = NULL;
-      else
-        flushq_head = flushq_head->next;
-    } else /* if (queue_head != NULL) */
+    if (w->flushq_head != NULL) {
+      batch_num = rrd_queue_take(&w->flushq_head, &w->flushq_tail, batch,
+                                 STATIC_ARRAY_SIZE(batch));
+      w->flushq_length -= batch_num;
+    } else /* if (w->queue_head != NULL) */
     {
-      /* Dequeue the first regular entry */
-      queue_entry = queue_head;
-      if (queue_head == queue_tail)
-        queue_head = queue_tail = NULL;
-      else
-        queue_head = queue_head->next;
+      /* When rate limited, write a single file per wake-up. */
+      size_t max = ((thread_write_rate > 0.0) && (do_shutdown == 0))
+                       ? 1
+                       : STATIC_ARRAY_SIZE(batch);
+      batch_num = rrd_queue_take(&w->queue_head, &w->queue_tail, batch, max);
+      w->queue_length -= batch_num;
     }
 
     /* Unlock the queue again */
-    pthread_mutex_unlock(&queue_lock);
+    pthread_mutex_unlock(&w->lock);
 
-    /* We now need the cache lock so the entry isn't updated while
-     * we make a copy of its values */
-    pthread_mutex_lock(&cache_lock);
-
-    status = c_avl_get(cache, queue_entry->filename, (void *)&cache_entry);
-
-    if (status == 0) {
-      values = cache_entry->values;
-      values_num = cache_entry->values_num;
-
-      cache_entry->values = NULL;
-      cache_entry->values_num = 0;
-      cache_entry->flags = FLAG_NONE;
-    }
-
-    pthread_mutex_unlock(&cache_lock);
-
-    if (status != 0) {
-      sfree(queue_entry->filename);
-      sfree(queue_entry);
-      continue;
-    }
+    if (batch_num > 1)
+      qsort(batch, batch_num, sizeof(batch[0]), rrd_queue_compare);
 
     /* Update `tv_next_update' */
-    if (write_rate > 0.0) {
+    if (thread_write_rate > 0.0) {
       gettimeofday(&tv_now, /* timezone = */ NULL);
       tv_next_update.tv_sec = tv_now.tv_sec;
       tv_next_update.tv_usec =
-          tv_now.tv_usec + ((suseconds_t)(1000000 * write_rate));
+          tv_now.tv_usec + ((suseconds_t)(1000000 * thread_write_rate));
       while (tv_next_update.tv_usec > 1000000) {
         tv_next_update.tv_sec++;
         tv_next_update.tv_usec -= 1000000;
       }
     }
 
-    /* Write the values to the RRD-file */
-    srrd_update(queue_entry->filename, NULL, values_num, (const char **)values);
-    DEBUG("rrdtool plugin: queue thread: Wrote %i value%s to %s", values_num,
-          (values_num == 1) ? "" : "s", queue_entry->filename);
-
-    for (int i = 0; i < values_num; i++) {
-      sfree(values[i]);
-    }
-    sfree(values);
-    sfree(queue_entry->filename);
-    sfree(queue_entry);
+    for (size_t i = 0; i < batch_num; i++)
+      rrd_queue_write(w, batch[i]);
   } /* while (42) */
 
   pthread_exit((void *)0);
   return (void *)0;
 } /* void *rrd_queue_thread */
 
-static int rrd_queue_enqueue(const char *filename, rrd_queue_t **head,
-                             rrd_queue_t **tail) {
+/* Appends the file to the update queue or, if "flush" is true, to the flush
+ * queue of the thread responsible for it. */
+static int rrd_queue_enqueue(const char *filename, ino_t inode, bool flush) {
+  rrd_writer_t *w = rrd_get_writer(filename);
   rrd_queue_t *queue_entry;
 
   queue_entry = malloc(sizeof(*queue_entry));
@@ -431,9 +529,14 @@ static int rrd_queue_enqueue(const char *filename, rrd_queue_t **head,
     return -1;
   }
 
+  queue_entry->inode = inode;
+  queue_entry->time = cdtime();
   queue_entry->next = NULL;
 
-  pthread_mutex_lock(&queue_lock);
+  pthread_mutex_lock(&w->lock);
+
+  rrd_queue_t **head = flush ? &w->flushq_head : &w->queue_head;
+  rrd_queue_t **tail = flush ? &w->flushq_tail : &w->queue_tail;
 
   if (*tail == NULL)
     *head = queue_entry;
@@ -441,21 +544,27 @@ static int rrd_queue_enqueue(const char *filename, rrd_queue_t **head,
     (*tail)->next = queue_entry;
   *tail = queue_entry;
 
-  pthread_cond_signal(&queue_cond);
-  pthread_mutex_unlock(&queue_lock);
+  if (flush)
+    w->flushq_length++;
+  else
+    w->queue_length++;
+
+  pthread_cond_signal(&w->cond);
+  pthread_mutex_unlock(&w->lock);
 
   return 0;
 } /* int rrd_queue_enqueue */
 
-static int rrd_queue_dequeue(const char *filename, rrd_queue_t **head,
-                             rrd_queue_t **tail) {
+/* Removes the file from the update queue of the thread responsible for it. */
+static int rrd_queue_dequeue(const char *filename) {
+  rrd_writer_t *w = rrd_get_writer(filename);
   rrd_queue_t *this;
   rrd_queue_t *prev;
 
-  pthread_mutex_lock(&queue_lock);
+  pthread_mutex_lock(&w->lock);
 
   prev = NULL;
-  this = *head;
+  this = w->queue_head;
 
   while (this != NULL) {
     if (strcmp(this->filename, filename) == 0)
@@ -466,19 +575,21 @@ static int rrd_queue_dequeue(const char *filename, rrd_queue_t **head,
   }
 
   if (this == NULL) {
-    pthread_mutex_unlock(&queue_lock);
+    pthread_mutex_unlock(&w->lock);
     return -1;
   }
 
   if (prev == NULL)
-    *head = this->next;
+    w->queue_head = this->next;
   else
     prev->next = this->next;
 
   if (this->next == NULL)
-    *tail = prev;
+    w->queue_tail = prev;
+
+  w->queue_length--;
 
-  pthread_mutex_unlock(&queue_lock);
+  pthread_mutex_unlock(&w->lock);
 
   sfree(this->filename);
   sfree(this);
@@ -513,7 +624,7 @@ static void rrd_cache_flush(cdtime_t timeout) {
     else if (rc->values_num > 0) {
       int status;
 
-      status = rrd_queue_enqueue(key, &queue_head, &queue_tail);
+      status = rrd_queue_enqueue(key, rc->inode, /* flush = */ false);
       if (status == 0)
         rc->flags = FLAG_QUEUED;
     } else /* ancient and no values -> waste of memory */
@@ -582,14 +693,14 @@ static int rrd_cache_flush_identifier(cdtime_t timeout,
   if (rc->flags == FLAG_FLUSHQ) {
     status = 0;
   } else if (rc->flags == FLAG_QUEUED) {
-    rrd_queue_dequeue(key, &queue_head, &queue_tail);
-    status = rrd_queue_enqueue(key, &flushq_head, &flushq_tail);
+    rrd_queue_dequeue(key);
+    status = rrd_queue_enqueue(key, rc->inode, /* flush = */ true);
     if (status == 0)
       rc->flags = FLAG_FLUSHQ;
   } else if ((now - rc->first_value) < timeout) {
     status = 0;
   } else if (rc->values_num > 0) {
-    status = rrd_queue_enqueue(key, &flushq_head, &flushq_tail);
+    status = rrd_queue_enqueue(key, rc->inode, /* flush = */ true);
     if (status == 0)
       rc->flags = FLAG_FLUSHQ;
   }
@@ -604,8 +715,8 @@ static int64_t rrd_get_random_variation(void) {
   return (int64_t)cdrand_range(-random_timeout, random_timeout);
 } /* int64_t rrd_get_random_variation */
 
-static int rrd_cache_insert(const char *filename, const char *value,
-                            cdtime_t value_time) {
+static int rrd_cache_insert(const char *filename, ino_t inode,
+                            const char *value, cdtime_t value_time) {
   rrd_cache_t *rc = NULL;
   int new_rc = 0;
   char **values_new;
@@ -636,6 +747,7 @@ static int rrd_cache_insert(const char *filename, const char *value,
     rc->flags = FLAG_NONE;
     new_rc = 1;
   }
+  rc->inode = inode;
 
   assert(value_time > 0); /* plugin_dispatch() ensures this. */
   if (rc->last_value >= value_time) {
@@ -696,12 +808,12 @@ static int rrd_cache_insert(const char *filename, const char *value,
 
   if ((rc->last_value - rc->first_value) >=
       (cache_timeout + rc->random_variation)) {
-    /* XXX: If you need to lock both, cache_lock and queue_lock, at
+    /* XXX: If you need to lock both, cache_lock and a writer's lock, at
      * the same time, ALWAYS lock `cache_lock' first! */
     if (rc->flags == FLAG_NONE) {
       int status;
 
-      status = rrd_queue_enqueue(filename, &queue_head, &queue_tail);
+      status = rrd_queue_enqueue(filename, rc->inode, /* flush = */ false);
       if (status == 0)
         rc->flags = FLAG_QUEUED;
 
@@ -811,6 +923,12 @@ static int rrd_write(const data_set_t *ds, const value_list_t *vl,
       } else if (rrdcreate_config.async) {
         return 0;
       }
+
+      /* The inode is needed to order the queue, see rrd_queue_compare(). */
+      if (stat(filename, &statbuf) == -1) {
+        ERROR("rrdtool plugin: stat(%s) failed: %s", filename, STRERRNO);
+        return -1;
+      }
     } else {
       ERROR("rrdtool plugin: stat(%s) failed: %s", filename, STRERRNO);
       return -1;
@@ -820,7 +938,7 @@ static int rrd_write(const data_set_t *ds, const value_list_t *vl,
     return -1;
   }
 
-  return rrd_cache_insert(filename, values, vl->time);
+  return rrd_cache_insert(filename, statbuf.st_ino, values, vl->time);
 } /* int rrd_write */
 
 static int rrd_flush(cdtime_t timeout, const char *identifier,
@@ -838,6 +956,70 @@ static int rrd_flush(cdtime_t timeout, const char *identifier,
   return 0;
 } /* int rrd_flush */
 
+static void rrd_submit(const char *type, const char *type_instance,
+                       value_t value) {
+  value_list_t vl = VALUE_LIST_INIT;
+
+  vl.values = &value;
+  vl.values_len = 1;
+  sstrncpy(vl.plugin, "rrdtool", sizeof(vl.plugin));
+  sstrncpy(vl.type, type, sizeof(vl.type));
+  sstrncpy(vl.type_instance, type_instance, sizeof(vl.type_instance));
+
+  plugin_dispatch_values(&vl);
+} /* void rrd_submit */
+
+/* Dispatches statistics about the write threads: the length of the queues,
+ * the number of updates, the average time an update took since the last read
+ * and the age of the oldest queued file. */
+static int rrd_read(void) {
+  gauge_t queue_length = 0;
+  gauge_t flushq_length = 0;
+  derive_t updates_num = 0;
+  derive_t values_num = 0;
+  cdtime_t latency_sum = 0;
+  uint64_t latency_num = 0;
+  cdtime_t oldest = 0;
+  cdtime_t now = cdtime();
+
+  for (size_t i = 0; i < writers_num; i++) {
+    rrd_writer_t *w = writers + i;
+
+    pthread_mutex_lock(&w->lock);
+    queue_length += (gauge_t)w->queue_length;
+    flushq_length += (gauge_t)w->flushq_length;
+    updates_num += w->updates_num;
+    values_num += w->values_num;
+    latency_sum += w->latency_sum;
+    latency_num += w->latency_num;
+    w->latency_sum = 0;
+    w->latency_num = 0;
+
+    if ((w->queue_head != NULL) &&
+        ((oldest == 0) || (w->queue_head->time < oldest)))
+      oldest = w->queue_head->time;
+    if ((w->flushq_head != NULL) &&
+        ((oldest == 0) || (w->flushq_head->time < oldest)))
+      oldest = w->flushq_head->time;
+    pthread_mutex_unlock(&w->lock);
+  }
+
+  rrd_submit("queue_length", "update", (value_t){.gauge = queue_length});
+  rrd_submit("queue_length", "flush", (value_t){.gauge = flushq_length});
+  rrd_submit("operations", "update", (value_t){.derive = updates_num});
+  rrd_submit("operations", "value", (value_t){.derive = values_num});
+  rrd_submit("latency", "update",
+             (value_t){.gauge = (latency_num > 0)
+                                    ? CDTIME_T_TO_DOUBLE(latency_sum) /
+                                          (gauge_t)latency_num
+                                    : NAN});
+  rrd_submit("duration", "backlog",
+             (value_t){.gauge = (oldest > 0) ? CDTIME_T_TO_DOUBLE(now - oldest)
+                                             : 0.0});
+
+  return 0;
+} /* int rrd_read */
+
 static int rrd_config(const char *key, const char *value) {
   if (strcasecmp("CacheTimeout", key) == 0) {
     double tmp = atof(value);
@@ -978,6 +1160,18 @@ static int rrd_config(const char *key, const char *value) {
     } else {
       random_timeout = DOUBLE_TO_CDTIME_T(tmp);
     }
+  } else if (strcasecmp("WriteThreads", key) == 0) {
+    int tmp = atoi(value);
+    if (tmp < 1) {
+      fprintf(stderr, "rrdtool: `WriteThreads' must "
+                      "be greater than 0.\n");
+      ERROR("rrdtool: `WriteThreads' must "
+            "be greater than 0.");
+      return 1;
+    }
+    conf_write_threads = (size_t)tmp;
+  } else if (strcasecmp("CollectStatistics", key) == 0) {
+    conf_collect_stats = IS_TRUE(value);
   } else {
     return -1;
   }
@@ -985,30 +1179,50 @@ static int rrd_config(const char *key, const char *value) {
 } /* int rrd_config */
 
 static int rrd_shutdown(void) {
+  size_t pending = 0;
+
+  if (writers == NULL) {
+    rrd_cache_destroy();
+    return 0;
+  }
+
   pthread_mutex_lock(&cache_lock);
   rrd_cache_flush(0);
   pthread_mutex_unlock(&cache_lock);
 
-  pthread_mutex_lock(&queue_lock);
-  do_shutdown = 1;
-  pthread_cond_signal(&queue_cond);
-  pthread_mutex_unlock(&queue_lock);
+  for (size_t i = 0; i < writers_num; i++) {
+    rrd_writer_t *w = writers + i;
+
+    pthread_mutex_lock(&w->lock);
+    do_shutdown = 1;
+    pending += w->queue_length + w->flushq_length;
+    pthread_cond_signal(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+  }
 
-  if ((queue_thread_running != 0) &&
-      ((queue_head != NULL) || (flushq_head != NULL))) {
-    INFO("rrdtool plugin: Shutting down the queue thread. "
+  if (pending > 0) {
+    INFO("rrdtool plugin: Shutting down the queue threads. "
          "This may take a while.");
-  } else if (queue_thread_running != 0) {
-    INFO("rrdtool plugin: Shutting down the queue thread.");
+  } else {
+    INFO("rrdtool plugin: Shutting down the queue threads.");
   }
 
   /* Wait for all the values to be written to disk before returning. */
-  if (queue_thread_running != 0) {
-    pthread_join(queue_thread, NULL);
-    memset(&queue_thread, 0, sizeof(queue_thread));
-    queue_thread_running = 0;
-    DEBUG("rrdtool plugin: queue_thread exited.");
+  for (size_t i = 0; i < writers_num; i++) {
+    rrd_writer_t *w = writers + i;
+
+    if (w->thread_running) {
+      pthread_join(w->thread, NULL);
+      w->thread_running = false;
+    }
+
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->cond);
   }
+  DEBUG("rrdtool plugin: queue threads exited.");
+
+  sfree(writers);
+  writers_num = 0;
 
   rrd_cache_destroy();
 
@@ -1057,13 +1271,33 @@ static int rrd_init(void) {
 
   pthread_mutex_unlock(&cache_lock);
 
-  int status = plugin_thread_create(&queue_thread, rrd_queue_thread,
-                                    /* args = */ NULL, "rrdtool queue");
-  if (status != 0) {
-    ERROR("rrdtool plugin: Cannot create queue-thread.");
+  writers = calloc(conf_write_threads, sizeof(*writers));
+  if (writers == NULL) {
+    ERROR("rrdtool plugin: calloc failed.");
     return -1;
   }
-  queue_thread_running = 1;
+  writers_num = conf_write_threads;
+
+  for (size_t i = 0; i < writers_num; i++) {
+    pthread_mutex_init(&writers[i].lock, /* attr = */ NULL);
+    pthread_cond_init(&writers[i].cond, /* attr = */ NULL);
+  }
+
+  for (size_t i = 0; i < writers_num; i++) {
+    rrd_writer_t *w = writers + i;
+    char name[32];
+
+    ssnprintf(name, sizeof(name), "rrdtool#%" PRIsz, i);
+    int status = plugin_thread_create(&w->thread, rrd_queue_thread, w, name);
+    if (status != 0) {
+      ERROR("rrdtool plugin: Cannot create queue-thread.");
+      return -1;
+    }
+    w->thread_running = true;
+  }
+
+  if (conf_collect_stats)
+    plugin_register_read("rrdtool", rrd_read);
 
   DEBUG("rrdtool plugin: rrd_init: datadir = %s; stepsize = %lu;"
         " heartbeat = %i; rrarows = %i; xff = %lf;",
@@ -24,12 +24,16 @@
  *   Florian octo Forster <octo at collectd.org>
  */
 
+#define _GNU_SOURCE /* For recvmmsg */
+
 #include "collectd.h"
 
 #include "plugin.h"
 #include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
+#include "utils/hll/hll.h"
 #include "utils/latency/latency.h"
+#include "utils/latency/latency_config.h"
 
 #include <netdb.h>
 #include <poll.h>
@@ -48,28 +52,50 @@
 #define STATSD_DEFAULT_SERVICE "8125"
 #endif
 
+/* Size of a receive buffer and the maximum number of datagrams read at once. */
+#define STATSD_BUFFER_SIZE 4096
+#define STATSD_BATCH_MAX 32
+
 enum metric_type_e { STATSD_COUNTER, STATSD_TIMER, STATSD_GAUGE, STATSD_SET };
 typedef enum metric_type_e metric_type_t;
 
 struct statsd_metric_s {
   metric_type_t type;
   double value;
+  /* Only used in shards: "value" replaces the gauge rather than adding to it. */
+  bool value_set;
   derive_t counter;
   latency_counter_t *latency;
   c_avl_tree_t *set;
+  /* Used instead of "set" if SetPrecision is configured. */
+  hll_t *hll;
   unsigned long updates_num;
 };
 typedef struct statsd_metric_s statsd_metric_t;
 
+/* Each receive thread aggregates the lines it parses in its own shard. The
+ * shard's tree only holds the changes since the last read, which statsd_read()
+ * takes over and merges into "metrics_tree". The shard's lock is therefore
+ * only contended while the tree is being swapped. */
+struct statsd_shard_s {
+  pthread_t thread;
+  bool thread_running;
+
+  pthread_mutex_t lock;
+  c_avl_tree_t *tree;
+};
+typedef struct statsd_shard_s statsd_shard_t;
+
 static c_avl_tree_t *metrics_tree;
 static pthread_mutex_t metrics_lock = PTHREAD_MUTEX_INITIALIZER;
 
-static pthread_t network_thread;
-static bool network_thread_running;
+static statsd_shard_t *shards;
+static size_t shards_num;
 static bool network_thread_shutdown;
 
 static char *conf_node;
 static char *conf_service;
+static size_t conf_receive_threads = 1;
 
 static bool conf_delete_counters;
 static bool conf_delete_timers;
@@ -78,6 +104,10 @@ static bool conf_delete_sets;
 
 static double *conf_timer_percentile;
 static size_t conf_timer_percentile_num;
+static latency_histogram_t conf_timer_histogram = LATENCY_HISTOGRAM_LINEAR;
+
+/* Zero means sets are counted exactly. */
+static int conf_set_precision;
 
 static bool conf_counter_sum;
 static bool conf_timer_lower;
@@ -85,14 +115,10 @@ static bool conf_timer_upper;
 static bool conf_timer_sum;
 static bool conf_timer_count;
 
-/* Must hold metrics_lock when calling this function. */
-static statsd_metric_t *statsd_metric_lookup_unsafe(char const *name, /* {{{ */
-                                                    metric_type_t type) {
-  char key[DATA_MAX_NAME_LEN + 2];
-  char *key_copy;
-  statsd_metric_t *metric;
-  int status;
-
+/* Builds the key of a metric, i.e. its name prefixed with the type, for
+ * example "c:name". */
+static int statsd_metric_key(char *key, size_t key_size, /* {{{ */
+                             char const *name, metric_type_t type) {
   switch (type) {
   case STATSD_COUNTER:
     key[0] = 'c';
@@ -107,13 +133,23 @@ static statsd_metric_t *statsd_metric_lookup_unsafe(char const *name, /* {{{ */
     key[0] = 's';
     break;
   default:
-    return NULL;
+    return EINVAL;
   }
 
   key[1] = ':';
-  sstrncpy(&key[2], name, sizeof(key) - 2);
+  sstrncpy(&key[2], name, key_size - 2);
+  return 0;
+} /* }}} int statsd_metric_key */
+
+/* Must hold the lock protecting "tree" when calling this function. */
+static statsd_metric_t *statsd_metric_lookup_unsafe(c_avl_tree_t *tree, /* {{{ */
+                                                    char const *key,
+                                                    metric_type_t type) {
+  char *key_copy;
+  statsd_metric_t *metric;
+  int status;
 
-  status = c_avl_get(metrics_tree, key, (void *)&metric);
+  status = c_avl_get(tree, key, (void *)&metric);
   if (status == 0)
     return metric;
 
@@ -134,7 +170,7 @@ static statsd_metric_t *statsd_metric_lookup_unsafe(char const *name, /* {{{ */
   metric->latency = NULL;
   metric->set = NULL;
 
-  status = c_avl_insert(metrics_tree, key_copy, metric);
+  status = c_avl_insert(tree, key_copy, metric);
   if (status != 0) {
     ERROR("statsd plugin: c_avl_insert failed.");
     sfree(key_copy);
@@ -145,46 +181,63 @@ static statsd_metric_t *statsd_metric_lookup_unsafe(char const *name, /* {{{ */
   return metric;
 } /* }}} statsd_metric_lookup_unsafe */
 
-static int statsd_metric_set(char const *name, double value, /* {{{ */
-                             metric_type_t type) {
-  statsd_metric_t *metric;
+/* Must hold the lock protecting "tree" when calling this function. */
+static statsd_metric_t *statsd_metric_get_unsafe(c_avl_tree_t *tree, /* {{{ */
+                                                 char const *name,
+                                                 metric_type_t type) {
+  char key[DATA_MAX_NAME_LEN + 2];
 
-  pthread_mutex_lock(&metrics_lock);
+  if (statsd_metric_key(key, sizeof(key), name, type) != 0)
+    return NULL;
 
-  metric = statsd_metric_lookup_unsafe(name, type);
-  if (metric == NULL) {
-    pthread_mutex_unlock(&metrics_lock);
+  return statsd_metric_lookup_unsafe(tree, key, type);
+} /* }}} statsd_metric_t *statsd_metric_get_unsafe */
+
+static int statsd_metric_set(c_avl_tree_t *tree, char const *name, /* {{{ */
+                             double value, metric_type_t type) {
+  statsd_metric_t *metric;
+
+  metric = statsd_metric_get_unsafe(tree, name, type);
+  if (metric == NULL)
     return -1;
-  }
 
   metric->value = value;
+  metric->value_set = true;
   metric->updates_num++;
 
-  pthread_mutex_unlock(&metrics_lock);
-
   return 0;
 } /* }}} int statsd_metric_set */
 
-static int statsd_metric_add(char const *name, double delta, /* {{{ */
-                             metric_type_t type) {
+static int statsd_metric_add(c_avl_tree_t *tree, char const *name, /* {{{ */
+                             double delta, metric_type_t type) {
   statsd_metric_t *metric;
 
-  pthread_mutex_lock(&metrics_lock);
-
-  metric = statsd_metric_lookup_unsafe(name, type);
-  if (metric == NULL) {
-    pthread_mutex_unlock(&metrics_lock);
+  metric = statsd_metric_get_unsafe(tree, name, type);
+  if (metric == NULL)
     return -1;
-  }
 
   metric->value += delta;
   metric->updates_num++;
 
-  pthread_mutex_unlock(&metrics_lock);
-
   return 0;
 } /* }}} int statsd_metric_add */
 
+static void statsd_set_free(c_avl_tree_t *set) /* {{{ */
+{
+  void *key;
+  void *value;
+
+  if (set == NULL)
+    return;
+
+  while (c_avl_pick(set, &key, &value) == 0) {
+    sfree(key);
+    assert(value == NULL);
+  }
+
+  c_avl_destroy(set);
+} /* }}} void statsd_set_free */
+
 static void statsd_metric_free(statsd_metric_t *metric) /* {{{ */
 {
   if (metric == NULL)
@@ -195,22 +248,30 @@ static void statsd_metric_free(statsd_metric_t *metric) /* {{{ */
     metric->latency = NULL;
   }
 
-  if (metric->set != NULL) {
-    void *key;
-    void *value;
-
-    while (c_avl_pick(metric->set, &key, &value) == 0) {
-      sfree(key);
-      assert(value == NULL);
-    }
+  statsd_set_free(metric->set);
+  metric->set = NULL;
 
-    c_avl_destroy(metric->set);
-    metric->set = NULL;
-  }
+  hll_destroy(metric->hll);
+  metric->hll = NULL;
 
   sfree(metric);
 } /* }}} void statsd_metric_free */
 
+static void statsd_tree_free(c_avl_tree_t *tree) /* {{{ */
+{
+  void *key;
+  void *value;
+
+  if (tree == NULL)
+    return;
+
+  while (c_avl_pick(tree, &key, &value) == 0) {
+    sfree(key);
+    statsd_metric_free(value);
+  }
+  c_avl_destroy(tree);
+} /* }}} void statsd_tree_free */
+
 static int statsd_parse_value(char const *str, value_t *ret_value) /* {{{ */
 {
   char *endptr = NULL;
@@ -222,8 +283,9 @@ static int statsd_parse_value(char const *str, value_t *ret_value) /* {{{ */
   return 0;
 } /* }}} int statsd_parse_value */
 
-static int statsd_handle_counter(char const *name, /* {{{ */
-                                 char const *value_str, char const *extra) {
+static int statsd_handle_counter(c_avl_tree_t *tree, /* {{{ */
+                                 char const *name, char const *value_str,
+                                 char const *extra) {
   value_t value;
   value_t scale;
   int status;
@@ -248,12 +310,12 @@ static int statsd_handle_counter(char const *name, /* {{{ */
 
   /* Changes to the counter are added to (statsd_metric_t*)->value. ->counter is
    * only updated in statsd_metric_submit_unsafe(). */
-  return statsd_metric_add(name, (double)(value.gauge / scale.gauge),
+  return statsd_metric_add(tree, name, (double)(value.gauge / scale.gauge),
                            STATSD_COUNTER);
 } /* }}} int statsd_handle_counter */
 
-static int statsd_handle_gauge(char const *name, /* {{{ */
-                               char const *value_str) {
+static int statsd_handle_gauge(c_avl_tree_t *tree, /* {{{ */
+                               char const *name, char const *value_str) {
   value_t value;
   int status;
 
@@ -263,13 +325,14 @@ static int statsd_handle_gauge(char const *name, /* {{{ */
     return status;
 
   if ((value_str[0] == '+') || (value_str[0] == '-'))
-    return statsd_metric_add(name, (double)value.gauge, STATSD_GAUGE);
+    return statsd_metric_add(tree, name, (double)value.gauge, STATSD_GAUGE);
   else
-    return statsd_metric_set(name, (double)value.gauge, STATSD_GAUGE);
+    return statsd_metric_set(tree, name, (double)value.gauge, STATSD_GAUGE);
 } /* }}} int statsd_handle_gauge */
 
-static int statsd_handle_timer(char const *name, /* {{{ */
-                               char const *value_str, char const *extra) {
+static int statsd_handle_timer(c_avl_tree_t *tree, /* {{{ */
+                               char const *name, char const *value_str,
+                               char const *extra) {
   statsd_metric_t *metric;
   value_t value_ms;
   value_t scale;
@@ -296,40 +359,42 @@ static int statsd_handle_timer(char const *name, /* {{{ */
 
   value = MS_TO_CDTIME_T(value_ms.gauge / scale.gauge);
 
-  pthread_mutex_lock(&metrics_lock);
-
-  metric = statsd_metric_lookup_unsafe(name, STATSD_TIMER);
-  if (metric == NULL) {
-    pthread_mutex_unlock(&metrics_lock);
+  metric = statsd_metric_get_unsafe(tree, name, STATSD_TIMER);
+  if (metric == NULL)
     return -1;
-  }
 
   if (metric->latency == NULL)
-    metric->latency = latency_counter_create();
-  if (metric->latency == NULL) {
-    pthread_mutex_unlock(&metrics_lock);
+    metric->latency = latency_counter_create_type(conf_timer_histogram);
+  if (metric->latency == NULL)
     return -1;
-  }
 
   latency_counter_add(metric->latency, value);
   metric->updates_num++;
 
-  pthread_mutex_unlock(&metrics_lock);
   return 0;
 } /* }}} int statsd_handle_timer */
 
-static int statsd_handle_set(char const *name, /* {{{ */
-                             char const *set_key_orig) {
+static int statsd_handle_set(c_avl_tree_t *tree, /* {{{ */
+                             char const *name, char const *set_key_orig) {
   statsd_metric_t *metric = NULL;
   char *set_key;
   int status;
 
-  pthread_mutex_lock(&metrics_lock);
-
-  metric = statsd_metric_lookup_unsafe(name, STATSD_SET);
-  if (metric == NULL) {
-    pthread_mutex_unlock(&metrics_lock);
+  metric = statsd_metric_get_unsafe(tree, name, STATSD_SET);
+  if (metric == NULL)
     return -1;
+
+  if (conf_set_precision > 0) {
+    if (metric->hll == NULL)
+      metric->hll = hll_create(conf_set_precision);
+    if (metric->hll == NULL) {
+      ERROR("statsd plugin: hll_create failed.");
+      return -1;
+    }
+
+    hll_add(metric->hll, set_key_orig);
+    metric->updates_num++;
+    return 0;
   }
 
   /* Make sure metric->set exists. */
@@ -337,21 +402,18 @@ static int statsd_handle_set(char const *name, /* {{{ */
     metric->set = c_avl_create((int (*)(const void *, const void *))strcmp);
 
   if (metric->set == NULL) {
-    pthread_mutex_unlock(&metrics_lock);
     ERROR("statsd plugin: c_avl_create failed.");
     return -1;
   }
 
   set_key = strdup(set_key_orig);
   if (set_key == NULL) {
-    pthread_mutex_unlock(&metrics_lock);
     ERROR("statsd plugin: strdup failed.");
     return -1;
   }
 
   status = c_avl_insert(metric->set, set_key, /* value = */ NULL);
   if (status < 0) {
-    pthread_mutex_unlock(&metrics_lock);
     ERROR("statsd plugin: c_avl_insert (\"%s\") failed with status %i.",
           set_key, status);
     sfree(set_key);
@@ -363,11 +425,11 @@ static int statsd_handle_set(char const *name, /* {{{ */
 
   metric->updates_num++;
 
-  pthread_mutex_unlock(&metrics_lock);
   return 0;
 } /* }}} int statsd_handle_set */
 
-static int statsd_parse_line(char *buffer) /* {{{ */
+/* Must hold the lock protecting "tree" when calling this function. */
+static int statsd_parse_line(c_avl_tree_t *tree, char *buffer) /* {{{ */
 {
   char *name = buffer;
   char *value;
@@ -393,23 +455,24 @@ static int statsd_parse_line(char *buffer) /* {{{ */
   }
 
   if (strcmp("c", type) == 0)
-    return statsd_handle_counter(name, value, extra);
+    return statsd_handle_counter(tree, name, value, extra);
   else if (strcmp("ms", type) == 0)
-    return statsd_handle_timer(name, value, extra);
+    return statsd_handle_timer(tree, name, value, extra);
 
   /* extra is only valid for counters and timers */
   if (extra != NULL)
     return -1;
 
   if (strcmp("g", type) == 0)
-    return statsd_handle_gauge(name, value);
+    return statsd_handle_gauge(tree, name, value);
   else if (strcmp("s", type) == 0)
-    return statsd_handle_set(name, value);
+    return statsd_handle_set(tree, name, value);
   else
     return -1;
 } /* }}} void statsd_parse_line */
 
-static void statsd_parse_buffer(char *buffer) /* {{{ */
+/* Must hold the lock protecting "tree" when calling this function. */
+static void statsd_parse_buffer(c_avl_tree_t *tree, char *buffer) /* {{{ */
 {
   while (buffer != NULL) {
     char orig[64];
@@ -429,7 +492,7 @@ static void statsd_parse_buffer(char *buffer) /* {{{ */
 
     sstrncpy(orig, buffer, sizeof(orig));
 
-    status = statsd_parse_line(buffer);
+    status = statsd_parse_line(tree, buffer);
     if (status != 0)
       ERROR("statsd plugin: Unable to parse line: \"%s\"", orig);
 
@@ -437,32 +500,80 @@ static void statsd_parse_buffer(char *buffer) /* {{{ */
   }
 } /* }}} void statsd_parse_buffer */
 
-static void statsd_network_read(int fd) /* {{{ */
-{
-  char buffer[4096];
-  size_t buffer_size;
-  ssize_t status;
+/* Reads up to "buffers_num" datagrams from "fd" into "buffers", each of which
+ * is STATSD_BUFFER_SIZE bytes long, and stores their sizes in "sizes". Returns
+ * the number of datagrams read, zero if none was available. */
+static int statsd_network_receive(int fd, char **buffers, /* {{{ */
+                                  size_t *sizes, size_t buffers_num) {
+#if HAVE_RECVMMSG
+  struct mmsghdr msgs[STATSD_BATCH_MAX];
+  struct iovec iovs[STATSD_BATCH_MAX];
+
+  assert(buffers_num <= STATSD_BATCH_MAX);
+  memset(msgs, 0, sizeof(*msgs) * buffers_num);
+  for (size_t i = 0; i < buffers_num; i++) {
+    iovs[i].iov_base = buffers[i];
+    iovs[i].iov_len = STATSD_BUFFER_SIZE;
+    msgs[i].msg_hdr.msg_iov = iovs + i;
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
 
-  status = recv(fd, buffer, sizeof(buffer), /* flags = */ MSG_DONTWAIT);
-  if (status < 0) {
+  int status = recvmmsg(fd, msgs, (unsigned int)buffers_num, MSG_DONTWAIT,
+                        /* timeout = */ NULL);
+  if (status < 0)
+    return ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+               ? 0
+               : -1;
+
+  for (int i = 0; i < status; i++)
+    sizes[i] = (size_t)msgs[i].msg_len;
+  return status;
+#else
+  size_t received = 0;
+  while (received < buffers_num) {
+    ssize_t status = recv(fd, buffers[received], STATSD_BUFFER_SIZE,
+                          /* flags = */ MSG_DONTWAIT);
+    if (status < 0) {
+      if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+        break;
+      return -1;
+    }
 
-    if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
-      return;
+    sizes[received] = (size_t)status;
+    received++;
+  }
+
+  return (int)received;
+#endif
+} /* }}} int statsd_network_receive */
+
+static void statsd_network_read(statsd_shard_t *shard, int fd, /* {{{ */
+                                char **buffers) {
+  size_t sizes[STATSD_BATCH_MAX];
 
+  int status = statsd_network_receive(fd, buffers, sizes, STATSD_BATCH_MAX);
+  if (status < 0) {
     ERROR("statsd plugin: recv(2) failed: %s", STRERRNO);
     return;
   }
 
-  buffer_size = (size_t)status;
-  if (buffer_size >= sizeof(buffer))
-    buffer_size = sizeof(buffer) - 1;
-  buffer[buffer_size] = 0;
+  if (status == 0)
+    return;
+
+  pthread_mutex_lock(&shard->lock);
+  for (int i = 0; i < status; i++) {
+    size_t buffer_size = sizes[i];
+    if (buffer_size >= STATSD_BUFFER_SIZE)
+      buffer_size = STATSD_BUFFER_SIZE - 1;
+    buffers[i][buffer_size] = 0;
 
-  statsd_parse_buffer(buffer);
+    statsd_parse_buffer(shard->tree, buffers[i]);
+  }
+  pthread_mutex_unlock(&shard->lock);
 } /* }}} void statsd_network_read */
 
 static int statsd_network_init(struct pollfd **ret_fds, /* {{{ */
-                               size_t *ret_fds_num) {
+                               size_t *ret_fds_num, bool reuse_port) {
   struct pollfd *fds = NULL;
   size_t fds_num = 0;
 
@@ -506,6 +617,19 @@ static int statsd_network_init(struct pollfd **ret_fds, /* {{{ */
       continue;
     }
 
+#ifdef SO_REUSEPORT
+    /* let the kernel distribute packets between the receive threads */
+    if (reuse_port &&
+        (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &(int){1}, sizeof(int)) ==
+         -1)) {
+      ERROR("statsd plugin: setsockopt (reuseport): %s", STRERRNO);
+      close(fd);
+      continue;
+    }
+#else
+    assert(!reuse_port);
+#endif
+
     getnameinfo(ai_ptr->ai_addr, ai_ptr->ai_addrlen, str_node, sizeof(str_node),
                 str_service, sizeof(str_service),
                 NI_DGRAM | NI_NUMERICHOST | NI_NUMERICSERV);
@@ -551,16 +675,27 @@ static int statsd_network_init(struct pollfd **ret_fds, /* {{{ */
 
 static void *statsd_network_thread(void *args) /* {{{ */
 {
+  statsd_shard_t *shard = args;
+  char *buffers[STATSD_BATCH_MAX] = {NULL};
   struct pollfd *fds = NULL;
   size_t fds_num = 0;
   int status;
 
-  status = statsd_network_init(&fds, &fds_num);
+  status = statsd_network_init(&fds, &fds_num, shards_num > 1);
   if (status != 0) {
     ERROR("statsd plugin: Unable to open listening sockets.");
     pthread_exit((void *)0);
   }
 
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(buffers); i++) {
+    buffers[i] = malloc(STATSD_BUFFER_SIZE);
+    if (buffers[i] == NULL) {
+      ERROR("statsd plugin: malloc failed.");
+      network_thread_shutdown = true;
+      break;
+    }
+  }
+
   while (!network_thread_shutdown) {
     status = poll(fds, (nfds_t)fds_num, /* timeout = */ -1);
     if (status < 0) {
@@ -576,12 +711,14 @@ static void *statsd_network_thread(void *args) /* {{{ */
       if ((fds[i].revents & (POLLIN | POLLPRI)) == 0)
         continue;
 
-      statsd_network_read(fds[i].fd);
+      statsd_network_read(shard, fds[i].fd, buffers);
       fds[i].revents = 0;
     }
   } /* while (!network_thread_shutdown) */
 
   /* Clean up */
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(buffers); i++)
+    sfree(buffers[i]);
   for (size_t i = 0; i < fds_num; i++)
     close(fds[i].fd);
   sfree(fds);
@@ -619,6 +756,53 @@ static int statsd_config_timer_percentile(oconfig_item_t *ci) /* {{{ */
   return 0;
 } /* }}} int statsd_config_timer_percentile */
 
+static int statsd_config_receive_threads(oconfig_item_t *ci) /* {{{ */
+{
+  int tmp = 0;
+  int status;
+
+  status = cf_util_get_int(ci, &tmp);
+  if (status != 0)
+    return status;
+
+  if (tmp < 1) {
+    ERROR("statsd plugin: \"%s\" must be at least 1.", ci->key);
+    return ERANGE;
+  }
+
+#ifndef SO_REUSEPORT
+  if (tmp > 1) {
+    WARNING("statsd plugin: \"%s\" greater than 1 requires SO_REUSEPORT, "
+            "which is not available on this system.",
+            ci->key);
+    return EINVAL;
+  }
+#endif
+
+  conf_receive_threads = (size_t)tmp;
+  return 0;
+} /* }}} int statsd_config_receive_threads */
+
+static int statsd_config_set_precision(oconfig_item_t *ci) /* {{{ */
+{
+  int tmp = 0;
+  int status;
+
+  status = cf_util_get_int(ci, &tmp);
+  if (status != 0)
+    return status;
+
+  if ((tmp != 0) &&
+      ((tmp < HLL_PRECISION_MIN) || (tmp > HLL_PRECISION_MAX))) {
+    ERROR("statsd plugin: \"%s\" must be zero or between %d and %d.",
+          ci->key, HLL_PRECISION_MIN, HLL_PRECISION_MAX);
+    return ERANGE;
+  }
+
+  conf_set_precision = tmp;
+  return 0;
+} /* }}} int statsd_config_set_precision */
+
 static int statsd_config(oconfig_item_t *ci) /* {{{ */
 {
   for (int i = 0; i < ci->children_num; i++) {
@@ -628,6 +812,8 @@ static int statsd_config(oconfig_item_t *ci) /* {{{ */
       cf_util_get_string(child, &conf_node);
     else if (strcasecmp("Port", child->key) == 0)
       cf_util_get_service(child, &conf_service);
+    else if (strcasecmp("ReceiveThreads", child->key) == 0)
+      statsd_config_receive_threads(child);
     else if (strcasecmp("DeleteCounters", child->key) == 0)
       cf_util_get_boolean(child, &conf_delete_counters);
     else if (strcasecmp("DeleteTimers", child->key) == 0)
@@ -636,6 +822,8 @@ static int statsd_config(oconfig_item_t *ci) /* {{{ */
       cf_util_get_boolean(child, &conf_delete_gauges);
     else if (strcasecmp("DeleteSets", child->key) == 0)
       cf_util_get_boolean(child, &conf_delete_sets);
+    else if (strcasecmp("SetPrecision", child->key) == 0)
+      statsd_config_set_precision(child);
     else if (strcasecmp("CounterSum", child->key) == 0)
       cf_util_get_boolean(child, &conf_counter_sum);
     else if (strcasecmp("TimerLower", child->key) == 0)
@@ -648,6 +836,8 @@ static int statsd_config(oconfig_item_t *ci) /* {{{ */
       cf_util_get_boolean(child, &conf_timer_count);
     else if (strcasecmp("TimerPercentile", child->key) == 0)
       statsd_config_timer_percentile(child);
+    else if (strcasecmp("TimerHistogram", child->key) == 0)
+      latency_config_get_histogram(child, &conf_timer_histogram);
     else
       ERROR("statsd plugin: The \"%s\" config option is not valid.",
             child->key);
@@ -656,27 +846,80 @@ static int statsd_config(oconfig_item_t *ci) /* {{{ */
   return 0;
 } /* }}} int statsd_config */
 
+/* Stops the receive threads and frees the shards. */
+static void statsd_shards_destroy(void) /* {{{ */
+{
+  network_thread_shutdown = true;
+  for (size_t i = 0; i < shards_num; i++) {
+    statsd_shard_t *shard = shards + i;
+
+    if (shard->thread_running) {
+      pthread_kill(shard->thread, SIGTERM);
+      pthread_join(shard->thread, /* retval = */ NULL);
+    }
+    shard->thread_running = false;
+  }
+  network_thread_shutdown = false;
+
+  for (size_t i = 0; i < shards_num; i++) {
+    statsd_tree_free(shards[i].tree);
+    pthread_mutex_destroy(&shards[i].lock);
+  }
+  sfree(shards);
+  shards_num = 0;
+} /* }}} void statsd_shards_destroy */
+
 static int statsd_init(void) /* {{{ */
 {
   pthread_mutex_lock(&metrics_lock);
   if (metrics_tree == NULL)
     metrics_tree = c_avl_create((int (*)(const void *, const void *))strcmp);
+  pthread_mutex_unlock(&metrics_lock);
+
+  if (metrics_tree == NULL) {
+    ERROR("statsd plugin: c_avl_create failed.");
+    return -1;
+  }
+
+  if (shards != NULL)
+    return 0;
+
+  shards = calloc(conf_receive_threads, sizeof(*shards));
+  if (shards == NULL) {
+    ERROR("statsd plugin: calloc failed.");
+    return ENOMEM;
+  }
 
-  if (!network_thread_running) {
+  for (size_t i = 0; i < conf_receive_threads; i++) {
+    statsd_shard_t *shard = shards + i;
+
+    pthread_mutex_init(&shard->lock, /* attr = */ NULL);
+    /* Only the initialized shards are cleaned up on failure. */
+    shards_num = i + 1;
+
+    shard->tree = c_avl_create((int (*)(const void *, const void *))strcmp);
+    if (shard->tree == NULL) {
+      ERROR("statsd plugin: c_avl_create failed.");
+      statsd_shards_destroy();
+      return -1;
+    }
+  }
+
+  for (size_t i = 0; i < shards_num; i++) {
+    statsd_shard_t *shard = shards + i;
+    char name[32];
     int status;
 
-    status = pthread_create(&network_thread,
-                            /* attr = */ NULL, statsd_network_thread,
-                            /* args = */ NULL);
+    ssnprintf(name, sizeof(name), "statsd recv#%" PRIsz, i);
+    status = plugin_thread_create(&shard->thread, statsd_network_thread, shard,
+                                  name);
     if (status != 0) {
-      pthread_mutex_unlock(&metrics_lock);
-      ERROR("statsd plugin: pthread_create failed: %s", STRERRNO);
+      ERROR("statsd plugin: pthread_create failed: %s", STRERROR(status));
+      statsd_shards_destroy();
       return status;
     }
+    shard->thread_running = true;
   }
-  network_thread_running = true;
-
-  pthread_mutex_unlock(&metrics_lock);
 
   return 0;
 } /* }}} int statsd_init */
@@ -690,6 +933,8 @@ static int statsd_metric_clear_set_unsafe(statsd_metric_t *metric) /* {{{ */
   if ((metric == NULL) || (metric->type != STATSD_SET))
     return EINVAL;
 
+  hll_reset(metric->hll);
+
   if (metric->set == NULL)
     return 0;
 
@@ -786,7 +1031,9 @@ static int statsd_metric_submit_unsafe(char const *name,
     latency_counter_reset(metric->latency);
     return 0;
   } else if (metric->type == STATSD_SET) {
-    if (metric->set == NULL)
+    if (metric->hll != NULL)
+      vl.values[0].gauge = nearbyint(hll_count(metric->hll));
+    else if (metric->set == NULL)
       vl.values[0].gauge = 0.0;
     else
       vl.values[0].gauge = (gauge_t)c_avl_size(metric->set);
@@ -817,6 +1064,103 @@ static int statsd_metric_submit_unsafe(char const *name,
   return plugin_dispatch_values(&vl);
 } /* }}} int statsd_metric_submit_unsafe */
 
+/* Merges "src", taken from a shard, into "dst", which lives in "metrics_tree".
+ * Must hold metrics_lock when calling this function. */
+static int statsd_metric_merge_unsafe(statsd_metric_t *dst, /* {{{ */
+                                      statsd_metric_t *src) {
+  switch (src->type) {
+  case STATSD_COUNTER:
+    dst->value += src->value;
+    break;
+
+  case STATSD_GAUGE:
+    if (src->value_set)
+      dst->value = src->value;
+    else
+      dst->value += src->value;
+    break;
+
+  case STATSD_TIMER:
+    if (src->latency == NULL)
+      break;
+    if (dst->latency == NULL) {
+      dst->latency = src->latency;
+      src->latency = NULL;
+    } else if (latency_counter_merge(dst->latency, src->latency) != 0) {
+      ERROR("statsd plugin: latency_counter_merge failed.");
+      return -1;
+    }
+    break;
+
+  case STATSD_SET:
+    if (src->hll != NULL) {
+      if (dst->hll == NULL) {
+        dst->hll = src->hll;
+        src->hll = NULL;
+      } else if (hll_merge(dst->hll, src->hll) != 0) {
+        ERROR("statsd plugin: hll_merge failed.");
+        return -1;
+      }
+    }
+
+    if (src->set == NULL)
+      break;
+    if (dst->set == NULL) {
+      dst->set = src->set;
+      src->set = NULL;
+      break;
+    }
+
+    void *key;
+    void *value;
+    while (c_avl_pick(src->set, &key, &value) == 0) {
+      if (c_avl_insert(dst->set, key, /* value = */ NULL) != 0)
+        sfree(key);
+    }
+    break;
+  }
+
+  dst->updates_num += src->updates_num;
+  return 0;
+} /* }}} int statsd_metric_merge_unsafe */
+
+/* Takes over the changes collected by "shard" since the last call and merges
+ * them into "metrics_tree". Must hold metrics_lock when calling this
+ * function. */
+static int statsd_shard_merge_unsafe(statsd_shard_t *shard) /* {{{ */
+{
+  c_avl_tree_t *tree;
+  c_avl_tree_t *tmp;
+  void *key;
+  void *value;
+
+  tmp = c_avl_create((int (*)(const void *, const void *))strcmp);
+  if (tmp == NULL) {
+    ERROR("statsd plugin: c_avl_create failed.");
+    return ENOMEM;
+  }
+
+  pthread_mutex_lock(&shard->lock);
+  tree = shard->tree;
+  shard->tree = tmp;
+  pthread_mutex_unlock(&shard->lock);
+
+  while (c_avl_pick(tree, &key, &value) == 0) {
+    statsd_metric_t *src = value;
+    statsd_metric_t *dst;
+
+    dst = statsd_metric_lookup_unsafe(metrics_tree, key, src->type);
+    if (dst != NULL)
+      statsd_metric_merge_unsafe(dst, src);
+
+    sfree(key);
+    statsd_metric_free(src);
+  }
+  c_avl_destroy(tree);
+
+  return 0;
+} /* }}} int statsd_shard_merge_unsafe */
+
 static int statsd_read(void) /* {{{ */
 {
   c_avl_iterator_t *iter;
@@ -833,6 +1177,9 @@ static int statsd_read(void) /* {{{ */
     return 0;
   }
 
+  for (size_t i = 0; i < shards_num; i++)
+    statsd_shard_merge_unsafe(shards + i);
+
   iter = c_avl_get_iterator(metrics_tree);
   while (c_avl_iterator_next(iter, (void *)&name, (void *)&metric) == 0) {
     if ((metric->updates_num == 0) &&
@@ -880,23 +1227,11 @@ static int statsd_read(void) /* {{{ */
 
 static int statsd_shutdown(void) /* {{{ */
 {
-  void *key;
-  void *value;
-
-  if (network_thread_running) {
-    network_thread_shutdown = true;
-    pthread_kill(network_thread, SIGTERM);
-    pthread_join(network_thread, /* retval = */ NULL);
-  }
-  network_thread_running = false;
+  statsd_shards_destroy();
 
   pthread_mutex_lock(&metrics_lock);
 
-  while (c_avl_pick(metrics_tree, &key, &value) == 0) {
-    sfree(key);
-    statsd_metric_free(value);
-  }
-  c_avl_destroy(metrics_tree);
+  statsd_tree_free(metrics_tree);
   metrics_tree = NULL;
 
   sfree(conf_node);
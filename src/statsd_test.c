@@ -0,0 +1,211 @@
+/**
+ * collectd - src/statsd_test.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "statsd.c" /* (sic) */
+
+#include "testing.h"
+
+static statsd_shard_t test_shards[2];
+
+static int shards_setup(void) {
+  metrics_tree = c_avl_create((int (*)(const void *, const void *))strcmp);
+  if (metrics_tree == NULL)
+    return -1;
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(test_shards); i++) {
+    pthread_mutex_init(&test_shards[i].lock, /* attr = */ NULL);
+    test_shards[i].tree =
+        c_avl_create((int (*)(const void *, const void *))strcmp);
+    if (test_shards[i].tree == NULL)
+      return -1;
+  }
+
+  return 0;
+}
+
+static void shards_teardown(void) {
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(test_shards); i++) {
+    statsd_tree_free(test_shards[i].tree);
+    test_shards[i].tree = NULL;
+    pthread_mutex_destroy(&test_shards[i].lock);
+  }
+
+  statsd_tree_free(metrics_tree);
+  metrics_tree = NULL;
+}
+
+static int shard_parse(size_t shard, char const *line) {
+  char buffer[256];
+
+  sstrncpy(buffer, line, sizeof(buffer));
+  return statsd_parse_line(test_shards[shard].tree, buffer);
+}
+
+static int shards_merge(void) {
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(test_shards); i++) {
+    int status = statsd_shard_merge_unsafe(test_shards + i);
+    if (status != 0)
+      return status;
+  }
+  return 0;
+}
+
+static statsd_metric_t *metric_get(char const *key) {
+  statsd_metric_t *metric = NULL;
+
+  if (c_avl_get(metrics_tree, key, (void *)&metric) != 0)
+    return NULL;
+  return metric;
+}
+
+DEF_TEST(merge_counter) {
+  CHECK_ZERO(shards_setup());
+
+  CHECK_ZERO(shard_parse(0, "foo:3|c"));
+  CHECK_ZERO(shard_parse(0, "foo:1|c"));
+  CHECK_ZERO(shard_parse(1, "foo:4|c"));
+  CHECK_ZERO(shards_merge());
+
+  statsd_metric_t *m = metric_get("c:foo");
+  CHECK_NOT_NULL(m);
+  EXPECT_EQ_DOUBLE(8.0, m->value);
+  EXPECT_EQ_UINT64(3, m->updates_num);
+
+  /* Shards only hold the changes since the last merge. */
+  CHECK_ZERO(shard_parse(1, "foo:2|c"));
+  CHECK_ZERO(shards_merge());
+  EXPECT_EQ_DOUBLE(10.0, m->value);
+  EXPECT_EQ_UINT64(4, m->updates_num);
+
+  shards_teardown();
+  return 0;
+}
+
+DEF_TEST(merge_gauge) {
+  struct {
+    char const *shard0[2];
+    char const *shard1[2];
+    double want;
+  } cases[] = {
+      /* absolute values replace the gauge */
+      {{"bar:10|g", NULL}, {NULL, NULL}, 10.0},
+      /* relative values from all shards add up */
+      {{"bar:+5|g", NULL}, {"bar:-2|g", NULL}, 13.0},
+      /* an absolute value in a later shard wins */
+      {{"bar:+1|g", NULL}, {"bar:20|g", NULL}, 20.0},
+      /* changes after an absolute value are relative to it */
+      {{"bar:7|g", "bar:+1|g"}, {"bar:+2|g", NULL}, 10.0},
+  };
+
+  CHECK_ZERO(shards_setup());
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
+    for (size_t j = 0; j < 2; j++) {
+      if (cases[i].shard0[j] != NULL)
+        CHECK_ZERO(shard_parse(0, cases[i].shard0[j]));
+      if (cases[i].shard1[j] != NULL)
+        CHECK_ZERO(shard_parse(1, cases[i].shard1[j]));
+    }
+    CHECK_ZERO(shards_merge());
+
+    statsd_metric_t *m = metric_get("g:bar");
+    CHECK_NOT_NULL(m);
+    EXPECT_EQ_DOUBLE(cases[i].want, m->value);
+  }
+
+  shards_teardown();
+  return 0;
+}
+
+DEF_TEST(merge_timer) {
+  CHECK_ZERO(shards_setup());
+
+  CHECK_ZERO(shard_parse(0, "baz:10|ms"));
+  CHECK_ZERO(shard_parse(1, "baz:30|ms"));
+  CHECK_ZERO(shard_parse(1, "baz:20|ms"));
+  CHECK_ZERO(shards_merge());
+
+  statsd_metric_t *m = metric_get("t:baz");
+  CHECK_NOT_NULL(m);
+  CHECK_NOT_NULL(m->latency);
+  EXPECT_EQ_UINT64(3, latency_counter_get_num(m->latency));
+  EXPECT_EQ_UINT64(MS_TO_CDTIME_T(10), latency_counter_get_min(m->latency));
+  EXPECT_EQ_UINT64(MS_TO_CDTIME_T(30), latency_counter_get_max(m->latency));
+  EXPECT_EQ_UINT64(MS_TO_CDTIME_T(60), latency_counter_get_sum(m->latency));
+
+  shards_teardown();
+  return 0;
+}
+
+DEF_TEST(merge_set) {
+  CHECK_ZERO(shards_setup());
+
+  CHECK_ZERO(shard_parse(0, "qux:a|s"));
+  CHECK_ZERO(shard_parse(0, "qux:b|s"));
+  CHECK_ZERO(shard_parse(1, "qux:b|s"));
+  CHECK_ZERO(shard_parse(1, "qux:c|s"));
+  CHECK_ZERO(shards_merge());
+
+  statsd_metric_t *m = metric_get("s:qux");
+  CHECK_NOT_NULL(m);
+  CHECK_NOT_NULL(m->set);
+  EXPECT_EQ_INT(3, c_avl_size(m->set));
+
+  CHECK_ZERO(shard_parse(1, "qux:d|s"));
+  CHECK_ZERO(shards_merge());
+  EXPECT_EQ_INT(4, c_avl_size(m->set));
+
+  shards_teardown();
+  return 0;
+}
+
+DEF_TEST(merge_set_hll) {
+  conf_set_precision = 10;
+  CHECK_ZERO(shards_setup());
+
+  CHECK_ZERO(shard_parse(0, "qux:a|s"));
+  CHECK_ZERO(shard_parse(0, "qux:b|s"));
+  CHECK_ZERO(shard_parse(1, "qux:b|s"));
+  CHECK_ZERO(shard_parse(1, "qux:c|s"));
+  CHECK_ZERO(shards_merge());
+
+  statsd_metric_t *m = metric_get("s:qux");
+  CHECK_NOT_NULL(m);
+  CHECK_NOT_NULL(m->hll);
+  EXPECT_EQ_PTR(NULL, m->set);
+  EXPECT_EQ_DOUBLE(3.0, nearbyint(hll_count(m->hll)));
+
+  shards_teardown();
+  conf_set_precision = 0;
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(merge_counter);
+  RUN_TEST(merge_gauge);
+  RUN_TEST(merge_timer);
+  RUN_TEST(merge_set);
+  RUN_TEST(merge_set_hll);
+
+  END_TEST;
+}
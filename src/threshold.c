@@ -85,6 +85,11 @@ static int ut_threshold_add(const threshold_t *th) { /* {{{ */
   if (th_ptr == NULL) /* no such threshold yet */
   {
     status = c_avl_insert(threshold_tree, name_copy, th_copy);
+    if (status == 0) {
+      status = threshold_index_insert(th_copy);
+      if (status != 0)
+        c_avl_remove(threshold_tree, name, NULL, NULL);
+    }
   } else /* th_ptr points to the last threshold in the list */
   {
     th_ptr->next = th_copy;
@@ -702,6 +707,32 @@ static int ut_missing(const value_list_t *vl,
   return 0;
 } /* }}} int ut_missing */
 
+static int ut_shutdown(void) { /* {{{ */
+  char *name;
+  threshold_t *th;
+
+  pthread_mutex_lock(&threshold_lock);
+
+  threshold_index_destroy();
+
+  if (threshold_tree != NULL) {
+    while (c_avl_pick(threshold_tree, (void *)&name, (void *)&th) == 0) {
+      sfree(name);
+      while (th != NULL) {
+        threshold_t *next = th->next;
+        sfree(th);
+        th = next;
+      }
+    }
+    c_avl_destroy(threshold_tree);
+    threshold_tree = NULL;
+  }
+
+  pthread_mutex_unlock(&threshold_lock);
+
+  return 0;
+} /* }}} int ut_shutdown */
+
 static int ut_config(oconfig_item_t *ci) { /* {{{ */
   int status = 0;
   int old_size = c_avl_size(threshold_tree);
@@ -746,6 +777,7 @@ static int ut_config(oconfig_item_t *ci) { /* {{{ */
                             /* user data = */ NULL);
     plugin_register_write("threshold", ut_check_threshold,
                           /* user data = */ NULL);
+    plugin_register_shutdown("threshold", ut_shutdown);
   }
 
   return status;
@@ -35,6 +35,7 @@
 #include "utils/cmds/listval.h"
 #include "utils/cmds/putnotif.h"
 #include "utils/cmds/putval.h"
+#include "utils/cmds/readstats.h"
 
 #include <sys/stat.h>
 #include <sys/un.h>
@@ -253,6 +254,8 @@ static void *us_handle_client(void *arg) {
       handle_putnotif(fhout, buffer);
     } else if (strcasecmp(fields[0], "flush") == 0) {
       cmd_handle_flush(fhout, buffer);
+    } else if (strcasecmp(fields[0], "readstats") == 0) {
+      handle_readstats(fhout, buffer);
     } else {
       if (fprintf(fhout, "-1 Unknown command: %s\n", fields[0]) < 0) {
         WARNING("unixsock plugin: failed to write to socket #%i: %s",
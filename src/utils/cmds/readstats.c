@@ -0,0 +1,125 @@
+/**
+ * collectd - src/utils/cmds/readstats.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "collectd.h"
+
+#include "plugin.h"
+#include "utils/common/common.h"
+
+#include "utils/cmds/parse_option.h" /* for `parse_string' */
+#include "utils/cmds/readstats.h"
+
+#define print_to_socket(fh, ...)                                               \
+  do {                                                                         \
+    if (fprintf(fh, __VA_ARGS__) < 0) {                                        \
+      WARNING("handle_readstats: failed to write to socket #%i: %s",           \
+              fileno(fh), STRERRNO);                                           \
+      sfree(stats);                                                            \
+      return -1;                                                               \
+    }                                                                          \
+    fflush(fh);                                                                \
+  } while (0)
+
+/* READSTATS [<limit>]
+ *
+ * Returns the read callbacks with the highest average execution time, one per
+ * line: the number of calls, the average, percentile and maximum execution
+ * time, the average, percentile and maximum scheduling lag (all in seconds)
+ * and the name of the callback. A limit of zero returns all callbacks. */
+int handle_readstats(FILE *fh, char *buffer) {
+  plugin_read_stats_t *stats = NULL;
+  size_t stats_num = 0;
+  size_t limit = READSTATS_DEFAULT_LIMIT;
+  char *command = NULL;
+  int status;
+
+  if ((fh == NULL) || (buffer == NULL))
+    return -1;
+
+  DEBUG("utils_cmd_readstats: handle_readstats (fh = %p, buffer = %s);",
+        (void *)fh, buffer);
+
+  status = parse_string(&buffer, &command);
+  if (status != 0) {
+    print_to_socket(fh, "-1 Cannot parse command.\n");
+    return -1;
+  }
+  assert(command != NULL);
+
+  if (strcasecmp("READSTATS", command) != 0) {
+    print_to_socket(fh, "-1 Unexpected command: `%s'.\n", command);
+    return -1;
+  }
+
+  if (*buffer != 0) {
+    char *limit_str = NULL;
+    char *endptr = NULL;
+    long tmp;
+
+    status = parse_string(&buffer, &limit_str);
+    if (status != 0) {
+      print_to_socket(fh, "-1 Cannot parse limit.\n");
+      return -1;
+    }
+
+    errno = 0;
+    tmp = strtol(limit_str, &endptr, 10);
+    if ((errno != 0) || (endptr == limit_str) || (*endptr != 0) || (tmp < 0)) {
+      print_to_socket(fh, "-1 Invalid limit: %s\n", limit_str);
+      return -1;
+    }
+    limit = (size_t)tmp;
+  }
+
+  if (*buffer != 0) {
+    print_to_socket(fh, "-1 Garbage after end of command: %s\n", buffer);
+    return -1;
+  }
+
+  status = plugin_get_read_stats(&stats, &stats_num);
+  if (status != 0) {
+    print_to_socket(fh, "-1 Cannot get read statistics: %s\n",
+                    STRERROR(status));
+    return -1;
+  }
+
+  if ((limit > 0) && (stats_num > limit))
+    stats_num = limit;
+
+  print_to_socket(fh, "%" PRIsz " Callback%s found\n", stats_num,
+                  (stats_num == 1) ? "" : "s");
+  for (size_t i = 0; i < stats_num; i++) {
+    plugin_read_stats_t *s = stats + i;
+    print_to_socket(fh, "%" PRIsz " %.6f %.6f %.6f %.6f %.6f %.6f %s\n",
+                    s->calls, CDTIME_T_TO_DOUBLE(s->exec_average),
+                    CDTIME_T_TO_DOUBLE(s->exec_percentile),
+                    CDTIME_T_TO_DOUBLE(s->exec_max),
+                    CDTIME_T_TO_DOUBLE(s->lag_average),
+                    CDTIME_T_TO_DOUBLE(s->lag_percentile),
+                    CDTIME_T_TO_DOUBLE(s->lag_max), s->name);
+  }
+
+  sfree(stats);
+  return 0;
+} /* int handle_readstats */
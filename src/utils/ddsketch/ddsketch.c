@@ -0,0 +1,304 @@
+/**
+ * collectd - src/utils/ddsketch/ddsketch.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "collectd.h"
+
+#include "utils/ddsketch/ddsketch.h"
+
+/* Absolute values smaller than this are counted as zero, which bounds the
+ * range of bin indexes. */
+#define DDSKETCH_MIN_VALUE 1e-9
+
+/* Contiguous range of bins: bins[i] counts the values with index
+ * "offset + i". */
+typedef struct {
+  uint64_t *bins;
+  size_t bins_num;
+  int offset;
+} ddsketch_store_t;
+
+struct ddsketch_s {
+  double relative_accuracy;
+  double gamma;
+  double log_gamma;
+  size_t max_bins;
+
+  ddsketch_store_t positive;
+  ddsketch_store_t negative;
+  uint64_t zero_count;
+
+  uint64_t count;
+  double min;
+  double max;
+};
+
+static int ddsketch_index(ddsketch_t const *s, double value) /* {{{ */
+{
+  return (int)ceil(log(value) / s->log_gamma);
+} /* }}} int ddsketch_index */
+
+/* Returns the value in the middle of the bin, which is within the relative
+ * accuracy of all values counted in it. */
+static double ddsketch_value(ddsketch_t const *s, int index) /* {{{ */
+{
+  return 2.0 * exp((double)index * s->log_gamma) / (s->gamma + 1.0);
+} /* }}} double ddsketch_value */
+
+/* Makes sure "store" covers "index", collapsing the lowest bins if more than
+ * "max_bins" would be needed. Returns the (possibly collapsed) bin of
+ * "index", or NULL if memory could not be allocated. */
+static uint64_t *store_bin(ddsketch_store_t *store, int index, /* {{{ */
+                           size_t max_bins) {
+  if (store->bins_num == 0) {
+    store->bins = calloc(1, sizeof(*store->bins));
+    if (store->bins == NULL)
+      return NULL;
+    store->bins_num = 1;
+    store->offset = index;
+    return store->bins;
+  }
+
+  int lo = store->offset;
+  int hi = store->offset + (int)store->bins_num - 1;
+  if ((index >= lo) && (index <= hi))
+    return store->bins + (index - lo);
+
+  int new_lo = (index < lo) ? index : lo;
+  int new_hi = (index > hi) ? index : hi;
+  if ((size_t)(new_hi - new_lo + 1) > max_bins)
+    new_lo = new_hi - (int)max_bins + 1;
+
+  size_t new_num = (size_t)(new_hi - new_lo + 1);
+  uint64_t *bins = calloc(new_num, sizeof(*bins));
+  if (bins == NULL)
+    return NULL;
+
+  for (size_t i = 0; i < store->bins_num; i++) {
+    int idx = store->offset + (int)i;
+    if (idx < new_lo)
+      idx = new_lo;
+    bins[idx - new_lo] += store->bins[i];
+  }
+
+  free(store->bins);
+  store->bins = bins;
+  store->bins_num = new_num;
+  store->offset = new_lo;
+
+  if (index < new_lo)
+    index = new_lo;
+  return store->bins + (index - new_lo);
+} /* }}} uint64_t *store_bin */
+
+static int store_add(ddsketch_store_t *store, int index, /* {{{ */
+                     uint64_t count, size_t max_bins) {
+  uint64_t *bin = store_bin(store, index, max_bins);
+  if (bin == NULL)
+    return ENOMEM;
+
+  *bin += count;
+  return 0;
+} /* }}} int store_add */
+
+ddsketch_t *ddsketch_create(double relative_accuracy, /* {{{ */
+                            size_t max_bins) {
+  if (!(relative_accuracy > 0.0) || !(relative_accuracy < 1.0) ||
+      (max_bins == 0))
+    return NULL;
+
+  ddsketch_t *s = calloc(1, sizeof(*s));
+  if (s == NULL)
+    return NULL;
+
+  s->relative_accuracy = relative_accuracy;
+  s->gamma = (1.0 + relative_accuracy) / (1.0 - relative_accuracy);
+  s->log_gamma = log(s->gamma);
+  s->max_bins = max_bins;
+  s->min = NAN;
+  s->max = NAN;
+
+  return s;
+} /* }}} ddsketch_t *ddsketch_create */
+
+void ddsketch_destroy(ddsketch_t *s) /* {{{ */
+{
+  if (s == NULL)
+    return;
+
+  free(s->positive.bins);
+  free(s->negative.bins);
+  free(s);
+} /* }}} void ddsketch_destroy */
+
+void ddsketch_reset(ddsketch_t *s) /* {{{ */
+{
+  if (s == NULL)
+    return;
+
+  /* Keep the allocated bins: the values of the next interval are likely to
+   * fall into the same range. */
+  if (s->positive.bins_num > 0)
+    memset(s->positive.bins, 0,
+           s->positive.bins_num * sizeof(*s->positive.bins));
+  if (s->negative.bins_num > 0)
+    memset(s->negative.bins, 0,
+           s->negative.bins_num * sizeof(*s->negative.bins));
+
+  s->zero_count = 0;
+  s->count = 0;
+  s->min = NAN;
+  s->max = NAN;
+} /* }}} void ddsketch_reset */
+
+int ddsketch_add(ddsketch_t *s, double value) /* {{{ */
+{
+  /* Infinite values have no bin: the index computation would overflow. */
+  if ((s == NULL) || !isfinite(value))
+    return EINVAL;
+
+  int status = 0;
+  if (value >= DDSKETCH_MIN_VALUE)
+    status = store_add(&s->positive, ddsketch_index(s, value), 1, s->max_bins);
+  else if (value <= -DDSKETCH_MIN_VALUE)
+    status = store_add(&s->negative, ddsketch_index(s, -value), 1, s->max_bins);
+  else
+    s->zero_count++;
+
+  if (status != 0)
+    return status;
+
+  s->count++;
+  if (isnan(s->min) || (s->min > value))
+    s->min = value;
+  if (isnan(s->max) || (s->max < value))
+    s->max = value;
+
+  return 0;
+} /* }}} int ddsketch_add */
+
+uint64_t ddsketch_count(ddsketch_t const *s) /* {{{ */
+{
+  return (s != NULL) ? s->count : 0;
+} /* }}} uint64_t ddsketch_count */
+
+double ddsketch_percentile(ddsketch_t const *s, double percent) /* {{{ */
+{
+  if ((s == NULL) || (s->count == 0) || !(percent >= 0.0) ||
+      !(percent <= 100.0))
+    return NAN;
+
+  /* The extremes are tracked exactly. */
+  if (percent == 0.0)
+    return s->min;
+  if (percent == 100.0)
+    return s->max;
+
+  /* Zero-based rank of the requested value. */
+  double rank = (percent / 100.0) * (double)(s->count - 1);
+  uint64_t seen = 0;
+  double value = NAN;
+  bool found = false;
+
+  /* Negative values, starting with the largest magnitude. */
+  for (size_t i = s->negative.bins_num; !found && (i > 0); i--) {
+    seen += s->negative.bins[i - 1];
+    if ((double)seen > rank) {
+      value = -ddsketch_value(s, s->negative.offset + (int)(i - 1));
+      found = true;
+    }
+  }
+
+  if (!found) {
+    seen += s->zero_count;
+    if ((double)seen > rank) {
+      value = 0.0;
+      found = true;
+    }
+  }
+
+  for (size_t i = 0; !found && (i < s->positive.bins_num); i++) {
+    seen += s->positive.bins[i];
+    if ((double)seen > rank) {
+      value = ddsketch_value(s, s->positive.offset + (int)i);
+      found = true;
+    }
+  }
+
+  if (!found)
+    value = s->max;
+
+  /* The bin's representative value may be outside of the observed range. */
+  if (value < s->min)
+    value = s->min;
+  if (value > s->max)
+    value = s->max;
+
+  return value;
+} /* }}} double ddsketch_percentile */
+
+static int store_merge(ddsketch_store_t *dst, /* {{{ */
+                       ddsketch_store_t const *src, size_t max_bins) {
+  if (src->bins_num == 0)
+    return 0;
+
+  /* Make sure the whole range is allocated before adding, so that bins are
+   * only reallocated (at most) twice. */
+  int status = store_add(dst, src->offset, 0, max_bins);
+  if (status == 0)
+    status = store_add(dst, src->offset + (int)src->bins_num - 1, 0, max_bins);
+
+  for (size_t i = 0; (status == 0) && (i < src->bins_num); i++) {
+    if (src->bins[i] == 0)
+      continue;
+    status = store_add(dst, src->offset + (int)i, src->bins[i], max_bins);
+  }
+
+  return status;
+} /* }}} int store_merge */
+
+int ddsketch_merge(ddsketch_t *dst, ddsketch_t const *src) /* {{{ */
+{
+  if ((dst == NULL) || (src == NULL))
+    return EINVAL;
+  if ((dst->relative_accuracy != src->relative_accuracy) ||
+      (dst->max_bins != src->max_bins))
+    return EINVAL;
+
+  if (src->count == 0)
+    return 0;
+
+  int status = store_merge(&dst->positive, &src->positive, dst->max_bins);
+  if (status == 0)
+    status = store_merge(&dst->negative, &src->negative, dst->max_bins);
+  if (status != 0)
+    return status;
+
+  dst->zero_count += src->zero_count;
+  dst->count += src->count;
+  if (isnan(dst->min) || (dst->min > src->min))
+    dst->min = src->min;
+  if (isnan(dst->max) || (dst->max < src->max))
+    dst->max = src->max;
+
+  return 0;
+} /* }}} int ddsketch_merge */
@@ -0,0 +1,63 @@
+/**
+ * collectd - src/utils/ddsketch/ddsketch.h
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef UTILS_DDSKETCH_H
+#define UTILS_DDSKETCH_H 1
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/* DDSketch quantile sketch. Values are counted in logarithmically sized bins,
+ * so that every quantile is returned with a relative error of at most
+ * "relative_accuracy". Sketches with the same accuracy can be merged, e.g. to
+ * combine the values of several hosts. When more than "max_bins" bins would be
+ * needed per sign, the bins closest to zero are collapsed, which only affects
+ * the accuracy of the lowest (absolute) values. */
+#define DDSKETCH_DEFAULT_ACCURACY 0.01
+#define DDSKETCH_DEFAULT_MAX_BINS 2048
+
+struct ddsketch_s;
+typedef struct ddsketch_s ddsketch_t;
+
+/* Returns NULL if "relative_accuracy" is not within (0, 1) or "max_bins" is
+ * zero, or allocation fails. */
+ddsketch_t *ddsketch_create(double relative_accuracy, size_t max_bins);
+void ddsketch_destroy(ddsketch_t *s);
+
+void ddsketch_reset(ddsketch_t *s);
+
+/* Returns EINVAL for NaN and infinite values, which are not counted, and
+ * ENOMEM if the bins could not be grown. */
+int ddsketch_add(ddsketch_t *s, double value);
+
+uint64_t ddsketch_count(ddsketch_t const *s);
+
+/* Returns the "percent" percentile, which must be within [0, 100], or NaN if
+ * the sketch is empty. */
+double ddsketch_percentile(ddsketch_t const *s, double percent);
+
+/* Adds all values of "src" to "dst". Returns EINVAL if the sketches have
+ * been created with different parameters. */
+int ddsketch_merge(ddsketch_t *dst, ddsketch_t const *src);
+
+#endif /* UTILS_DDSKETCH_H */
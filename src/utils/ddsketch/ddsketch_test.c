@@ -0,0 +1,169 @@
+/**
+ * collectd - src/utils/ddsketch/ddsketch_test.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "collectd.h"
+
+#include "testing.h"
+#include "utils/ddsketch/ddsketch.h"
+
+/* Checks that "got" is within the relative accuracy of "want". */
+#define EXPECT_WITHIN_ACCURACY(want, got)                                      \
+  do {                                                                         \
+    double want_ = (want);                                                     \
+    double got_ = (got);                                                       \
+    printf("# want %g, got %g\n", want_, got_);                                \
+    OK(fabs(got_ - want_) <= DDSKETCH_DEFAULT_ACCURACY * fabs(want_) + 1e-9);  \
+  } while (0)
+
+DEF_TEST(create) {
+  ddsketch_t *s;
+
+  EXPECT_EQ_PTR(NULL, ddsketch_create(0.0, DDSKETCH_DEFAULT_MAX_BINS));
+  EXPECT_EQ_PTR(NULL, ddsketch_create(1.0, DDSKETCH_DEFAULT_MAX_BINS));
+  EXPECT_EQ_PTR(NULL, ddsketch_create(DDSKETCH_DEFAULT_ACCURACY, 0));
+
+  CHECK_NOT_NULL(s = ddsketch_create(DDSKETCH_DEFAULT_ACCURACY,
+                                     DDSKETCH_DEFAULT_MAX_BINS));
+  EXPECT_EQ_UINT64(0, ddsketch_count(s));
+  OK(isnan(ddsketch_percentile(s, 50.0)));
+  EXPECT_EQ_INT(EINVAL, ddsketch_add(s, NAN));
+
+  ddsketch_destroy(s);
+  return 0;
+}
+
+DEF_TEST(percentile) {
+  ddsketch_t *s;
+
+  CHECK_NOT_NULL(s = ddsketch_create(DDSKETCH_DEFAULT_ACCURACY,
+                                     DDSKETCH_DEFAULT_MAX_BINS));
+
+  /* 1 .. 10000, added in a scrambled order. */
+  for (int i = 0; i < 10000; i++)
+    CHECK_ZERO(ddsketch_add(s, (double)(((i * 7919) % 10000) + 1)));
+  EXPECT_EQ_UINT64(10000, ddsketch_count(s));
+
+  EXPECT_EQ_DOUBLE(1.0, ddsketch_percentile(s, 0.0));
+  EXPECT_EQ_DOUBLE(10000.0, ddsketch_percentile(s, 100.0));
+  EXPECT_WITHIN_ACCURACY(5000.0, ddsketch_percentile(s, 50.0));
+  EXPECT_WITHIN_ACCURACY(9500.0, ddsketch_percentile(s, 95.0));
+  EXPECT_WITHIN_ACCURACY(9900.0, ddsketch_percentile(s, 99.0));
+  OK(isnan(ddsketch_percentile(s, 101.0)));
+
+  ddsketch_reset(s);
+  EXPECT_EQ_UINT64(0, ddsketch_count(s));
+  OK(isnan(ddsketch_percentile(s, 50.0)));
+
+  /* Negative values and zero. */
+  for (int i = -50; i <= 50; i++)
+    CHECK_ZERO(ddsketch_add(s, (double)i));
+  EXPECT_EQ_DOUBLE(-50.0, ddsketch_percentile(s, 0.0));
+  EXPECT_EQ_DOUBLE(0.0, ddsketch_percentile(s, 50.0));
+  EXPECT_WITHIN_ACCURACY(-40.0, ddsketch_percentile(s, 10.0));
+  EXPECT_WITHIN_ACCURACY(40.0, ddsketch_percentile(s, 90.0));
+
+  ddsketch_destroy(s);
+  return 0;
+}
+
+DEF_TEST(merge) {
+  ddsketch_t *a;
+  ddsketch_t *b;
+  ddsketch_t *c;
+
+  CHECK_NOT_NULL(a = ddsketch_create(DDSKETCH_DEFAULT_ACCURACY,
+                                     DDSKETCH_DEFAULT_MAX_BINS));
+  CHECK_NOT_NULL(b = ddsketch_create(DDSKETCH_DEFAULT_ACCURACY,
+                                     DDSKETCH_DEFAULT_MAX_BINS));
+  CHECK_NOT_NULL(c = ddsketch_create(0.05, DDSKETCH_DEFAULT_MAX_BINS));
+
+  /* Odd values in "a", even values in "b". */
+  for (int i = 1; i <= 1000; i++)
+    CHECK_ZERO(ddsketch_add((i % 2) ? a : b, (double)i));
+
+  CHECK_ZERO(ddsketch_merge(a, b));
+  EXPECT_EQ_UINT64(1000, ddsketch_count(a));
+  EXPECT_EQ_DOUBLE(1.0, ddsketch_percentile(a, 0.0));
+  EXPECT_EQ_DOUBLE(1000.0, ddsketch_percentile(a, 100.0));
+  EXPECT_WITHIN_ACCURACY(500.0, ddsketch_percentile(a, 50.0));
+  EXPECT_WITHIN_ACCURACY(950.0, ddsketch_percentile(a, 95.0));
+
+  EXPECT_EQ_INT(EINVAL, ddsketch_merge(a, c));
+
+  ddsketch_destroy(a);
+  ddsketch_destroy(b);
+  ddsketch_destroy(c);
+  return 0;
+}
+
+DEF_TEST(non_finite) {
+  ddsketch_t *s;
+
+  CHECK_NOT_NULL(s = ddsketch_create(DDSKETCH_DEFAULT_ACCURACY,
+                                     DDSKETCH_DEFAULT_MAX_BINS));
+
+  CHECK_ZERO(ddsketch_add(s, -1.0));
+  CHECK_ZERO(ddsketch_add(s, 1.0));
+
+  EXPECT_EQ_INT(EINVAL, ddsketch_add(s, INFINITY));
+  EXPECT_EQ_INT(EINVAL, ddsketch_add(s, -INFINITY));
+  EXPECT_EQ_INT(EINVAL, ddsketch_add(s, NAN));
+
+  /* Rejected values are neither counted nor tracked as extremes. */
+  EXPECT_EQ_UINT64(2, ddsketch_count(s));
+  EXPECT_EQ_DOUBLE(-1.0, ddsketch_percentile(s, 0.0));
+  EXPECT_EQ_DOUBLE(1.0, ddsketch_percentile(s, 100.0));
+
+  ddsketch_destroy(s);
+  return 0;
+}
+
+DEF_TEST(collapse) {
+  ddsketch_t *s;
+
+  /* With only 64 bins, the smallest values are collapsed, but the high
+   * percentiles keep their accuracy. */
+  CHECK_NOT_NULL(s = ddsketch_create(DDSKETCH_DEFAULT_ACCURACY, 64));
+
+  for (int i = 0; i < 1000; i++)
+    CHECK_ZERO(ddsketch_add(s, 1e-3 * (double)(i + 1)));
+  for (int i = 0; i < 1000; i++)
+    CHECK_ZERO(ddsketch_add(s, 1e6 + (double)i));
+
+  EXPECT_EQ_UINT64(2000, ddsketch_count(s));
+  EXPECT_WITHIN_ACCURACY(1e6 + 900.0, ddsketch_percentile(s, 95.0));
+  OK(ddsketch_percentile(s, 25.0) <= 1e6);
+
+  ddsketch_destroy(s);
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(create);
+  RUN_TEST(percentile);
+  RUN_TEST(merge);
+  RUN_TEST(non_finite);
+  RUN_TEST(collapse);
+
+  END_TEST;
+}
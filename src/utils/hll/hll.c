@@ -0,0 +1,149 @@
+/**
+ * collectd - src/utils/hll/hll.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "collectd.h"
+
+#include "utils/hll/hll.h"
+
+struct hll_s {
+  int precision;
+  size_t registers_num;
+  uint8_t registers[];
+};
+
+/* 64 bit FNV-1a, followed by the MurmurHash3 finalizer so that all bits of the
+ * result depend on all bits of the input. */
+static uint64_t hll_hash(char const *key) /* {{{ */
+{
+  uint64_t h = 14695981039346656037ULL;
+
+  for (unsigned char const *c = (unsigned char const *)key; *c != 0; c++) {
+    h ^= (uint64_t)*c;
+    h *= 1099511628211ULL;
+  }
+
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+
+  return h;
+} /* }}} uint64_t hll_hash */
+
+hll_t *hll_create(int precision) /* {{{ */
+{
+  if ((precision < HLL_PRECISION_MIN) || (precision > HLL_PRECISION_MAX))
+    return NULL;
+
+  size_t registers_num = ((size_t)1) << precision;
+  hll_t *hll = calloc(1, sizeof(*hll) + registers_num);
+  if (hll == NULL)
+    return NULL;
+
+  hll->precision = precision;
+  hll->registers_num = registers_num;
+  return hll;
+} /* }}} hll_t *hll_create */
+
+void hll_destroy(hll_t *hll) /* {{{ */
+{
+  free(hll);
+} /* }}} void hll_destroy */
+
+void hll_reset(hll_t *hll) /* {{{ */
+{
+  if (hll == NULL)
+    return;
+
+  memset(hll->registers, 0, hll->registers_num);
+} /* }}} void hll_reset */
+
+void hll_add(hll_t *hll, char const *key) /* {{{ */
+{
+  if ((hll == NULL) || (key == NULL))
+    return;
+
+  uint64_t h = hll_hash(key);
+  size_t idx = (size_t)(h >> (64 - hll->precision));
+
+  /* The rank is the position of the first set bit in the remaining
+   * 64 - precision bits, or 64 - precision + 1 if all of them are zero. */
+  uint64_t w = h << hll->precision;
+  uint8_t rank = 1;
+  while ((rank <= (64 - hll->precision)) && ((w & (1ULL << 63)) == 0)) {
+    rank++;
+    w <<= 1;
+  }
+
+  if (hll->registers[idx] < rank)
+    hll->registers[idx] = rank;
+} /* }}} void hll_add */
+
+double hll_count(hll_t const *hll) /* {{{ */
+{
+  if (hll == NULL)
+    return NAN;
+
+  double m = (double)hll->registers_num;
+  double alpha;
+  if (hll->registers_num == 16)
+    alpha = 0.673;
+  else if (hll->registers_num == 32)
+    alpha = 0.697;
+  else if (hll->registers_num == 64)
+    alpha = 0.709;
+  else
+    alpha = 0.7213 / (1.0 + 1.079 / m);
+
+  double sum = 0.0;
+  size_t zeros = 0;
+  for (size_t i = 0; i < hll->registers_num; i++) {
+    sum += ldexp(1.0, -(int)hll->registers[i]);
+    if (hll->registers[i] == 0)
+      zeros++;
+  }
+
+  double estimate = alpha * m * m / sum;
+
+  /* Small range correction: use linear counting while registers are still
+   * empty. With a 64 bit hash, no large range correction is necessary. */
+  if ((estimate <= 2.5 * m) && (zeros > 0))
+    estimate = m * log(m / (double)zeros);
+
+  return estimate;
+} /* }}} double hll_count */
+
+int hll_merge(hll_t *dst, hll_t const *src) /* {{{ */
+{
+  if ((dst == NULL) || (src == NULL))
+    return EINVAL;
+  if (dst->precision != src->precision)
+    return EINVAL;
+
+  for (size_t i = 0; i < dst->registers_num; i++)
+    if (dst->registers[i] < src->registers[i])
+      dst->registers[i] = src->registers[i];
+
+  return 0;
+} /* }}} int hll_merge */
@@ -0,0 +1,51 @@
+/**
+ * collectd - src/utils/hll/hll.h
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef UTILS_HLL_H
+#define UTILS_HLL_H 1
+
+/* HyperLogLog cardinality estimator. A sketch with precision p uses 2^p bytes
+ * and estimates the number of distinct strings added to it with a standard
+ * error of about 1.04 / sqrt(2^p), e.g. 0.8% for p = 14. */
+#define HLL_PRECISION_MIN 4
+#define HLL_PRECISION_MAX 18
+
+struct hll_s;
+typedef struct hll_s hll_t;
+
+/* Returns NULL if "precision" is out of range or allocation fails. */
+hll_t *hll_create(int precision);
+void hll_destroy(hll_t *hll);
+
+void hll_reset(hll_t *hll);
+
+void hll_add(hll_t *hll, char const *key);
+
+/* Estimates the number of distinct keys added since the last reset. */
+double hll_count(hll_t const *hll);
+
+/* Adds all keys seen by "src" to "dst". Both sketches must have the same
+ * precision, EINVAL is returned otherwise. */
+int hll_merge(hll_t *dst, hll_t const *src);
+
+#endif /* UTILS_HLL_H */
@@ -0,0 +1,119 @@
+/**
+ * collectd - src/utils/hll/hll_test.c
+ * Copyright (C) 2026       The collectd authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "collectd.h"
+#include "utils/common/common.h" /* for STATIC_ARRAY_SIZE */
+
+#include "testing.h"
+#include "utils/hll/hll.h"
+
+/* Returns the relative error of the estimate for "n" distinct keys, each
+ * added "repeat" times. */
+static double estimate_error(hll_t *hll, int n, int repeat) {
+  char key[32];
+
+  hll_reset(hll);
+  for (int r = 0; r < repeat; r++) {
+    for (int i = 0; i < n; i++) {
+      snprintf(key, sizeof(key), "user-%d", i);
+      hll_add(hll, key);
+    }
+  }
+
+  return fabs(hll_count(hll) - (double)n) / (double)n;
+}
+
+DEF_TEST(create) {
+  hll_t *hll;
+
+  EXPECT_EQ_PTR(NULL, hll_create(HLL_PRECISION_MIN - 1));
+  EXPECT_EQ_PTR(NULL, hll_create(HLL_PRECISION_MAX + 1));
+
+  CHECK_NOT_NULL(hll = hll_create(HLL_PRECISION_MIN));
+  EXPECT_EQ_DOUBLE(0.0, hll_count(hll));
+  hll_destroy(hll);
+
+  return 0;
+}
+
+DEF_TEST(count) {
+  hll_t *hll;
+
+  CHECK_NOT_NULL(hll = hll_create(14));
+
+  /* Standard error for p = 14 is 0.8%, allow for four times that. */
+  int cases[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
+    double err = estimate_error(hll, cases[i], /* repeat = */ 1);
+    printf("# n = %d: relative error %.4f\n", cases[i], err);
+    OK(err < 0.033);
+  }
+
+  /* Duplicates don't change the estimate. */
+  OK(estimate_error(hll, 5000, /* repeat = */ 3) < 0.033);
+
+  hll_reset(hll);
+  EXPECT_EQ_DOUBLE(0.0, hll_count(hll));
+
+  hll_destroy(hll);
+  return 0;
+}
+
+DEF_TEST(merge) {
+  hll_t *a;
+  hll_t *b;
+  hll_t *c;
+  char key[32];
+
+  CHECK_NOT_NULL(a = hll_create(12));
+  CHECK_NOT_NULL(b = hll_create(12));
+  CHECK_NOT_NULL(c = hll_create(10));
+
+  /* Overlapping ranges: [0, 60000) and [40000, 100000). */
+  for (int i = 0; i < 60000; i++) {
+    snprintf(key, sizeof(key), "%d", i);
+    hll_add(a, key);
+    snprintf(key, sizeof(key), "%d", i + 40000);
+    hll_add(b, key);
+  }
+
+  CHECK_ZERO(hll_merge(a, b));
+  double count = hll_count(a);
+  printf("# merged estimate: %.0f\n", count);
+  OK(fabs(count - 100000.0) / 100000.0 < 0.065);
+
+  EXPECT_EQ_INT(EINVAL, hll_merge(a, c));
+
+  hll_destroy(a);
+  hll_destroy(b);
+  hll_destroy(c);
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(create);
+  RUN_TEST(count);
+  RUN_TEST(merge);
+
+  END_TEST;
+}
@@ -53,8 +53,130 @@ struct latency_counter_s {
 
   cdtime_t bin_width;
   int histogram[HISTOGRAM_NUM_BINS];
+
+  latency_histogram_t type;
+  /* Buckets of the log-linear histogram. The array is grown as larger values
+   * are added and kept across resets. */
+  uint32_t *buckets;
+  size_t buckets_num;
 };
 
+#define LL_SUB_BITS LATENCY_LOG_LINEAR_SUB_BITS
+#define LL_SUB_COUNT ((size_t)1 << LL_SUB_BITS)
+/* Values are at most LLONG_MAX, i.e. less than 2^63. */
+#define LL_BUCKETS_MAX ((64 - LL_SUB_BITS) * LL_SUB_COUNT)
+
+/*
+ * The log-linear histogram divides each interval [2^n, 2^(n+1)) into
+ * LL_SUB_COUNT buckets of equal width. Values below LL_SUB_COUNT get a bucket
+ * of their own. The bucket index is therefore computed from the position of
+ * the most significant bit and the LL_SUB_BITS bits following it. Like the
+ * linear histogram, buckets have an exclusive lower and an inclusive upper
+ * bound, so the index is calculated for (latency - 1).
+ */
+static unsigned int log2_floor(uint64_t x) /* {{{ */
+{
+  unsigned int n = 0;
+
+  if (x >= ((uint64_t)1) << 32) {
+    x >>= 32;
+    n += 32;
+  }
+  if (x >= ((uint64_t)1) << 16) {
+    x >>= 16;
+    n += 16;
+  }
+  if (x >= ((uint64_t)1) << 8) {
+    x >>= 8;
+    n += 8;
+  }
+  if (x >= ((uint64_t)1) << 4) {
+    x >>= 4;
+    n += 4;
+  }
+  if (x >= ((uint64_t)1) << 2) {
+    x >>= 2;
+    n += 2;
+  }
+  if (x >= ((uint64_t)1) << 1)
+    n += 1;
+
+  return n;
+} /* }}} unsigned int log2_floor */
+
+/* ll_bucket returns the index of the bucket (latency - 1) falls into. */
+static size_t ll_bucket(cdtime_t latency) /* {{{ */
+{
+  uint64_t x = latency - 1;
+  if (x < LL_SUB_COUNT)
+    return (size_t)x;
+
+  unsigned int shift = log2_floor(x) - LL_SUB_BITS;
+  size_t sub = (size_t)(x >> shift) - LL_SUB_COUNT;
+  return (((size_t)shift) + 1) * LL_SUB_COUNT + sub;
+} /* }}} size_t ll_bucket */
+
+/* ll_lower returns the exclusive lower bound of a bucket. The inclusive upper
+ * bound is the lower bound of the next bucket. */
+static cdtime_t ll_lower(size_t index) /* {{{ */
+{
+  if (index < LL_SUB_COUNT)
+    return (cdtime_t)index;
+
+  size_t shift = (index / LL_SUB_COUNT) - 1;
+  cdtime_t sub = (cdtime_t)(index % LL_SUB_COUNT);
+  return (((cdtime_t)LL_SUB_COUNT) + sub) << shift;
+} /* }}} cdtime_t ll_lower */
+
+/* ll_grow makes sure the bucket "index" exists. The array is grown in steps
+ * of LL_SUB_COUNT buckets, i.e. one power of two at a time. */
+static int ll_grow(latency_counter_t *lc, size_t index) /* {{{ */
+{
+  if (index < lc->buckets_num)
+    return 0;
+  if (index >= LL_BUCKETS_MAX)
+    return ERANGE;
+
+  size_t new_num = ((index / LL_SUB_COUNT) + 1) * LL_SUB_COUNT;
+  uint32_t *tmp = realloc(lc->buckets, new_num * sizeof(*lc->buckets));
+  if (tmp == NULL)
+    return ENOMEM;
+
+  memset(tmp + lc->buckets_num, 0,
+         (new_num - lc->buckets_num) * sizeof(*lc->buckets));
+  lc->buckets = tmp;
+  lc->buckets_num = new_num;
+  return 0;
+} /* }}} int ll_grow */
+
+/* set_bin_width increases the bin width of the linear histogram and moves the
+ * counts of the old bins to the new, wider bins. */
+static void set_bin_width(latency_counter_t *lc, cdtime_t new_bin_width) /* {{{ */
+{
+  cdtime_t old_bin_width = lc->bin_width;
+  assert(new_bin_width >= old_bin_width);
+
+  lc->bin_width = new_bin_width;
+
+  /* bin_width has been increased, now iterate through all bins and move the
+   * old bin's count to new bin. */
+  if (lc->num > 0) // if the histogram has data then iterate else skip
+  {
+    double width_change_ratio =
+        ((double)old_bin_width) / ((double)new_bin_width);
+
+    for (size_t i = 0; i < HISTOGRAM_NUM_BINS; i++) {
+      size_t new_bin = (size_t)(((double)i) * width_change_ratio);
+      if (i == new_bin)
+        continue;
+      assert(new_bin < i);
+
+      lc->histogram[new_bin] += lc->histogram[i];
+      lc->histogram[i] = 0;
+    }
+  }
+} /* }}} void set_bin_width */
+
 /*
  * Histogram represents the distribution of data, it has a list of "bins".
  * Each bin represents an interval and has a count (frequency) of
@@ -85,35 +207,22 @@ static void change_bin_width(latency_counter_t *lc, cdtime_t latency) /* {{{ */
   double required_bin_width_logbase2 = log(required_bin_width) / log(2.0);
   cdtime_t new_bin_width =
       (cdtime_t)(pow(2.0, ceil(required_bin_width_logbase2)) + .5);
-  cdtime_t old_bin_width = lc->bin_width;
-
-  lc->bin_width = new_bin_width;
-
-  /* bin_width has been increased, now iterate through all bins and move the
-   * old bin's count to new bin. */
-  if (lc->num > 0) // if the histogram has data then iterate else skip
-  {
-    double width_change_ratio =
-        ((double)old_bin_width) / ((double)new_bin_width);
-
-    for (size_t i = 0; i < HISTOGRAM_NUM_BINS; i++) {
-      size_t new_bin = (size_t)(((double)i) * width_change_ratio);
-      if (i == new_bin)
-        continue;
-      assert(new_bin < i);
-
-      lc->histogram[new_bin] += lc->histogram[i];
-      lc->histogram[i] = 0;
-    }
-  }
 
   DEBUG("utils_latency: change_bin_width: latency = %.3f; "
         "old_bin_width = %.3f; new_bin_width = %.3f;",
-        CDTIME_T_TO_DOUBLE(latency), CDTIME_T_TO_DOUBLE(old_bin_width),
+        CDTIME_T_TO_DOUBLE(latency), CDTIME_T_TO_DOUBLE(lc->bin_width),
         CDTIME_T_TO_DOUBLE(new_bin_width));
+
+  set_bin_width(lc, new_bin_width);
 } /* }}} void change_bin_width */
 
 latency_counter_t *latency_counter_create(void) /* {{{ */
+{
+  return latency_counter_create_type(LATENCY_HISTOGRAM_LINEAR);
+} /* }}} latency_counter_t *latency_counter_create */
+
+latency_counter_t *
+latency_counter_create_type(latency_histogram_t type) /* {{{ */
 {
   latency_counter_t *lc;
 
@@ -121,13 +230,18 @@ latency_counter_t *latency_counter_create(void) /* {{{ */
   if (lc == NULL)
     return NULL;
 
+  lc->type = type;
   lc->bin_width = HISTOGRAM_DEFAULT_BIN_WIDTH;
   latency_counter_reset(lc);
   return lc;
-} /* }}} latency_counter_t *latency_counter_create */
+} /* }}} latency_counter_t *latency_counter_create_type */
 
 void latency_counter_destroy(latency_counter_t *lc) /* {{{ */
 {
+  if (lc == NULL)
+    return;
+
+  sfree(lc->buckets);
   sfree(lc);
 } /* }}} void latency_counter_destroy */
 
@@ -148,6 +262,19 @@ void latency_counter_add(latency_counter_t *lc, cdtime_t latency) /* {{{ */
   if (lc->max < latency)
     lc->max = latency;
 
+  if (lc->type == LATENCY_HISTOGRAM_LOG_LINEAR) {
+    size_t index = ll_bucket(latency);
+    int status = ll_grow(lc, index);
+    if (status != 0) {
+      P_ERROR("latency_counter_add: Growing histogram to %" PRIsz
+              " buckets failed: %s",
+              index + 1, STRERROR(status));
+      return;
+    }
+    lc->buckets[index]++;
+    return;
+  }
+
   /* A latency of _exactly_ 1.0 ms is stored in the buffer 0, so
    * subtract one from the cdtime_t value so that exactly 1.0 ms get sorted
    * accordingly. */
@@ -188,13 +315,71 @@ void latency_counter_reset(latency_counter_t *lc) /* {{{ */
           CDTIME_T_TO_DOUBLE(lc->bin_width), CDTIME_T_TO_DOUBLE(bin_width));
   }
 
+  latency_histogram_t type = lc->type;
+  uint32_t *buckets = lc->buckets;
+  size_t buckets_num = lc->buckets_num;
+
   memset(lc, 0, sizeof(*lc));
 
   /* preserve bin width */
   lc->bin_width = bin_width;
   lc->start_time = cdtime();
+
+  /* preserve the log-linear buckets, so they don't need to grow again. */
+  lc->type = type;
+  lc->buckets = buckets;
+  lc->buckets_num = buckets_num;
+  if (buckets != NULL)
+    memset(buckets, 0, buckets_num * sizeof(*buckets));
 } /* }}} void latency_counter_reset */
 
+int latency_counter_merge(latency_counter_t *dst, /* {{{ */
+                          const latency_counter_t *src) {
+  if ((dst == NULL) || (src == NULL) || (dst->type != src->type))
+    return EINVAL;
+
+  if (src->num == 0)
+    return 0;
+
+  if (src->type == LATENCY_HISTOGRAM_LOG_LINEAR) {
+    int status = ll_grow(dst, src->buckets_num - 1);
+    if (status != 0)
+      return status;
+
+    for (size_t i = 0; i < src->buckets_num; i++)
+      dst->buckets[i] += src->buckets[i];
+  } else {
+    if (src->bin_width > dst->bin_width)
+      set_bin_width(dst, src->bin_width);
+
+    /* Like set_bin_width(), count each source bin in the destination bin
+     * holding its lower bound. This is exact if the destination width is a
+     * multiple of the source width. That is the case with the default width
+     * of 2^20, because change_bin_width() and latency_counter_reset() only
+     * pick powers of two. With other widths, a source bin may straddle two
+     * destination bins. */
+    for (size_t i = 0; i < HISTOGRAM_NUM_BINS; i++) {
+      if (src->histogram[i] == 0)
+        continue;
+
+      cdtime_t lower = ((cdtime_t)i) * src->bin_width;
+      size_t bin = (size_t)(lower / dst->bin_width);
+      dst->histogram[bin] += src->histogram[i];
+    }
+  }
+
+  if ((dst->num == 0) || (src->min < dst->min))
+    dst->min = src->min;
+  if ((dst->num == 0) || (src->max > dst->max))
+    dst->max = src->max;
+  dst->sum += src->sum;
+  dst->num += src->num;
+  if (src->start_time < dst->start_time)
+    dst->start_time = src->start_time;
+
+  return 0;
+} /* }}} int latency_counter_merge */
+
 cdtime_t latency_counter_get_min(latency_counter_t *lc) /* {{{ */
 {
   if (lc == NULL)
@@ -234,6 +419,43 @@ cdtime_t latency_counter_get_average(latency_counter_t *lc) /* {{{ */
   return DOUBLE_TO_CDTIME_T(average);
 } /* }}} cdtime_t latency_counter_get_average */
 
+static cdtime_t ll_get_percentile(latency_counter_t *lc, /* {{{ */
+                                  double percent) {
+  double percent_upper = 0.0;
+  double percent_lower = 0.0;
+  uint64_t sum = 0;
+  size_t i;
+
+  for (i = 0; i < lc->buckets_num; i++) {
+    if (lc->buckets[i] == 0)
+      continue;
+
+    percent_lower = percent_upper;
+    sum += lc->buckets[i];
+    percent_upper = 100.0 * ((double)sum) / ((double)lc->num);
+
+    if (percent_upper >= percent)
+      break;
+  }
+
+  if (i >= lc->buckets_num)
+    return 0;
+
+  cdtime_t lower = ll_lower(i);
+  cdtime_t width = ll_lower(i + 1) - lower;
+  double p = (percent - percent_lower) / (percent_upper - percent_lower);
+
+  cdtime_t latency = lower + (cdtime_t)(p * ((double)width) + .5);
+
+  /* The interpolation may not be more precise than the observed extremes. */
+  if (latency < lc->min)
+    latency = lc->min;
+  if (latency > lc->max)
+    latency = lc->max;
+
+  return latency;
+} /* }}} cdtime_t ll_get_percentile */
+
 cdtime_t latency_counter_get_percentile(latency_counter_t *lc, /* {{{ */
                                         double percent) {
   double percent_upper;
@@ -247,6 +469,9 @@ cdtime_t latency_counter_get_percentile(latency_counter_t *lc, /* {{{ */
   if ((lc == NULL) || (lc->num == 0) || !((percent > 0.0) && (percent < 100.0)))
     return 0;
 
+  if (lc->type == LATENCY_HISTOGRAM_LOG_LINEAR)
+    return ll_get_percentile(lc, percent);
+
   /* Find index i so that at least "percent" events are within i+1 ms. */
   percent_upper = 0.0;
   percent_lower = 0.0;
@@ -283,6 +508,48 @@ cdtime_t latency_counter_get_percentile(latency_counter_t *lc, /* {{{ */
   return latency_interpolated;
 } /* }}} cdtime_t latency_counter_get_percentile */
 
+static double ll_get_count(const latency_counter_t *lc, /* {{{ */
+                           cdtime_t lower, cdtime_t upper) {
+  /* See latency_counter_get_rate() below for the handling of the bounds. */
+  size_t lower_bucket = 0;
+  if (lower)
+    lower_bucket = ll_bucket(lower + 1);
+
+  if (lower_bucket >= lc->buckets_num)
+    return 0;
+
+  size_t upper_bucket = lc->buckets_num - 1;
+  if (upper)
+    upper_bucket = ll_bucket(upper);
+
+  if (upper_bucket >= lc->buckets_num) {
+    upper_bucket = lc->buckets_num - 1;
+    upper = 0;
+  }
+
+  double sum = 0;
+  for (size_t i = lower_bucket; i <= upper_bucket; i++)
+    sum += lc->buckets[i];
+
+  if (lower) {
+    cdtime_t boundary = ll_lower(lower_bucket);
+    cdtime_t width = ll_lower(lower_bucket + 1) - boundary;
+    assert(lower >= boundary);
+    double ratio = (double)(lower - boundary) / ((double)width);
+    sum -= ratio * lc->buckets[lower_bucket];
+  }
+
+  if (upper) {
+    cdtime_t boundary = ll_lower(upper_bucket + 1);
+    cdtime_t width = boundary - ll_lower(upper_bucket);
+    assert(upper <= boundary);
+    double ratio = (double)(boundary - upper) / ((double)width);
+    sum -= ratio * lc->buckets[upper_bucket];
+  }
+
+  return sum;
+} /* }}} double ll_get_count */
+
 double latency_counter_get_rate(const latency_counter_t *lc, /* {{{ */
                                 cdtime_t lower, cdtime_t upper,
                                 const cdtime_t now) {
@@ -294,6 +561,10 @@ double latency_counter_get_rate(const latency_counter_t *lc, /* {{{ */
   if (lower == upper)
     return 0;
 
+  if (lc->type == LATENCY_HISTOGRAM_LOG_LINEAR)
+    return ll_get_count(lc, lower, upper) /
+           (CDTIME_T_TO_DOUBLE(now - lc->start_time));
+
   /* Buckets have an exclusive lower bound and an inclusive upper bound. That
    * means that the first bucket, index 0, represents (0-bin_width]. That means
    * that latency==bin_width needs to result in bin=0, that's why we need to
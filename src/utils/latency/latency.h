@@ -35,15 +35,43 @@
 #define HISTOGRAM_NUM_BINS 1000
 #endif
 
+/* Number of bits used for the sub-buckets of the log-linear histogram. Each
+ * power of two is divided into 2^LATENCY_LOG_LINEAR_SUB_BITS buckets, which
+ * bounds the relative error of percentiles to 2^-LATENCY_LOG_LINEAR_SUB_BITS. */
+#ifndef LATENCY_LOG_LINEAR_SUB_BITS
+#define LATENCY_LOG_LINEAR_SUB_BITS 7
+#endif
+
+typedef enum {
+  /* HISTOGRAM_NUM_BINS bins of equal width. The width is doubled when a value
+   * exceeds the histogram's range. */
+  LATENCY_HISTOGRAM_LINEAR = 0,
+  /* Buckets whose width grows with the value (similar to HdrHistogram). Adding
+   * a value never requires rescaling. */
+  LATENCY_HISTOGRAM_LOG_LINEAR,
+} latency_histogram_t;
+
 struct latency_counter_s;
 typedef struct latency_counter_s latency_counter_t;
 
 latency_counter_t *latency_counter_create(void);
+latency_counter_t *latency_counter_create_type(latency_histogram_t type);
 void latency_counter_destroy(latency_counter_t *lc);
 
 void latency_counter_add(latency_counter_t *lc, cdtime_t latency);
 void latency_counter_reset(latency_counter_t *lc);
 
+/*
+ * NAME
+ *  latency_counter_merge(dst,src)
+ *
+ * DESCRIPTION
+ *   Adds all values recorded by "src" to "dst". Both counters must use the
+ *   same histogram type. Returns zero on success and EINVAL if the types
+ *   differ.
+ */
+int latency_counter_merge(latency_counter_t *dst, const latency_counter_t *src);
+
 cdtime_t latency_counter_get_min(latency_counter_t *lc);
 cdtime_t latency_counter_get_max(latency_counter_t *lc);
 cdtime_t latency_counter_get_sum(latency_counter_t *lc);
@@ -91,6 +91,28 @@ static int latency_config_add_bucket(latency_config_t *conf,
   return 0;
 } /* int latency_config_add_bucket */
 
+int latency_config_get_histogram(const oconfig_item_t *ci,
+                                 latency_histogram_t *ret) {
+  if ((ci->values_num != 1) || (ci->values[0].type != OCONFIG_TYPE_STRING)) {
+    P_ERROR("\"%s\" requires exactly one string argument.", ci->key);
+    return EINVAL;
+  }
+
+  char const *name = ci->values[0].value.string;
+  if (strcasecmp("Linear", name) == 0)
+    *ret = LATENCY_HISTOGRAM_LINEAR;
+  else if (strcasecmp("LogLinear", name) == 0)
+    *ret = LATENCY_HISTOGRAM_LOG_LINEAR;
+  else {
+    P_ERROR("Invalid histogram type \"%s\" in \"%s\". Valid types are "
+            "\"Linear\" and \"LogLinear\".",
+            name, ci->key);
+    return EINVAL;
+  }
+
+  return 0;
+} /* int latency_config_get_histogram */
+
 int latency_config(latency_config_t *conf, oconfig_item_t *ci) {
   int status = 0;
 
@@ -103,6 +125,8 @@ int latency_config(latency_config_t *conf, oconfig_item_t *ci) {
       status = latency_config_add_bucket(conf, child);
     else if (strcasecmp("BucketType", child->key) == 0)
       status = cf_util_get_string(child, &conf->bucket_type);
+    else if (strcasecmp("Histogram", child->key) == 0)
+      status = latency_config_get_histogram(child, &conf->histogram);
     else
       P_WARNING("\"%s\" is not a valid option within a \"%s\" block.",
                 child->key, ci->key);
@@ -126,6 +150,7 @@ int latency_config_copy(latency_config_t *dst, const latency_config_t src) {
   *dst = (latency_config_t){
       .percentile_num = src.percentile_num,
       .buckets_num = src.buckets_num,
+      .histogram = src.histogram,
   };
 
   dst->percentile = calloc(dst->percentile_num, sizeof(*dst->percentile));
@@ -31,6 +31,7 @@
 #include "collectd.h"
 
 #include "liboconfig/oconfig.h"
+#include "utils/latency/latency.h"
 #include "utils_time.h"
 
 typedef struct {
@@ -46,6 +47,8 @@ typedef struct {
   size_t buckets_num;
   char *bucket_type;
 
+  latency_histogram_t histogram;
+
   /*
   bool lower;
   bool upper;
@@ -55,6 +58,11 @@ typedef struct {
 
 int latency_config(latency_config_t *conf, oconfig_item_t *ci);
 
+/* latency_config_get_histogram parses the name of a histogram type, i.e.
+ * "Linear" or "LogLinear". */
+int latency_config_get_histogram(const oconfig_item_t *ci,
+                                 latency_histogram_t *ret);
+
 int latency_config_copy(latency_config_t *dst, const latency_config_t src);
 
 void latency_config_free(latency_config_t conf);
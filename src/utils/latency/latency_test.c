@@ -242,10 +242,133 @@ DEF_TEST(get_rate) {
   return 0;
 }
 
+DEF_TEST(log_linear_percentile) {
+  latency_counter_t *l;
+
+  CHECK_NOT_NULL(l = latency_counter_create_type(LATENCY_HISTOGRAM_LOG_LINEAR));
+
+  /* 1µs to 100s: a range the linear histogram can't resolve. */
+  double values[] = {1e-6, 1e-5, 1e-4, 1e-3, 1e-2, 1e-1, 1, 10, 100};
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(values); i++) {
+    for (size_t j = 0; j < 100; j++)
+      latency_counter_add(l, DOUBLE_TO_CDTIME_T(values[i]));
+  }
+
+  EXPECT_EQ_DOUBLE(1e-6, CDTIME_T_TO_DOUBLE(latency_counter_get_min(l)));
+  EXPECT_EQ_DOUBLE(100.0, CDTIME_T_TO_DOUBLE(latency_counter_get_max(l)));
+  EXPECT_EQ_INT(900, latency_counter_get_num(l));
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(values); i++) {
+    double percent = 100.0 * ((double)i + 0.5) / STATIC_ARRAY_SIZE(values);
+    double got = CDTIME_T_TO_DOUBLE(latency_counter_get_percentile(l, percent));
+    double error = fabs(got - values[i]) / values[i];
+
+    printf("# percentile %.2f: want %g, got %g (error %.4f)\n", percent,
+           values[i], got, error);
+    OK(error < 1.0 / 128.0);
+  }
+
+  /* Resetting keeps the buckets but discards the counts. */
+  latency_counter_reset(l);
+  EXPECT_EQ_INT(0, latency_counter_get_num(l));
+  CHECK_ZERO(latency_counter_get_percentile(l, 50.0));
+
+  latency_counter_add(l, DOUBLE_TO_CDTIME_T(0.5));
+  EXPECT_EQ_DOUBLE(0.5,
+                   CDTIME_T_TO_DOUBLE(latency_counter_get_percentile(l, 99.9)));
+
+  latency_counter_destroy(l);
+  return 0;
+}
+
+DEF_TEST(log_linear_get_rate) {
+  latency_counter_t *l;
+
+  CHECK_NOT_NULL(l = latency_counter_create_type(LATENCY_HISTOGRAM_LOG_LINEAR));
+
+  for (time_t i = 1; i <= 125; i++) {
+    latency_counter_add(l, TIME_T_TO_CDTIME_T(i));
+  }
+
+  struct {
+    cdtime_t lower_bound;
+    cdtime_t upper_bound;
+    double want;
+  } cases[] = {
+      {DOUBLE_TO_CDTIME_T_STATIC(0.5), DOUBLE_TO_CDTIME_T_STATIC(1.0), 1.0},
+      {DOUBLE_TO_CDTIME_T_STATIC(1.0), DOUBLE_TO_CDTIME_T_STATIC(2.0), 1.0},
+      {0, DOUBLE_TO_CDTIME_T_STATIC(10.0), 10.0},
+      {DOUBLE_TO_CDTIME_T_STATIC(100.0), 0, 25.0},
+      {DOUBLE_TO_CDTIME_T_STATIC(1.0), DOUBLE_TO_CDTIME_T_STATIC(999999), 124.0},
+      {DOUBLE_TO_CDTIME_T_STATIC(130), 0, 0.0},
+      {DOUBLE_TO_CDTIME_T_STATIC(10), DOUBLE_TO_CDTIME_T_STATIC(9), NAN},
+      {DOUBLE_TO_CDTIME_T_STATIC(9), DOUBLE_TO_CDTIME_T_STATIC(9), 0.0},
+  };
+
+  /* The start time is the first member of the struct. */
+  cdtime_t now = *((cdtime_t *)l) + TIME_T_TO_CDTIME_T(1);
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
+    EXPECT_EQ_DOUBLE(cases[i].want,
+                     latency_counter_get_rate(l, cases[i].lower_bound,
+                                              cases[i].upper_bound, now));
+  }
+
+  latency_counter_destroy(l);
+  return 0;
+}
+
+DEF_TEST(merge) {
+  latency_histogram_t types[] = {LATENCY_HISTOGRAM_LINEAR,
+                                 LATENCY_HISTOGRAM_LOG_LINEAR};
+
+  for (size_t t = 0; t < STATIC_ARRAY_SIZE(types); t++) {
+    latency_counter_t *a, *b, *all;
+
+    CHECK_NOT_NULL(a = latency_counter_create_type(types[t]));
+    CHECK_NOT_NULL(b = latency_counter_create_type(types[t]));
+    CHECK_NOT_NULL(all = latency_counter_create_type(types[t]));
+
+    /* "b" sees larger values, so that a linear histogram has to widen its
+     * bins during the merge. */
+    for (time_t i = 1; i <= 100; i++) {
+      latency_counter_t *l = (i <= 50) ? a : b;
+      latency_counter_add(l, TIME_T_TO_CDTIME_T(i));
+      latency_counter_add(all, TIME_T_TO_CDTIME_T(i));
+    }
+
+    CHECK_ZERO(latency_counter_merge(a, b));
+    EXPECT_EQ_INT(latency_counter_get_num(all), latency_counter_get_num(a));
+    EXPECT_EQ_UINT64(latency_counter_get_sum(all), latency_counter_get_sum(a));
+    EXPECT_EQ_UINT64(latency_counter_get_min(all), latency_counter_get_min(a));
+    EXPECT_EQ_UINT64(latency_counter_get_max(all), latency_counter_get_max(a));
+
+    double percents[] = {50.0, 90.0, 99.0};
+    for (size_t i = 0; i < STATIC_ARRAY_SIZE(percents); i++)
+      EXPECT_EQ_UINT64(latency_counter_get_percentile(all, percents[i]),
+                       latency_counter_get_percentile(a, percents[i]));
+
+    latency_counter_destroy(a);
+    latency_counter_destroy(b);
+    latency_counter_destroy(all);
+  }
+
+  latency_counter_t *linear = latency_counter_create();
+  latency_counter_t *log_linear =
+      latency_counter_create_type(LATENCY_HISTOGRAM_LOG_LINEAR);
+  EXPECT_EQ_INT(EINVAL, latency_counter_merge(linear, log_linear));
+  latency_counter_destroy(linear);
+  latency_counter_destroy(log_linear);
+
+  return 0;
+}
+
 int main(void) {
   RUN_TEST(simple);
   RUN_TEST(percentile);
   RUN_TEST(get_rate);
+  RUN_TEST(log_linear_percentile);
+  RUN_TEST(log_linear_get_rate);
+  RUN_TEST(merge);
 
   END_TEST;
 }
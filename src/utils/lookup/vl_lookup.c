@@ -72,9 +72,22 @@ struct identifier_match_s {
 };
 typedef struct identifier_match_s identifier_match_t;
 
+/* Maximum number of identifiers in the decision cache. When it is full, the
+ * cache is cleared and filled anew, so that identifiers which are no longer
+ * seen don't occupy it forever. */
+#ifndef LU_CACHE_SIZE_MAX
+#define LU_CACHE_SIZE_MAX 1048576
+#endif
+
 struct lookup_s {
   c_avl_tree_t *by_type_tree;
 
+  /* Decision cache: maps identifiers to the user objects they resolved to.
+   * Cleared whenever a user class is added. */
+  c_avl_tree_t *cache;
+  size_t cache_size;
+  pthread_rwlock_t cache_lock;
+
   lookup_class_callback_t cb_user_class;
   lookup_obj_callback_t cb_user_obj;
   lookup_free_class_callback_t cb_free_class;
@@ -111,6 +124,18 @@ struct by_type_entry_s {
 };
 typedef struct by_type_entry_s by_type_entry_t;
 
+/* The user classes matching an identifier and the user objects the identifier
+ * belongs to. User objects are only freed by lookup_destroy(), so the pointers
+ * stay valid as long as the cache entry exists. */
+struct lu_cache_entry_s {
+  size_t objs_num;
+  struct {
+    user_class_t *user_class;
+    user_obj_t *user_obj;
+  } objs[];
+};
+typedef struct lu_cache_entry_s lu_cache_entry_t;
+
 /*
  * Private functions
  */
@@ -134,6 +159,54 @@ static bool lu_part_matches(part_match_t const *match, /* {{{ */
     return false;
 } /* }}} bool lu_part_matches */
 
+/* Cache keys are the five parts of the identifier, each terminated by a null
+ * byte. "buffer" must hold at least 5 * DATA_MAX_NAME_LEN bytes. Returns the
+ * size of the key. */
+static size_t lu_cache_key(char *buffer, value_list_t const *vl) /* {{{ */
+{
+  char const *parts[] = {vl->host, vl->plugin, vl->plugin_instance, vl->type,
+                         vl->type_instance};
+  size_t offset = 0;
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(parts); i++) {
+    size_t len = strlen(parts[i]) + 1;
+    memcpy(buffer + offset, parts[i], len);
+    offset += len;
+  }
+
+  return offset;
+} /* }}} size_t lu_cache_key */
+
+static int lu_cache_key_compare(void const *a_ptr, void const *b_ptr) /* {{{ */
+{
+  char const *a = a_ptr;
+  char const *b = b_ptr;
+
+  for (size_t i = 0; i < 5; i++) {
+    int status = strcmp(a, b);
+    if (status != 0)
+      return status;
+
+    a += strlen(a) + 1;
+    b += strlen(b) + 1;
+  }
+
+  return 0;
+} /* }}} int lu_cache_key_compare */
+
+/* obj->cache_lock must be held for writing when calling this function */
+static void lu_cache_clear(lookup_t *obj) /* {{{ */
+{
+  void *key;
+  void *value;
+
+  while (c_avl_pick(obj->cache, &key, &value) == 0) {
+    sfree(key);
+    sfree(value);
+  }
+  obj->cache_size = 0;
+} /* }}} void lu_cache_clear */
+
 static int lu_copy_ident_to_match_part(part_match_t *match_part, /* {{{ */
                                        char const *ident_part) {
   size_t len = strlen(ident_part);
@@ -269,11 +342,42 @@ static user_obj_t *lu_find_user_obj(user_class_t *user_class, /* {{{ */
   return NULL;
 } /* }}} user_obj_t *lu_find_user_obj */
 
+static int lu_call_user_obj(lookup_t *obj, /* {{{ */
+                            data_set_t const *ds, value_list_t const *vl,
+                            user_class_t *user_class, user_obj_t *user_obj) {
+  int status;
+
+  status = obj->cb_user_obj(ds, vl, user_class->user_class, user_obj->user_obj);
+  if (status != 0) {
+    ERROR("utils_vl_lookup: The user object callback failed with status %i.",
+          status);
+    /* Returning a negative value means: abort! */
+    if (status < 0)
+      return status;
+    else
+      return 1;
+  }
+
+  return 0;
+} /* }}} int lu_call_user_obj */
+
+/* Appends the user class and object to the cache entry, if any. */
+static void lu_cache_entry_add(lu_cache_entry_t *entry, /* {{{ */
+                               user_class_t *user_class,
+                               user_obj_t *user_obj) {
+  if (entry == NULL)
+    return;
+
+  entry->objs[entry->objs_num].user_class = user_class;
+  entry->objs[entry->objs_num].user_obj = user_obj;
+  entry->objs_num++;
+} /* }}} void lu_cache_entry_add */
+
 static int lu_handle_user_class(lookup_t *obj, /* {{{ */
                                 data_set_t const *ds, value_list_t const *vl,
-                                user_class_t *user_class) {
+                                user_class_t *user_class,
+                                lu_cache_entry_t *entry) {
   user_obj_t *user_obj;
-  int status;
 
   assert(strcmp(vl->type, user_class->match.type.str) == 0);
   assert(user_class->match.plugin.is_regex ||
@@ -299,31 +403,23 @@ static int lu_handle_user_class(lookup_t *obj, /* {{{ */
   }
   pthread_mutex_unlock(&user_class->lock);
 
-  status = obj->cb_user_obj(ds, vl, user_class->user_class, user_obj->user_obj);
-  if (status != 0) {
-    ERROR("utils_vl_lookup: The user object callback failed with status %i.",
-          status);
-    /* Returning a negative value means: abort! */
-    if (status < 0)
-      return status;
-    else
-      return 1;
-  }
+  lu_cache_entry_add(entry, user_class, user_obj);
 
-  return 0;
+  return lu_call_user_obj(obj, ds, vl, user_class, user_obj);
 } /* }}} int lu_handle_user_class */
 
 static int lu_handle_user_class_list(lookup_t *obj, /* {{{ */
                                      data_set_t const *ds,
                                      value_list_t const *vl,
-                                     user_class_list_t *user_class_list) {
+                                     user_class_list_t *user_class_list,
+                                     lu_cache_entry_t *entry) {
   user_class_list_t *ptr;
   int retval = 0;
 
   for (ptr = user_class_list; ptr != NULL; ptr = ptr->next) {
     int status;
 
-    status = lu_handle_user_class(obj, ds, vl, &ptr->entry);
+    status = lu_handle_user_class(obj, ds, vl, &ptr->entry, entry);
     if (status < 0)
       return status;
     else if (status == 0)
@@ -536,6 +632,15 @@ lookup_t *lookup_create(lookup_class_callback_t cb_user_class, /* {{{ */
     return NULL;
   }
 
+  obj->cache = c_avl_create(lu_cache_key_compare);
+  if (obj->cache == NULL) {
+    ERROR("utils_vl_lookup: c_avl_create failed.");
+    c_avl_destroy(obj->by_type_tree);
+    sfree(obj);
+    return NULL;
+  }
+  pthread_rwlock_init(&obj->cache_lock, /* attr = */ NULL);
+
   obj->cb_user_class = cb_user_class;
   obj->cb_user_obj = cb_user_obj;
   obj->cb_free_class = cb_free_class;
@@ -567,6 +672,11 @@ void lookup_destroy(lookup_t *obj) /* {{{ */
   c_avl_destroy(obj->by_type_tree);
   obj->by_type_tree = NULL;
 
+  lu_cache_clear(obj);
+  c_avl_destroy(obj->cache);
+  obj->cache = NULL;
+  pthread_rwlock_destroy(&obj->cache_lock);
+
   sfree(obj);
 } /* }}} void lookup_destroy */
 
@@ -580,6 +690,11 @@ int lookup_add(lookup_t *obj, /* {{{ */
   if (by_type == NULL)
     return -1;
 
+  /* Cached decisions don't know about the new user class. */
+  pthread_rwlock_wrlock(&obj->cache_lock);
+  lu_cache_clear(obj);
+  pthread_rwlock_unlock(&obj->cache_lock);
+
   user_class_obj = calloc(1, sizeof(*user_class_obj));
   if (user_class_obj == NULL) {
     ERROR("utils_vl_lookup: calloc failed.");
@@ -594,11 +709,46 @@ int lookup_add(lookup_t *obj, /* {{{ */
   return lu_add_by_plugin(by_type, user_class_obj);
 } /* }}} int lookup_add */
 
+/* Calls the user object callback for all user objects in the cache entry.
+ * Returns the number of successful calls, like lookup_search(). */
+static int lu_handle_cache_entry(lookup_t *obj, /* {{{ */
+                                 data_set_t const *ds, value_list_t const *vl,
+                                 lu_cache_entry_t const *entry) {
+  int retval = 0;
+
+  for (size_t i = 0; i < entry->objs_num; i++) {
+    int status = lu_call_user_obj(obj, ds, vl, entry->objs[i].user_class,
+                                  entry->objs[i].user_obj);
+    if (status < 0)
+      return status;
+    else if (status == 0)
+      retval++;
+  }
+
+  return retval;
+} /* }}} int lu_handle_cache_entry */
+
+/* Counts the user classes an identifier may match, i.e. the maximum number of
+ * user objects in its cache entry. */
+static size_t lu_count_user_classes(user_class_list_t *user_class_list) /* {{{ */
+{
+  size_t num = 0;
+
+  for (user_class_list_t *ptr = user_class_list; ptr != NULL; ptr = ptr->next)
+    num++;
+
+  return num;
+} /* }}} size_t lu_count_user_classes */
+
 /* returns the number of successful calls to the callback function */
 int lookup_search(lookup_t *obj, /* {{{ */
                   data_set_t const *ds, value_list_t const *vl) {
   by_type_entry_t *by_type = NULL;
   user_class_list_t *user_class_list = NULL;
+  lu_cache_entry_t *entry = NULL;
+  char key[5 * DATA_MAX_NAME_LEN];
+  size_t key_size;
+  char *key_copy;
   int retval = 0;
   int status;
 
@@ -609,22 +759,70 @@ int lookup_search(lookup_t *obj, /* {{{ */
   if (by_type == NULL)
     return 0;
 
+  key_size = lu_cache_key(key, vl);
+
+  /* The callbacks are called with the lock held, since another thread clears
+   * the cache when it is full. */
+  pthread_rwlock_rdlock(&obj->cache_lock);
+  if (c_avl_get(obj->cache, key, (void *)&entry) == 0) {
+    retval = lu_handle_cache_entry(obj, ds, vl, entry);
+    pthread_rwlock_unlock(&obj->cache_lock);
+    return retval;
+  }
+  pthread_rwlock_unlock(&obj->cache_lock);
+  entry = NULL;
+
   status =
       c_avl_get(by_type->by_plugin_tree, vl->plugin, (void *)&user_class_list);
-  if (status == 0) {
-    status = lu_handle_user_class_list(obj, ds, vl, user_class_list);
-    if (status < 0)
+  if (status != 0)
+    user_class_list = NULL;
+
+  size_t objs_max = lu_count_user_classes(user_class_list) +
+                    lu_count_user_classes(by_type->wildcard_plugin_list);
+  entry = calloc(1, sizeof(*entry) + objs_max * sizeof(entry->objs[0]));
+
+  if (user_class_list != NULL) {
+    status = lu_handle_user_class_list(obj, ds, vl, user_class_list, entry);
+    if (status < 0) {
+      sfree(entry);
       return status;
+    }
     retval += status;
   }
 
   if (by_type->wildcard_plugin_list != NULL) {
-    status =
-        lu_handle_user_class_list(obj, ds, vl, by_type->wildcard_plugin_list);
-    if (status < 0)
+    status = lu_handle_user_class_list(obj, ds, vl,
+                                       by_type->wildcard_plugin_list, entry);
+    if (status < 0) {
+      sfree(entry);
       return status;
+    }
     retval += status;
   }
 
+  if (entry == NULL)
+    return retval;
+
+  key_copy = malloc(key_size);
+  if (key_copy == NULL) {
+    sfree(entry);
+    return retval;
+  }
+  memcpy(key_copy, key, key_size);
+
+  pthread_rwlock_wrlock(&obj->cache_lock);
+  if (obj->cache_size >= LU_CACHE_SIZE_MAX)
+    lu_cache_clear(obj);
+  if (c_avl_insert(obj->cache, key_copy, entry) == 0) {
+    obj->cache_size++;
+    key_copy = NULL;
+    entry = NULL;
+  }
+  pthread_rwlock_unlock(&obj->cache_lock);
+
+  /* Not inserted: another thread was faster. */
+  sfree(entry);
+  sfree(key_copy);
+
   return retval;
 } /* }}} lookup_search */
@@ -231,12 +231,51 @@ DEF_TEST(regex) {
   return 0;
 }
 
+DEF_TEST(cached_decisions) {
+  lookup_t *obj;
+  int status;
+
+  CHECK_NOT_NULL(obj = lookup_create(lookup_class_callback, lookup_obj_callback,
+                                     (void *)free, (void *)free));
+
+  checked_lookup_add(obj, "/.*/", "/^cpu$/", "/.*/", "test", "/.*/",
+                     LU_GROUP_BY_HOST);
+
+  status = checked_lookup_search(obj, "host0", "cpu", "0", "test", "user",
+                                 /* expect new = */ 1);
+  EXPECT_EQ_INT(1, status);
+  /* Served from the decision cache. */
+  status = checked_lookup_search(obj, "host0", "cpu", "0", "test", "user",
+                                 /* expect new = */ 0);
+  EXPECT_EQ_INT(1, status);
+  status = checked_lookup_search(obj, "host0", "memory", "", "test", "used",
+                                 /* expect new = */ 0);
+  EXPECT_EQ_INT(0, status);
+  status = checked_lookup_search(obj, "host0", "memory", "", "test", "used",
+                                 /* expect new = */ 0);
+  EXPECT_EQ_INT(0, status);
+
+  /* Adding a user class invalidates the cached decisions. */
+  checked_lookup_add(obj, "/.*/", "/.*/", "/.*/", "test", "/.*/",
+                     LU_GROUP_BY_HOST);
+  status = checked_lookup_search(obj, "host0", "memory", "", "test", "used",
+                                 /* expect new = */ 1);
+  EXPECT_EQ_INT(1, status);
+  status = checked_lookup_search(obj, "host0", "memory", "", "test", "used",
+                                 /* expect new = */ 0);
+  EXPECT_EQ_INT(1, status);
+
+  lookup_destroy(obj);
+  return 0;
+}
+
 int main(int argc, char **argv) /* {{{ */
 {
   RUN_TEST(group_by_specific_host);
   RUN_TEST(group_by_any_host);
   RUN_TEST(multiple_lookups);
   RUN_TEST(regex);
+  RUN_TEST(cached_decisions);
 
   END_TEST;
 } /* }}} int main */
@@ -255,8 +255,10 @@ match_create_callback(const char *regex, const char *excluderegex,
   return obj;
 } /* cu_match_t *match_create_callback */
 
-cu_match_t *match_create_simple(const char *regex, const char *excluderegex,
-                                int match_ds_type) {
+static cu_match_t *match_create_value(const char *regex,
+                                      const char *excluderegex,
+                                      int match_ds_type,
+                                      latency_histogram_t histogram) {
   cu_match_value_t *user_data;
   cu_match_t *obj;
 
@@ -267,7 +269,7 @@ cu_match_t *match_create_simple(const char *regex, const char *excluderegex,
 
   if ((match_ds_type & UTILS_MATCH_DS_TYPE_GAUGE) &&
       (match_ds_type & UTILS_MATCH_CF_GAUGE_DIST)) {
-    user_data->latency = latency_counter_create();
+    user_data->latency = latency_counter_create_type(histogram);
     if (user_data->latency == NULL) {
       ERROR("match_create_simple(): latency_counter_create() failed.");
       free(user_data);
@@ -285,8 +287,22 @@ cu_match_t *match_create_simple(const char *regex, const char *excluderegex,
     return NULL;
   }
   return obj;
+} /* cu_match_t *match_create_value */
+
+cu_match_t *match_create_simple(const char *regex, const char *excluderegex,
+                                int match_ds_type) {
+  return match_create_value(regex, excluderegex, match_ds_type,
+                            LATENCY_HISTOGRAM_LINEAR);
 } /* cu_match_t *match_create_simple */
 
+cu_match_t *match_create_distribution(const char *regex,
+                                      const char *excluderegex,
+                                      latency_histogram_t histogram) {
+  return match_create_value(
+      regex, excluderegex,
+      UTILS_MATCH_DS_TYPE_GAUGE | UTILS_MATCH_CF_GAUGE_DIST, histogram);
+} /* cu_match_t *match_create_distribution */
+
 void match_value_reset(cu_match_value_t *mv) {
   if (mv == NULL)
     return;
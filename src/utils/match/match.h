@@ -132,6 +132,19 @@ match_create_callback(const char *regex, const char *excluderegex,
 cu_match_t *match_create_simple(const char *regex, const char *excluderegex,
                                 int ds_type);
 
+/*
+ * NAME
+ *  match_create_distribution
+ *
+ * DESCRIPTION
+ *  Like `match_create_simple' with a `ds_type' of
+ *  `UTILS_MATCH_DS_TYPE_GAUGE | UTILS_MATCH_CF_GAUGE_DIST', but lets the
+ *  caller choose the type of histogram used for the latency counter.
+ */
+cu_match_t *match_create_distribution(const char *regex,
+                                      const char *excluderegex,
+                                      latency_histogram_t histogram);
+
 /*
  * NAME
  *  match_value_reset
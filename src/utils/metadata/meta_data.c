@@ -29,14 +29,26 @@
 #include "plugin.h"
 #include "utils/common/common.h"
 #include "utils/metadata/meta_data.h"
+#include "utils_atomic.h"
 
 #define MD_MAX_NONSTRING_CHARS 128
 
+/* Strings of up to this size, including the terminating null byte, are stored
+ * within the entry itself. */
+#define MD_INLINE_STRING_SIZE 16
+
+/* Upper bound for the number of interned keys. Keys beyond that, e.g. keys
+ * received with PUTVAL, are stored in the string area of the block. */
+#define MD_INTERN_MAX 4096
+
+#define MD_FLAG_INLINE 0x01
+
 /*
  * Data types
  */
 union meta_value_u {
-  char *mv_string;
+  uint32_t mv_string; /* offset into the string area */
+  char mv_inline[MD_INLINE_STRING_SIZE];
   int64_t mv_signed_int;
   uint64_t mv_unsigned_int;
   double mv_double;
@@ -47,17 +59,127 @@ typedef union meta_value_u meta_value_t;
 struct meta_entry_s;
 typedef struct meta_entry_s meta_entry_t;
 struct meta_entry_s {
-  char *key;
+  const char *key; /* interned key or NULL, see key_offset */
+  uint32_t key_offset;
+  uint8_t type;
+  uint8_t flags;
   meta_value_t value;
-  int type;
-  meta_entry_t *next;
 };
 
+/* All entries of a meta data set live in one allocation: the entries array is
+ * followed by the string area, which holds strings too long to be inlined and
+ * keys which could not be interned. A block referenced by more than one
+ * meta_data_t is never modified; it is copied on the first write instead. */
+struct meta_block_s;
+typedef struct meta_block_s meta_block_t;
+struct meta_block_s {
+  unsigned int refcount;
+  uint32_t entries_num;
+  uint32_t entries_size;
+  uint32_t strings_len;
+  uint32_t strings_size;
+  meta_entry_t entries[];
+};
+
+#define MD_STRINGS(b) ((char *)((b)->entries + (b)->entries_size))
+
 struct meta_data_s {
-  meta_entry_t *head;
-  pthread_mutex_t lock;
+  meta_block_t *block;
 };
 
+/*
+ * Interned keys
+ * {{{ */
+static char **md_keys = NULL;
+static size_t md_keys_size = 0;
+static size_t md_keys_num = 0;
+static pthread_rwlock_t md_keys_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+static uint32_t md_hash(const char *key) {
+  uint32_t hash = 2166136261U;
+
+  for (const unsigned char *c = (const unsigned char *)key; *c != 0; c++) {
+    hash ^= *c;
+    hash *= 16777619U;
+  }
+
+  return hash;
+} /* uint32_t md_hash */
+
+/* XXX: The lock on md_keys must be held while calling this function! */
+static char *md_keys_find(const char *key, uint32_t hash) {
+  if (md_keys == NULL)
+    return NULL;
+
+  for (size_t i = hash & (md_keys_size - 1); md_keys[i] != NULL;
+       i = (i + 1) & (md_keys_size - 1))
+    if (strcmp(key, md_keys[i]) == 0)
+      return md_keys[i];
+
+  return NULL;
+} /* char *md_keys_find */
+
+/* XXX: The write lock on md_keys must be held while calling this function! */
+static int md_keys_grow(void) {
+  size_t size = (md_keys_size == 0) ? 64 : 2 * md_keys_size;
+  char **keys;
+
+  keys = calloc(size, sizeof(*keys));
+  if (keys == NULL)
+    return ENOMEM;
+
+  for (size_t i = 0; i < md_keys_size; i++) {
+    size_t j;
+
+    if (md_keys[i] == NULL)
+      continue;
+
+    for (j = md_hash(md_keys[i]) & (size - 1); keys[j] != NULL;
+         j = (j + 1) & (size - 1))
+      /* nop */;
+    keys[j] = md_keys[i];
+  }
+
+  free(md_keys);
+  md_keys = keys;
+  md_keys_size = size;
+
+  return 0;
+} /* int md_keys_grow */
+
+/* Returns the interned copy of "key" or NULL if the key could not be
+ * interned. Interned keys are never freed. */
+static const char *md_intern(const char *key) {
+  uint32_t hash = md_hash(key);
+  char *ret;
+
+  pthread_rwlock_rdlock(&md_keys_lock);
+  ret = md_keys_find(key, hash);
+  pthread_rwlock_unlock(&md_keys_lock);
+  if (ret != NULL)
+    return ret;
+
+  pthread_rwlock_wrlock(&md_keys_lock);
+  ret = md_keys_find(key, hash);
+  if ((ret == NULL) && (md_keys_num < MD_INTERN_MAX)) {
+    if ((2 * (md_keys_num + 1) <= md_keys_size) || (md_keys_grow() == 0))
+      ret = strdup(key);
+
+    if (ret != NULL) {
+      size_t i;
+      for (i = hash & (md_keys_size - 1); md_keys[i] != NULL;
+           i = (i + 1) & (md_keys_size - 1))
+        /* nop */;
+      md_keys[i] = ret;
+      md_keys_num++;
+    }
+  }
+  pthread_rwlock_unlock(&md_keys_lock);
+
+  return ret;
+} /* const char *md_intern */
+/* }}} */
+
 /*
  * Private functions
  */
@@ -79,204 +201,223 @@ static char *md_strdup(const char *orig) /* {{{ */
   return dest;
 } /* }}} char *md_strdup */
 
-static meta_entry_t *md_entry_alloc(const char *key) /* {{{ */
+static const char *md_entry_key(const meta_block_t *b, /* {{{ */
+                                const meta_entry_t *e) {
+  if (e->key != NULL)
+    return e->key;
+  return MD_STRINGS(b) + e->key_offset;
+} /* }}} const char *md_entry_key */
+
+static const char *md_entry_string(const meta_block_t *b, /* {{{ */
+                                   const meta_entry_t *e) {
+  if (e->flags & MD_FLAG_INLINE)
+    return e->value.mv_inline;
+  return MD_STRINGS(b) + e->value.mv_string;
+} /* }}} const char *md_entry_string */
+
+/* Returns the number of bytes of the string area still in use. */
+static size_t md_block_strings_used(const meta_block_t *b) /* {{{ */
 {
-  meta_entry_t *e;
+  size_t sz = 0;
 
-  e = calloc(1, sizeof(*e));
-  if (e == NULL) {
-    ERROR("md_entry_alloc: calloc failed.");
-    return NULL;
-  }
+  for (uint32_t i = 0; i < b->entries_num; i++) {
+    const meta_entry_t *e = b->entries + i;
 
-  e->key = md_strdup(key);
-  if (e->key == NULL) {
-    free(e);
-    ERROR("md_entry_alloc: md_strdup failed.");
-    return NULL;
+    if (e->key == NULL)
+      sz += strlen(md_entry_key(b, e)) + 1;
+    if ((e->type == MD_TYPE_STRING) && !(e->flags & MD_FLAG_INLINE))
+      sz += strlen(md_entry_string(b, e)) + 1;
   }
 
-  e->type = 0;
-  e->next = NULL;
+  return sz;
+} /* }}} size_t md_block_strings_used */
 
-  return e;
-} /* }}} meta_entry_t *md_entry_alloc */
+/* The caller must make sure the string fits into the string area. */
+static uint32_t md_block_append_string(meta_block_t *b, /* {{{ */
+                                       const char *str) {
+  size_t sz = strlen(str) + 1;
+  uint32_t offset = b->strings_len;
 
-/* XXX: The lock on md must be held while calling this function! */
-static meta_entry_t *md_entry_clone_contents(const meta_entry_t *orig) /* {{{ */
-{
-  meta_entry_t *copy;
+  memcpy(MD_STRINGS(b) + offset, str, sz);
+  b->strings_len += (uint32_t)sz;
 
-  /* WARNINGS :
-   *  - we do not check that orig != NULL here. You should have done it before.
-   *  - we do not set copy->next. DO NOT FORGET TO SET copy->next IN YOUR
-   * FUNCTION
-   */
+  return offset;
+} /* }}} uint32_t md_block_append_string */
 
-  copy = md_entry_alloc(orig->key);
-  if (copy == NULL)
-    return NULL;
-  copy->type = orig->type;
-  if (copy->type == MD_TYPE_STRING)
-    copy->value.mv_string = strdup(orig->value.mv_string);
-  else
-    copy->value = orig->value;
-
-  return copy;
-} /* }}} meta_entry_t *md_entry_clone_contents */
-
-static meta_entry_t *md_entry_clone(const meta_entry_t *orig) /* {{{ */
-{
-  meta_entry_t *copy;
+static meta_block_t *md_block_alloc(size_t entries_size, /* {{{ */
+                                    size_t strings_size) {
+  meta_block_t *b;
 
-  if (orig == NULL)
+  b = calloc(1, sizeof(*b) + entries_size * sizeof(meta_entry_t) +
+                    strings_size);
+  if (b == NULL)
     return NULL;
 
-  copy = md_entry_clone_contents(orig);
+  b->refcount = 1;
+  b->entries_size = (uint32_t)entries_size;
+  b->strings_size = (uint32_t)strings_size;
 
-  copy->next = md_entry_clone(orig->next);
-  return copy;
-} /* }}} meta_entry_t *md_entry_clone */
+  return b;
+} /* }}} meta_block_t *md_block_alloc */
 
-static void md_entry_free(meta_entry_t *e) /* {{{ */
+static void md_block_release(meta_block_t *b) /* {{{ */
 {
-  if (e == NULL)
+  if (b == NULL)
     return;
 
-  free(e->key);
-
-  if (e->type == MD_TYPE_STRING)
-    free(e->value.mv_string);
+  if (ATOMIC_SUB_FETCH(&b->refcount, 1) == 0)
+    free(b);
+} /* }}} void md_block_release */
 
-  if (e->next != NULL)
-    md_entry_free(e->next);
+/* Copies "orig" into a new block, dropping strings which are no longer
+ * referenced from the string area. */
+static meta_block_t *md_block_copy(const meta_block_t *orig, /* {{{ */
+                                   size_t entries_size, size_t strings_size) {
+  meta_block_t *b;
 
-  free(e);
-} /* }}} void md_entry_free */
-
-static int md_entry_insert(meta_data_t *md, meta_entry_t *e) /* {{{ */
-{
-  meta_entry_t *this;
-  meta_entry_t *prev;
-
-  if ((md == NULL) || (e == NULL))
-    return -EINVAL;
-
-  pthread_mutex_lock(&md->lock);
-
-  prev = NULL;
-  this = md->head;
-  while (this != NULL) {
-    if (strcasecmp(e->key, this->key) == 0)
-      break;
+  b = md_block_alloc(entries_size, strings_size);
+  if (b == NULL)
+    return NULL;
 
-    prev = this;
-    this = this->next;
+  if (orig == NULL)
+    return b;
+
+  for (uint32_t i = 0; i < orig->entries_num; i++) {
+    const meta_entry_t *src = orig->entries + i;
+    meta_entry_t *dst = b->entries + i;
+
+    *dst = *src;
+    if (src->key == NULL)
+      dst->key_offset = md_block_append_string(b, md_entry_key(orig, src));
+    if ((src->type == MD_TYPE_STRING) && !(src->flags & MD_FLAG_INLINE))
+      dst->value.mv_string =
+          md_block_append_string(b, md_entry_string(orig, src));
   }
+  b->entries_num = orig->entries_num;
+
+  return b;
+} /* }}} meta_block_t *md_block_copy */
+
+/* Makes sure "md" has a block of its own with room for "entries_num" more
+ * entries and "strings_len" more bytes in the string area. */
+static int md_block_reserve(meta_data_t *md, size_t entries_num, /* {{{ */
+                            size_t strings_len) {
+  meta_block_t *b = md->block;
+  size_t entries_size = 4;
+  size_t strings_size = 0;
+  size_t strings_used = 0;
+
+  if ((b != NULL) && (ATOMIC_LOAD(&b->refcount) == 1) &&
+      ((b->entries_num + entries_num) <= b->entries_size) &&
+      ((b->strings_len + strings_len) <= b->strings_size))
+    return 0;
 
-  if (this == NULL) {
-    /* This key does not exist yet. */
-    if (md->head == NULL)
-      md->head = e;
-    else {
-      assert(prev != NULL);
-      prev->next = e;
-    }
-
-    e->next = NULL;
-  } else /* (this != NULL) */
-  {
-    if (prev == NULL)
-      md->head = e;
-    else
-      prev->next = e;
+  if (b != NULL) {
+    entries_size = b->entries_size;
+    strings_size = b->strings_size;
+    strings_used = md_block_strings_used(b);
 
-    e->next = this->next;
+    if ((b->entries_num + entries_num) > entries_size)
+      entries_size *= 2;
   }
+  if ((strings_used + strings_len) > strings_size)
+    strings_size = (strings_used + strings_len) +
+                   ((strings_size < 64) ? 64 : strings_size);
 
-  pthread_mutex_unlock(&md->lock);
+  if ((entries_size > UINT32_MAX / sizeof(meta_entry_t)) ||
+      (strings_size > UINT32_MAX))
+    return ENOMEM;
 
-  if (this != NULL) {
-    this->next = NULL;
-    md_entry_free(this);
-  }
+  b = md_block_copy(md->block, entries_size, strings_size);
+  if (b == NULL)
+    return ENOMEM;
+
+  md_block_release(md->block);
+  md->block = b;
 
   return 0;
-} /* }}} int md_entry_insert */
+} /* }}} int md_block_reserve */
 
-/* XXX: The lock on md must be held while calling this function! */
-static int md_entry_insert_clone(meta_data_t *md, meta_entry_t *orig) /* {{{ */
+static int md_entry_index(const meta_block_t *b, const char *key) /* {{{ */
 {
-  meta_entry_t *e;
-  meta_entry_t *this;
-  meta_entry_t *prev;
-
-  /* WARNINGS :
-   *  - we do not check that md and e != NULL here. You should have done it
-   * before.
-   *  - we do not use the lock. You should have set it before.
-   */
-
-  e = md_entry_clone_contents(orig);
+  if (b == NULL)
+    return -1;
 
-  prev = NULL;
-  this = md->head;
-  while (this != NULL) {
-    if (strcasecmp(e->key, this->key) == 0)
-      break;
-
-    prev = this;
-    this = this->next;
+  for (uint32_t i = 0; i < b->entries_num; i++) {
+    const char *k = md_entry_key(b, b->entries + i);
+    if ((k == key) || (strcasecmp(key, k) == 0))
+      return (int)i;
   }
 
-  if (this == NULL) {
-    /* This key does not exist yet. */
-    if (md->head == NULL)
-      md->head = e;
-    else {
-      assert(prev != NULL);
-      prev->next = e;
-    }
+  return -1;
+} /* }}} int md_entry_index */
 
-    e->next = NULL;
-  } else /* (this != NULL) */
-  {
-    if (prev == NULL)
-      md->head = e;
-    else
-      prev->next = e;
+static const meta_entry_t *md_entry_lookup(meta_data_t *md, /* {{{ */
+                                           const char *key) {
+  int i;
 
-    e->next = this->next;
-  }
+  if ((md == NULL) || (key == NULL))
+    return NULL;
 
-  if (this != NULL) {
-    this->next = NULL;
-    md_entry_free(this);
-  }
+  i = md_entry_index(md->block, key);
+  if (i < 0)
+    return NULL;
 
-  return 0;
-} /* }}} int md_entry_insert_clone */
+  return md->block->entries + i;
+} /* }}} meta_entry_t *md_entry_lookup */
 
-/* XXX: The lock on md must be held while calling this function! */
-static meta_entry_t *md_entry_lookup(meta_data_t *md, /* {{{ */
-                                     const char *key) {
+/* Adds or replaces the entry "key". For strings, "str" holds the value and
+ * "value" is ignored. */
+static int md_entry_set(meta_data_t *md, const char *key, int type, /* {{{ */
+                        meta_value_t value, const char *str) {
+  const char *interned = md_intern(key);
+  size_t str_size = (type == MD_TYPE_STRING) ? strlen(str) + 1 : 0;
+  size_t strings_len = 0;
   meta_entry_t *e;
+  int i;
 
-  if ((md == NULL) || (key == NULL))
-    return NULL;
+  if (interned == NULL)
+    strings_len += strlen(key) + 1;
+  if (str_size > MD_INLINE_STRING_SIZE)
+    strings_len += str_size;
 
-  for (e = md->head; e != NULL; e = e->next)
-    if (strcasecmp(key, e->key) == 0)
-      break;
+  i = md_entry_index(md->block, key);
+  if (md_block_reserve(md, (i < 0) ? 1 : 0, strings_len) != 0) {
+    ERROR("md_entry_set: md_block_reserve failed.");
+    return -ENOMEM;
+  }
 
-  return e;
-} /* }}} meta_entry_t *md_entry_lookup */
+  /* Copying the block retains the order of the entries. */
+  if (i < 0)
+    i = (int)md->block->entries_num++;
+  e = md->block->entries + i;
+
+  e->key = interned;
+  e->key_offset = 0;
+  if (interned == NULL)
+    e->key_offset = md_block_append_string(md->block, key);
+
+  e->type = (uint8_t)type;
+  e->flags = 0;
+  if (type != MD_TYPE_STRING) {
+    e->value = value;
+  } else if (str_size <= MD_INLINE_STRING_SIZE) {
+    memcpy(e->value.mv_inline, str, str_size);
+    e->flags |= MD_FLAG_INLINE;
+  } else {
+    e->value.mv_string = md_block_append_string(md->block, str);
+  }
+
+  return 0;
+} /* }}} int md_entry_set */
 
 /*
  * Each value_list_t*, as it is going through the system, is handled by exactly
  * one thread. Plugins which pass a value_list_t* to another thread, e.g. the
  * rrdtool plugin, must create a copy first. The meta data within a
- * value_list_t* is not thread safe and doesn't need to be.
+ * value_list_t* is not thread safe and doesn't need to be. Copies share their
+ * block until one of them is modified, which is why the block's reference
+ * count is updated atomically.
  *
  * The meta data associated with cache entries are a different story. There, we
  * need to ensure exclusive locking to prevent leaks and other funky business.
@@ -296,8 +437,6 @@ meta_data_t *meta_data_create(void) /* {{{ */
     return NULL;
   }
 
-  pthread_mutex_init(&md->lock, /* attr = */ NULL);
-
   return md;
 } /* }}} meta_data_t *meta_data_create */
 
@@ -312,16 +451,18 @@ meta_data_t *meta_data_clone(meta_data_t *orig) /* {{{ */
   if (copy == NULL)
     return NULL;
 
-  pthread_mutex_lock(&orig->lock);
-  copy->head = md_entry_clone(orig->head);
-  pthread_mutex_unlock(&orig->lock);
+  copy->block = orig->block;
+  if (copy->block != NULL)
+    ATOMIC_ADD_FETCH(&copy->block->refcount, 1);
 
   return copy;
 } /* }}} meta_data_t *meta_data_clone */
 
 int meta_data_clone_merge(meta_data_t **dest, meta_data_t *orig) /* {{{ */
 {
-  if (orig == NULL)
+  meta_block_t *b;
+
+  if ((orig == NULL) || (orig->block == NULL))
     return 0;
 
   if (*dest == NULL) {
@@ -329,11 +470,23 @@ int meta_data_clone_merge(meta_data_t **dest, meta_data_t *orig) /* {{{ */
     return 0;
   }
 
-  pthread_mutex_lock(&orig->lock);
-  for (meta_entry_t *e = orig->head; e != NULL; e = e->next) {
-    md_entry_insert_clone((*dest), e);
+  if ((*dest)->block == NULL) {
+    (*dest)->block = orig->block;
+    ATOMIC_ADD_FETCH(&orig->block->refcount, 1);
+    return 0;
+  }
+
+  b = orig->block;
+  if ((*dest)->block == b)
+    return 0;
+
+  for (uint32_t i = 0; i < b->entries_num; i++) {
+    const meta_entry_t *e = b->entries + i;
+    const char *str =
+        (e->type == MD_TYPE_STRING) ? md_entry_string(b, e) : NULL;
+
+    md_entry_set(*dest, md_entry_key(b, e), e->type, e->value, str);
   }
-  pthread_mutex_unlock(&orig->lock);
 
   return 0;
 } /* }}} int meta_data_clone_merge */
@@ -343,8 +496,7 @@ void meta_data_destroy(meta_data_t *md) /* {{{ */
   if (md == NULL)
     return;
 
-  md_entry_free(md->head);
-  pthread_mutex_destroy(&md->lock);
+  md_block_release(md->block);
   free(md);
 } /* }}} void meta_data_destroy */
 
@@ -353,96 +505,66 @@ int meta_data_exists(meta_data_t *md, const char *key) /* {{{ */
   if ((md == NULL) || (key == NULL))
     return -EINVAL;
 
-  pthread_mutex_lock(&md->lock);
-
-  for (meta_entry_t *e = md->head; e != NULL; e = e->next) {
-    if (strcasecmp(key, e->key) == 0) {
-      pthread_mutex_unlock(&md->lock);
-      return 1;
-    }
-  }
-
-  pthread_mutex_unlock(&md->lock);
-  return 0;
+  return (md_entry_lookup(md, key) != NULL) ? 1 : 0;
 } /* }}} int meta_data_exists */
 
 int meta_data_type(meta_data_t *md, const char *key) /* {{{ */
 {
+  const meta_entry_t *e;
+
   if ((md == NULL) || (key == NULL))
     return -EINVAL;
 
-  pthread_mutex_lock(&md->lock);
-
-  for (meta_entry_t *e = md->head; e != NULL; e = e->next) {
-    if (strcasecmp(key, e->key) == 0) {
-      pthread_mutex_unlock(&md->lock);
-      return e->type;
-    }
-  }
+  e = md_entry_lookup(md, key);
+  if (e == NULL)
+    return 0;
 
-  pthread_mutex_unlock(&md->lock);
-  return 0;
+  return e->type;
 } /* }}} int meta_data_type */
 
 int meta_data_toc(meta_data_t *md, char ***toc) /* {{{ */
 {
-  int i = 0, count = 0;
+  meta_block_t *b;
 
   if ((md == NULL) || (toc == NULL))
     return -EINVAL;
 
-  pthread_mutex_lock(&md->lock);
-
-  for (meta_entry_t *e = md->head; e != NULL; e = e->next)
-    ++count;
+  b = md->block;
+  if ((b == NULL) || (b->entries_num == 0))
+    return 0;
 
-  if (count == 0) {
-    pthread_mutex_unlock(&md->lock);
-    return count;
-  }
+  *toc = calloc(b->entries_num, sizeof(**toc));
+  if (*toc == NULL)
+    return -ENOMEM;
 
-  *toc = calloc(count, sizeof(**toc));
-  for (meta_entry_t *e = md->head; e != NULL; e = e->next)
-    (*toc)[i++] = strdup(e->key);
+  for (uint32_t i = 0; i < b->entries_num; i++)
+    (*toc)[i] = strdup(md_entry_key(b, b->entries + i));
 
-  pthread_mutex_unlock(&md->lock);
-  return count;
+  return (int)b->entries_num;
 } /* }}} int meta_data_toc */
 
 int meta_data_delete(meta_data_t *md, const char *key) /* {{{ */
 {
-  meta_entry_t *this;
-  meta_entry_t *prev;
+  meta_block_t *b;
+  int i;
 
   if ((md == NULL) || (key == NULL))
     return -EINVAL;
 
-  pthread_mutex_lock(&md->lock);
-
-  prev = NULL;
-  this = md->head;
-  while (this != NULL) {
-    if (strcasecmp(key, this->key) == 0)
-      break;
-
-    prev = this;
-    this = this->next;
-  }
-
-  if (this == NULL) {
-    pthread_mutex_unlock(&md->lock);
+  i = md_entry_index(md->block, key);
+  if (i < 0)
     return -ENOENT;
-  }
-
-  if (prev == NULL)
-    md->head = this->next;
-  else
-    prev->next = this->next;
 
-  pthread_mutex_unlock(&md->lock);
+  if (md_block_reserve(md, 0, 0) != 0) {
+    ERROR("meta_data_delete: md_block_reserve failed.");
+    return -ENOMEM;
+  }
 
-  this->next = NULL;
-  md_entry_free(this);
+  /* The string area is compacted the next time the block is copied. */
+  b = md->block;
+  memmove(b->entries + i, b->entries + i + 1,
+          (b->entries_num - (uint32_t)i - 1) * sizeof(*b->entries));
+  b->entries_num--;
 
   return 0;
 } /* }}} int meta_data_delete */
@@ -452,92 +574,52 @@ int meta_data_delete(meta_data_t *md, const char *key) /* {{{ */
  */
 int meta_data_add_string(meta_data_t *md, /* {{{ */
                          const char *key, const char *value) {
-  meta_entry_t *e;
+  meta_value_t mv = {0};
 
   if ((md == NULL) || (key == NULL) || (value == NULL))
     return -EINVAL;
 
-  e = md_entry_alloc(key);
-  if (e == NULL)
-    return -ENOMEM;
-
-  e->value.mv_string = md_strdup(value);
-  if (e->value.mv_string == NULL) {
-    ERROR("meta_data_add_string: md_strdup failed.");
-    md_entry_free(e);
-    return -ENOMEM;
-  }
-  e->type = MD_TYPE_STRING;
-
-  return md_entry_insert(md, e);
+  return md_entry_set(md, key, MD_TYPE_STRING, mv, value);
 } /* }}} int meta_data_add_string */
 
 int meta_data_add_signed_int(meta_data_t *md, /* {{{ */
                              const char *key, int64_t value) {
-  meta_entry_t *e;
+  meta_value_t mv = {.mv_signed_int = value};
 
   if ((md == NULL) || (key == NULL))
     return -EINVAL;
 
-  e = md_entry_alloc(key);
-  if (e == NULL)
-    return -ENOMEM;
-
-  e->value.mv_signed_int = value;
-  e->type = MD_TYPE_SIGNED_INT;
-
-  return md_entry_insert(md, e);
+  return md_entry_set(md, key, MD_TYPE_SIGNED_INT, mv, NULL);
 } /* }}} int meta_data_add_signed_int */
 
 int meta_data_add_unsigned_int(meta_data_t *md, /* {{{ */
                                const char *key, uint64_t value) {
-  meta_entry_t *e;
+  meta_value_t mv = {.mv_unsigned_int = value};
 
   if ((md == NULL) || (key == NULL))
     return -EINVAL;
 
-  e = md_entry_alloc(key);
-  if (e == NULL)
-    return -ENOMEM;
-
-  e->value.mv_unsigned_int = value;
-  e->type = MD_TYPE_UNSIGNED_INT;
-
-  return md_entry_insert(md, e);
+  return md_entry_set(md, key, MD_TYPE_UNSIGNED_INT, mv, NULL);
 } /* }}} int meta_data_add_unsigned_int */
 
 int meta_data_add_double(meta_data_t *md, /* {{{ */
                          const char *key, double value) {
-  meta_entry_t *e;
+  meta_value_t mv = {.mv_double = value};
 
   if ((md == NULL) || (key == NULL))
     return -EINVAL;
 
-  e = md_entry_alloc(key);
-  if (e == NULL)
-    return -ENOMEM;
-
-  e->value.mv_double = value;
-  e->type = MD_TYPE_DOUBLE;
-
-  return md_entry_insert(md, e);
+  return md_entry_set(md, key, MD_TYPE_DOUBLE, mv, NULL);
 } /* }}} int meta_data_add_double */
 
 int meta_data_add_boolean(meta_data_t *md, /* {{{ */
                           const char *key, bool value) {
-  meta_entry_t *e;
+  meta_value_t mv = {.mv_boolean = value};
 
   if ((md == NULL) || (key == NULL))
     return -EINVAL;
 
-  e = md_entry_alloc(key);
-  if (e == NULL)
-    return -ENOMEM;
-
-  e->value.mv_boolean = value;
-  e->type = MD_TYPE_BOOLEAN;
-
-  return md_entry_insert(md, e);
+  return md_entry_set(md, key, MD_TYPE_BOOLEAN, mv, NULL);
 } /* }}} int meta_data_add_boolean */
 
 /*
@@ -545,35 +627,27 @@ int meta_data_add_boolean(meta_data_t *md, /* {{{ */
  */
 int meta_data_get_string(meta_data_t *md, /* {{{ */
                          const char *key, char **value) {
-  meta_entry_t *e;
+  const meta_entry_t *e;
   char *temp;
 
   if ((md == NULL) || (key == NULL) || (value == NULL))
     return -EINVAL;
 
-  pthread_mutex_lock(&md->lock);
-
   e = md_entry_lookup(md, key);
-  if (e == NULL) {
-    pthread_mutex_unlock(&md->lock);
+  if (e == NULL)
     return -ENOENT;
-  }
 
   if (e->type != MD_TYPE_STRING) {
-    ERROR("meta_data_get_string: Type mismatch for key `%s'", e->key);
-    pthread_mutex_unlock(&md->lock);
+    ERROR("meta_data_get_string: Type mismatch for key `%s'", key);
     return -ENOENT;
   }
 
-  temp = md_strdup(e->value.mv_string);
+  temp = md_strdup(md_entry_string(md->block, e));
   if (temp == NULL) {
-    pthread_mutex_unlock(&md->lock);
     ERROR("meta_data_get_string: md_strdup failed.");
     return -ENOMEM;
   }
 
-  pthread_mutex_unlock(&md->lock);
-
   *value = temp;
 
   return 0;
@@ -581,115 +655,87 @@ int meta_data_get_string(meta_data_t *md, /* {{{ */
 
 int meta_data_get_signed_int(meta_data_t *md, /* {{{ */
                              const char *key, int64_t *value) {
-  meta_entry_t *e;
+  const meta_entry_t *e;
 
   if ((md == NULL) || (key == NULL) || (value == NULL))
     return -EINVAL;
 
-  pthread_mutex_lock(&md->lock);
-
   e = md_entry_lookup(md, key);
-  if (e == NULL) {
-    pthread_mutex_unlock(&md->lock);
+  if (e == NULL)
     return -ENOENT;
-  }
 
   if (e->type != MD_TYPE_SIGNED_INT) {
-    ERROR("meta_data_get_signed_int: Type mismatch for key `%s'", e->key);
-    pthread_mutex_unlock(&md->lock);
+    ERROR("meta_data_get_signed_int: Type mismatch for key `%s'", key);
     return -ENOENT;
   }
 
   *value = e->value.mv_signed_int;
-
-  pthread_mutex_unlock(&md->lock);
   return 0;
 } /* }}} int meta_data_get_signed_int */
 
 int meta_data_get_unsigned_int(meta_data_t *md, /* {{{ */
                                const char *key, uint64_t *value) {
-  meta_entry_t *e;
+  const meta_entry_t *e;
 
   if ((md == NULL) || (key == NULL) || (value == NULL))
     return -EINVAL;
 
-  pthread_mutex_lock(&md->lock);
-
   e = md_entry_lookup(md, key);
-  if (e == NULL) {
-    pthread_mutex_unlock(&md->lock);
+  if (e == NULL)
     return -ENOENT;
-  }
 
   if (e->type != MD_TYPE_UNSIGNED_INT) {
-    ERROR("meta_data_get_unsigned_int: Type mismatch for key `%s'", e->key);
-    pthread_mutex_unlock(&md->lock);
+    ERROR("meta_data_get_unsigned_int: Type mismatch for key `%s'", key);
     return -ENOENT;
   }
 
   *value = e->value.mv_unsigned_int;
-
-  pthread_mutex_unlock(&md->lock);
   return 0;
 } /* }}} int meta_data_get_unsigned_int */
 
 int meta_data_get_double(meta_data_t *md, /* {{{ */
                          const char *key, double *value) {
-  meta_entry_t *e;
+  const meta_entry_t *e;
 
   if ((md == NULL) || (key == NULL) || (value == NULL))
     return -EINVAL;
 
-  pthread_mutex_lock(&md->lock);
-
   e = md_entry_lookup(md, key);
-  if (e == NULL) {
-    pthread_mutex_unlock(&md->lock);
+  if (e == NULL)
     return -ENOENT;
-  }
 
   if (e->type != MD_TYPE_DOUBLE) {
-    ERROR("meta_data_get_double: Type mismatch for key `%s'", e->key);
-    pthread_mutex_unlock(&md->lock);
+    ERROR("meta_data_get_double: Type mismatch for key `%s'", key);
     return -ENOENT;
   }
 
   *value = e->value.mv_double;
-
-  pthread_mutex_unlock(&md->lock);
   return 0;
 } /* }}} int meta_data_get_double */
 
 int meta_data_get_boolean(meta_data_t *md, /* {{{ */
                           const char *key, bool *value) {
-  meta_entry_t *e;
+  const meta_entry_t *e;
 
   if ((md == NULL) || (key == NULL) || (value == NULL))
     return -EINVAL;
 
-  pthread_mutex_lock(&md->lock);
-
   e = md_entry_lookup(md, key);
-  if (e == NULL) {
-    pthread_mutex_unlock(&md->lock);
+  if (e == NULL)
     return -ENOENT;
-  }
 
   if (e->type != MD_TYPE_BOOLEAN) {
-    ERROR("meta_data_get_boolean: Type mismatch for key `%s'", e->key);
-    pthread_mutex_unlock(&md->lock);
+    ERROR("meta_data_get_boolean: Type mismatch for key `%s'", key);
     return -ENOENT;
   }
 
   *value = e->value.mv_boolean;
-
-  pthread_mutex_unlock(&md->lock);
   return 0;
 } /* }}} int meta_data_get_boolean */
 
 int meta_data_as_string(meta_data_t *md, /* {{{ */
                         const char *key, char **value) {
-  meta_entry_t *e;
+  const meta_entry_t *e;
   const char *actual;
   char buffer[MD_MAX_NONSTRING_CHARS]; /* For non-string types. */
   char *temp;
@@ -698,19 +744,15 @@ int meta_data_as_string(meta_data_t *md, /* {{{ */
   if ((md == NULL) || (key == NULL) || (value == NULL))
     return -EINVAL;
 
-  pthread_mutex_lock(&md->lock);
-
   e = md_entry_lookup(md, key);
-  if (e == NULL) {
-    pthread_mutex_unlock(&md->lock);
+  if (e == NULL)
     return -ENOENT;
-  }
 
   type = e->type;
 
   switch (type) {
   case MD_TYPE_STRING:
-    actual = e->value.mv_string;
+    actual = md_entry_string(md->block, e);
     break;
   case MD_TYPE_SIGNED_INT:
     snprintf(buffer, sizeof(buffer), "%" PRIi64, e->value.mv_signed_int);
@@ -728,13 +770,10 @@ int meta_data_as_string(meta_data_t *md, /* {{{ */
     actual = e->value.mv_boolean ? "true" : "false";
     break;
   default:
-    pthread_mutex_unlock(&md->lock);
     ERROR("meta_data_as_string: unknown type %d for key `%s'", type, key);
     return -ENOENT;
   }
 
-  pthread_mutex_unlock(&md->lock);
-
   temp = md_strdup(actual);
   if (temp == NULL) {
     ERROR("meta_data_as_string: md_strdup failed for key `%s'.", key);
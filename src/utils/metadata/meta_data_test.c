@@ -110,8 +110,75 @@ DEF_TEST(base) {
   return 0;
 }
 
+DEF_TEST(clone) {
+  meta_data_t *m;
+  meta_data_t *c;
+
+  char *s;
+  int64_t si;
+  char key[32];
+  const char *long_string = "this string is too long to be stored inline";
+
+  CHECK_NOT_NULL(m = meta_data_create());
+  CHECK_ZERO(meta_data_add_string(m, "short", "foo"));
+  CHECK_ZERO(meta_data_add_string(m, "long", long_string));
+  CHECK_ZERO(meta_data_add_signed_int(m, "signed_int", 42));
+
+  /* modifying a clone doesn't modify the original and vice versa */
+  CHECK_NOT_NULL(c = meta_data_clone(m));
+  CHECK_ZERO(meta_data_add_string(c, "long", "bar"));
+  CHECK_ZERO(meta_data_delete(c, "short"));
+  CHECK_ZERO(meta_data_add_signed_int(m, "signed_int", 23));
+
+  CHECK_ZERO(meta_data_get_string(m, "long", &s));
+  EXPECT_EQ_STR(long_string, s);
+  sfree(s);
+  OK(meta_data_exists(m, "short"));
+  CHECK_ZERO(meta_data_get_signed_int(m, "signed_int", &si));
+  EXPECT_EQ_INT(23, (int)si);
+
+  CHECK_ZERO(meta_data_get_string(c, "long", &s));
+  EXPECT_EQ_STR("bar", s);
+  sfree(s);
+  OK(!meta_data_exists(c, "short"));
+  CHECK_ZERO(meta_data_get_signed_int(c, "signed_int", &si));
+  EXPECT_EQ_INT(42, (int)si);
+
+  /* keys are case insensitive */
+  CHECK_ZERO(meta_data_add_string(c, "LONG", long_string));
+  CHECK_ZERO(meta_data_get_string(c, "long", &s));
+  EXPECT_EQ_STR(long_string, s);
+  sfree(s);
+
+  /* growing the block retains all entries */
+  for (int i = 0; i < 100; i++) {
+    snprintf(key, sizeof(key), "key%d", i);
+    CHECK_ZERO(meta_data_add_string(c, key, long_string));
+  }
+  for (int i = 0; i < 100; i++) {
+    snprintf(key, sizeof(key), "key%d", i);
+    CHECK_ZERO(meta_data_get_string(c, key, &s));
+    EXPECT_EQ_STR(long_string, s);
+    sfree(s);
+  }
+  CHECK_ZERO(meta_data_get_signed_int(c, "signed_int", &si));
+  EXPECT_EQ_INT(42, (int)si);
+
+  /* merging overwrites existing keys and adds missing ones */
+  CHECK_ZERO(meta_data_clone_merge(&c, m));
+  OK(meta_data_exists(c, "short"));
+  CHECK_ZERO(meta_data_get_signed_int(c, "signed_int", &si));
+  EXPECT_EQ_INT(23, (int)si);
+  OK(meta_data_exists(c, "key99"));
+
+  meta_data_destroy(c);
+  meta_data_destroy(m);
+  return 0;
+}
+
 int main(void) {
   RUN_TEST(base);
+  RUN_TEST(clone);
 
   END_TEST;
 }
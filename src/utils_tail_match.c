@@ -261,7 +261,12 @@ int tail_match_add_match_simple(cu_tail_match_t *obj, const char *regex,
   cu_tail_match_simple_t *user_data;
   int status;
 
-  match = match_create_simple(regex, excluderegex, ds_type);
+  if ((ds_type & UTILS_MATCH_DS_TYPE_GAUGE) &&
+      (ds_type & UTILS_MATCH_CF_GAUGE_DIST))
+    match = match_create_distribution(regex, excluderegex,
+                                      latency_cfg.histogram);
+  else
+    match = match_create_simple(regex, excluderegex, ds_type);
   if (match == NULL)
     return -1;
 
@@ -53,6 +53,7 @@
 #include "utils_complain.h"
 
 #include <netdb.h>
+#include <poll.h>
 
 #ifndef WG_DEFAULT_NODE
 #define WG_DEFAULT_NODE "localhost"
@@ -83,9 +84,34 @@
 #define WG_MIN_RECONNECT_INTERVAL TIME_T_TO_CDTIME_T(1)
 #endif
 
+/* Time the sender thread is given to drain its queue on shutdown. */
+#ifndef WG_DRAIN_TIMEOUT
+#define WG_DRAIN_TIMEOUT TIME_T_TO_CDTIME_T(2)
+#endif
+
 /*
  * Private variables
  */
+/* A full send buffer queued for the sender thread. Buffers beyond the ring
+ * are allocated on demand and marked as "spilled". */
+struct wg_buffer {
+  struct wg_buffer *next;
+  size_t len;
+  bool spilled;
+  char data[WG_SEND_BUF_SIZE];
+};
+
+struct wg_connection {
+  int fd;
+  bool connected;
+  cdtime_t last_connect_time;
+  cdtime_t connect_time;
+
+  /* The buffer currently being sent and the number of bytes sent so far. */
+  struct wg_buffer *buffer;
+  size_t sent;
+};
+
 struct wg_callback {
   int sock_fd;
 
@@ -114,6 +140,25 @@ struct wg_callback {
   cdtime_t last_reconnect_time;
   cdtime_t reconnect_interval;
   bool reconnect_interval_reached;
+
+  /* Asynchronous mode, enabled by a positive send_buffers_num. */
+  int send_buffers_num;
+  int connections_num;
+  size_t spill_max;
+
+  struct wg_buffer *buffers;
+  struct wg_buffer *buffers_free;
+  struct wg_buffer *queue_head;
+  struct wg_buffer *queue_tail;
+  size_t spill_size;
+  pthread_mutex_t queue_lock;
+  c_complain_t queue_complaint;
+
+  struct wg_connection *connections;
+  pthread_t sender_thread;
+  bool sender_running;
+  bool sender_shutdown;
+  int wakeup_fd[2];
 };
 
 /* wg_force_reconnect_check closes cb->sock_fd when it was open for longer
@@ -172,6 +217,445 @@ static int wg_send_buffer(struct wg_callback *cb) {
   return 0;
 }
 
+/*
+ * Asynchronous mode
+ * =================
+ * Full send buffers are copied into a queue which a dedicated sender thread
+ * drains over up to "connections_num" non-blocking connections. The queue
+ * uses the preallocated ring of "send_buffers_num" buffers first, then up to
+ * "spill_max" bytes of additional buffers, before dropping the oldest data.
+ */
+static void wg_sender_wakeup(struct wg_callback *cb) {
+  /* If the pipe is full, the sender thread is about to wake up anyway. */
+  if (write(cb->wakeup_fd[1], "", 1) < 0)
+    return;
+}
+
+/* NOTE: You must hold cb->queue_lock when calling this function! */
+static void wg_queue_append(struct wg_callback *cb, struct wg_buffer *buf) {
+  buf->next = NULL;
+  if (cb->queue_tail == NULL)
+    cb->queue_head = buf;
+  else
+    cb->queue_tail->next = buf;
+  cb->queue_tail = buf;
+}
+
+/* NOTE: You must hold cb->queue_lock when calling this function! */
+static struct wg_buffer *wg_queue_shift(struct wg_callback *cb) {
+  struct wg_buffer *buf = cb->queue_head;
+
+  if (buf == NULL)
+    return NULL;
+
+  cb->queue_head = buf->next;
+  if (cb->queue_head == NULL)
+    cb->queue_tail = NULL;
+  buf->next = NULL;
+
+  return buf;
+}
+
+static void wg_buffer_release(struct wg_callback *cb, struct wg_buffer *buf) {
+  pthread_mutex_lock(&cb->queue_lock);
+  if (buf->spilled) {
+    cb->spill_size -= sizeof(buf->data);
+    sfree(buf);
+  } else {
+    buf->next = cb->buffers_free;
+    cb->buffers_free = buf;
+  }
+  pthread_mutex_unlock(&cb->queue_lock);
+}
+
+/* wg_queue_buffer hands the contents of cb->send_buf to the sender thread.
+ * NOTE: You must hold cb->send_lock when calling this function! */
+static int wg_queue_buffer(struct wg_callback *cb) {
+  struct wg_buffer *buf;
+  size_t dropped = 0;
+
+  pthread_mutex_lock(&cb->queue_lock);
+
+  buf = cb->buffers_free;
+  if (buf != NULL) {
+    cb->buffers_free = buf->next;
+  } else if ((cb->spill_size + sizeof(buf->data)) <= cb->spill_max) {
+    buf = calloc(1, sizeof(*buf));
+    if (buf != NULL) {
+      buf->spilled = true;
+      cb->spill_size += sizeof(buf->data);
+    }
+  }
+
+  /* There are more ring buffers than connections, so the queue is never empty
+   * when no buffer is free. */
+  if (buf == NULL) {
+    buf = wg_queue_shift(cb);
+    assert(buf != NULL);
+    dropped = buf->len;
+  }
+
+  memcpy(buf->data, cb->send_buf, cb->send_buf_fill);
+  buf->len = cb->send_buf_fill;
+  wg_queue_append(cb, buf);
+
+  pthread_mutex_unlock(&cb->queue_lock);
+
+  wg_sender_wakeup(cb);
+
+  if (dropped > 0) {
+    c_complain(LOG_WARNING, &cb->queue_complaint,
+               "write_graphite plugin: Send queue for %s:%s (%s) is full; "
+               "dropping %" PRIsz " bytes of the oldest data.",
+               cb->node, cb->service, cb->protocol, dropped);
+    return 0;
+  }
+
+  c_release(LOG_INFO, &cb->queue_complaint,
+            "write_graphite plugin: Send queue for %s:%s (%s) is no longer "
+            "full.",
+            cb->node, cb->service, cb->protocol);
+  return 0;
+}
+
+/* wg_buffer_skip_sent removes the part of "buf" that has already been sent.
+ * A line that was only partially sent is dropped as well, so the next
+ * connection starts with a complete line. Returns the number of bytes left. */
+static size_t wg_buffer_skip_sent(struct wg_buffer *buf, size_t sent) {
+  size_t start = sent;
+
+  if ((sent > 0) && (buf->data[sent - 1] != '\n')) {
+    char *eol = memchr(buf->data + sent, '\n', buf->len - sent);
+    start = (eol != NULL) ? (size_t)(eol - buf->data) + 1 : buf->len;
+  }
+
+  memmove(buf->data, buf->data + start, buf->len - start);
+  buf->len -= start;
+  return buf->len;
+}
+
+/* wg_connection_close closes the connection and puts the unsent part of a
+ * buffer which was only partially sent back to the front of the queue. */
+static void wg_connection_close(struct wg_callback *cb,
+                                struct wg_connection *conn) {
+  if (conn->fd >= 0)
+    close(conn->fd);
+  conn->fd = -1;
+  conn->connected = false;
+
+  if ((conn->buffer != NULL) &&
+      (wg_buffer_skip_sent(conn->buffer, conn->sent) > 0)) {
+    pthread_mutex_lock(&cb->queue_lock);
+    conn->buffer->next = cb->queue_head;
+    cb->queue_head = conn->buffer;
+    if (cb->queue_tail == NULL)
+      cb->queue_tail = conn->buffer;
+    pthread_mutex_unlock(&cb->queue_lock);
+  } else if (conn->buffer != NULL) {
+    wg_buffer_release(cb, conn->buffer);
+  }
+  conn->buffer = NULL;
+  conn->sent = 0;
+}
+
+static void wg_connection_open(struct wg_callback *cb,
+                               struct wg_connection *conn) {
+  struct addrinfo *ai_list;
+  char connerr[1024] = "";
+  int status;
+
+  conn->last_connect_time = cdtime();
+
+  struct addrinfo ai_hints = {.ai_family = AF_UNSPEC,
+                              .ai_flags = AI_ADDRCONFIG};
+
+  if (0 == strcasecmp("tcp", cb->protocol))
+    ai_hints.ai_socktype = SOCK_STREAM;
+  else
+    ai_hints.ai_socktype = SOCK_DGRAM;
+
+  status = getaddrinfo(cb->node, cb->service, &ai_hints, &ai_list);
+  if (status != 0) {
+    c_complain(LOG_ERR, &cb->init_complaint,
+               "write_graphite plugin: getaddrinfo (%s, %s, %s) failed: %s",
+               cb->node, cb->service, cb->protocol, gai_strerror(status));
+    return;
+  }
+
+  for (struct addrinfo *ai_ptr = ai_list; ai_ptr != NULL;
+       ai_ptr = ai_ptr->ai_next) {
+    conn->fd =
+        socket(ai_ptr->ai_family, ai_ptr->ai_socktype, ai_ptr->ai_protocol);
+    if (conn->fd < 0) {
+      snprintf(connerr, sizeof(connerr), "failed to open socket: %s", STRERRNO);
+      continue;
+    }
+
+    set_sock_opts(conn->fd);
+    fcntl(conn->fd, F_SETFL, fcntl(conn->fd, F_GETFL) | O_NONBLOCK);
+
+    status = connect(conn->fd, ai_ptr->ai_addr, ai_ptr->ai_addrlen);
+    if (status == 0) {
+      conn->connected = true;
+      conn->connect_time = cdtime();
+      break;
+    } else if (errno == EINPROGRESS) {
+      break;
+    }
+
+    snprintf(connerr, sizeof(connerr), "failed to connect to remote host: %s",
+             STRERRNO);
+    close(conn->fd);
+    conn->fd = -1;
+  }
+
+  freeaddrinfo(ai_list);
+
+  if (conn->fd < 0)
+    c_complain(LOG_ERR, &cb->init_complaint,
+               "write_graphite plugin: Connecting to %s:%s via %s failed. "
+               "The last error was: %s",
+               cb->node, cb->service, cb->protocol, connerr);
+}
+
+/* wg_connection_connected is called when a pending connect() completes. */
+static void wg_connection_connected(struct wg_callback *cb,
+                                    struct wg_connection *conn) {
+  int err = 0;
+
+  if ((getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &err,
+                  &(socklen_t){sizeof(err)}) != 0) ||
+      (err != 0)) {
+    c_complain(LOG_ERR, &cb->init_complaint,
+               "write_graphite plugin: Connecting to %s:%s via %s failed: %s",
+               cb->node, cb->service, cb->protocol,
+               (err != 0) ? strerror(err) : STRERRNO);
+    wg_connection_close(cb, conn);
+    return;
+  }
+
+  conn->connected = true;
+  conn->connect_time = cdtime();
+  c_release(LOG_INFO, &cb->init_complaint,
+            "write_graphite plugin: Successfully connected to %s:%s via %s.",
+            cb->node, cb->service, cb->protocol);
+}
+
+static void wg_connection_send(struct wg_callback *cb,
+                               struct wg_connection *conn) {
+  struct wg_buffer *buf = conn->buffer;
+  ssize_t status;
+
+  status = send(conn->fd, buf->data + conn->sent, buf->len - conn->sent, 0);
+  if (status < 0) {
+    if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+      return;
+
+    if (cb->log_send_errors) {
+      ERROR("write_graphite plugin: send to %s:%s (%s) failed with status %zi "
+            "(%s)",
+            cb->node, cb->service, cb->protocol, status, STRERRNO);
+    }
+    wg_connection_close(cb, conn);
+    return;
+  }
+
+  conn->sent += (size_t)status;
+  if (conn->sent < buf->len)
+    return;
+
+  wg_buffer_release(cb, buf);
+  conn->buffer = NULL;
+  conn->sent = 0;
+}
+
+static void *wg_sender_thread(void *arg) {
+  struct wg_callback *cb = arg;
+  struct pollfd *fds;
+  int *fds_index;
+  cdtime_t drain_deadline = 0;
+
+  fds = calloc((size_t)cb->connections_num + 1, sizeof(*fds));
+  fds_index = calloc((size_t)cb->connections_num, sizeof(*fds_index));
+  if ((fds == NULL) || (fds_index == NULL)) {
+    ERROR("write_graphite plugin: calloc failed.");
+    sfree(fds);
+    sfree(fds_index);
+    return NULL;
+  }
+
+  while (true) {
+    cdtime_t now = cdtime();
+    bool pending;
+    bool busy;
+    nfds_t fds_num = 1;
+    char drain[64];
+
+    pthread_mutex_lock(&cb->queue_lock);
+    pending = (cb->queue_head != NULL);
+    busy = pending;
+    if (cb->sender_shutdown && (drain_deadline == 0))
+      drain_deadline = now + WG_DRAIN_TIMEOUT;
+    pthread_mutex_unlock(&cb->queue_lock);
+
+    fds[0] = (struct pollfd){.fd = cb->wakeup_fd[0], .events = POLLIN};
+
+    for (int i = 0; i < cb->connections_num; i++) {
+      struct wg_connection *conn = cb->connections + i;
+
+      /* Force reconnect useful for load balanced environments */
+      if (conn->connected && (conn->buffer == NULL) &&
+          (cb->reconnect_interval > 0) &&
+          ((now - conn->connect_time) >= cb->reconnect_interval))
+        wg_connection_close(cb, conn);
+
+      if ((conn->fd < 0) && pending &&
+          ((now - conn->last_connect_time) >= WG_MIN_RECONNECT_INTERVAL))
+        wg_connection_open(cb, conn);
+
+      if (conn->connected && (conn->buffer == NULL)) {
+        pthread_mutex_lock(&cb->queue_lock);
+        conn->buffer = wg_queue_shift(cb);
+        pending = (cb->queue_head != NULL);
+        pthread_mutex_unlock(&cb->queue_lock);
+        conn->sent = 0;
+      }
+
+      fds_index[i] = -1;
+      if (conn->fd < 0)
+        continue;
+
+      if (conn->buffer != NULL)
+        busy = true;
+
+      fds_index[i] = (int)fds_num;
+      fds[fds_num] = (struct pollfd){
+          .fd = conn->fd,
+          .events = (!conn->connected || (conn->buffer != NULL)) ? POLLOUT : 0,
+      };
+      fds_num++;
+    }
+
+    if ((drain_deadline != 0) && (!busy || (now >= drain_deadline)))
+      break;
+
+    if (poll(fds, fds_num, /* timeout = */ 1000) < 0) {
+      if (errno != EINTR)
+        ERROR("write_graphite plugin: poll failed: %s", STRERRNO);
+      continue;
+    }
+
+    if (fds[0].revents & POLLIN)
+      while (read(cb->wakeup_fd[0], drain, sizeof(drain)) > 0)
+        /* nop */;
+
+    for (int i = 0; i < cb->connections_num; i++) {
+      struct wg_connection *conn = cb->connections + i;
+      short revents;
+
+      if (fds_index[i] < 0)
+        continue;
+      revents = fds[fds_index[i]].revents;
+
+      if (!conn->connected) {
+        if (revents != 0)
+          wg_connection_connected(cb, conn);
+      } else if (revents & (POLLERR | POLLHUP | POLLNVAL)) {
+        if (cb->log_send_errors)
+          ERROR("write_graphite plugin: Connection to %s:%s (%s) failed.",
+                cb->node, cb->service, cb->protocol);
+        wg_connection_close(cb, conn);
+      } else if ((revents & POLLOUT) && (conn->buffer != NULL)) {
+        wg_connection_send(cb, conn);
+      }
+    }
+  }
+
+  for (int i = 0; i < cb->connections_num; i++)
+    wg_connection_close(cb, cb->connections + i);
+
+  sfree(fds);
+  sfree(fds_index);
+  return NULL;
+}
+
+/* NOTE: You must hold cb->send_lock when calling this function! */
+static int wg_sender_start(struct wg_callback *cb) {
+  int status;
+
+  if (cb->sender_running)
+    return 0;
+
+  cb->buffers = calloc((size_t)cb->send_buffers_num, sizeof(*cb->buffers));
+  cb->connections =
+      calloc((size_t)cb->connections_num, sizeof(*cb->connections));
+  if ((cb->buffers == NULL) || (cb->connections == NULL)) {
+    ERROR("write_graphite plugin: calloc failed.");
+    return -1;
+  }
+
+  for (int i = 0; i < cb->send_buffers_num; i++) {
+    cb->buffers[i].next = cb->buffers_free;
+    cb->buffers_free = cb->buffers + i;
+  }
+
+  for (int i = 0; i < cb->connections_num; i++)
+    cb->connections[i].fd = -1;
+
+  if (pipe(cb->wakeup_fd) != 0) {
+    ERROR("write_graphite plugin: pipe failed: %s", STRERRNO);
+    cb->wakeup_fd[0] = cb->wakeup_fd[1] = -1;
+    return -1;
+  }
+  for (int i = 0; i < 2; i++)
+    fcntl(cb->wakeup_fd[i], F_SETFL,
+          fcntl(cb->wakeup_fd[i], F_GETFL) | O_NONBLOCK);
+
+  cb->sender_shutdown = false;
+  status = plugin_thread_create(&cb->sender_thread, wg_sender_thread, cb,
+                                "write_graphite");
+  if (status != 0) {
+    ERROR("write_graphite plugin: plugin_thread_create failed: %s",
+          STRERROR(status));
+    return -1;
+  }
+  cb->sender_running = true;
+
+  wg_reset_buffer(cb);
+  return 0;
+}
+
+/* wg_sender_stop waits for the sender thread to drain the queue, for at most
+ * WG_DRAIN_TIMEOUT, and frees the buffers. */
+static void wg_sender_stop(struct wg_callback *cb) {
+  struct wg_buffer *buf;
+
+  if (cb->sender_running) {
+    pthread_mutex_lock(&cb->queue_lock);
+    cb->sender_shutdown = true;
+    pthread_mutex_unlock(&cb->queue_lock);
+
+    wg_sender_wakeup(cb);
+    pthread_join(cb->sender_thread, NULL);
+    cb->sender_running = false;
+  }
+
+  while ((buf = wg_queue_shift(cb)) != NULL)
+    if (buf->spilled)
+      sfree(buf);
+  cb->buffers_free = NULL;
+  cb->spill_size = 0;
+
+  sfree(cb->buffers);
+  sfree(cb->connections);
+
+  for (int i = 0; i < 2; i++) {
+    if (cb->wakeup_fd[i] >= 0)
+      close(cb->wakeup_fd[i]);
+    cb->wakeup_fd[i] = -1;
+  }
+}
+
 /* NOTE: You must hold cb->send_lock when calling this function! */
 static int wg_flush_nolock(cdtime_t timeout, struct wg_callback *cb) {
   int status;
@@ -194,7 +678,10 @@ static int wg_flush_nolock(cdtime_t timeout, struct wg_callback *cb) {
     return 0;
   }
 
-  status = wg_send_buffer(cb);
+  if (cb->sender_running)
+    status = wg_queue_buffer(cb);
+  else
+    status = wg_send_buffer(cb);
   wg_reset_buffer(cb);
 
   return status;
@@ -281,6 +768,26 @@ static int wg_callback_init(struct wg_callback *cb) {
   return 0;
 }
 
+/* wg_connect_nolock makes sure data can be sent: in asynchronous mode by
+ * starting the sender thread, otherwise by connecting cb->sock_fd.
+ * NOTE: You must hold cb->send_lock when calling this function! */
+static int wg_connect_nolock(struct wg_callback *cb) {
+  if (cb->send_buffers_num > 0) {
+    if (wg_sender_start(cb) == 0)
+      return 0;
+
+    ERROR("write_graphite plugin: Starting the sender thread failed. "
+          "Falling back to synchronous sending.");
+    wg_sender_stop(cb);
+    cb->send_buffers_num = 0;
+  }
+
+  if (cb->sock_fd < 0)
+    return wg_callback_init(cb);
+
+  return 0;
+}
+
 static void wg_callback_free(void *data) {
   struct wg_callback *cb;
 
@@ -293,6 +800,8 @@ static void wg_callback_free(void *data) {
 
   wg_flush_nolock(/* timeout = */ 0, cb);
 
+  wg_sender_stop(cb);
+
   if (cb->sock_fd >= 0) {
     close(cb->sock_fd);
     cb->sock_fd = -1;
@@ -307,6 +816,7 @@ static void wg_callback_free(void *data) {
 
   pthread_mutex_unlock(&cb->send_lock);
   pthread_mutex_destroy(&cb->send_lock);
+  pthread_mutex_destroy(&cb->queue_lock);
 
   sfree(cb);
 }
@@ -324,13 +834,11 @@ static int wg_flush(cdtime_t timeout,
 
   pthread_mutex_lock(&cb->send_lock);
 
-  if (cb->sock_fd < 0) {
-    status = wg_callback_init(cb);
-    if (status != 0) {
-      /* An error message has already been printed. */
-      pthread_mutex_unlock(&cb->send_lock);
-      return -1;
-    }
+  status = wg_connect_nolock(cb);
+  if (status != 0) {
+    /* An error message has already been printed. */
+    pthread_mutex_unlock(&cb->send_lock);
+    return -1;
   }
 
   status = wg_flush_nolock(timeout, cb);
@@ -339,31 +847,15 @@ static int wg_flush(cdtime_t timeout,
   return status;
 }
 
-static int wg_send_message(char const *message, struct wg_callback *cb) {
-  int status;
-  size_t message_len;
-
-  message_len = strlen(message);
-
-  pthread_mutex_lock(&cb->send_lock);
-
-  wg_force_reconnect_check(cb);
-
-  if (cb->sock_fd < 0) {
-    status = wg_callback_init(cb);
-    if (status != 0) {
-      /* An error message has already been printed. */
-      pthread_mutex_unlock(&cb->send_lock);
-      return -1;
-    }
-  }
+/* NOTE: You must hold cb->send_lock and be connected when calling this
+ * function! */
+static int wg_send_message_nolock(char const *message, struct wg_callback *cb) {
+  size_t message_len = strlen(message);
 
   if (message_len >= cb->send_buf_free) {
-    status = wg_flush_nolock(/* timeout = */ 0, cb);
-    if (status != 0) {
-      pthread_mutex_unlock(&cb->send_lock);
+    int status = wg_flush_nolock(/* timeout = */ 0, cb);
+    if (status != 0)
       return status;
-    }
   }
 
   /* Assert that we have enough space for this message. */
@@ -382,49 +874,69 @@ static int wg_send_message(char const *message, struct wg_callback *cb) {
         100.0 * ((double)cb->send_buf_fill) / ((double)sizeof(cb->send_buf)),
         message);
 
-  pthread_mutex_unlock(&cb->send_lock);
-
   return 0;
 }
 
-static int wg_write_messages(const data_set_t *ds, const value_list_t *vl,
+static int wg_format_message(char *buffer, size_t buffer_size,
+                             const data_set_t *ds, const value_list_t *vl,
                              struct wg_callback *cb) {
-  char buffer[WG_SEND_BUF_SIZE] = {0};
-  int status;
-
   if (0 != strcmp(ds->type, vl->type)) {
     ERROR("write_graphite plugin: DS type does not match "
           "value list type");
     return -1;
   }
 
-  status = format_graphite(buffer, sizeof(buffer), ds, vl, cb->prefix,
-                           cb->postfix, cb->escape_char, cb->format_flags);
-  if (status != 0) /* error message has been printed already. */
-    return status;
-
-  /* Send the message to graphite */
-  status = wg_send_message(buffer, cb);
-  if (status != 0) /* error message has been printed already. */
-    return status;
-
-  return 0;
-} /* int wg_write_messages */
+  return format_graphite(buffer, buffer_size, ds, vl, cb->prefix, cb->postfix,
+                         cb->escape_char, cb->format_flags);
+}
 
-static int wg_write(const data_set_t *ds, const value_list_t *vl,
-                    user_data_t *user_data) {
+/* Formats and buffers a whole batch of values while holding `send_lock' and
+ * connecting only once. */
+static int wg_write_batch(const write_batch_entry_t *entries,
+                          size_t entries_num, user_data_t *user_data) {
   struct wg_callback *cb;
   int status;
+  int ret = 0;
 
   if (user_data == NULL)
     return EINVAL;
 
   cb = user_data->data;
 
-  status = wg_write_messages(ds, vl, cb);
+  pthread_mutex_lock(&cb->send_lock);
 
-  return status;
-}
+  if (!cb->sender_running)
+    wg_force_reconnect_check(cb);
+
+  status = wg_connect_nolock(cb);
+  if (status != 0) {
+    /* An error message has already been printed. */
+    pthread_mutex_unlock(&cb->send_lock);
+    return -1;
+  }
+
+  for (size_t i = 0; i < entries_num; i++) {
+    char buffer[WG_SEND_BUF_SIZE] = {0};
+
+    status = wg_format_message(buffer, sizeof(buffer), entries[i].ds,
+                               entries[i].vl, cb);
+    if (status != 0) { /* error message has been printed already. */
+      ret = status;
+      continue;
+    }
+
+    /* Send the message to graphite */
+    status = wg_send_message_nolock(buffer, cb);
+    if (status != 0) { /* error message has been printed already. */
+      ret = status;
+      break;
+    }
+  }
+
+  pthread_mutex_unlock(&cb->send_lock);
+
+  return ret;
+} /* int wg_write_batch */
 
 static int config_set_char(char *dest, oconfig_item_t *ci) {
   char buffer[4] = {0};
@@ -474,6 +986,10 @@ static int wg_config_node(oconfig_item_t *ci) {
   cb->postfix = NULL;
   cb->escape_char = WG_DEFAULT_ESCAPE;
   cb->format_flags = GRAPHITE_STORE_RATES;
+  cb->send_buffers_num = 0;
+  cb->connections_num = 1;
+  cb->spill_max = 0;
+  cb->wakeup_fd[0] = cb->wakeup_fd[1] = -1;
 
   /* FIXME: Legacy configuration syntax. */
   if (strcasecmp("Carbon", ci->key) != 0) {
@@ -485,7 +1001,9 @@ static int wg_config_node(oconfig_item_t *ci) {
   }
 
   pthread_mutex_init(&cb->send_lock, /* attr = */ NULL);
+  pthread_mutex_init(&cb->queue_lock, /* attr = */ NULL);
   C_COMPLAIN_INIT(&cb->init_complaint);
+  C_COMPLAIN_INIT(&cb->queue_complaint);
 
   for (int i = 0; i < ci->children_num; i++) {
     oconfig_item_t *child = ci->children + i;
@@ -526,6 +1044,20 @@ static int wg_config_node(oconfig_item_t *ci) {
       cf_util_get_flag(child, &cb->format_flags, GRAPHITE_REVERSE_HOST);
     else if (strcasecmp("EscapeCharacter", child->key) == 0)
       config_set_char(&cb->escape_char, child);
+    else if (strcasecmp("SendBuffers", child->key) == 0)
+      status = cf_util_get_int(child, &cb->send_buffers_num);
+    else if (strcasecmp("Connections", child->key) == 0)
+      status = cf_util_get_int(child, &cb->connections_num);
+    else if (strcasecmp("MaxSpillSize", child->key) == 0) {
+      int tmp = 0;
+      status = cf_util_get_int(child, &tmp);
+      if ((status == 0) && (tmp >= 0))
+        cb->spill_max = (size_t)tmp;
+      else if (status == 0) {
+        ERROR("write_graphite plugin: MaxSpillSize must not be negative.");
+        status = -1;
+      }
+    }
     else {
       ERROR("write_graphite plugin: Invalid configuration "
             "option: %s.",
@@ -542,6 +1074,24 @@ static int wg_config_node(oconfig_item_t *ci) {
     return status;
   }
 
+  if (cb->connections_num < 1) {
+    ERROR("write_graphite plugin: Connections must be at least 1.");
+    wg_callback_free(cb);
+    return -1;
+  }
+
+  if (cb->send_buffers_num <= 0) {
+    if ((cb->connections_num != 1) || (cb->spill_max != 0))
+      WARNING("write_graphite plugin: Connections and MaxSpillSize have no "
+              "effect unless SendBuffers is set.");
+    cb->send_buffers_num = 0;
+  } else if (cb->send_buffers_num <= cb->connections_num) {
+    WARNING("write_graphite plugin: SendBuffers must be greater than "
+            "Connections. Setting it to %d.",
+            cb->connections_num + 1);
+    cb->send_buffers_num = cb->connections_num + 1;
+  }
+
   /* FIXME: Legacy configuration syntax. */
   if (cb->name == NULL)
     snprintf(callback_name, sizeof(callback_name), "write_graphite/%s/%s/%s",
@@ -550,11 +1100,11 @@ static int wg_config_node(oconfig_item_t *ci) {
     snprintf(callback_name, sizeof(callback_name), "write_graphite/%s",
              cb->name);
 
-  plugin_register_write(callback_name, wg_write,
-                        &(user_data_t){
-                            .data = cb,
-                            .free_func = wg_callback_free,
-                        });
+  plugin_register_write_batch(callback_name, wg_write_batch,
+                              &(user_data_t){
+                                  .data = cb,
+                                  .free_func = wg_callback_free,
+                              });
 
   plugin_register_flush(callback_name, wg_flush, &(user_data_t){.data = cb});
 
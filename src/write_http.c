@@ -30,9 +30,14 @@
 #include "utils/curl_stats/curl_stats.h"
 #include "utils/format_json/format_json.h"
 #include "utils/format_kairosdb/format_kairosdb.h"
+#include "utils_complain.h"
 
 #include <curl/curl.h>
 
+#if HAVE_LIBZ
+#include <zlib.h>
+#endif
+
 #ifndef WRITE_HTTP_DEFAULT_BUFFER_SIZE
 #define WRITE_HTTP_DEFAULT_BUFFER_SIZE 4096
 #endif
@@ -48,6 +53,39 @@
 /*
  * Private variables
  */
+/* A send buffer of the pool used in asynchronous mode. */
+struct wh_buffer_s;
+typedef struct wh_buffer_s wh_buffer_t;
+struct wh_buffer_s {
+  char *data;
+  size_t len;
+  wh_buffer_t *next;
+};
+
+/* An in-flight request of the sender thread. "buffer" is NULL if the body has
+ * been compressed, in which case the buffer has already been returned to the
+ * pool. */
+struct wh_request_s;
+typedef struct wh_request_s wh_request_t;
+struct wh_request_s {
+  CURL *curl;
+  wh_buffer_t *buffer;
+  char curl_errbuf[CURL_ERROR_SIZE];
+
+  char response_buffer[WRITE_HTTP_RESPONSE_BUFFER_SIZE];
+  unsigned int response_buffer_pos;
+
+#if HAVE_LIBZ
+  z_stream zs;
+  bool zs_initialized;
+  char *gz_buffer;
+  size_t gz_buffer_size;
+  size_t gz_buffer_fill;
+#endif
+
+  wh_request_t *next;
+};
+
 struct wh_callback_s {
   char *name;
 
@@ -94,6 +132,31 @@ struct wh_callback_s {
 
   int data_ttl;
   char *metrics_prefix;
+
+  /* Asynchronous mode: full buffers are queued for the sender thread, which
+   * keeps up to "requests_num" requests in flight. */
+  int requests_num;
+  int buffers_num;
+  bool compress;
+
+  wh_buffer_t *buffers;
+  wh_buffer_t *send_buffer_current;
+  wh_buffer_t *buffers_free;
+  wh_buffer_t *buffers_queue_head;
+  wh_buffer_t *buffers_queue_tail;
+  pthread_mutex_t buffers_lock;
+  c_complain_t buffers_complaint;
+
+  wh_request_t *requests;
+  wh_request_t *requests_idle;
+  int requests_active;
+  CURLM *multi;
+  struct curl_slist *async_headers;
+
+  pthread_t sender_thread;
+  bool sender_running;
+  bool sender_shutdown;
+  int wakeup_fd[2];
 };
 typedef struct wh_callback_s wh_callback_t;
 
@@ -128,13 +191,13 @@ static size_t wh_curl_write_callback(char *ptr, size_t size, size_t nmemb,
 
 } /* }}} wh_curl_write_callback */
 
-static void wh_log_http_error(wh_callback_t *cb) {
+static void wh_log_http_error(wh_callback_t *cb, CURL *curl) {
   if (!cb->log_http_error)
     return;
 
   long http_code = 0;
 
-  curl_easy_getinfo(cb->curl, CURLINFO_RESPONSE_CODE, &http_code);
+  curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
 
   if (http_code != 200)
     INFO("write_http plugin: HTTP Error code: %lu", http_code);
@@ -171,7 +234,7 @@ static int wh_post_nolock(wh_callback_t *cb, char const *data) /* {{{ */
   curl_easy_setopt(cb->curl, CURLOPT_WRITEDATA, (void *)cb);
   status = curl_easy_perform(cb->curl);
 
-  wh_log_http_error(cb);
+  wh_log_http_error(cb, cb->curl);
 
   if (cb->curl_stats != NULL) {
     int rc = curl_stats_dispatch(cb->curl_stats, cb->curl, NULL, "write_http",
@@ -196,91 +259,516 @@ static int wh_post_nolock(wh_callback_t *cb, char const *data) /* {{{ */
   return status;
 } /* }}} wh_post_nolock */
 
-static int wh_callback_init(wh_callback_t *cb) /* {{{ */
-{
-  if (cb->curl != NULL)
-    return 0;
-
-  cb->curl = curl_easy_init();
-  if (cb->curl == NULL) {
-    ERROR("curl plugin: curl_easy_init failed.");
-    return -1;
-  }
-
+static int wh_curl_setup(wh_callback_t *cb, CURL *curl, /* {{{ */
+                         struct curl_slist *headers, char *errbuf) {
   if (cb->low_speed_limit > 0 && cb->low_speed_time > 0) {
-    curl_easy_setopt(cb->curl, CURLOPT_LOW_SPEED_LIMIT,
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT,
                      (long)(cb->low_speed_limit * cb->low_speed_time));
-    curl_easy_setopt(cb->curl, CURLOPT_LOW_SPEED_TIME,
-                     (long)cb->low_speed_time);
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, (long)cb->low_speed_time);
   }
 
 #ifdef HAVE_CURLOPT_TIMEOUT_MS
   if (cb->timeout > 0)
-    curl_easy_setopt(cb->curl, CURLOPT_TIMEOUT_MS, (long)cb->timeout);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, (long)cb->timeout);
 #endif
 
-  curl_easy_setopt(cb->curl, CURLOPT_NOSIGNAL, 1L);
-  curl_easy_setopt(cb->curl, CURLOPT_USERAGENT, COLLECTD_USERAGENT);
+  curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(curl, CURLOPT_USERAGENT, COLLECTD_USERAGENT);
 
-  cb->headers = curl_slist_append(cb->headers, "Accept:  */*");
-  if (cb->format == WH_FORMAT_JSON || cb->format == WH_FORMAT_KAIROSDB)
-    cb->headers =
-        curl_slist_append(cb->headers, "Content-Type: application/json");
-  else
-    cb->headers = curl_slist_append(cb->headers, "Content-Type: text/plain");
-  cb->headers = curl_slist_append(cb->headers, "Expect:");
-  curl_easy_setopt(cb->curl, CURLOPT_HTTPHEADER, cb->headers);
+  curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
 
-  curl_easy_setopt(cb->curl, CURLOPT_ERRORBUFFER, cb->curl_errbuf);
-  curl_easy_setopt(cb->curl, CURLOPT_FOLLOWLOCATION, 1L);
-  curl_easy_setopt(cb->curl, CURLOPT_MAXREDIRS, 50L);
+  curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, errbuf);
+  curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+  curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 50L);
 
   if (cb->user != NULL) {
 #ifdef HAVE_CURLOPT_USERNAME
-    curl_easy_setopt(cb->curl, CURLOPT_USERNAME, cb->user);
-    curl_easy_setopt(cb->curl, CURLOPT_PASSWORD,
+    curl_easy_setopt(curl, CURLOPT_USERNAME, cb->user);
+    curl_easy_setopt(curl, CURLOPT_PASSWORD,
                      (cb->pass == NULL) ? "" : cb->pass);
 #else
-    size_t credentials_size;
+    if (cb->credentials == NULL) {
+      size_t credentials_size;
 
-    credentials_size = strlen(cb->user) + 2;
-    if (cb->pass != NULL)
-      credentials_size += strlen(cb->pass);
+      credentials_size = strlen(cb->user) + 2;
+      if (cb->pass != NULL)
+        credentials_size += strlen(cb->pass);
 
-    cb->credentials = malloc(credentials_size);
-    if (cb->credentials == NULL) {
-      ERROR("curl plugin: malloc failed.");
-      return -1;
-    }
+      cb->credentials = malloc(credentials_size);
+      if (cb->credentials == NULL) {
+        ERROR("curl plugin: malloc failed.");
+        return -1;
+      }
 
-    snprintf(cb->credentials, credentials_size, "%s:%s", cb->user,
-             (cb->pass == NULL) ? "" : cb->pass);
-    curl_easy_setopt(cb->curl, CURLOPT_USERPWD, cb->credentials);
+      snprintf(cb->credentials, credentials_size, "%s:%s", cb->user,
+               (cb->pass == NULL) ? "" : cb->pass);
+    }
+    curl_easy_setopt(curl, CURLOPT_USERPWD, cb->credentials);
 #endif
-    curl_easy_setopt(cb->curl, CURLOPT_HTTPAUTH, CURLAUTH_ANY);
+    curl_easy_setopt(curl, CURLOPT_HTTPAUTH, CURLAUTH_ANY);
   }
 
-  curl_easy_setopt(cb->curl, CURLOPT_SSL_VERIFYPEER, (long)cb->verify_peer);
-  curl_easy_setopt(cb->curl, CURLOPT_SSL_VERIFYHOST, cb->verify_host ? 2L : 0L);
-  curl_easy_setopt(cb->curl, CURLOPT_SSLVERSION, cb->sslversion);
+  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, (long)cb->verify_peer);
+  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, cb->verify_host ? 2L : 0L);
+  curl_easy_setopt(curl, CURLOPT_SSLVERSION, cb->sslversion);
   if (cb->cacert != NULL)
-    curl_easy_setopt(cb->curl, CURLOPT_CAINFO, cb->cacert);
+    curl_easy_setopt(curl, CURLOPT_CAINFO, cb->cacert);
   if (cb->capath != NULL)
-    curl_easy_setopt(cb->curl, CURLOPT_CAPATH, cb->capath);
+    curl_easy_setopt(curl, CURLOPT_CAPATH, cb->capath);
 
   if (cb->clientkey != NULL && cb->clientcert != NULL) {
-    curl_easy_setopt(cb->curl, CURLOPT_SSLKEY, cb->clientkey);
-    curl_easy_setopt(cb->curl, CURLOPT_SSLCERT, cb->clientcert);
+    curl_easy_setopt(curl, CURLOPT_SSLKEY, cb->clientkey);
+    curl_easy_setopt(curl, CURLOPT_SSLCERT, cb->clientcert);
 
     if (cb->clientkeypass != NULL)
-      curl_easy_setopt(cb->curl, CURLOPT_SSLKEYPASSWD, cb->clientkeypass);
+      curl_easy_setopt(curl, CURLOPT_SSLKEYPASSWD, cb->clientkeypass);
+  }
+
+  return 0;
+} /* }}} int wh_curl_setup */
+
+/*
+ * Asynchronous mode
+ * {{{ */
+static size_t wh_request_write_callback(char *ptr, size_t size, size_t nmemb,
+                                        void *userdata) {
+  wh_request_t *req = userdata;
+  size_t len = nmemb;
+
+  if ((req->response_buffer_pos + len) > sizeof(req->response_buffer))
+    len = sizeof(req->response_buffer) - req->response_buffer_pos;
+
+  memcpy(req->response_buffer + req->response_buffer_pos, ptr, len);
+  req->response_buffer_pos += len;
+  req->response_buffer[sizeof(req->response_buffer) - 1] = '\0';
+
+  return nmemb;
+} /* size_t wh_request_write_callback */
+
+static void wh_sender_wakeup(wh_callback_t *cb) {
+  /* If the pipe is full, the sender thread is about to wake up anyway. */
+  if (write(cb->wakeup_fd[1], "", 1) < 0)
+    return;
+} /* void wh_sender_wakeup */
+
+static void wh_buffer_release(wh_callback_t *cb, wh_buffer_t *buf) {
+  pthread_mutex_lock(&cb->buffers_lock);
+  buf->next = cb->buffers_free;
+  cb->buffers_free = buf;
+  pthread_mutex_unlock(&cb->buffers_lock);
+} /* void wh_buffer_release */
+
+/* Queues the current send buffer for the sender thread and replaces it with a
+ * free buffer from the pool. When the pool is exhausted, the oldest queued
+ * buffer is dropped instead of blocking the caller.
+ * must hold cb->send_lock when calling */
+static int wh_submit_nolock(wh_callback_t *cb) /* {{{ */
+{
+  wh_buffer_t *buf = cb->send_buffer_current;
+  wh_buffer_t *next;
+  bool dropped = false;
+
+  buf->len = cb->send_buffer_fill;
+  buf->next = NULL;
+
+  pthread_mutex_lock(&cb->buffers_lock);
+  if (cb->buffers_queue_tail == NULL)
+    cb->buffers_queue_head = buf;
+  else
+    cb->buffers_queue_tail->next = buf;
+  cb->buffers_queue_tail = buf;
+
+  next = cb->buffers_free;
+  if (next != NULL) {
+    cb->buffers_free = next->next;
+  } else {
+    next = cb->buffers_queue_head;
+    cb->buffers_queue_head = next->next;
+    if (cb->buffers_queue_head == NULL)
+      cb->buffers_queue_tail = NULL;
+    dropped = true;
+  }
+  pthread_mutex_unlock(&cb->buffers_lock);
+
+  next->next = NULL;
+  cb->send_buffer_current = next;
+  cb->send_buffer = next->data;
+
+  wh_sender_wakeup(cb);
+
+  if (dropped) {
+    c_complain(LOG_WARNING, &cb->buffers_complaint,
+               "write_http plugin: <%s> All %d send buffers are in use; "
+               "dropping %" PRIsz " bytes of queued data.",
+               cb->location, cb->buffers_num, next->len);
+  } else {
+    c_release(LOG_INFO, &cb->buffers_complaint,
+              "write_http plugin: <%s> Send buffers are available again.",
+              cb->location);
+  }
+
+  return 0;
+} /* }}} int wh_submit_nolock */
+
+#if HAVE_LIBZ
+static int wh_request_compress(wh_request_t *req, /* {{{ */
+                               char const *data, size_t len) {
+  int status;
+
+  status = deflateReset(&req->zs);
+  if (status != Z_OK)
+    return status;
+
+  req->zs.next_in = (Bytef *)data;
+  req->zs.avail_in = (uInt)len;
+  req->zs.next_out = (Bytef *)req->gz_buffer;
+  req->zs.avail_out = (uInt)req->gz_buffer_size;
+
+  status = deflate(&req->zs, Z_FINISH);
+  if (status != Z_STREAM_END)
+    return (status == Z_OK) ? Z_BUF_ERROR : status;
+
+  req->gz_buffer_fill = req->gz_buffer_size - req->zs.avail_out;
+  return 0;
+} /* }}} int wh_request_compress */
+#endif
+
+static void wh_request_start(wh_callback_t *cb, /* {{{ */
+                             wh_request_t *req, wh_buffer_t *buf) {
+  char const *body = buf->data;
+  size_t body_len = buf->len;
+  CURLMcode status;
+
+  req->buffer = buf;
+  req->curl_errbuf[0] = '\0';
+  memset(req->response_buffer, 0, sizeof(req->response_buffer));
+  req->response_buffer_pos = 0;
+
+#if HAVE_LIBZ
+  if (cb->compress) {
+    int zstatus = wh_request_compress(req, buf->data, buf->len);
+    wh_buffer_release(cb, buf);
+    req->buffer = NULL;
+
+    if (zstatus != 0) {
+      ERROR("write_http plugin: <%s> Compressing %" PRIsz " bytes failed "
+            "with status %d.",
+            cb->location, body_len, zstatus);
+      req->next = cb->requests_idle;
+      cb->requests_idle = req;
+      return;
+    }
+
+    body = req->gz_buffer;
+    body_len = req->gz_buffer_fill;
+  }
+#endif
+
+  curl_easy_setopt(req->curl, CURLOPT_POSTFIELDSIZE, (long)body_len);
+  curl_easy_setopt(req->curl, CURLOPT_POSTFIELDS, body);
+
+  status = curl_multi_add_handle(cb->multi, req->curl);
+  if (status != CURLM_OK) {
+    ERROR("write_http plugin: curl_multi_add_handle failed with status %i: "
+          "%s",
+          (int)status, curl_multi_strerror(status));
+    if (req->buffer != NULL)
+      wh_buffer_release(cb, req->buffer);
+    req->buffer = NULL;
+    req->next = cb->requests_idle;
+    cb->requests_idle = req;
+    return;
+  }
+
+  cb->requests_active++;
+} /* }}} void wh_request_start */
+
+/* Returns the number of requests which have completed. */
+static int wh_requests_complete(wh_callback_t *cb) /* {{{ */
+{
+  CURLMsg *msg;
+  int msgs_left;
+  int num = 0;
+
+  while ((msg = curl_multi_info_read(cb->multi, &msgs_left)) != NULL) {
+    wh_request_t *req = NULL;
+    CURLcode status;
+
+    if (msg->msg != CURLMSG_DONE)
+      continue;
+
+    status = msg->data.result;
+    curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&req);
+    curl_multi_remove_handle(cb->multi, msg->easy_handle);
+
+    wh_log_http_error(cb, req->curl);
+
+    if (cb->curl_stats != NULL) {
+      int rc = curl_stats_dispatch(cb->curl_stats, req->curl, NULL,
+                                   "write_http", cb->name);
+      if (rc != 0) {
+        ERROR("write_http plugin: curl_stats_dispatch failed with "
+              "status %i",
+              rc);
+      }
+    }
+
+    if (status != CURLE_OK) {
+      ERROR("write_http plugin: <%s> request failed with "
+            "status %i: %s",
+            cb->location, (int)status, req->curl_errbuf);
+      if (strlen(req->response_buffer) > 0) {
+        ERROR("write_http plugin: curl_response=%s", req->response_buffer);
+      }
+    } else {
+      DEBUG("write_http plugin: curl_response=%s", req->response_buffer);
+    }
+
+    if (req->buffer != NULL)
+      wh_buffer_release(cb, req->buffer);
+    req->buffer = NULL;
+
+    req->next = cb->requests_idle;
+    cb->requests_idle = req;
+    cb->requests_active--;
+    num++;
+  }
+
+  return num;
+} /* }}} int wh_requests_complete */
+
+static void *wh_sender_thread(void *arg) /* {{{ */
+{
+  wh_callback_t *cb = arg;
+
+  while (true) {
+    struct curl_waitfd wakeup = {
+        .fd = cb->wakeup_fd[0],
+        .events = CURL_WAIT_POLLIN,
+    };
+    bool shutdown;
+    int running = 0;
+    char drain[64];
+
+    pthread_mutex_lock(&cb->buffers_lock);
+    while ((cb->requests_idle != NULL) && (cb->buffers_queue_head != NULL)) {
+      wh_request_t *req = cb->requests_idle;
+      wh_buffer_t *buf = cb->buffers_queue_head;
+
+      cb->requests_idle = req->next;
+      cb->buffers_queue_head = buf->next;
+      if (cb->buffers_queue_head == NULL)
+        cb->buffers_queue_tail = NULL;
+
+      pthread_mutex_unlock(&cb->buffers_lock);
+      wh_request_start(cb, req, buf);
+      pthread_mutex_lock(&cb->buffers_lock);
+    }
+    shutdown = cb->sender_shutdown && (cb->buffers_queue_head == NULL) &&
+               (cb->requests_active == 0);
+    pthread_mutex_unlock(&cb->buffers_lock);
+
+    if (shutdown)
+      break;
+
+    curl_multi_perform(cb->multi, &running);
+    if (wh_requests_complete(cb) > 0)
+      continue;
+
+    curl_multi_wait(cb->multi, &wakeup, 1, /* timeout_ms = */ 1000, NULL);
+    while (read(cb->wakeup_fd[0], drain, sizeof(drain)) > 0)
+      /* nop */;
+  }
+
+  return NULL;
+} /* }}} void *wh_sender_thread */
+
+static void wh_sender_stop(wh_callback_t *cb) /* {{{ */
+{
+  if (cb->sender_running) {
+    pthread_mutex_lock(&cb->buffers_lock);
+    cb->sender_shutdown = true;
+    pthread_mutex_unlock(&cb->buffers_lock);
+
+    wh_sender_wakeup(cb);
+    pthread_join(cb->sender_thread, NULL);
+    cb->sender_running = false;
   }
 
+  for (int i = 0; (cb->requests != NULL) && (i < cb->requests_num); i++) {
+    wh_request_t *req = cb->requests + i;
+
+    if (req->curl != NULL)
+      curl_easy_cleanup(req->curl);
+#if HAVE_LIBZ
+    if (req->zs_initialized)
+      deflateEnd(&req->zs);
+    sfree(req->gz_buffer);
+#endif
+  }
+  sfree(cb->requests);
+  cb->requests_idle = NULL;
+
+  if (cb->multi != NULL) {
+    curl_multi_cleanup(cb->multi);
+    cb->multi = NULL;
+  }
+
+  if (cb->async_headers != NULL) {
+    curl_slist_free_all(cb->async_headers);
+    cb->async_headers = NULL;
+  }
+
+  for (int i = 0; i < 2; i++) {
+    if (cb->wakeup_fd[i] >= 0)
+      close(cb->wakeup_fd[i]);
+    cb->wakeup_fd[i] = -1;
+  }
+} /* }}} void wh_sender_stop */
+
+static int wh_request_init(wh_callback_t *cb, wh_request_t *req) /* {{{ */
+{
+  req->curl = curl_easy_init();
+  if (req->curl == NULL) {
+    ERROR("write_http plugin: curl_easy_init failed.");
+    return -1;
+  }
+
+  if (wh_curl_setup(cb, req->curl, cb->async_headers, req->curl_errbuf) != 0)
+    return -1;
+
+  curl_easy_setopt(req->curl, CURLOPT_URL, cb->location);
+  curl_easy_setopt(req->curl, CURLOPT_WRITEFUNCTION,
+                   &wh_request_write_callback);
+  curl_easy_setopt(req->curl, CURLOPT_WRITEDATA, (void *)req);
+  curl_easy_setopt(req->curl, CURLOPT_PRIVATE, (void *)req);
+
+#if HAVE_LIBZ
+  if (cb->compress) {
+    /* 15 window bits plus 16 selects the gzip format. */
+    int status = deflateInit2(&req->zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                              15 + 16, /* memLevel = */ 8, Z_DEFAULT_STRATEGY);
+    if (status != Z_OK) {
+      ERROR("write_http plugin: deflateInit2 failed with status %d", status);
+      return -1;
+    }
+    req->zs_initialized = true;
+
+    req->gz_buffer_size = (size_t)deflateBound(&req->zs, cb->send_buffer_size);
+    req->gz_buffer = malloc(req->gz_buffer_size);
+    if (req->gz_buffer == NULL) {
+      ERROR("write_http plugin: malloc(%" PRIsz ") failed.",
+            req->gz_buffer_size);
+      return -1;
+    }
+  }
+#endif
+
+  return 0;
+} /* }}} int wh_request_init */
+
+/* must hold cb->send_lock when calling */
+static int wh_sender_start(wh_callback_t *cb) /* {{{ */
+{
+  int status;
+
+  if (pipe(cb->wakeup_fd) != 0) {
+    ERROR("write_http plugin: pipe failed: %s", STRERRNO);
+    cb->wakeup_fd[0] = cb->wakeup_fd[1] = -1;
+    return -1;
+  }
+  for (int i = 0; i < 2; i++)
+    fcntl(cb->wakeup_fd[i], F_SETFL,
+          fcntl(cb->wakeup_fd[i], F_GETFL) | O_NONBLOCK);
+
+  for (struct curl_slist *h = cb->headers; h != NULL; h = h->next)
+    cb->async_headers = curl_slist_append(cb->async_headers, h->data);
+  if (cb->compress)
+    cb->async_headers =
+        curl_slist_append(cb->async_headers, "Content-Encoding: gzip");
+
+  cb->multi = curl_multi_init();
+  if (cb->multi == NULL) {
+    ERROR("write_http plugin: curl_multi_init failed.");
+    wh_sender_stop(cb);
+    return -1;
+  }
+
+  cb->requests = calloc((size_t)cb->requests_num, sizeof(*cb->requests));
+  if (cb->requests == NULL) {
+    ERROR("write_http plugin: calloc failed.");
+    wh_sender_stop(cb);
+    return -1;
+  }
+
+  for (int i = 0; i < cb->requests_num; i++) {
+    wh_request_t *req = cb->requests + i;
+
+    if (wh_request_init(cb, req) != 0) {
+      wh_sender_stop(cb);
+      return -1;
+    }
+
+    req->next = cb->requests_idle;
+    cb->requests_idle = req;
+  }
+
+  cb->sender_shutdown = false;
+  status = plugin_thread_create(&cb->sender_thread, wh_sender_thread, cb,
+                                "write_http send");
+  if (status != 0) {
+    ERROR("write_http plugin: plugin_thread_create failed: %s",
+          STRERROR(status));
+    wh_sender_stop(cb);
+    return -1;
+  }
+  cb->sender_running = true;
+
+  return 0;
+} /* }}} int wh_sender_start */
+/* }}} */
+
+static int wh_callback_init(wh_callback_t *cb) /* {{{ */
+{
+  if (cb->curl != NULL)
+    return 0;
+
+  cb->curl = curl_easy_init();
+  if (cb->curl == NULL) {
+    ERROR("curl plugin: curl_easy_init failed.");
+    return -1;
+  }
+
+  cb->headers = curl_slist_append(cb->headers, "Accept:  */*");
+  if (cb->format == WH_FORMAT_JSON || cb->format == WH_FORMAT_KAIROSDB)
+    cb->headers =
+        curl_slist_append(cb->headers, "Content-Type: application/json");
+  else
+    cb->headers = curl_slist_append(cb->headers, "Content-Type: text/plain");
+  cb->headers = curl_slist_append(cb->headers, "Expect:");
+
+  if (wh_curl_setup(cb, cb->curl, cb->headers, cb->curl_errbuf) != 0)
+    return -1;
+
   wh_reset_buffer(cb);
 
+  if ((cb->requests_num > 0) && (wh_sender_start(cb) != 0))
+    ERROR("write_http plugin: Starting the sender thread failed. "
+          "Falling back to synchronous requests.");
+
   return 0;
 } /* }}} int wh_callback_init */
 
+/* Posts the send buffer, or hands it to the sender thread if it is running.
+ * must hold cb->send_lock when calling */
+static int wh_send_nolock(wh_callback_t *cb) /* {{{ */
+{
+  if (cb->sender_running)
+    return wh_submit_nolock(cb);
+
+  return wh_post_nolock(cb, cb->send_buffer);
+} /* }}} int wh_send_nolock */
+
 static int wh_flush_nolock(cdtime_t timeout, wh_callback_t *cb) /* {{{ */
 {
   int status;
@@ -304,7 +792,7 @@ static int wh_flush_nolock(cdtime_t timeout, wh_callback_t *cb) /* {{{ */
       return 0;
     }
 
-    status = wh_post_nolock(cb, cb->send_buffer);
+    status = wh_send_nolock(cb);
     wh_reset_buffer(cb);
   } else if (cb->format == WH_FORMAT_JSON || cb->format == WH_FORMAT_KAIROSDB) {
     if (cb->send_buffer_fill <= 2) {
@@ -321,7 +809,7 @@ static int wh_flush_nolock(cdtime_t timeout, wh_callback_t *cb) /* {{{ */
       return status;
     }
 
-    status = wh_post_nolock(cb, cb->send_buffer);
+    status = wh_send_nolock(cb);
     wh_reset_buffer(cb);
   } else {
     ERROR("write_http: wh_flush_nolock: "
@@ -370,6 +858,16 @@ static void wh_callback_free(void *data) /* {{{ */
   if (cb->send_buffer != NULL)
     wh_flush_nolock(/* timeout = */ 0, cb);
 
+  wh_sender_stop(cb);
+
+  if (cb->buffers != NULL) {
+    for (int i = 0; i < cb->buffers_num; i++)
+      sfree(cb->buffers[i].data);
+    sfree(cb->buffers);
+    /* send_buffer points into the pool. */
+    cb->send_buffer = NULL;
+  }
+
   if (cb->curl != NULL) {
     curl_easy_cleanup(cb->curl);
     cb->curl = NULL;
@@ -698,6 +1196,11 @@ static int wh_config_node(oconfig_item_t *ci) /* {{{ */
   cb->data_ttl = 0;
   cb->metrics_prefix = strdup(WRITE_HTTP_DEFAULT_PREFIX);
   cb->curl_stats = NULL;
+  cb->requests_num = 0;
+  cb->buffers_num = 0;
+  cb->compress = false;
+  cb->wakeup_fd[0] = cb->wakeup_fd[1] = -1;
+  C_COMPLAIN_INIT(&cb->buffers_complaint);
 
   if (cb->metrics_prefix == NULL) {
     ERROR("write_http plugin: strdup failed.");
@@ -706,6 +1209,7 @@ static int wh_config_node(oconfig_item_t *ci) /* {{{ */
   }
 
   pthread_mutex_init(&cb->send_lock, /* attr = */ NULL);
+  pthread_mutex_init(&cb->buffers_lock, /* attr = */ NULL);
 
   cf_util_get_string(ci, &cb->name);
 
@@ -788,6 +1292,12 @@ static int wh_config_node(oconfig_item_t *ci) /* {{{ */
       status = cf_util_get_int(child, &cb->timeout);
     else if (strcasecmp("LogHttpError", child->key) == 0)
       status = cf_util_get_boolean(child, &cb->log_http_error);
+    else if (strcasecmp("ConcurrentRequests", child->key) == 0)
+      status = cf_util_get_int(child, &cb->requests_num);
+    else if (strcasecmp("BufferPoolSize", child->key) == 0)
+      status = cf_util_get_int(child, &cb->buffers_num);
+    else if (strcasecmp("Compress", child->key) == 0)
+      status = cf_util_get_boolean(child, &cb->compress);
     else if (strcasecmp("Header", child->key) == 0)
       status = wh_config_append_string("Header", &cb->headers, child);
     else if (strcasecmp("Attribute", child->key) == 0) {
@@ -854,6 +1364,43 @@ static int wh_config_node(oconfig_item_t *ci) /* {{{ */
   if (strlen(cb->metrics_prefix) == 0)
     sfree(cb->metrics_prefix);
 
+  if (cb->requests_num < 0) {
+    ERROR("write_http plugin: Ignoring invalid ConcurrentRequests setting "
+          "(%d).",
+          cb->requests_num);
+    cb->requests_num = 0;
+  }
+
+  if (cb->requests_num == 0) {
+    if (cb->buffers_num != 0)
+      WARNING("write_http plugin: BufferPoolSize has no effect unless "
+              "ConcurrentRequests is set.");
+    cb->buffers_num = 0;
+  } else if (cb->buffers_num == 0) {
+    cb->buffers_num = 2 * cb->requests_num + 1;
+  } else if (cb->buffers_num <= cb->requests_num) {
+    WARNING("write_http plugin: BufferPoolSize must be greater than "
+            "ConcurrentRequests. Setting it to %d.",
+            cb->requests_num + 1);
+    cb->buffers_num = cb->requests_num + 1;
+  }
+
+  if (cb->compress && (cb->requests_num == 0)) {
+    ERROR("write_http plugin: Compress requires ConcurrentRequests to be set "
+          "for instance '%s'.",
+          cb->name);
+    wh_callback_free(cb);
+    return -1;
+  }
+#if !HAVE_LIBZ
+  if (cb->compress) {
+    ERROR("write_http plugin: Compress is not supported because collectd was "
+          "built without zlib.");
+    wh_callback_free(cb);
+    return -1;
+  }
+#endif
+
   if (cb->low_speed_limit > 0)
     cb->low_speed_time = CDTIME_T_TO_TIME_T(plugin_get_interval());
 
@@ -865,13 +1412,40 @@ static int wh_config_node(oconfig_item_t *ci) /* {{{ */
     ERROR("write_http plugin: Ignoring invalid BufferSize setting (%d).",
           buffer_size);
 
-  /* Allocate the buffer. */
-  cb->send_buffer = malloc(cb->send_buffer_size);
-  if (cb->send_buffer == NULL) {
-    ERROR("write_http plugin: malloc(%" PRIsz ") failed.",
-          cb->send_buffer_size);
-    wh_callback_free(cb);
-    return -1;
+  /* Allocate the buffer, or the buffer pool in asynchronous mode. */
+  if (cb->buffers_num > 0) {
+    cb->buffers = calloc((size_t)cb->buffers_num, sizeof(*cb->buffers));
+    if (cb->buffers == NULL) {
+      ERROR("write_http plugin: calloc failed.");
+      wh_callback_free(cb);
+      return -1;
+    }
+
+    for (int i = 0; i < cb->buffers_num; i++) {
+      cb->buffers[i].data = malloc(cb->send_buffer_size);
+      if (cb->buffers[i].data == NULL) {
+        ERROR("write_http plugin: malloc(%" PRIsz ") failed.",
+              cb->send_buffer_size);
+        wh_callback_free(cb);
+        return -1;
+      }
+
+      if (i > 0) {
+        cb->buffers[i].next = cb->buffers_free;
+        cb->buffers_free = cb->buffers + i;
+      }
+    }
+
+    cb->send_buffer_current = cb->buffers;
+    cb->send_buffer = cb->buffers[0].data;
+  } else {
+    cb->send_buffer = malloc(cb->send_buffer_size);
+    if (cb->send_buffer == NULL) {
+      ERROR("write_http plugin: malloc(%" PRIsz ") failed.",
+            cb->send_buffer_size);
+      wh_callback_free(cb);
+      return -1;
+    }
   }
 
   /* Nulls the buffer and sets ..._free and ..._fill. */
@@ -28,15 +28,31 @@
 
 #include "plugin.h"
 #include "utils/cmds/putval.h"
+#include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
 #include "utils/format_graphite/format_graphite.h"
 #include "utils/format_json/format_json.h"
+#include "utils_complain.h"
 #include "utils_random.h"
 
 #include <errno.h>
 #include <librdkafka/rdkafka.h>
 #include <stdint.h>
 
+/* 31 bit -> 4 byte -> 8 byte hex string + null byte */
+#define KAFKA_RANDOM_KEY_SIZE 9
+
+/* A message being filled with value lists that share the same partitioning
+ * key. Batches are kept in the topic context's "batches" tree, keyed by host
+ * name if "Key Host" is configured and by the empty string otherwise. */
+struct kafka_batch {
+  char *key;
+  char random_key[KAFKA_RANDOM_KEY_SIZE];
+  char *buffer;
+  size_t fill;
+  cdtime_t first_time;
+};
+
 struct kafka_topic_context {
 #define KAFKA_FORMAT_JSON 0
 #define KAFKA_FORMAT_COMMAND 1
@@ -53,7 +69,19 @@ struct kafka_topic_context {
   char *postfix;
   char escape_char;
   char *topic_name;
+  bool key_by_host;
   pthread_mutex_t lock;
+
+  /* Batching; "batch_size" == 0 disables it. All members are protected by
+   * "lock". */
+  size_t batch_size;
+  cdtime_t batch_timeout;
+  cdtime_t batch_oldest;
+  c_avl_tree_t *batches;
+  rd_kafka_message_t *ready;
+  size_t ready_num;
+  size_t ready_size;
+  c_complain_t produce_complaint;
 };
 
 static int kafka_handle(struct kafka_topic_context *);
@@ -92,8 +120,6 @@ static uint32_t kafka_hash(const char *keydata, size_t keylen) {
   return hash;
 }
 
-/* 31 bit -> 4 byte -> 8 byte hex string + null byte */
-#define KAFKA_RANDOM_KEY_SIZE 9
 #define KAFKA_RANDOM_KEY_BUFFER                                                \
   (char[KAFKA_RANDOM_KEY_SIZE]) { "" }
 static char *kafka_random_key(char buffer[static KAFKA_RANDOM_KEY_SIZE]) {
@@ -170,62 +196,268 @@ static int kafka_handle(struct kafka_topic_context *ctx) /* {{{ */
 
 } /* }}} int kafka_handle */
 
-static int kafka_write(const data_set_t *ds, /* {{{ */
-                       const value_list_t *vl, user_data_t *ud) {
-  int status = 0;
-  void *key;
-  size_t keylen = 0;
-  char buffer[8192];
-  size_t bfree = sizeof(buffer);
+static int kafka_format(struct kafka_topic_context *ctx, /* {{{ */
+                        const data_set_t *ds, const value_list_t *vl,
+                        char *buffer, size_t buffer_size) {
+  size_t bfree = buffer_size;
   size_t bfill = 0;
-  size_t blen = 0;
-  struct kafka_topic_context *ctx = ud->data;
-
-  if ((ds == NULL) || (vl == NULL) || (ctx == NULL))
-    return EINVAL;
-
-  pthread_mutex_lock(&ctx->lock);
-  status = kafka_handle(ctx);
-  pthread_mutex_unlock(&ctx->lock);
-  if (status != 0)
-    return status;
+  int status;
 
-  bzero(buffer, sizeof(buffer));
+  memset(buffer, 0, buffer_size);
 
   switch (ctx->format) {
   case KAFKA_FORMAT_COMMAND:
-    status = cmd_create_putval(buffer, sizeof(buffer), ds, vl);
+    status = cmd_create_putval(buffer, buffer_size, ds, vl);
     if (status != 0) {
       ERROR("write_kafka plugin: cmd_create_putval failed with status %i.",
             status);
       return status;
     }
-    blen = strlen(buffer);
     break;
   case KAFKA_FORMAT_JSON:
     format_json_initialize(buffer, &bfill, &bfree);
     format_json_value_list(buffer, &bfill, &bfree, ds, vl, ctx->store_rates);
     format_json_finalize(buffer, &bfill, &bfree);
-    blen = strlen(buffer);
     break;
   case KAFKA_FORMAT_GRAPHITE:
     status =
-        format_graphite(buffer, sizeof(buffer), ds, vl, ctx->prefix,
-                        ctx->postfix, ctx->escape_char, ctx->graphite_flags);
+        format_graphite(buffer, buffer_size, ds, vl, ctx->prefix, ctx->postfix,
+                        ctx->escape_char, ctx->graphite_flags);
     if (status != 0) {
       ERROR("write_kafka plugin: format_graphite failed with status %i.",
             status);
       return status;
     }
-    blen = strlen(buffer);
     break;
   default:
     ERROR("write_kafka plugin: invalid format %i.", ctx->format);
     return -1;
   }
 
-  key =
-      (ctx->key != NULL) ? ctx->key : kafka_random_key(KAFKA_RANDOM_KEY_BUFFER);
+  return 0;
+} /* }}} int kafka_format */
+
+/* Moves the batch's buffer to the "ready" queue. The queued message points to
+ * the batch's key, so every batch may be closed at most once before the queue
+ * is handed to kafka_produce_ready(). */
+static int kafka_batch_close(struct kafka_topic_context *ctx, /* {{{ */
+                             struct kafka_batch *batch) {
+  rd_kafka_message_t *msg;
+  const char *key;
+
+  if (batch->fill == 0)
+    return 0;
+
+  if (ctx->ready_num >= ctx->ready_size) {
+    size_t new_size = (ctx->ready_size == 0) ? 8 : 2 * ctx->ready_size;
+    rd_kafka_message_t *tmp =
+        realloc(ctx->ready, new_size * sizeof(*ctx->ready));
+    if (tmp == NULL) {
+      ERROR("write_kafka plugin: realloc failed.");
+      return ENOMEM;
+    }
+    ctx->ready = tmp;
+    ctx->ready_size = new_size;
+  }
+
+  if (ctx->key_by_host)
+    key = batch->key;
+  else if (ctx->key != NULL)
+    key = ctx->key;
+  else
+    key = kafka_random_key(batch->random_key);
+
+  msg = ctx->ready + ctx->ready_num;
+  memset(msg, 0, sizeof(*msg));
+  msg->payload = batch->buffer;
+  msg->len = batch->fill;
+  msg->key = (void *)key;
+  msg->key_len = strlen(key);
+  ctx->ready_num++;
+
+  batch->buffer = NULL;
+  batch->fill = 0;
+  return 0;
+} /* }}} int kafka_batch_close */
+
+/* Hands all queued messages to librdkafka in one call. Ownership of the
+ * payloads passes to librdkafka (RD_KAFKA_MSG_F_FREE), except for those it
+ * refused to enqueue. */
+static int kafka_produce_ready(struct kafka_topic_context *ctx) /* {{{ */
+{
+  int produced;
+  int failed = 0;
+  rd_kafka_resp_err_t err = RD_KAFKA_RESP_ERR_NO_ERROR;
+
+  if (ctx->ready_num == 0)
+    return 0;
+
+  produced = rd_kafka_produce_batch(ctx->topic, RD_KAFKA_PARTITION_UA,
+                                    RD_KAFKA_MSG_F_FREE, ctx->ready,
+                                    (int)ctx->ready_num);
+
+  if (produced != (int)ctx->ready_num) {
+    for (size_t i = 0; i < ctx->ready_num; i++) {
+      if (ctx->ready[i].err == RD_KAFKA_RESP_ERR_NO_ERROR)
+        continue;
+      err = ctx->ready[i].err;
+      sfree(ctx->ready[i].payload);
+      failed++;
+    }
+  }
+  ctx->ready_num = 0;
+
+  if (failed > 0) {
+    c_complain(LOG_ERR, &ctx->produce_complaint,
+               "write_kafka plugin: Dropped %i message(s) for topic \"%s\": "
+               "%s",
+               failed, ctx->topic_name, rd_kafka_err2str(err));
+    return -1;
+  }
+
+  c_release(LOG_INFO, &ctx->produce_complaint,
+            "write_kafka plugin: Producing to topic \"%s\" succeeded again.",
+            ctx->topic_name);
+  return 0;
+} /* }}} int kafka_produce_ready */
+
+/* Closes all batches that were started at or before "older_than" and produces
+ * them. Pass zero to flush everything. */
+static int kafka_batch_flush_nolock(struct kafka_topic_context *ctx, /* {{{ */
+                                    cdtime_t older_than) {
+  c_avl_iterator_t *iter;
+  struct kafka_batch *batch;
+  char *key;
+
+  if (ctx->batches == NULL || ctx->topic == NULL)
+    return 0;
+
+  ctx->batch_oldest = 0;
+
+  iter = c_avl_get_iterator(ctx->batches);
+  while (c_avl_iterator_next(iter, (void *)&key, (void *)&batch) == 0) {
+    if (batch->fill == 0)
+      continue;
+
+    if (older_than == 0 || batch->first_time <= older_than) {
+      kafka_batch_close(ctx, batch);
+      continue;
+    }
+
+    if (ctx->batch_oldest == 0 || batch->first_time < ctx->batch_oldest)
+      ctx->batch_oldest = batch->first_time;
+  }
+  c_avl_iterator_destroy(iter);
+
+  return kafka_produce_ready(ctx);
+} /* }}} int kafka_batch_flush_nolock */
+
+static struct kafka_batch *
+kafka_batch_get(struct kafka_topic_context *ctx, /* {{{ */
+                const value_list_t *vl) {
+  struct kafka_batch *batch = NULL;
+  const char *name = ctx->key_by_host ? vl->host : "";
+
+  if (c_avl_get(ctx->batches, name, (void *)&batch) == 0)
+    return batch;
+
+  if ((batch = calloc(1, sizeof(*batch))) == NULL) {
+    ERROR("write_kafka plugin: calloc failed.");
+    return NULL;
+  }
+  if ((batch->key = strdup(name)) == NULL) {
+    ERROR("write_kafka plugin: strdup failed.");
+    sfree(batch);
+    return NULL;
+  }
+  if (c_avl_insert(ctx->batches, batch->key, batch) != 0) {
+    ERROR("write_kafka plugin: c_avl_insert failed.");
+    sfree(batch->key);
+    sfree(batch);
+    return NULL;
+  }
+
+  return batch;
+} /* }}} struct kafka_batch *kafka_batch_get */
+
+/* Appends one formatted record to the value list's batch. Every record ends
+ * with a newline, so consumers can split a batched message into exactly the
+ * messages the unbatched mode would have sent. */
+static int kafka_batch_append(struct kafka_topic_context *ctx, /* {{{ */
+                              const value_list_t *vl, const char *record,
+                              size_t record_len) {
+  struct kafka_batch *batch;
+  bool newline = (record_len == 0) || (record[record_len - 1] != '\n');
+  size_t len = record_len + (newline ? 1 : 0);
+  int status = 0;
+
+  if ((batch = kafka_batch_get(ctx, vl)) == NULL)
+    return ENOMEM;
+
+  if (batch->fill > 0 && (batch->fill + len) > ctx->batch_size) {
+    kafka_batch_close(ctx, batch);
+    status = kafka_produce_ready(ctx);
+  }
+
+  if (batch->buffer == NULL) {
+    /* A record larger than BatchSize is sent as a message of its own. */
+    batch->buffer = malloc((len > ctx->batch_size) ? len : ctx->batch_size);
+    if (batch->buffer == NULL) {
+      ERROR("write_kafka plugin: malloc failed.");
+      return ENOMEM;
+    }
+    batch->first_time = cdtime();
+    if (ctx->batch_oldest == 0 || batch->first_time < ctx->batch_oldest)
+      ctx->batch_oldest = batch->first_time;
+  }
+
+  memcpy(batch->buffer + batch->fill, record, record_len);
+  batch->fill += record_len;
+  if (newline)
+    batch->buffer[batch->fill++] = '\n';
+
+  return status;
+} /* }}} int kafka_batch_append */
+
+static int kafka_write(const data_set_t *ds, /* {{{ */
+                       const value_list_t *vl, user_data_t *ud) {
+  int status = 0;
+  void *key;
+  size_t keylen = 0;
+  char buffer[8192];
+  size_t blen = 0;
+  struct kafka_topic_context *ctx = ud->data;
+
+  if ((ds == NULL) || (vl == NULL) || (ctx == NULL))
+    return EINVAL;
+
+  pthread_mutex_lock(&ctx->lock);
+  status = kafka_handle(ctx);
+  pthread_mutex_unlock(&ctx->lock);
+  if (status != 0)
+    return status;
+
+  status = kafka_format(ctx, ds, vl, buffer, sizeof(buffer));
+  if (status != 0)
+    return status;
+  blen = strlen(buffer);
+
+  if (ctx->batch_size > 0) {
+    pthread_mutex_lock(&ctx->lock);
+    status = kafka_batch_append(ctx, vl, buffer, blen);
+    if ((ctx->batch_oldest != 0) &&
+        (ctx->batch_oldest + ctx->batch_timeout <= cdtime()))
+      kafka_batch_flush_nolock(ctx, cdtime() - ctx->batch_timeout);
+    pthread_mutex_unlock(&ctx->lock);
+    return status;
+  }
+
+  if (ctx->key_by_host)
+    key = (void *)vl->host;
+  else if (ctx->key != NULL)
+    key = ctx->key;
+  else
+    key = kafka_random_key(KAFKA_RANDOM_KEY_BUFFER);
   keylen = strlen(key);
 
   rd_kafka_produce(ctx->topic, RD_KAFKA_PARTITION_UA, RD_KAFKA_MSG_F_COPY,
@@ -234,6 +466,45 @@ static int kafka_write(const data_set_t *ds, /* {{{ */
   return status;
 } /* }}} int kafka_write */
 
+static int kafka_flush(cdtime_t timeout, /* {{{ */
+                       const char *identifier __attribute__((unused)),
+                       user_data_t *ud) {
+  struct kafka_topic_context *ctx = ud->data;
+  int status;
+
+  if (ctx == NULL)
+    return EINVAL;
+
+  /* timeout == 0  => flush unconditionally */
+  pthread_mutex_lock(&ctx->lock);
+  status = kafka_batch_flush_nolock(ctx, (timeout > 0) ? cdtime() - timeout
+                                                       : 0);
+  pthread_mutex_unlock(&ctx->lock);
+
+  return status;
+} /* }}} int kafka_flush */
+
+/* Sends the batches which have waited for "BatchTimeout", also if no further
+ * values arrive for the topic. Registered as a read callback. */
+static int kafka_batch_timeout(user_data_t *ud) /* {{{ */
+{
+  struct kafka_topic_context *ctx = ud->data;
+  cdtime_t now = cdtime();
+
+  if (ctx == NULL)
+    return EINVAL;
+
+  pthread_mutex_lock(&ctx->lock);
+  if ((ctx->batch_oldest != 0) &&
+      (ctx->batch_oldest + ctx->batch_timeout <= now))
+    kafka_batch_flush_nolock(ctx, now - ctx->batch_timeout);
+  pthread_mutex_unlock(&ctx->lock);
+
+  /* Failures have been reported already. Returning an error would only make
+   * the daemon check less often. */
+  return 0;
+} /* }}} int kafka_batch_timeout */
+
 static void kafka_topic_context_free(void *p) /* {{{ */
 {
   struct kafka_topic_context *ctx = p;
@@ -241,6 +512,27 @@ static void kafka_topic_context_free(void *p) /* {{{ */
   if (ctx == NULL)
     return;
 
+  if (ctx->batches != NULL) {
+    struct kafka_batch *batch;
+    char *key;
+
+    kafka_batch_flush_nolock(ctx, /* older_than = */ 0);
+    while (c_avl_pick(ctx->batches, (void *)&key, (void *)&batch) == 0) {
+      sfree(batch->buffer);
+      sfree(batch->key);
+      sfree(batch);
+    }
+    c_avl_destroy(ctx->batches);
+    ctx->batches = NULL;
+  }
+  sfree(ctx->ready);
+
+#if RD_KAFKA_VERSION >= 0x000902ff
+  /* Give queued messages a chance to reach the broker. */
+  if (ctx->kafka != NULL)
+    rd_kafka_flush(ctx->kafka, /* timeout_ms = */ 1000);
+#endif
+
   if (ctx->topic_name != NULL)
     sfree(ctx->topic_name);
   if (ctx->topic != NULL)
@@ -343,6 +635,9 @@ static void kafka_config_topic(rd_kafka_conf_t *conf,
       if (strcasecmp("Random", tctx->key) == 0) {
         sfree(tctx->key);
         tctx->key = strdup(kafka_random_key(KAFKA_RANDOM_KEY_BUFFER));
+      } else if (strcasecmp("Host", tctx->key) == 0) {
+        sfree(tctx->key);
+        tctx->key_by_host = true;
       }
     } else if (strcasecmp("Format", child->key) == 0) {
       status = cf_util_get_string(child, &key);
@@ -366,6 +661,23 @@ static void kafka_config_topic(rd_kafka_conf_t *conf,
 
       sfree(key);
 
+    } else if (strcasecmp("BatchSize", child->key) == 0) {
+      int tmp = 0;
+      status = cf_util_get_int(child, &tmp);
+      if (status == 0 && tmp < 0) {
+        WARNING("write_kafka plugin: The \"BatchSize\" option must not be "
+                "negative.");
+        status = -1;
+      }
+      if (status == 0)
+        tctx->batch_size = (size_t)tmp;
+    } else if (strcasecmp("BatchTimeout", child->key) == 0) {
+      status = cf_util_get_cdtime(child, &tctx->batch_timeout);
+      if (status == 0 && tctx->batch_timeout == 0) {
+        WARNING("write_kafka plugin: The \"BatchTimeout\" option must be "
+                "positive.");
+        status = -1;
+      }
     } else if (strcasecmp("StoreRates", child->key) == 0) {
       status = cf_util_get_boolean(child, &tctx->store_rates);
       (void)cf_util_get_flag(child, &tctx->graphite_flags,
@@ -407,6 +719,17 @@ static void kafka_config_topic(rd_kafka_conf_t *conf,
       break;
   }
 
+  if (tctx->batch_size > 0) {
+    if (tctx->batch_timeout == 0)
+      tctx->batch_timeout = plugin_get_interval();
+    tctx->batches = c_avl_create((int (*)(const void *, const void *))strcmp);
+    if (tctx->batches == NULL) {
+      ERROR("write_kafka plugin: c_avl_create failed.");
+      goto errout;
+    }
+    C_COMPLAIN_INIT(&tctx->produce_complaint);
+  }
+
   rd_kafka_topic_conf_set_partitioner_cb(tctx->conf, kafka_partition);
   rd_kafka_topic_conf_set_opaque(tctx->conf, tctx);
 
@@ -427,8 +750,18 @@ static void kafka_config_topic(rd_kafka_conf_t *conf,
 
   pthread_mutex_init(&tctx->lock, /* attr = */ NULL);
 
+  if (tctx->batch_size > 0) {
+    plugin_register_flush(callback_name, kafka_flush,
+                          &(user_data_t){.data = tctx});
+    plugin_register_complex_read(/* group = */ "write_kafka", callback_name,
+                                 kafka_batch_timeout, tctx->batch_timeout / 2,
+                                 &(user_data_t){.data = tctx});
+  }
+
   return;
 errout:
+  if (tctx->batches != NULL)
+    c_avl_destroy(tctx->batches);
   if (tctx->topic_name != NULL)
     free(tctx->topic_name);
   if (tctx->conf != NULL)
@@ -36,6 +36,13 @@
 
 #include <microhttpd.h>
 
+#if HAVE_LIBZ
+#include <zlib.h>
+#endif
+#if HAVE_LIBZSTD
+#include <zstd.h>
+#endif
+
 #include <netdb.h>
 #include <sys/socket.h>
 #include <sys/types.h>
@@ -46,6 +53,15 @@
 
 #define VARINT_UINT32_BYTES 5
 
+/* Initial size of the buffers holding a serialized metric family. */
+#define FRAGMENT_MIN_SIZE 256
+
+/* Alignment of the objects in a copy of a metric family, see family_copy(). */
+#define FAMILY_COPY_ALIGN 16
+
+/* Size of the chunks in which responses are sent. */
+#define SCRAPE_BLOCK_SIZE 65536
+
 #define CONTENT_TYPE_PROTO                                                     \
   "application/vnd.google.protobuf; proto=io.prometheus.client.MetricFamily; " \
   "encoding=delimited"
@@ -57,6 +73,77 @@
 #define MHD_RESULT int
 #endif
 
+#ifndef MHD_SIZE_UNKNOWN
+#define MHD_SIZE_UNKNOWN ((uint64_t)-1LL)
+#endif
+#ifndef MHD_CONTENT_READER_END_OF_STREAM
+#define MHD_CONTENT_READER_END_OF_STREAM ((ssize_t)-1)
+#define MHD_CONTENT_READER_END_WITH_ERROR ((ssize_t)-2)
+#endif
+
+/* fragment_t is a buffer holding a serialized metric family. Fragments are not
+ * modified once they have been encoded: a family that changed gets a new
+ * fragment. The reference count is protected by "metrics_lock". */
+typedef struct {
+  uint8_t *data;
+  size_t len;
+  size_t size;
+  size_t refcount;
+} fragment_t;
+
+/* metric_family_t wraps a metric family and caches its serialized forms. The
+ * "metrics" tree holds pointers to "fam", which is the first member, so the
+ * wrapper can be retrieved with METRIC_FAMILY(). Writers only increment
+ * "generation"; a fragment is current if it has been encoded from the same
+ * generation. */
+typedef struct {
+  Io__Prometheus__Client__MetricFamily fam;
+  uint64_t generation;
+
+  fragment_t *text;
+  fragment_t *proto;
+  uint64_t text_generation;
+  uint64_t proto_generation;
+} metric_family_t;
+
+#define METRIC_FAMILY(f) ((metric_family_t *)(f))
+
+/* family_snapshot_t is a copy of a metric family which is serialized by a
+ * scrape without holding "metrics_lock". */
+typedef struct {
+  Io__Prometheus__Client__MetricFamily *copy;
+  uint64_t generation;
+} family_snapshot_t;
+
+typedef enum {
+  ENCODING_IDENTITY = 0,
+  ENCODING_GZIP,
+  ENCODING_ZSTD,
+} content_encoding_t;
+
+/* scrape_t is the state of a single HTTP response. It references the
+ * fragments of all metric families as of the time of the request, so that the
+ * response can be compressed and streamed without holding "metrics_lock". */
+typedef struct {
+  fragment_t **fragments;
+  size_t fragments_num;
+  size_t size;
+
+  /* Read position: the next byte to send is fragments[index]->data[offset]. */
+  size_t index;
+  size_t offset;
+
+  content_encoding_t encoding;
+  bool finished;
+#if HAVE_LIBZ
+  z_stream zs;
+  bool zs_initialized;
+#endif
+#if HAVE_LIBZSTD
+  ZSTD_CCtx *zstd;
+#endif
+} scrape_t;
+
 static c_avl_tree_t *metrics;
 static pthread_mutex_t metrics_lock = PTHREAD_MUTEX_INITIALIZER;
 
@@ -83,32 +170,6 @@ static size_t varint(uint8_t buffer[static VARINT_UINT32_BYTES],
   return 0;
 }
 
-/* format_protobuf iterates over all metric families in "metrics" and adds them
- * to a buffer in ProtoBuf format. It prefixes each protobuf with its encoded
- * size, the so called "delimited" format. */
-static void format_protobuf(ProtobufCBuffer *buffer) {
-  pthread_mutex_lock(&metrics_lock);
-
-  char *unused_name;
-  Io__Prometheus__Client__MetricFamily *fam;
-  c_avl_iterator_t *iter = c_avl_get_iterator(metrics);
-  while (c_avl_iterator_next(iter, (void *)&unused_name, (void *)&fam) == 0) {
-    /* Prometheus uses a message length prefix to determine where one
-     * MetricFamily ends and the next begins. This delimiter is encoded as a
-     * "varint", which is common in Protobufs. */
-    uint8_t delim[VARINT_UINT32_BYTES] = {0};
-    size_t delim_len = varint(
-        delim,
-        (uint32_t)io__prometheus__client__metric_family__get_packed_size(fam));
-    buffer->append(buffer, delim_len, delim);
-
-    io__prometheus__client__metric_family__pack_to_buffer(fam, buffer);
-  }
-  c_avl_iterator_destroy(iter);
-
-  pthread_mutex_unlock(&metrics_lock);
-}
-
 static char const *escape_label_value(char *buffer, size_t buffer_size,
                                       char const *value) {
   /* shortcut for values that don't need escaping. */
@@ -179,56 +240,623 @@ static char *format_labels(char *buffer, size_t buffer_size,
   return buffer;
 }
 
-/* format_protobuf iterates over all metric families in "metrics" and adds them
- * to a buffer in plain text format. */
-static void format_text(ProtobufCBuffer *buffer) {
+static fragment_t *fragment_create(void) {
+  fragment_t *f = calloc(1, sizeof(*f));
+  if (f == NULL)
+    return NULL;
+
+  f->refcount = 1;
+  return f;
+}
+
+/* fragment_unref drops a reference to the fragment, freeing it when the last
+ * reference is gone. Must be called with "metrics_lock" held. */
+static void fragment_unref(fragment_t *f) {
+  if (f == NULL)
+    return;
+
+  assert(f->refcount > 0);
+  f->refcount--;
+  if (f->refcount > 0)
+    return;
+
+  sfree(f->data);
+  sfree(f);
+}
+
+/* fragment_reserve makes sure that at least "size" more bytes can be appended
+ * to the fragment. */
+static int fragment_reserve(fragment_t *f, size_t size) {
+  if ((f->size - f->len) >= size)
+    return 0;
+
+  size_t new_size = (f->size != 0) ? f->size : FRAGMENT_MIN_SIZE;
+  while ((new_size - f->len) < size)
+    new_size *= 2;
+
+  uint8_t *tmp = realloc(f->data, new_size);
+  if (tmp == NULL)
+    return ENOMEM;
+  f->data = tmp;
+  f->size = new_size;
+
+  return 0;
+}
+
+static int fragment_append(fragment_t *f, void const *data, size_t size) {
+  int status = fragment_reserve(f, size);
+  if (status != 0)
+    return status;
+
+  memcpy(f->data + f->len, data, size);
+  f->len += size;
+  return 0;
+}
+
+/* family_format_protobuf serializes a metric family in ProtoBuf format. It
+ * prefixes the protobuf with its encoded size, the so called "delimited"
+ * format. */
+static int family_format_protobuf(fragment_t *f,
+                                  Io__Prometheus__Client__MetricFamily *fam) {
+  size_t size = io__prometheus__client__metric_family__get_packed_size(fam);
+
+  /* Prometheus uses a message length prefix to determine where one
+   * MetricFamily ends and the next begins. This delimiter is encoded as a
+   * "varint", which is common in Protobufs. */
+  uint8_t delim[VARINT_UINT32_BYTES] = {0};
+  size_t delim_len = varint(delim, (uint32_t)size);
+
+  int status = fragment_reserve(f, delim_len + size);
+  if (status != 0)
+    return status;
+
+  memcpy(f->data + f->len, delim, delim_len);
+  f->len += delim_len;
+  f->len += io__prometheus__client__metric_family__pack(fam, f->data + f->len);
+
+  return 0;
+}
+
+/* family_format_text serializes a metric family in plain text format. */
+static int family_format_text(fragment_t *f,
+                              Io__Prometheus__Client__MetricFamily *fam) {
+  char line[1024]; /* 4x DATA_MAX_NAME_LEN? */
+
+  ssnprintf(line, sizeof(line), "# HELP %s %s\n", fam->name, fam->help);
+  int status = fragment_append(f, line, strlen(line));
+  if (status != 0)
+    return status;
+
+  ssnprintf(line, sizeof(line), "# TYPE %s %s\n", fam->name,
+            (fam->type == IO__PROMETHEUS__CLIENT__METRIC_TYPE__GAUGE)
+                ? "gauge"
+                : "counter");
+  status = fragment_append(f, line, strlen(line));
+  if (status != 0)
+    return status;
+
+  for (size_t i = 0; i < fam->n_metric; i++) {
+    Io__Prometheus__Client__Metric *m = fam->metric[i];
+
+    char labels[1024];
+
+    char timestamp_ms[24] = "";
+    if (m->has_timestamp_ms)
+      ssnprintf(timestamp_ms, sizeof(timestamp_ms), " %" PRIi64,
+                m->timestamp_ms);
+
+    if (fam->type == IO__PROMETHEUS__CLIENT__METRIC_TYPE__GAUGE)
+      ssnprintf(line, sizeof(line), "%s{%s} " GAUGE_FORMAT "%s\n", fam->name,
+                format_labels(labels, sizeof(labels), m), m->gauge->value,
+                timestamp_ms);
+    else /* if (fam->type == IO__PROMETHEUS__CLIENT__METRIC_TYPE__COUNTER) */
+      ssnprintf(line, sizeof(line), "%s{%s} %.0f%s\n", fam->name,
+                format_labels(labels, sizeof(labels), m), m->counter->value,
+                timestamp_ms);
+
+    status = fragment_append(f, line, strlen(line));
+    if (status != 0)
+      return status;
+  }
+
+  return 0;
+}
+
+/* family_copy_size rounds "size" up so that every object placed by
+ * family_copy_alloc() is suitably aligned. */
+static size_t family_copy_size(size_t size) {
+  return (size + FAMILY_COPY_ALIGN - 1) & ~((size_t)FAMILY_COPY_ALIGN - 1);
+}
+
+static void *family_copy_alloc(uint8_t **pos, size_t size) {
+  void *ptr = *pos;
+  *pos += family_copy_size(size);
+  return ptr;
+}
+
+static char *family_copy_string(uint8_t **pos, char const *str) {
+  size_t len = strlen(str) + 1;
+  char *copy = family_copy_alloc(pos, len);
+  memcpy(copy, str, len);
+  return copy;
+}
+
+/* family_copy creates a deep copy of a metric family in a single allocation,
+ * so that the family can be serialized without holding "metrics_lock". Copying
+ * is much cheaper than serializing. The copy is freed with sfree(). Must be
+ * called with "metrics_lock" held. */
+static Io__Prometheus__Client__MetricFamily *
+family_copy(Io__Prometheus__Client__MetricFamily const *fam) {
+  size_t size = family_copy_size(sizeof(*fam)) +
+                family_copy_size(fam->n_metric * sizeof(*fam->metric)) +
+                family_copy_size(strlen(fam->name) + 1) +
+                family_copy_size(strlen(fam->help) + 1);
+  for (size_t i = 0; i < fam->n_metric; i++) {
+    Io__Prometheus__Client__Metric const *m = fam->metric[i];
+
+    size += family_copy_size(sizeof(*m)) +
+            family_copy_size(m->n_label * sizeof(*m->label));
+    if (m->gauge != NULL)
+      size += family_copy_size(sizeof(*m->gauge));
+    if (m->counter != NULL)
+      size += family_copy_size(sizeof(*m->counter));
+    for (size_t j = 0; j < m->n_label; j++)
+      size += family_copy_size(sizeof(*m->label[j])) +
+              family_copy_size(strlen(m->label[j]->name) + 1) +
+              family_copy_size(strlen(m->label[j]->value) + 1);
+  }
+
+  uint8_t *pos = malloc(size);
+  if (pos == NULL)
+    return NULL;
+
+  Io__Prometheus__Client__MetricFamily *copy =
+      family_copy_alloc(&pos, sizeof(*copy));
+  *copy = *fam;
+  copy->name = family_copy_string(&pos, fam->name);
+  copy->help = family_copy_string(&pos, fam->help);
+  copy->metric =
+      family_copy_alloc(&pos, fam->n_metric * sizeof(*copy->metric));
+
+  for (size_t i = 0; i < fam->n_metric; i++) {
+    Io__Prometheus__Client__Metric const *m = fam->metric[i];
+    Io__Prometheus__Client__Metric *mc = family_copy_alloc(&pos, sizeof(*mc));
+
+    *mc = *m;
+    if (m->gauge != NULL) {
+      mc->gauge = family_copy_alloc(&pos, sizeof(*mc->gauge));
+      *mc->gauge = *m->gauge;
+    }
+    if (m->counter != NULL) {
+      mc->counter = family_copy_alloc(&pos, sizeof(*mc->counter));
+      *mc->counter = *m->counter;
+    }
+
+    mc->label = family_copy_alloc(&pos, m->n_label * sizeof(*mc->label));
+    for (size_t j = 0; j < m->n_label; j++) {
+      Io__Prometheus__Client__LabelPair *lc =
+          family_copy_alloc(&pos, sizeof(*lc));
+
+      *lc = *m->label[j];
+      lc->name = family_copy_string(&pos, m->label[j]->name);
+      lc->value = family_copy_string(&pos, m->label[j]->value);
+      mc->label[j] = lc;
+    }
+
+    copy->metric[i] = mc;
+  }
+
+  return copy;
+}
+
+/* family_encode serializes a metric family into a new fragment. */
+static fragment_t *family_encode(Io__Prometheus__Client__MetricFamily *fam,
+                                 bool want_proto) {
+  fragment_t *f = fragment_create();
+  if (f == NULL)
+    return NULL;
+
+  int status = want_proto ? family_format_protobuf(f, fam)
+                          : family_format_text(f, fam);
+  if (status != 0) {
+    ERROR("write_prometheus plugin: Serializing metric family \"%s\" failed "
+          "with status %d",
+          fam->name, status);
+    sfree(f->data);
+    sfree(f);
+    return NULL;
+  }
+
+  return f;
+}
+
+/* scrape_destroy releases all resources held by a scrape. It is used as the
+ * "free" callback of microhttpd's response. */
+static void scrape_destroy(void *arg) {
+  scrape_t *s = arg;
+  if (s == NULL)
+    return;
+
   pthread_mutex_lock(&metrics_lock);
+  for (size_t i = 0; i < s->fragments_num; i++)
+    fragment_unref(s->fragments[i]);
+  pthread_mutex_unlock(&metrics_lock);
+  sfree(s->fragments);
+
+#if HAVE_LIBZ
+  if (s->zs_initialized)
+    deflateEnd(&s->zs);
+#endif
+#if HAVE_LIBZSTD
+  ZSTD_freeCCtx(s->zstd);
+#endif
+
+  sfree(s);
+}
+
+/* scrape_create references the serialized forms of all metric families in
+ * "metrics". Families that have changed since they were last serialized are
+ * copied while holding "metrics_lock" and serialized after releasing it, so
+ * writers are only blocked for as long as it takes to copy the changes. */
+static scrape_t *scrape_create(bool want_proto, content_encoding_t encoding) {
+  scrape_t *s = calloc(1, sizeof(*s));
+  if (s == NULL)
+    return NULL;
+  s->encoding = encoding;
+
+  fragment_t *footer = NULL;
+  if (!want_proto) {
+    char server[1024];
+    ssnprintf(server, sizeof(server), "\n# collectd/write_prometheus %s at %s\n",
+              PACKAGE_VERSION, hostname_g);
+
+    /* The footer is not shared, so it may be released without holding
+     * "metrics_lock". */
+    footer = fragment_create();
+    if ((footer == NULL) ||
+        (fragment_append(footer, server, strlen(server)) != 0)) {
+      fragment_unref(footer);
+      sfree(s);
+      return NULL;
+    }
+  }
+
+  pthread_mutex_lock(&metrics_lock);
+
+  /* One extra element each: "fragments" needs room for the footer, and
+   * calloc() is never asked for zero elements. */
+  size_t families_num = (size_t)c_avl_size(metrics);
+  family_snapshot_t *snapshots = calloc(families_num + 1, sizeof(*snapshots));
+  s->fragments = calloc(families_num + 1, sizeof(*s->fragments));
+  if ((snapshots == NULL) || (s->fragments == NULL)) {
+    fragment_unref(footer);
+    pthread_mutex_unlock(&metrics_lock);
+    sfree(snapshots);
+    sfree(s->fragments);
+    sfree(s);
+    return NULL;
+  }
 
+  /* Reference the current fragments and copy the families without one. The
+   * slots of "snapshots" and "fragments" correspond to each other. */
   char *unused_name;
   Io__Prometheus__Client__MetricFamily *fam;
   c_avl_iterator_t *iter = c_avl_get_iterator(metrics);
-  while (c_avl_iterator_next(iter, (void *)&unused_name, (void *)&fam) == 0) {
-    char line[1024]; /* 4x DATA_MAX_NAME_LEN? */
-
-    ssnprintf(line, sizeof(line), "# HELP %s %s\n", fam->name, fam->help);
-    buffer->append(buffer, strlen(line), (uint8_t *)line);
-
-    ssnprintf(line, sizeof(line), "# TYPE %s %s\n", fam->name,
-              (fam->type == IO__PROMETHEUS__CLIENT__METRIC_TYPE__GAUGE)
-                  ? "gauge"
-                  : "counter");
-    buffer->append(buffer, strlen(line), (uint8_t *)line);
-
-    for (size_t i = 0; i < fam->n_metric; i++) {
-      Io__Prometheus__Client__Metric *m = fam->metric[i];
-
-      char labels[1024];
-
-      char timestamp_ms[24] = "";
-      if (m->has_timestamp_ms)
-        ssnprintf(timestamp_ms, sizeof(timestamp_ms), " %" PRIi64,
-                  m->timestamp_ms);
-
-      if (fam->type == IO__PROMETHEUS__CLIENT__METRIC_TYPE__GAUGE)
-        ssnprintf(line, sizeof(line), "%s{%s} " GAUGE_FORMAT "%s\n", fam->name,
-                  format_labels(labels, sizeof(labels), m), m->gauge->value,
-                  timestamp_ms);
-      else /* if (fam->type == IO__PROMETHEUS__CLIENT__METRIC_TYPE__COUNTER) */
-        ssnprintf(line, sizeof(line), "%s{%s} %.0f%s\n", fam->name,
-                  format_labels(labels, sizeof(labels), m), m->counter->value,
-                  timestamp_ms);
-
-      buffer->append(buffer, strlen(line), (uint8_t *)line);
+  for (size_t i = 0;
+       (i < families_num) &&
+       (c_avl_iterator_next(iter, (void *)&unused_name, (void *)&fam) == 0);
+       i++) {
+    metric_family_t *mf = METRIC_FAMILY(fam);
+    fragment_t *f = want_proto ? mf->proto : mf->text;
+    uint64_t generation =
+        want_proto ? mf->proto_generation : mf->text_generation;
+
+    if ((f != NULL) && (generation == mf->generation)) {
+      f->refcount++;
+      s->fragments[i] = f;
+      continue;
     }
+
+    snapshots[i].copy = family_copy(fam);
+    snapshots[i].generation = mf->generation;
+    if (snapshots[i].copy == NULL)
+      ERROR("write_prometheus plugin: Copying metric family \"%s\" failed.",
+            fam->name);
   }
   c_avl_iterator_destroy(iter);
 
-  char server[1024];
-  ssnprintf(server, sizeof(server), "\n# collectd/write_prometheus %s at %s\n",
-            PACKAGE_VERSION, hostname_g);
-  buffer->append(buffer, strlen(server), (uint8_t *)server);
+  pthread_mutex_unlock(&metrics_lock);
+
+  for (size_t i = 0; i < families_num; i++) {
+    if (snapshots[i].copy != NULL)
+      s->fragments[i] = family_encode(snapshots[i].copy, want_proto);
+  }
+
+  pthread_mutex_lock(&metrics_lock);
+
+  /* Cache the new fragments, unless the family has changed or has been
+   * removed in the meantime, and drop the slots of families that could not be
+   * serialized. */
+  for (size_t i = 0; i < families_num; i++) {
+    fragment_t *f = s->fragments[i];
+
+    if ((snapshots[i].copy != NULL) && (f != NULL) &&
+        (c_avl_get(metrics, snapshots[i].copy->name, (void *)&fam) == 0)) {
+      metric_family_t *mf = METRIC_FAMILY(fam);
+      fragment_t **cached = want_proto ? &mf->proto : &mf->text;
+      uint64_t *generation =
+          want_proto ? &mf->proto_generation : &mf->text_generation;
+
+      if ((mf->generation == snapshots[i].generation) &&
+          ((*cached == NULL) || (*generation != snapshots[i].generation))) {
+        fragment_unref(*cached);
+        f->refcount++;
+        *cached = f;
+        *generation = snapshots[i].generation;
+      }
+    }
+    sfree(snapshots[i].copy);
+
+    if ((f == NULL) || (f->len == 0)) {
+      fragment_unref(f);
+      continue;
+    }
+
+    s->fragments[s->fragments_num] = f;
+    s->fragments_num++;
+    s->size += f->len;
+  }
 
   pthread_mutex_unlock(&metrics_lock);
+  sfree(snapshots);
+
+  if (footer != NULL) {
+    s->fragments[s->fragments_num] = footer;
+    s->fragments_num++;
+    s->size += footer->len;
+  }
+
+  int status = 0;
+#if HAVE_LIBZ
+  if (encoding == ENCODING_GZIP) {
+    /* 15 window bits plus 16 selects the gzip format. Scrapes are large and
+     * time sensitive, so favor speed over compression ratio. */
+    status = deflateInit2(&s->zs, Z_BEST_SPEED, Z_DEFLATED, 15 + 16,
+                          /* memLevel = */ 8, Z_DEFAULT_STRATEGY);
+    if (status != Z_OK)
+      ERROR("write_prometheus plugin: deflateInit2 failed with status %d",
+            status);
+    else
+      s->zs_initialized = true;
+  }
+#endif
+#if HAVE_LIBZSTD
+  if (encoding == ENCODING_ZSTD) {
+    s->zstd = ZSTD_createCCtx();
+    if (s->zstd == NULL) {
+      ERROR("write_prometheus plugin: ZSTD_createCCtx failed.");
+      status = -1;
+    }
+  }
+#endif
+  if (status != 0) {
+    scrape_destroy(s);
+    return NULL;
+  }
+
+  return s;
+}
+
+/* scrape_input returns the next chunk of uncompressed data, or zero when the
+ * end of the response has been reached. */
+static size_t scrape_input(scrape_t *s, uint8_t const **ret_data) {
+  while (s->index < s->fragments_num) {
+    fragment_t const *f = s->fragments[s->index];
+    if (s->offset < f->len) {
+      *ret_data = f->data + s->offset;
+      return f->len - s->offset;
+    }
+
+    s->index++;
+    s->offset = 0;
+  }
+
+  *ret_data = NULL;
+  return 0;
+}
+
+static ssize_t scrape_read_identity(scrape_t *s, char *buf, size_t max) {
+  size_t len = 0;
+  while (len < max) {
+    uint8_t const *data;
+    size_t avail = scrape_input(s, &data);
+    if (avail == 0)
+      break;
+
+    size_t n = (avail < (max - len)) ? avail : (max - len);
+    memcpy(buf + len, data, n);
+    s->offset += n;
+    len += n;
+  }
+
+  return (ssize_t)len;
+}
+
+#if HAVE_LIBZ
+static ssize_t scrape_read_gzip(scrape_t *s, char *buf, size_t max) {
+  if (max > UINT_MAX)
+    max = UINT_MAX;
+
+  s->zs.next_out = (Bytef *)buf;
+  s->zs.avail_out = (uInt)max;
+
+  while (!s->finished && (s->zs.avail_out > 0)) {
+    uint8_t const *data;
+    size_t avail = scrape_input(s, &data);
+    if (avail > UINT_MAX)
+      avail = UINT_MAX;
+
+    s->zs.next_in = (Bytef *)data;
+    s->zs.avail_in = (uInt)avail;
+
+    int status = deflate(&s->zs, (avail == 0) ? Z_FINISH : Z_NO_FLUSH);
+    s->offset += avail - s->zs.avail_in;
+
+    if (status == Z_STREAM_END) {
+      s->finished = true;
+    } else if (status != Z_OK) {
+      ERROR("write_prometheus plugin: deflate failed with status %d", status);
+      return -1;
+    }
+  }
+
+  return (ssize_t)(max - s->zs.avail_out);
+}
+#endif
+
+#if HAVE_LIBZSTD
+static ssize_t scrape_read_zstd(scrape_t *s, char *buf, size_t max) {
+  ZSTD_outBuffer out = {.dst = buf, .size = max, .pos = 0};
+
+  while (!s->finished && (out.pos < out.size)) {
+    uint8_t const *data;
+    size_t avail = scrape_input(s, &data);
+
+    ZSTD_inBuffer in = {.src = data, .size = avail, .pos = 0};
+    ZSTD_EndDirective mode = (avail == 0) ? ZSTD_e_end : ZSTD_e_continue;
+
+    size_t remaining = ZSTD_compressStream2(s->zstd, &out, &in, mode);
+    if (ZSTD_isError(remaining)) {
+      ERROR("write_prometheus plugin: ZSTD_compressStream2 failed: %s",
+            ZSTD_getErrorName(remaining));
+      return -1;
+    }
+    s->offset += in.pos;
+
+    if ((mode == ZSTD_e_end) && (remaining == 0))
+      s->finished = true;
+  }
+
+  return (ssize_t)out.pos;
+}
+#endif
+
+/* scrape_read is the content reader callback of microhttpd's response. It
+ * fills "buf" with the next chunk of the (possibly compressed) response. */
+static ssize_t scrape_read(void *arg, __attribute__((unused)) uint64_t pos,
+                           char *buf, size_t max) {
+  scrape_t *s = arg;
+  ssize_t len;
+
+  switch (s->encoding) {
+#if HAVE_LIBZ
+  case ENCODING_GZIP:
+    len = scrape_read_gzip(s, buf, max);
+    break;
+#endif
+#if HAVE_LIBZSTD
+  case ENCODING_ZSTD:
+    len = scrape_read_zstd(s, buf, max);
+    break;
+#endif
+  default:
+    len = scrape_read_identity(s, buf, max);
+    break;
+  }
+
+  if (len < 0)
+    return MHD_CONTENT_READER_END_WITH_ERROR;
+  if (len == 0)
+    return MHD_CONTENT_READER_END_OF_STREAM;
+  return len;
+}
+
+#if HAVE_LIBZ || HAVE_LIBZSTD
+/* encoding_quality returns the quality which the "Accept-Encoding" header
+ * assigns to the given content coding, taken from the coding's own entry or,
+ * if it is not listed, from the "*" entry. Zero means that the coding must not
+ * be used. */
+static double encoding_quality(char const *header, char const *coding) {
+  if (header == NULL)
+    return 0.0;
+
+  size_t coding_len = strlen(coding);
+  double coding_q = -1.0; /* negative: not listed */
+  double wildcard_q = -1.0;
+
+  char const *ptr = header;
+  while (*ptr != 0) {
+    ptr += strspn(ptr, " \t,");
+    if (*ptr == 0)
+      break;
+
+    size_t name_len = strcspn(ptr, " \t,;");
+    bool is_coding =
+        (name_len == coding_len) && (strncasecmp(ptr, coding, name_len) == 0);
+    bool is_wildcard = (name_len == 1) && (ptr[0] == '*');
+
+    char const *end = ptr + strcspn(ptr, ",");
+    double q = 1.0;
+    for (char const *p = ptr + name_len; p < end; p++) {
+      if (*p != ';')
+        continue;
+      p += 1 + strspn(p + 1, " \t");
+      if ((p >= end) || ((p[0] != 'q') && (p[0] != 'Q')) || (p[1] != '='))
+        continue;
+
+      /* A malformed quality refuses the coding rather than accepting it. */
+      char *q_end = NULL;
+      q = strtod(p + 2, &q_end);
+      if ((q_end == p + 2) || !(q >= 0.0))
+        q = 0.0;
+      else if (q > 1.0)
+        q = 1.0;
+    }
+    ptr = end;
+
+    if (is_coding)
+      coding_q = q;
+    else if (is_wildcard)
+      wildcard_q = q;
+  }
+
+  if (coding_q >= 0.0)
+    return coding_q;
+  if (wildcard_q >= 0.0)
+    return wildcard_q;
+  return 0.0;
+}
+#endif
+
+/* choose_encoding picks the content coding of the response based on the
+ * client's "Accept-Encoding" header: the supported coding with the highest
+ * non-zero quality, preferring zstd over gzip if both are equally acceptable.
+ */
+static content_encoding_t choose_encoding(struct MHD_Connection *connection) {
+  content_encoding_t encoding = ENCODING_IDENTITY;
+
+#if HAVE_LIBZ || HAVE_LIBZSTD
+  char const *header = MHD_lookup_connection_value(
+      connection, MHD_HEADER_KIND, MHD_HTTP_HEADER_ACCEPT_ENCODING);
+  double best = 0.0;
+#endif
+
+#if HAVE_LIBZSTD
+  double zstd_q = encoding_quality(header, "zstd");
+  if (zstd_q > best) {
+    encoding = ENCODING_ZSTD;
+    best = zstd_q;
+  }
+#endif
+#if HAVE_LIBZ
+  double gzip_q = encoding_quality(header, "gzip");
+  if (gzip_q > best) {
+    encoding = ENCODING_GZIP;
+    best = gzip_q;
+  }
+#endif
+
+  return encoding;
 }
 
 /* http_handler is the callback called by the microhttpd library. It essentially
@@ -255,30 +883,37 @@ static MHD_RESULT http_handler(void *cls, struct MHD_Connection *connection,
                                                    MHD_HTTP_HEADER_ACCEPT);
   bool want_proto = (accept != NULL) &&
                     (strstr(accept, "application/vnd.google.protobuf") != NULL);
+  content_encoding_t encoding = choose_encoding(connection);
 
-  uint8_t scratch[4096] = {0};
-  ProtobufCBufferSimple simple = PROTOBUF_C_BUFFER_SIMPLE_INIT(scratch);
-  ProtobufCBuffer *buffer = (ProtobufCBuffer *)&simple;
+  scrape_t *s = scrape_create(want_proto, encoding);
+  if (s == NULL)
+    return MHD_NO;
 
-  if (want_proto)
-    format_protobuf(buffer);
-  else
-    format_text(buffer);
+  /* The size of the compressed response is not known in advance; microhttpd
+   * uses chunked transfer encoding in that case. */
+  uint64_t size = (encoding == ENCODING_IDENTITY) ? (uint64_t)s->size
+                                                  : MHD_SIZE_UNKNOWN;
+  struct MHD_Response *res = MHD_create_response_from_callback(
+      size, SCRAPE_BLOCK_SIZE, scrape_read, s, scrape_destroy);
+  if (res == NULL) {
+    scrape_destroy(s);
+    return MHD_NO;
+  }
 
-#if defined(MHD_VERSION) && MHD_VERSION >= 0x00090500
-  struct MHD_Response *res = MHD_create_response_from_buffer(
-      simple.len, simple.data, MHD_RESPMEM_MUST_COPY);
-#else
-  struct MHD_Response *res = MHD_create_response_from_data(
-      simple.len, simple.data, /* must_free = */ 0, /* must_copy = */ 1);
-#endif
   MHD_add_response_header(res, MHD_HTTP_HEADER_CONTENT_TYPE,
                           want_proto ? CONTENT_TYPE_PROTO : CONTENT_TYPE_TEXT);
+#if HAVE_LIBZ || HAVE_LIBZSTD
+  MHD_add_response_header(res, MHD_HTTP_HEADER_VARY,
+                          MHD_HTTP_HEADER_ACCEPT_ENCODING);
+#endif
+  if (encoding == ENCODING_GZIP)
+    MHD_add_response_header(res, MHD_HTTP_HEADER_CONTENT_ENCODING, "gzip");
+  else if (encoding == ENCODING_ZSTD)
+    MHD_add_response_header(res, MHD_HTTP_HEADER_CONTENT_ENCODING, "zstd");
 
   MHD_RESULT status = MHD_queue_response(connection, MHD_HTTP_OK, res);
 
   MHD_destroy_response(res);
-  PROTOBUF_C_BUFFER_SIMPLE_CLEAR(&simple);
   return status;
 }
 
@@ -615,6 +1250,12 @@ static int metric_family_update(Io__Prometheus__Client__MetricFamily *fam,
                        vl->interval);
 }
 
+/* metric_family_touch marks the serialized forms of a metric family as
+ * outdated. */
+static void metric_family_touch(Io__Prometheus__Client__MetricFamily *fam) {
+  METRIC_FAMILY(fam)->generation++;
+}
+
 /* metric_family_destroy frees the memory used by a metric family. */
 static void metric_family_destroy(Io__Prometheus__Client__MetricFamily *msg) {
   if (msg == NULL)
@@ -628,16 +1269,23 @@ static void metric_family_destroy(Io__Prometheus__Client__MetricFamily *msg) {
   }
   sfree(msg->metric);
 
-  sfree(msg);
+  metric_family_t *mf = METRIC_FAMILY(msg);
+  fragment_unref(mf->text);
+  fragment_unref(mf->proto);
+
+  sfree(mf);
 }
 
 /* metric_family_create allocates and initializes a new metric family. */
 static Io__Prometheus__Client__MetricFamily *
 metric_family_create(char *name, data_set_t const *ds, value_list_t const *vl,
                      size_t ds_index) {
-  Io__Prometheus__Client__MetricFamily *msg = calloc(1, sizeof(*msg));
-  if (msg == NULL)
+  metric_family_t *mf = calloc(1, sizeof(*mf));
+  if (mf == NULL)
     return NULL;
+  mf->generation = 1;
+
+  Io__Prometheus__Client__MetricFamily *msg = &mf->fam;
   io__prometheus__client__metric_family__init(msg);
 
   msg->name = name;
@@ -924,6 +1572,7 @@ static int prom_write(data_set_t const *ds, value_list_t const *vl,
     if (fam == NULL)
       continue;
 
+    metric_family_touch(fam);
     int status = metric_family_update(fam, ds, vl, i);
     if (status != 0) {
       ERROR("write_prometheus plugin: Updating metric \"%s\" failed with "
@@ -959,6 +1608,7 @@ static int prom_missing(value_list_t const *vl,
 
       continue;
     }
+    metric_family_touch(fam);
 
     if (fam->n_metric == 0) {
       int status = c_avl_remove(metrics, fam->name, NULL, NULL);